@@ -0,0 +1,168 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "common/clock.h"
+#include "common/shared_memory_bus.h"
+#include "gesturerecognition/bus_messages.h"
+#include "pianoapp/performance_recorder.h"
+
+using common::BusMessage;
+using common::BusMessageType;
+using common::BusReadResult;
+
+namespace {
+
+/**
+ * The messages of each type read in the last second, and those which were
+ * overwritten while they were being read.
+ */
+struct MessageCounts {
+  int frames = 0;
+  int masks = 0;
+  int hands = 0;
+  int notes = 0;
+  int malformed = 0;
+  int torn = 0;
+};
+
+void PrintUsage() {
+  std::cerr << "Usage: gesture-piano-bus-reader <bus_name> [options]\n"
+            << "  --slow-ms <ms>    sleep after every message, to see how a "
+               "consumer which falls behind is told so\n"
+            << "  --count <n>       exit after reading n messages\n"
+            << "  --notes           print every note event\n";
+}
+
+/**
+ * Decodes the message the way a real consumer would, and counts it.
+ * @return  false if it was not well formed
+ */
+bool ReadMessage(const BusMessage& message, bool print_notes,
+                 MessageCounts& counts) {
+  switch (message.type) {
+    case BusMessageType::FRAME: {
+      gesturerecognition::CapturedFrame frame;
+      if (!gesturerecognition::ReadFrame(message, frame)) {
+        return false;
+      }
+      // Touches the pixels, like a consumer which processes them.
+      cv::mean(frame.data_);
+      ++counts.frames;
+      return true;
+    }
+    case BusMessageType::MASK: {
+      cv::Mat mask;
+      if (!gesturerecognition::ReadMask(message, mask)) {
+        return false;
+      }
+      cv::countNonZero(mask.reshape(1));
+      ++counts.masks;
+      return true;
+    }
+    case BusMessageType::RLE_MASK: {
+      gesturerecognition::RleMask mask;
+      if (!gesturerecognition::ReadRleMask(message, mask)) {
+        return false;
+      }
+      mask.GetArea();
+      ++counts.masks;
+      return true;
+    }
+    case BusMessageType::HANDS: {
+      std::pair<gesturerecognition::Hand, gesturerecognition::Hand> hands;
+      if (!gesturerecognition::ReadHands(message, hands)) {
+        return false;
+      }
+      ++counts.hands;
+      return true;
+    }
+    case BusMessageType::NOTE_EVENT: {
+      piano::NoteEvent event;
+      if (!piano::ReadNoteEvent(message, event)) {
+        return false;
+      }
+      if (print_notes) {
+        std::cout << (event.type == piano::NoteEventType::PRESS ? "press "
+                                                                 : "release ")
+                  << static_cast<int>(event.midi_note) << ", "
+                  << (event.trigger_time_ns - event.capture_time_ns) / 1000
+                  << " us after capture\n";
+      }
+      ++counts.notes;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    PrintUsage();
+    return 1;
+  }
+  std::string bus_name = argv[1];
+  int slow_ms = 0;
+  long long count = 0;
+  bool print_notes = false;
+  for (int i = 2; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--slow-ms") == 0 && i + 1 < argc) {
+      slow_ms = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+      count = std::stoll(argv[++i]);
+    } else if (std::strcmp(argv[i], "--notes") == 0) {
+      print_notes = true;
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  common::SharedMemoryBusReader reader(bus_name);
+  MessageCounts counts;
+  long long read_messages = 0;
+  int64_t report_time_ns = common::GetTimestampNanoseconds();
+  bool closed = false;
+  while (!closed && (count == 0 || read_messages < count)) {
+    BusMessage message;
+    BusReadResult result = reader.Next(message);
+    if (result == BusReadResult::MESSAGE) {
+      if (!ReadMessage(message, print_notes, counts)) {
+        ++counts.malformed;
+      }
+      // Whatever was read is only whole if the writer has not reached it yet.
+      if (!reader.IsValid(message)) {
+        ++counts.torn;
+      }
+      ++read_messages;
+      if (slow_ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(slow_ms));
+      }
+    } else if (result == BusReadResult::NO_MESSAGE) {
+      reader.Wait(100);
+    } else if (result == BusReadResult::CLOSED) {
+      closed = true;
+    }
+    int64_t now_ns = common::GetTimestampNanoseconds();
+    if (now_ns - report_time_ns >= 1000000000 || closed) {
+      std::cout << "frames " << counts.frames << ", masks " << counts.masks
+                << ", hands " << counts.hands << ", notes " << counts.notes
+                << ", malformed " << counts.malformed << ", torn "
+                << counts.torn << " | overruns " << reader.GetOverruns()
+                << ", lost " << reader.GetLostMessages() << "\n";
+      counts = MessageCounts();
+      report_time_ns = now_ns;
+    }
+  }
+  if (closed) {
+    std::cout << "The writer closed the bus\n";
+  }
+  std::cout << "Read " << read_messages << " messages, lost "
+            << reader.GetLostMessages() << " in " << reader.GetOverruns()
+            << " overruns\n";
+  return 0;
+}
@@ -0,0 +1,464 @@
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+
+#include "common/clock.h"
+#include "common/latency.h"
+#include "common/metrics.h"
+#include "common/shared_memory_bus.h"
+#include "common/thread_policy.h"
+#include "gesturerecognition/gesture_wrapper.h"
+#include "pianoapp/audio_backend.h"
+#include "pianoapp/piano_engine.h"
+
+using gesturerecognition::GestureWrapper;
+using gesturerecognition::ProgramSettings;
+using gesturerecognition::StageTimings;
+
+namespace {
+
+/**
+ * Keeps the total and the maximum time of a pipeline stage over all frames.
+ */
+struct StageStatistics {
+  std::string name;
+  double total_ms = 0;
+  double max_ms = 0;
+
+  void Add(double milliseconds) {
+    total_ms += milliseconds;
+    max_ms = std::max(max_ms, milliseconds);
+  }
+};
+
+/**
+ * The processing time of the recognised frames the frame gate skipped and
+ * of the ones it let through.
+ */
+struct GateStatistics {
+  int skipped_frames = 0;
+  int processed_frames = 0;
+  double skipped_ms = 0;
+  double processed_ms = 0;
+
+  /**
+   * Returns the processing time the skipped frames would have taken had they
+   * been processed, minus the time they took.
+   */
+  double GetSavedMilliseconds() const {
+    if (skipped_frames == 0 || processed_frames == 0) {
+      return 0;
+    }
+    return skipped_frames * (processed_ms / processed_frames) - skipped_ms;
+  }
+};
+
+const int64_t DEFAULT_FRAME_INTERVAL_NS = 1000000000 / 30;
+
+void PrintUsage() {
+  std::cerr << "Usage: gesture-piano-cli <video_file> [options]\n"
+            << "  --config <file>           the config file (config.json)\n"
+            << "  --train-frames <n>        frames used to learn the "
+               "background before recognition starts (30)\n"
+            << "  --hsv <lh ls lv hh hs hv> the HSV filter ranges\n"
+            << "  --auto-hsv                estimate the HSV filter ranges "
+               "from the hands in the boxes of the first frames\n"
+            << "  --per-frame               print the stage timings of every "
+               "frame as CSV\n"
+            << "  --metrics <file>          write all metrics as JSON when "
+               "done\n"
+            << "  --latency                 print the latency breakdown of "
+               "every note\n"
+            << "  --synthetic-clock         timestamp frames one frame "
+               "interval apart instead of with the real clock, so that only "
+               "the latency added by the algorithms is measured and every run "
+               "gives the same numbers\n"
+            << "  --max-latency-ms <ms>     exit with 2 if the p99 note "
+               "latency is higher\n"
+            << "  --profile <file>          load the calibration profile "
+               "instead of learning the background, and save it after "
+               "learning\n"
+            << "  --yuv <format> <w> <h>    read the video file as raw yuyv "
+               "or nv12 frames of the given size, and filter them without "
+               "converting them to BGR\n"
+            << "  --buffers <n>             the number of buffers the YUV "
+               "stand-in device fills (4)\n"
+            << "  --paced                   deliver the YUV frames at their "
+               "frame rate, dropping those that come while every buffer is "
+               "held, like a camera\n"
+            << "  --finger-tips <detector>  find the finger tips with "
+               "convexity_defects or column_profile\n"
+            << "  --keypoint-model <file>   find the hands with this keypoint "
+               "network while playing\n"
+            << "  --keypoint-int8 <file>    the same with its int8 version\n"
+            << "  --bus <name>              publish every frame, mask, pair "
+               "of hands and note on the shared memory bus, for "
+               "gesture-piano-bus-reader\n";
+}
+}  // namespace
+
+/**
+ * Runs the whole gesture piano pipeline on a video file without opening any
+ * windows or playing any sound, and prints how long each stage took.
+ */
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    PrintUsage();
+    return 1;
+  }
+  std::string video_file_name = argv[1];
+  std::string config_file_name = "config.json";
+  int train_frames = 30;
+  bool per_frame = false;
+  std::string metrics_file_name;
+  bool print_latency = false;
+  bool use_synthetic_clock = false;
+  double max_latency_ms = 0;
+  std::string profile_file_name;
+  bool auto_hsv = false;
+  bool has_hsv_range = false;
+  cv::Scalar low_hsv;
+  cv::Scalar high_hsv;
+  std::string yuv_pixel_format;
+  cv::Size yuv_frame_size;
+  int capture_buffer_count = 0;
+  bool capture_paced = false;
+  std::string bus_name;
+  std::string finger_tip_detector;
+  std::string keypoint_model_file;
+  std::string keypoint_int8_model_file;
+  for (int i = 2; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+      config_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--train-frames") == 0 && i + 1 < argc) {
+      train_frames = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--hsv") == 0 && i + 6 < argc) {
+      low_hsv = cv::Scalar(std::stoi(argv[i + 1]), std::stoi(argv[i + 2]),
+                           std::stoi(argv[i + 3]));
+      high_hsv = cv::Scalar(std::stoi(argv[i + 4]), std::stoi(argv[i + 5]),
+                            std::stoi(argv[i + 6]));
+      has_hsv_range = true;
+      i += 6;
+    } else if (std::strcmp(argv[i], "--auto-hsv") == 0) {
+      auto_hsv = true;
+    } else if (std::strcmp(argv[i], "--per-frame") == 0) {
+      per_frame = true;
+    } else if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+      metrics_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--latency") == 0) {
+      print_latency = true;
+    } else if (std::strcmp(argv[i], "--synthetic-clock") == 0) {
+      use_synthetic_clock = true;
+    } else if (std::strcmp(argv[i], "--max-latency-ms") == 0 && i + 1 < argc) {
+      max_latency_ms = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+      profile_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--yuv") == 0 && i + 3 < argc) {
+      yuv_pixel_format = argv[i + 1];
+      yuv_frame_size =
+          cv::Size(std::stoi(argv[i + 2]), std::stoi(argv[i + 3]));
+      i += 3;
+    } else if (std::strcmp(argv[i], "--buffers") == 0 && i + 1 < argc) {
+      capture_buffer_count = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--paced") == 0) {
+      capture_paced = true;
+    } else if (std::strcmp(argv[i], "--finger-tips") == 0 && i + 1 < argc) {
+      finger_tip_detector = argv[++i];
+    } else if (std::strcmp(argv[i], "--keypoint-model") == 0 &&
+               i + 1 < argc) {
+      keypoint_model_file = argv[++i];
+    } else if (std::strcmp(argv[i], "--keypoint-int8") == 0 && i + 1 < argc) {
+      keypoint_int8_model_file = argv[++i];
+    } else if (std::strcmp(argv[i], "--bus") == 0 && i + 1 < argc) {
+      bus_name = argv[++i];
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  ProgramSettings settings(config_file_name);
+  settings.video_file_name = video_file_name;
+  settings.show_debug_windows = false;
+  // Runs only use a profile when asked to, so that they stay repeatable.
+  settings.calibration_profile_file = profile_file_name;
+  if (!yuv_pixel_format.empty()) {
+    settings.capture_pixel_format = yuv_pixel_format;
+    settings.yuv_frame_size = yuv_frame_size;
+  }
+  if (capture_buffer_count > 0) {
+    settings.capture_buffer_count = static_cast<size_t>(capture_buffer_count);
+  }
+  settings.capture_paced = capture_paced;
+  if (!finger_tip_detector.empty()) {
+    settings.finger_tip_detector = finger_tip_detector;
+  }
+  if (!keypoint_int8_model_file.empty()) {
+    settings.keypoint_model.int8_model_file = keypoint_int8_model_file;
+    settings.keypoint_model.use_int8 = true;
+  } else if (!keypoint_model_file.empty()) {
+    settings.keypoint_model.model_file = keypoint_model_file;
+    settings.keypoint_model.use_int8 = false;
+  }
+  common::ThreadPolicies thread_policies(settings.thread_policy_config);
+  thread_policies.LockMemory();
+  // This thread captures, filters and plays every frame.
+  thread_policies.Apply(common::PIPELINE_THREAD);
+  GestureWrapper gesture_wrapper(settings);
+  gesture_wrapper.SetThreadPolicies(&thread_policies);
+  if (has_hsv_range) {
+    gesture_wrapper.SetHSVRange(low_hsv, high_hsv);
+  }
+  piano::SilentAudioBackend audio_backend;
+  piano::PianoEngine piano_engine(
+      cv::Point(0, 0), settings.output_window_size.width,
+      settings.output_window_size.height, settings.row_margin,
+      piano::LoadKeyboardLayout(
+          settings.keyboard_layout_file, settings.piano_notes_file_name,
+          settings.number_of_white_keys, settings.number_of_rows),
+      audio_backend);
+  std::unique_ptr<common::SharedMemoryBusWriter> bus;
+  if (!bus_name.empty()) {
+    bus.reset(new common::SharedMemoryBusWriter(
+        bus_name, settings.bus_capacity_mb * 1024 * 1024));
+    gesture_wrapper.SetBus(bus.get());
+    piano_engine.SetBus(bus.get());
+  }
+  common::MetricsRegistry metrics;
+  gesture_wrapper.SetMetrics(&metrics);
+  piano_engine.SetMetrics(&metrics);
+  common::NoteLatencyRecorder latency_recorder(metrics);
+  common::SyntheticClock synthetic_clock;
+  int64_t synthetic_frame_interval_ns = 0;
+  if (use_synthetic_clock) {
+    synthetic_frame_interval_ns =
+        gesture_wrapper.GetSourceFrameInterval() > 0
+            ? gesture_wrapper.GetSourceFrameInterval()
+            : DEFAULT_FRAME_INTERVAL_NS;
+    gesture_wrapper.SetClock(synthetic_clock);
+    piano_engine.SetClock(synthetic_clock);
+  }
+
+  std::vector<StageStatistics> statistics(6);
+  const char* stage_names[] = {"capture",  "filter",  "extraction",
+                               "tracking", "drawing", "piano"};
+  for (size_t i = 0; i < statistics.size(); ++i) {
+    statistics[i].name = stage_names[i];
+  }
+  if (per_frame) {
+    std::cout << "frame,capture_ms,filter_ms,extraction_ms,tracking_ms,"
+                 "drawing_ms,piano_ms\n";
+  }
+
+  int frame_number = 0;
+  int recognised_frames = 0;
+  int notes_played = 0;
+  GateStatistics gated;
+  std::set<float> previously_pressed_keys;
+  if (auto_hsv) {
+    gesture_wrapper.ToggleAutoHSVCalibration();
+  }
+  // A loaded profile starts recognition straight away.
+  bool started_with_profile = gesture_wrapper.IsRecognitionMode();
+  if (!started_with_profile) {
+    gesture_wrapper.ToggleBackgroundCalibration();
+  }
+  int training_start_frame = 0;
+  int64_t start_time_ns = common::GetTimestampNanoseconds();
+  while (true) {
+    if (gesture_wrapper.IsBackgroundTraining() &&
+        frame_number - training_start_frame >= train_frames) {
+      gesture_wrapper.ToggleGestureRecognitionMode();
+    }
+    synthetic_clock.Advance(synthetic_frame_interval_ns);
+    bool was_training = gesture_wrapper.IsBackgroundTraining();
+    const std::vector<cv::Point>& click_points = gesture_wrapper.Update();
+    if (gesture_wrapper.IsEndOfStream()) {
+      break;
+    }
+    if (!was_training && gesture_wrapper.IsBackgroundTraining()) {
+      // The profile did not match the video.
+      training_start_frame = frame_number + 1;
+    }
+    int64_t piano_start_ns = common::GetTimestampNanoseconds();
+    piano_engine.Run(click_points, gesture_wrapper.GetLastCaptureTime(),
+                     gesture_wrapper.GetLastOnsetTimes());
+    double piano_ms = common::NanosecondsToMilliseconds(
+        common::GetTimestampNanoseconds() - piano_start_ns);
+    for (const common::PressTiming& press :
+         piano_engine.GetLastPressTimings()) {
+      common::NoteLatency latency = common::ComputeNoteLatency(
+          gesture_wrapper.GetLastFrameTimestamps(), press);
+      latency_recorder.Record(latency);
+      if (print_latency) {
+        std::cout << "frame " << frame_number << " " << latency.ToString()
+                  << "\n";
+      }
+    }
+
+    std::set<float> pressed_keys;
+    for (const auto& pair : piano_engine.getPressedKeys()) {
+      pressed_keys.insert(pair.first);
+      if (previously_pressed_keys.count(pair.first) == 0) {
+        ++notes_played;
+      }
+    }
+    previously_pressed_keys.swap(pressed_keys);
+
+    const StageTimings& timings = gesture_wrapper.GetLastStageTimings();
+    double frame_timings[] = {timings.capture_ms,    timings.filter_ms,
+                              timings.extraction_ms, timings.tracking_ms,
+                              timings.drawing_ms,    piano_ms};
+    if (gesture_wrapper.IsRecognitionMode()) {
+      // Training frames do not run the whole pipeline, so they would skew
+      // the averages.
+      for (size_t i = 0; i < statistics.size(); ++i) {
+        statistics[i].Add(frame_timings[i]);
+      }
+      ++recognised_frames;
+      double vision_ms = timings.filter_ms + timings.extraction_ms +
+                         timings.tracking_ms + timings.drawing_ms;
+      if (gesture_wrapper.WasLastFrameSkipped()) {
+        gated.skipped_ms += vision_ms;
+        ++gated.skipped_frames;
+      } else {
+        gated.processed_ms += vision_ms;
+        ++gated.processed_frames;
+      }
+    }
+    if (per_frame) {
+      std::cout << frame_number;
+      for (double milliseconds : frame_timings) {
+        std::cout << "," << milliseconds;
+      }
+      std::cout << "\n";
+    }
+    ++frame_number;
+  }
+  double wall_time_s = common::NanosecondsToMilliseconds(
+                           common::GetTimestampNanoseconds() - start_time_ns) /
+                       1000;
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Frames: " << frame_number << " (" << recognised_frames
+            << " in recognition mode)\n";
+  std::cout << "Notes played: " << notes_played << "\n";
+  if (gesture_wrapper.CountsDroppedFrames()) {
+    std::cout << "Frames dropped by the capture device: "
+              << gesture_wrapper.GetDroppedFrames() << "\n";
+  }
+  if (!settings.keypoint_model.GetModelFile().empty()) {
+    const common::LatencyHistogram& inference =
+        metrics.GetHistogram("keypoints.inference");
+    std::cout << "Keypoint inference: " << inference.GetCount()
+              << " frames, p50 "
+              << common::NanosecondsToMilliseconds(inference.GetPercentile(50))
+              << " ms, p99 "
+              << common::NanosecondsToMilliseconds(inference.GetPercentile(99))
+              << " ms, "
+              << metrics.GetCounter("keypoints.dropped_frames").Get()
+              << " frames dropped while it was busy\n";
+  }
+  if (bus != nullptr) {
+    std::cout << "Messages published on " << bus_name << ": "
+              << bus->GetPublishedMessages() << "\n";
+  }
+  std::cout << "Thread policies:\n";
+  for (const std::string& line : thread_policies.GetReport()) {
+    std::cout << "  " << line << "\n";
+  }
+  std::cout << "Final quality level: " << gesture_wrapper.GetQualityLevel()
+            << "\n";
+  if (recognised_frames > 0) {
+    double saved_ms = gated.GetSavedMilliseconds();
+    double spent_ms = gated.processed_ms + gated.skipped_ms;
+    std::cout << "Frames skipped by the gate: " << gated.skipped_frames
+              << " (" << 100.0 * gated.skipped_frames / recognised_frames
+              << "% of the recognised frames), saving " << saved_ms
+              << " ms of processing ("
+              << (saved_ms > 0 ? 100 * saved_ms / (spent_ms + saved_ms) : 0)
+              << "%)\n";
+  }
+  std::pair<cv::Scalar, cv::Scalar> hsv_range = gesture_wrapper.GetHSVRange();
+  std::cout << "HSV range: " << hsv_range.first[0] << " "
+            << hsv_range.first[1] << " " << hsv_range.first[2] << " to "
+            << hsv_range.second[0] << " " << hsv_range.second[1] << " "
+            << hsv_range.second[2] << "\n";
+  std::cout << "Time to playable: "
+            << common::NanosecondsToMilliseconds(
+                   gesture_wrapper.GetTimeToPlayable())
+            << " ms, " << gesture_wrapper.GetFramesToPlayable() << " frames ("
+            << (!gesture_wrapper.IsProfileLoaded() ? "without a profile"
+                : started_with_profile &&
+                        metrics.GetCounter("profile.rejections").Get() == 0
+                    ? "with a profile"
+                    : "profile rejected")
+            << ")\n";
+  for (const char* part : {"capture", "vision", "tracker_hold",
+                           "audio_scheduling", "total"}) {
+    const common::LatencyHistogram& latency =
+        metrics.GetHistogram(std::string("latency.") + part);
+    std::cout << "Note latency " << std::left << std::setw(17) << part
+              << std::right << " p50 "
+              << common::NanosecondsToMilliseconds(latency.GetPercentile(50))
+              << " ms, p99 "
+              << common::NanosecondsToMilliseconds(latency.GetPercentile(99))
+              << " ms, max "
+              << common::NanosecondsToMilliseconds(latency.GetMax())
+              << " ms\n";
+  }
+  if (!metrics_file_name.empty()) {
+    std::ofstream metrics_file(metrics_file_name);
+    metrics_file << metrics.ToJson().dump(2) << "\n";
+  }
+  int exit_code = 0;
+  double p99_latency_ms = common::NanosecondsToMilliseconds(
+      latency_recorder.GetTotalHistogram().GetPercentile(99));
+  if (max_latency_ms > 0 && p99_latency_ms > max_latency_ms) {
+    std::cerr << "The p99 note latency " << p99_latency_ms
+              << " ms is above " << max_latency_ms << " ms\n";
+    exit_code = 2;
+  }
+  std::cout << "Wall time: " << wall_time_s << " s ("
+            << (wall_time_s > 0 ? frame_number / wall_time_s : 0) << " fps)\n";
+  if (recognised_frames == 0) {
+    return exit_code;
+  }
+  std::cout << std::left << std::setw(12) << "stage" << std::right
+            << std::setw(12) << "mean ms" << std::setw(12) << "max ms" << "\n";
+  double total_mean_ms = 0;
+  for (const StageStatistics& stage : statistics) {
+    double mean_ms = stage.total_ms / recognised_frames;
+    total_mean_ms += mean_ms;
+    std::cout << std::left << std::setw(12) << stage.name << std::right
+              << std::setw(12) << mean_ms << std::setw(12) << stage.max_ms
+              << "\n";
+  }
+  std::cout << std::left << std::setw(12) << "total" << std::right
+            << std::setw(12) << total_mean_ms << "\n";
+  std::vector<gesturerecognition::FilterNodeTiming> node_timings =
+      gesture_wrapper.GetFilterNodeTimings();
+  if (!node_timings.empty()) {
+    // The nodes of a level run at once, so these add up to more than the
+    // filter stage.
+    std::cout << std::left << std::setw(20) << "filter node" << std::right
+              << std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms"
+              << "\n";
+    for (const gesturerecognition::FilterNodeTiming& node : node_timings) {
+      const common::LatencyHistogram& histogram =
+          metrics.GetHistogram("filter_graph." + node.name);
+      std::cout << std::left << std::setw(20) << node.name << std::right
+                << std::setw(12)
+                << common::NanosecondsToMilliseconds(
+                       histogram.GetPercentile(50))
+                << std::setw(12)
+                << common::NanosecondsToMilliseconds(
+                       histogram.GetPercentile(99))
+                << "\n";
+    }
+  }
+  return exit_code;
+}
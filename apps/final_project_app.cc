@@ -0,0 +1,169 @@
+#include <final_project_app.h>
+
+namespace finalproject {
+
+FinalProjectApp::FinalProjectApp()
+    : settings(gesturerecognition::CONFIG_FILE_PATH),
+      thread_policies(settings.thread_policy_config),
+      gesture_wrapper(settings),
+      piano_engine(cv::Point(0, 0), settings.output_window_size.width,
+                   settings.output_window_size.height, settings.row_margin,
+                   piano::LoadKeyboardLayout(settings.keyboard_layout_file,
+                                             settings.piano_notes_file_name,
+                                             settings.number_of_white_keys,
+                                             settings.number_of_rows),
+                   audio_backend),
+      replay_cursor(0),
+      replay_start_time_ns(0),
+      latency_recorder(metrics),
+      replay_frame_interval_ns(0),
+      show_metrics_overlay(settings.show_metrics_overlay),
+      time_to_playable_reported(false) {
+  ci::app::setWindowSize(settings.output_window_size.width,
+                         settings.output_window_size.height);
+  thread_policies.LockMemory();
+  // update, which captures, filters and plays every frame, runs on this
+  // thread.
+  thread_policies.Apply(common::PIPELINE_THREAD);
+  gesture_wrapper.SetThreadPolicies(&thread_policies);
+  audio_backend.SetThreadPolicies(&thread_policies);
+  if (!settings.replay_log_file.empty()) {
+    replay_events =
+        piano::PerformanceRecorder::LoadBinaryLog(settings.replay_log_file);
+    replay_start_time_ns = common::GetTimestampNanoseconds();
+  } else if (!settings.recording_file_prefix.empty()) {
+    recorder.reset(new piano::PerformanceRecorder(
+        settings.recording_file_prefix, settings.journal_capacity,
+        settings.journal_flush_interval_ms, &thread_policies));
+    piano_engine.SetRecorder(recorder.get());
+  }
+  if (!settings.bus_name.empty()) {
+    bus.reset(new common::SharedMemoryBusWriter(
+        settings.bus_name, settings.bus_capacity_mb * 1024 * 1024));
+    gesture_wrapper.SetBus(bus.get());
+    piano_engine.SetBus(bus.get());
+  }
+  gesture_wrapper.SetMetrics(&metrics);
+  piano_engine.SetMetrics(&metrics);
+  if (gesture_wrapper.IsReadingVideoFile()) {
+    replay_frame_interval_ns = gesture_wrapper.GetSourceFrameInterval() > 0
+                                   ? gesture_wrapper.GetSourceFrameInterval()
+                                   : DEFAULT_FRAME_INTERVAL_NS;
+    gesture_wrapper.SetClock(replay_clock);
+    piano_engine.SetClock(replay_clock);
+  }
+  if (!settings.metrics_file_name.empty()) {
+    metrics_writer.reset(new common::MetricsFileWriter(
+        metrics, settings.metrics_file_name,
+        settings.metrics_dump_interval_s * 1000, &thread_policies));
+  }
+}
+
+void FinalProjectApp::draw() {
+  ci::gl::clear(ci::ColorA::black());
+  piano_engine.DrawKeys(renderer);
+  if (show_metrics_overlay) {
+    DrawMetricsOverlay();
+  }
+  if (!replay_events.empty()) {
+    return;
+  }
+  gesture_wrapper.Draw();
+  for (const cv::Rect& box : gesture_wrapper.GetAutoHSVBoxes()) {
+    renderer.DrawStrokedRect(box, piano::RED);
+    renderer.DrawString("Hold a hand here", box.tl(), piano::RED);
+  }
+  if (gesture_wrapper.IsRecognitionMode()) {
+    for (const cv::Point& point : gesture_wrapper.GetRightFingerTips()) {
+      renderer.DrawSolidCircle(
+          point, static_cast<float>(settings.piano_circle_radius), piano::BLUE);
+    }
+    for (const cv::Point& point : gesture_wrapper.GetLeftFingerTips()) {
+      renderer.DrawSolidCircle(
+          point, static_cast<float>(settings.piano_circle_radius), piano::PINK);
+    }
+  }
+}
+
+void FinalProjectApp::DrawMetricsOverlay() {
+  std::vector<std::string> lines = metrics.GetOverlayLines();
+  renderer.DrawSolidRoundedRect(
+      cv::Rect2f(0, 0, OVERLAY_WIDTH, OVERLAY_LINE_HEIGHT * (lines.size() + 1)),
+      0, piano::BLACK);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    renderer.DrawString(
+        lines[i],
+        cv::Point2f(OVERLAY_LINE_HEIGHT / 2, OVERLAY_LINE_HEIGHT * (i + 0.5f)),
+        piano::WHITE);
+  }
+}
+
+void FinalProjectApp::update() {
+  if (!replay_events.empty()) {
+    // We play every event that is due, keeping the recorded spacing between
+    // the events.
+    int64_t elapsed_time_ns =
+        common::GetTimestampNanoseconds() - replay_start_time_ns;
+    while (replay_cursor < replay_events.size() &&
+           replay_events[replay_cursor].trigger_time_ns -
+                   replay_events.front().trigger_time_ns <=
+               elapsed_time_ns) {
+      piano_engine.Replay(replay_events[replay_cursor]);
+      ++replay_cursor;
+    }
+    return;
+  }
+  if (replay_frame_interval_ns > 0) {
+    replay_clock.Advance(replay_frame_interval_ns);
+  }
+  const std::vector<cv::Point>& click_points = gesture_wrapper.Update();
+  piano_engine.Run(click_points, gesture_wrapper.GetLastCaptureTime(),
+                   gesture_wrapper.GetLastOnsetTimes());
+  if (!time_to_playable_reported && gesture_wrapper.GetTimeToPlayable() > 0) {
+    ci::app::console() << "Playable after "
+                       << common::NanosecondsToMilliseconds(
+                              gesture_wrapper.GetTimeToPlayable())
+                       << " ms"
+                       << (gesture_wrapper.IsProfileLoaded()
+                               ? " with a calibration profile"
+                               : " without a calibration profile")
+                       << std::endl;
+    // By now every thread that was started has applied its policy.
+    for (const std::string& line : thread_policies.GetReport()) {
+      ci::app::console() << "Thread policy " << line << std::endl;
+    }
+    time_to_playable_reported = true;
+  }
+  if (settings.latency_measurement_mode) {
+    for (const common::PressTiming& press :
+         piano_engine.GetLastPressTimings()) {
+      common::NoteLatency latency = common::ComputeNoteLatency(
+          gesture_wrapper.GetLastFrameTimestamps(), press);
+      latency_recorder.Record(latency);
+      ci::app::console() << latency.ToString() << std::endl;
+    }
+  }
+}
+
+void FinalProjectApp::keyDown(ci::app::KeyEvent event) {
+  switch (event.getCode()) {
+    case ci::app::KeyEvent::KEY_h:
+      gesture_wrapper.ToggleHSVCalibration();
+      break;
+    case ci::app::KeyEvent::KEY_a:
+      gesture_wrapper.ToggleAutoHSVCalibration();
+      break;
+    case ci::app::KeyEvent::KEY_b:
+      gesture_wrapper.ToggleBackgroundCalibration();
+      break;
+    case ci::app::KeyEvent::KEY_y:
+      gesture_wrapper.ToggleGestureRecognitionMode();
+      break;
+    case ci::app::KeyEvent::KEY_m:
+      show_metrics_overlay = !show_metrics_overlay;
+      break;
+    case ci::app::KeyEvent::KEY_ESCAPE:
+      quit();
+  }
+}
+}  // namespace finalproject
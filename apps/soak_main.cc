@@ -0,0 +1,480 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+
+#include "common/clock.h"
+#include "common/latency.h"
+#include "common/metrics.h"
+#include "common/process_memory.h"
+#include "gesturerecognition/gesture_wrapper.h"
+#include "pianoapp/audio_backend.h"
+#include "pianoapp/piano_engine.h"
+
+namespace {
+// Every allocation through operator new, e.g by the STL containers. OpenCV
+// allocates its images itself, so those only show up in the resident size.
+std::atomic<uint64_t> allocations(0);
+std::atomic<uint64_t> deallocations(0);
+}  // namespace
+
+void* operator new(std::size_t size) {
+  void* pointer = std::malloc(size == 0 ? 1 : size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return pointer;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  void* pointer = std::malloc(size == 0 ? 1 : size);
+  if (pointer != nullptr) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+  if (pointer != nullptr) {
+    deallocations.fetch_add(1, std::memory_order_relaxed);
+    std::free(pointer);
+  }
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  operator delete(pointer);
+}
+
+using gesturerecognition::GestureWrapper;
+using gesturerecognition::PipelineState;
+using gesturerecognition::ProgramSettings;
+
+namespace {
+
+const char* const STAGE_NAMES[] = {"capture",  "filter",  "extraction",
+                                   "tracking", "drawing", "piano"};
+const size_t STAGES = 6;
+// Latencies that moved by less than this are not counted as drift, however
+// large the change is relative to them.
+const double MIN_DRIFT_MS = 0.1;
+
+/**
+ * Everything measured over one sampling interval, or at its end.
+ */
+struct Sample {
+  double elapsed_s = 0;
+  uint64_t frames = 0;      // Recognised frames in the interval
+  int64_t resident_bytes = 0;
+  uint64_t allocations = 0;  // In the interval
+  int64_t live_allocations = 0;
+  size_t pressed_keys = 0;
+  PipelineState state;
+  // The mean absolute difference between the background image and the one
+  // of the previous sample, i.e how much the model learnt in the interval.
+  double background_change = 0;
+  double stage_p50_ms[STAGES] = {0};
+  double stage_p99_ms[STAGES] = {0};
+  uint64_t notes = 0;
+  double note_p50_ms = 0;
+  double note_p99_ms = 0;
+};
+
+/**
+ * A value sampled over the run, and how it is checked.
+ */
+struct Series {
+  std::string name;
+  std::vector<double> values;
+  bool is_latency;  // Checked for drift instead of growth
+};
+
+void PrintUsage() {
+  std::cerr << "Usage: gesture-piano-soak <video_file> [options]\n"
+            << "  --config <file>           the config file (config.json)\n"
+            << "  --duration-s <s>          how long to play the video in a "
+               "loop (3600)\n"
+            << "  --sample-s <s>            how often to sample (10)\n"
+            << "  --warmup-s <s>            samples of the first seconds are "
+               "not checked (60)\n"
+            << "  --train-frames <n>        frames used to learn the "
+               "background before recognition starts (30)\n"
+            << "  --hsv <lh ls lv hh hs hv> the HSV filter ranges\n"
+            << "  --auto-hsv                estimate the HSV filter ranges "
+               "from the hands in the boxes of the first frames\n"
+            << "  --paced                   read the frames at the video's "
+               "frame rate, like a camera, instead of as fast as possible\n"
+            << "  --growth-threshold <f>    flag memory and state which grew "
+               "by more than this fraction (0.2)\n"
+            << "  --drift-threshold <f>     flag latencies which rose by more "
+               "than this fraction (0.25)\n"
+            << "  --out <file>              write the samples as CSV\n";
+}
+
+/**
+ * Returns whether a series kept growing: it ends more than the threshold
+ * above where it started, relative to its start or 1 if that is smaller,
+ * and rose in at least three quarters of the intervals in which it changed.
+ */
+bool IsGrowing(const std::vector<double>& values, double threshold) {
+  if (values.size() < 3) {
+    return false;
+  }
+  int rises = 0;
+  int falls = 0;
+  for (size_t i = 1; i < values.size(); ++i) {
+    if (values[i] > values[i - 1]) {
+      ++rises;
+    } else if (values[i] < values[i - 1]) {
+      ++falls;
+    }
+  }
+  double growth = values.back() - values.front();
+  return growth > threshold * std::max(std::abs(values.front()), 1.0) &&
+         rises >= 3 * falls;
+}
+
+/**
+ * Returns the mean of the last quarter of the series minus the mean of its
+ * first quarter.
+ */
+double GetDrift(const std::vector<double>& values) {
+  size_t quarter = std::max<size_t>(values.size() / 4, 1);
+  double first = 0;
+  double last = 0;
+  for (size_t i = 0; i < quarter; ++i) {
+    first += values[i];
+    last += values[values.size() - 1 - i];
+  }
+  return (last - first) / quarter;
+}
+
+/**
+ * Returns the mean of the first quarter of the series.
+ */
+double GetStart(const std::vector<double>& values) {
+  size_t quarter = std::max<size_t>(values.size() / 4, 1);
+  double first = 0;
+  for (size_t i = 0; i < quarter; ++i) {
+    first += values[i];
+  }
+  return first / quarter;
+}
+
+/**
+ * Turns the samples into one series per checked value.
+ */
+std::vector<Series> ToSeries(const std::vector<Sample>& samples) {
+  std::vector<Series> series = {{"resident_mb", {}, false},
+                                {"live_allocations", {}, false},
+                                {"pressed_keys", {}, false},
+                                {"held_hands", {}, false},
+                                {"click_points", {}, false},
+                                {"background_variance", {}, false},
+                                {"note_p99_ms", {}, true}};
+  for (const char* stage : STAGE_NAMES) {
+    series.push_back(Series{std::string(stage) + "_p99_ms", {}, true});
+  }
+  for (const Sample& sample : samples) {
+    if (sample.resident_bytes >= 0) {
+      series[0].values.push_back(sample.resident_bytes / 1e6);
+    }
+    series[1].values.push_back(static_cast<double>(sample.live_allocations));
+    series[2].values.push_back(static_cast<double>(sample.pressed_keys));
+    series[3].values.push_back(static_cast<double>(sample.state.held_hands));
+    series[4].values.push_back(static_cast<double>(sample.state.click_points));
+    // MOG2 does not report its variance.
+    if (sample.state.background.mean_variance >= 0) {
+      series[5].values.push_back(sample.state.background.mean_variance);
+    }
+    if (sample.notes > 0) {
+      series[6].values.push_back(sample.note_p99_ms);
+    }
+    for (size_t stage = 0; stage < STAGES; ++stage) {
+      series[7 + stage].values.push_back(sample.stage_p99_ms[stage]);
+    }
+  }
+  return series;
+}
+
+void WriteSamples(const std::string& file_name,
+                  const std::vector<Sample>& samples) {
+  std::ofstream ostream(file_name);
+  ostream << "elapsed_s,frames,resident_bytes,allocations,live_allocations,"
+             "pressed_keys,held_hands,click_points,foreground_fraction,"
+             "background_frames_learnt,background_variance,"
+             "background_change,notes,note_p50_ms,note_p99_ms";
+  for (const char* stage : STAGE_NAMES) {
+    ostream << "," << stage << "_p50_ms," << stage << "_p99_ms";
+  }
+  ostream << "\n";
+  for (const Sample& sample : samples) {
+    ostream << sample.elapsed_s << "," << sample.frames << ","
+            << sample.resident_bytes << "," << sample.allocations << ","
+            << sample.live_allocations << "," << sample.pressed_keys << ","
+            << sample.state.held_hands << "," << sample.state.click_points
+            << "," << sample.state.foreground_fraction << ","
+            << sample.state.background.frames_learnt << ","
+            << sample.state.background.mean_variance << ","
+            << sample.background_change << "," << sample.notes << ","
+            << sample.note_p50_ms << "," << sample.note_p99_ms;
+    for (size_t stage = 0; stage < STAGES; ++stage) {
+      ostream << "," << sample.stage_p50_ms[stage] << ","
+              << sample.stage_p99_ms[stage];
+    }
+    ostream << "\n";
+  }
+}
+
+double ToMilliseconds(const common::LatencyHistogram& histogram,
+                      double percentile) {
+  return common::NanosecondsToMilliseconds(
+      histogram.GetPercentile(percentile));
+}
+}  // namespace
+
+/**
+ * Plays a video in a loop through one pipeline for hours, as at an event,
+ * and samples its memory, the state it carries between frames and its
+ * latencies at fixed intervals. Exits with 2 if anything kept growing or
+ * the latencies drifted up.
+ */
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    PrintUsage();
+    return 1;
+  }
+  std::string video_file_name = argv[1];
+  std::string config_file_name = "config.json";
+  double duration_s = 3600;
+  double sample_s = 10;
+  double warmup_s = 60;
+  int train_frames = 30;
+  bool has_hsv_range = false;
+  cv::Scalar low_hsv;
+  cv::Scalar high_hsv;
+  bool auto_hsv = false;
+  bool paced = false;
+  double growth_threshold = 0.2;
+  double drift_threshold = 0.25;
+  std::string output_file_name;
+  for (int i = 2; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--config") == 0 && has_value) {
+      config_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--duration-s") == 0 && has_value) {
+      duration_s = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--sample-s") == 0 && has_value) {
+      sample_s = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--warmup-s") == 0 && has_value) {
+      warmup_s = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--train-frames") == 0 && has_value) {
+      train_frames = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--hsv") == 0 && i + 6 < argc) {
+      low_hsv = cv::Scalar(std::stoi(argv[i + 1]), std::stoi(argv[i + 2]),
+                           std::stoi(argv[i + 3]));
+      high_hsv = cv::Scalar(std::stoi(argv[i + 4]), std::stoi(argv[i + 5]),
+                            std::stoi(argv[i + 6]));
+      has_hsv_range = true;
+      i += 6;
+    } else if (std::strcmp(argv[i], "--auto-hsv") == 0) {
+      auto_hsv = true;
+    } else if (std::strcmp(argv[i], "--paced") == 0) {
+      paced = true;
+    } else if (std::strcmp(argv[i], "--growth-threshold") == 0 && has_value) {
+      growth_threshold = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--drift-threshold") == 0 && has_value) {
+      drift_threshold = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--out") == 0 && has_value) {
+      output_file_name = argv[++i];
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  ProgramSettings settings(config_file_name);
+  settings.video_file_name = video_file_name;
+  settings.show_debug_windows = false;
+  settings.calibration_profile_file.clear();
+  GestureWrapper gesture_wrapper(settings);
+  if (has_hsv_range) {
+    gesture_wrapper.SetHSVRange(low_hsv, high_hsv);
+  }
+  piano::SilentAudioBackend audio_backend;
+  piano::PianoEngine piano_engine(
+      cv::Point(0, 0), settings.output_window_size.width,
+      settings.output_window_size.height, settings.row_margin,
+      piano::LoadKeyboardLayout(
+          settings.keyboard_layout_file, settings.piano_notes_file_name,
+          settings.number_of_white_keys, settings.number_of_rows),
+      audio_backend);
+  const int64_t frame_interval_ns =
+      gesture_wrapper.GetSourceFrameInterval() > 0
+          ? gesture_wrapper.GetSourceFrameInterval()
+          : 1000000000 / 30;
+
+  // Recreated for every interval, so that each sample only has its own.
+  std::vector<std::unique_ptr<common::LatencyHistogram>> stage_histograms(
+      STAGES);
+  std::unique_ptr<common::LatencyHistogram> note_histogram;
+  auto reset_histograms = [&]() {
+    for (auto& histogram : stage_histograms) {
+      histogram.reset(new common::LatencyHistogram());
+    }
+    note_histogram.reset(new common::LatencyHistogram());
+  };
+  reset_histograms();
+
+  if (auto_hsv) {
+    gesture_wrapper.ToggleAutoHSVCalibration();
+  }
+  gesture_wrapper.ToggleBackgroundCalibration();
+  std::vector<Sample> samples;
+  cv::Mat last_background_image;
+  int frame_number = 0;
+  int training_start_frame = 0;
+  int loops = 1;
+  uint64_t interval_frames = 0;
+  uint64_t interval_start_allocations = allocations.load();
+  const int64_t start_time_ns = common::GetTimestampNanoseconds();
+  int64_t next_sample_ns = start_time_ns + static_cast<int64_t>(sample_s * 1e9);
+  int64_t next_frame_ns = start_time_ns;
+  const int64_t end_time_ns =
+      start_time_ns + static_cast<int64_t>(duration_s * 1e9);
+  while (common::GetTimestampNanoseconds() < end_time_ns) {
+    if (paced) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(
+          next_frame_ns - common::GetTimestampNanoseconds()));
+      next_frame_ns += frame_interval_ns;
+    }
+    if (gesture_wrapper.IsBackgroundTraining() &&
+        frame_number - training_start_frame >= train_frames) {
+      gesture_wrapper.ToggleGestureRecognitionMode();
+    }
+    const std::vector<cv::Point>& click_points = gesture_wrapper.Update();
+    if (gesture_wrapper.IsEndOfStream()) {
+      if (!gesture_wrapper.RewindVideo()) {
+        std::cerr << "The video cannot be played in a loop\n";
+        return 1;
+      }
+      ++loops;
+      continue;
+    }
+    int64_t piano_start_ns = common::GetTimestampNanoseconds();
+    piano_engine.Run(click_points, gesture_wrapper.GetLastCaptureTime(),
+                     gesture_wrapper.GetLastOnsetTimes());
+    int64_t piano_ns = common::GetTimestampNanoseconds() - piano_start_ns;
+    if (gesture_wrapper.IsRecognitionMode()) {
+      const gesturerecognition::StageTimings& timings =
+          gesture_wrapper.GetLastStageTimings();
+      double stage_ms[] = {timings.capture_ms,    timings.filter_ms,
+                           timings.extraction_ms, timings.tracking_ms,
+                           timings.drawing_ms};
+      for (size_t stage = 0; stage < STAGES - 1; ++stage) {
+        stage_histograms[stage]->Record(
+            static_cast<int64_t>(stage_ms[stage] * 1e6));
+      }
+      stage_histograms[STAGES - 1]->Record(piano_ns);
+      for (const common::PressTiming& press :
+           piano_engine.GetLastPressTimings()) {
+        note_histogram->Record(
+            common::ComputeNoteLatency(gesture_wrapper.GetLastFrameTimestamps(),
+                                       press)
+                .GetTotal());
+      }
+      ++interval_frames;
+    }
+    ++frame_number;
+
+    int64_t now_ns = common::GetTimestampNanoseconds();
+    if (now_ns < next_sample_ns) {
+      continue;
+    }
+    next_sample_ns += static_cast<int64_t>(sample_s * 1e9);
+    Sample sample;
+    sample.elapsed_s = (now_ns - start_time_ns) / 1e9;
+    sample.frames = interval_frames;
+    sample.resident_bytes = common::GetResidentMemoryBytes();
+    uint64_t allocated = allocations.load();
+    sample.allocations = allocated - interval_start_allocations;
+    sample.live_allocations = static_cast<int64_t>(allocated) -
+                              static_cast<int64_t>(deallocations.load());
+    sample.pressed_keys = piano_engine.getPressedKeys().size();
+    sample.state = gesture_wrapper.GetPipelineState();
+    const cv::Mat& background_image = sample.state.background.background_image;
+    if (!last_background_image.empty() &&
+        last_background_image.size() == background_image.size() &&
+        last_background_image.type() == background_image.type()) {
+      cv::Mat difference;
+      cv::absdiff(background_image, last_background_image, difference);
+      sample.background_change = cv::mean(difference)[0];
+    }
+    last_background_image = background_image;
+    for (size_t stage = 0; stage < STAGES; ++stage) {
+      sample.stage_p50_ms[stage] = ToMilliseconds(*stage_histograms[stage], 50);
+      sample.stage_p99_ms[stage] = ToMilliseconds(*stage_histograms[stage], 99);
+    }
+    sample.notes = note_histogram->GetCount();
+    sample.note_p50_ms = ToMilliseconds(*note_histogram, 50);
+    sample.note_p99_ms = ToMilliseconds(*note_histogram, 99);
+    // The state is not kept in the samples, only its summary.
+    sample.state.background.background_image.release();
+    samples.push_back(sample);
+    std::cout << std::fixed << std::setprecision(1) << sample.elapsed_s
+              << " s: " << sample.frames << " frames, "
+              << sample.resident_bytes / 1e6 << " MB resident, "
+              << sample.live_allocations << " live allocations, "
+              << sample.state.click_points << " click points, note p99 "
+              << std::setprecision(3) << sample.note_p99_ms << " ms\n";
+    reset_histograms();
+    interval_frames = 0;
+    interval_start_allocations = allocations.load();
+  }
+
+  if (!output_file_name.empty()) {
+    WriteSamples(output_file_name, samples);
+  }
+  // Only samples taken after the warm-up while recognising are checked.
+  std::vector<Sample> checked_samples;
+  for (const Sample& sample : samples) {
+    if (sample.elapsed_s >= warmup_s && sample.frames > 0) {
+      checked_samples.push_back(sample);
+    }
+  }
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Played " << frame_number << " frames in " << loops
+            << " loops, took " << samples.size() << " samples, checked "
+            << checked_samples.size() << "\n";
+  int flagged = 0;
+  for (const Series& series : ToSeries(checked_samples)) {
+    if (series.values.size() < 3) {
+      continue;
+    }
+    if (series.is_latency) {
+      double drift_ms = GetDrift(series.values);
+      double start_ms = GetStart(series.values);
+      if (drift_ms > MIN_DRIFT_MS && drift_ms > drift_threshold * start_ms) {
+        std::cout << "DRIFT " << series.name << ": from " << start_ms
+                  << " to " << start_ms + drift_ms << "\n";
+        ++flagged;
+      }
+    } else if (IsGrowing(series.values, growth_threshold)) {
+      std::cout << "GROWTH " << series.name << ": from "
+                << series.values.front() << " to " << series.values.back()
+                << "\n";
+      ++flagged;
+    }
+  }
+  if (flagged == 0) {
+    std::cout << "Nothing grew or drifted\n";
+  }
+  return flagged > 0 ? 2 : 0;
+}
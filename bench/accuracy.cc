@@ -0,0 +1,194 @@
+#include "accuracy.h"
+
+#include <algorithm>
+
+#include "gesturerecognition/hand_extractor.h"
+#include "gesturerecognition/hand_tracker.h"
+#include "gesturerecognition/synthetic_hands.h"
+
+namespace bench {
+
+namespace {
+const cv::Size RESOLUTIONS[] = {cv::Size(320, 240), cv::Size(640, 480),
+                                cv::Size(1280, 720), cv::Size(1920, 1080)};
+const int FINGER_COUNTS[] = {1, 3, 5};
+const float HAND_SCALES[] = {0.12f, 0.16f, 0.2f};
+const float HAND_ROTATIONS[] = {-20, 0, 20};
+// A detected point counts as a match when it is within this fraction of the
+// palm width of the real point.
+const double MATCH_DISTANCE_BY_PALM_WIDTH = 0.3;
+const float SESSION_HAND_SCALE = 0.16f;  // The scale GenerateSession uses
+
+/**
+ * Returns the points of current which were not in previous, i.e the points the
+ * tracker has just clicked.
+ */
+std::vector<cv::Point> FindNewPoints(const std::vector<cv::Point>& previous,
+                                     const std::vector<cv::Point>& current) {
+  std::vector<cv::Point> new_points;
+  for (const cv::Point& point : current) {
+    if (std::find(previous.begin(), previous.end(), point) == previous.end()) {
+      new_points.push_back(point);
+    }
+  }
+  return new_points;
+}
+
+/**
+ * Returns what the ids of the detector's results start with. Those of the
+ * convexity defects have none, so that they stay comparable with older runs.
+ */
+std::string GetIdPrefix(gesturerecognition::FingerTipDetector detector) {
+  return detector == gesturerecognition::FingerTipDetector::COLUMN_PROFILE
+             ? "ColumnProfile/"
+             : "";
+}
+
+AccuracyResult EvaluateFingerTips(
+    gesturerecognition::FingerTipDetector detector,
+    const cv::Size& resolution, int number_of_fingers, uint64_t seed) {
+  gesturerecognition::SyntheticSceneSettings scene_settings;
+  scene_settings.resolution_ = resolution;
+  scene_settings.seed_ = seed;
+  gesturerecognition::SyntheticHandGenerator generator(scene_settings);
+  gesturerecognition::HandExtractor hand_extractor(detector);
+
+  AccuracyResult result{GetIdPrefix(detector) + "FingerTips/width=" +
+                            std::to_string(resolution.width) +
+                            "/fingers=" + std::to_string(number_of_fingers),
+                        0, 0, 0};
+  for (float scale : HAND_SCALES) {
+    for (float rotation : HAND_ROTATIONS) {
+      auto hands = generator.CreateHandPair(number_of_fingers, scale);
+      hands.first.rotation_degrees_ = rotation;
+      hands.second.rotation_degrees_ = -rotation;
+      gesturerecognition::SyntheticFrame frame =
+          generator.Render(hands.first, hands.second, false);
+      auto detected_hands = hand_extractor.ExtractHands(frame.mask_);
+
+      double max_distance =
+          MATCH_DISTANCE_BY_PALM_WIDTH * scale * resolution.width;
+      const std::vector<cv::Point>* detected[] = {
+          &detected_hands.first.finger_tips_,
+          &detected_hands.second.finger_tips_};
+      const std::vector<cv::Point>* truth[] = {&frame.left_finger_tips_,
+                                               &frame.right_finger_tips_};
+      for (int i = 0; i < 2; ++i) {
+        result.matched += gesturerecognition::CountMatchedPoints(
+            *detected[i], *truth[i], max_distance);
+        result.detected += detected[i]->size();
+        result.ground_truth += truth[i]->size();
+      }
+    }
+  }
+  return result;
+}
+
+AccuracyResult EvaluatePresses(gesturerecognition::FingerTipDetector detector,
+                               size_t frames_to_track, size_t number_of_frames,
+                               uint64_t seed) {
+  gesturerecognition::SyntheticSceneSettings scene_settings;
+  scene_settings.seed_ = seed;
+  gesturerecognition::SyntheticHandGenerator generator(scene_settings);
+  gesturerecognition::SyntheticSessionSettings session_settings;
+  session_settings.number_of_frames_ = number_of_frames;
+  gesturerecognition::SyntheticSession session =
+      generator.GenerateSession(session_settings);
+
+  gesturerecognition::HandExtractor hand_extractor(detector);
+  gesturerecognition::HandTracker hand_trackers[] = {
+      gesturerecognition::HandTracker(frames_to_track),
+      gesturerecognition::HandTracker(frames_to_track)};
+  std::vector<cv::Point> click_points[2];
+  // The frame and position of every click, for each hand.
+  std::vector<std::pair<size_t, cv::Point>> clicks[2];
+  for (size_t frame_number = 0; frame_number < session.frames_.size();
+       ++frame_number) {
+    auto hands =
+        hand_extractor.ExtractHands(session.frames_[frame_number].mask_);
+    const gesturerecognition::Hand* detected_hands[] = {&hands.first,
+                                                        &hands.second};
+    for (int i = 0; i < 2; ++i) {
+      std::vector<cv::Point> current =
+          hand_trackers[i].FindClickPoints(*detected_hands[i]);
+      for (const cv::Point& point : FindNewPoints(click_points[i], current)) {
+        clicks[i].push_back(std::make_pair(frame_number, point));
+      }
+      click_points[i] = current;
+    }
+  }
+
+  AccuracyResult result{GetIdPrefix(detector) + "Presses/frames=" +
+                            std::to_string(frames_to_track),
+                        0, clicks[0].size() + clicks[1].size(), 0};
+  double max_distance = MATCH_DISTANCE_BY_PALM_WIDTH * SESSION_HAND_SCALE *
+                        scene_settings.resolution_.width;
+  // The tracker only compares whole batches, so a press shows up at most two
+  // batches after the finger was bent.
+  size_t max_delay_frames = 2 * frames_to_track;
+  std::vector<bool> is_matched[] = {std::vector<bool>(clicks[0].size()),
+                                    std::vector<bool>(clicks[1].size())};
+  for (const gesturerecognition::SyntheticPressEvent& event :
+       session.press_events_) {
+    if (!event.is_press_) {
+      continue;
+    }
+    ++result.ground_truth;
+    int hand_index = event.is_left_hand_ ? 0 : 1;
+    for (size_t i = 0; i < clicks[hand_index].size(); ++i) {
+      const std::pair<size_t, cv::Point>& click = clicks[hand_index][i];
+      if (!is_matched[hand_index][i] && click.first >= event.frame_number_ &&
+          click.first <= event.frame_number_ + max_delay_frames &&
+          gesturerecognition::FindEuclideanDistance(
+              click.second, event.position_) <= max_distance) {
+        is_matched[hand_index][i] = true;
+        ++result.matched;
+        break;
+      }
+    }
+  }
+  return result;
+}
+}  // namespace
+
+double AccuracyResult::GetPrecision() const {
+  return detected == 0 ? 0 : static_cast<double>(matched) / detected;
+}
+
+double AccuracyResult::GetRecall() const {
+  return ground_truth == 0 ? 0 : static_cast<double>(matched) / ground_truth;
+}
+
+std::vector<AccuracyResult> EvaluateAccuracy(size_t number_of_frames,
+                                             uint64_t seed) {
+  std::vector<AccuracyResult> results;
+  for (gesturerecognition::FingerTipDetector detector :
+       {gesturerecognition::FingerTipDetector::CONVEXITY_DEFECTS,
+        gesturerecognition::FingerTipDetector::COLUMN_PROFILE}) {
+    for (const cv::Size& resolution : RESOLUTIONS) {
+      for (int number_of_fingers : FINGER_COUNTS) {
+        results.push_back(EvaluateFingerTips(detector, resolution,
+                                             number_of_fingers, seed));
+      }
+    }
+    for (size_t frames_to_track : {3, 6}) {
+      results.push_back(
+          EvaluatePresses(detector, frames_to_track, number_of_frames, seed));
+    }
+  }
+  return results;
+}
+
+nlohmann::json AccuracyToJson(const std::vector<AccuracyResult>& results) {
+  nlohmann::json json = nlohmann::json::array();
+  for (const AccuracyResult& result : results) {
+    json.push_back({{"id", result.id},
+                    {"matched", result.matched},
+                    {"detected", result.detected},
+                    {"ground_truth", result.ground_truth},
+                    {"precision", result.GetPrecision()},
+                    {"recall", result.GetRecall()}});
+  }
+  return json;
+}
+}  // namespace bench
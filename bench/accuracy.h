@@ -0,0 +1,43 @@
+#ifndef FINAL_PROJECT_ACCURACY_H
+#define FINAL_PROJECT_ACCURACY_H
+
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace bench {
+
+/**
+ * How well the detected points of one scenario match the ground truth of the
+ * synthetic hands.
+ */
+struct AccuracyResult {
+  std::string id;
+  size_t matched;       // Detected points close to a ground truth point
+  size_t detected;      // All detected points
+  size_t ground_truth;  // All ground truth points
+
+  double GetPrecision() const;
+  double GetRecall() const;
+};
+
+/**
+ * Runs the hand extractor, with each finger tip detector, on synthetic masks at
+ * every benchmark resolution and finger count, and the hand trackers on
+ * generated sessions, and compares the finger tips and presses they find
+ * with where the hands really were.
+ * @param number_of_frames  the length of each generated session
+ * @param seed              the seed of the generator, for repeatable runs
+ * @return                  one result per scenario
+ */
+std::vector<AccuracyResult> EvaluateAccuracy(size_t number_of_frames,
+                                             uint64_t seed);
+
+/**
+ * Converts accuracy results into JSON, for the --out file of the benchmark
+ * runner.
+ */
+nlohmann::json AccuracyToJson(const std::vector<AccuracyResult>& results);
+}  // namespace bench
+#endif  // FINAL_PROJECT_ACCURACY_H
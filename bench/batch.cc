@@ -0,0 +1,166 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "common/clock.h"
+
+namespace bench {
+
+namespace {
+/**
+ * Returns the path relative to the directory of the file, unless it is
+ * absolute.
+ */
+std::string ResolvePath(const std::string& path,
+                        const std::string& relative_to_file) {
+  size_t separator = relative_to_file.find_last_of("/\\");
+  if (path.empty() || path[0] == '/' || path[0] == '\\' ||
+      path.find(':') != std::string::npos ||
+      separator == std::string::npos) {
+    return path;
+  }
+  return relative_to_file.substr(0, separator + 1) + path;
+}
+
+/**
+ * Returns the size of a file in bytes, or 0 if it cannot be opened. It is
+ * how long a session is guessed to take.
+ */
+std::streamoff GetFileSize(const std::string& file_name) {
+  std::ifstream istream(file_name, std::ios::binary | std::ios::ate);
+  return istream.is_open() ? static_cast<std::streamoff>(istream.tellg()) : 0;
+}
+}  // namespace
+
+std::vector<SweepSession> LoadCorpus(const std::string& file_name,
+                                     const nlohmann::json& config) {
+  std::ifstream istream(file_name);
+  if (!istream.is_open()) {
+    throw std::runtime_error("Could not open the corpus " + file_name);
+  }
+  nlohmann::json corpus = nlohmann::json::parse(istream);
+  std::vector<SweepSession> sessions;
+  for (const nlohmann::json& entry : corpus["sessions"]) {
+    SweepSession session;
+    session.config = config;
+    session.video_file_name =
+        ResolvePath(entry["video"].get<std::string>(), file_name);
+    session.labels = LoadLabels(
+        ResolvePath(entry["labels"].get<std::string>(), file_name));
+    if (entry.find("train_frames") != entry.end()) {
+      session.train_frames = entry["train_frames"];
+    }
+    if (entry.find("hsv") != entry.end()) {
+      const nlohmann::json& hsv = entry["hsv"];
+      session.low_hsv = cv::Scalar(hsv[0], hsv[1], hsv[2]);
+      session.high_hsv = cv::Scalar(hsv[3], hsv[4], hsv[5]);
+      session.has_hsv_range = true;
+    }
+    if (entry.find("auto_hsv") != entry.end()) {
+      session.auto_hsv = entry["auto_hsv"];
+    }
+    sessions.push_back(session);
+  }
+  return sessions;
+}
+
+AccuracyResult BatchReport::GetTotalAccuracy() const {
+  AccuracyResult total{"total", 0, 0, 0};
+  for (const SweepResult& result : results) {
+    if (result.error.empty()) {
+      total.matched += result.accuracy.matched;
+      total.detected += result.accuracy.detected;
+      total.ground_truth += result.accuracy.ground_truth;
+    }
+  }
+  return total;
+}
+
+double BatchReport::GetSerialMilliseconds() const {
+  double serial_ms = 0;
+  for (const SweepResult& result : results) {
+    serial_ms += result.wall_ms;
+  }
+  return serial_ms;
+}
+
+BatchReport RunBatch(const std::vector<SweepSession>& sessions,
+                     size_t workers) {
+  std::vector<size_t> order(sessions.size());
+  std::vector<std::streamoff> sizes;
+  for (size_t i = 0; i < sessions.size(); ++i) {
+    order[i] = i;
+    sizes.push_back(GetFileSize(sessions[i].video_file_name));
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&sizes](size_t first, size_t second) {
+                     return sizes[first] > sizes[second];
+                   });
+  std::vector<SweepRun> runs;
+  for (size_t session : order) {
+    runs.push_back(SweepRun{&sessions[session], SweepPoint()});
+  }
+
+  BatchReport report;
+  report.workers = std::max<size_t>(workers, 1);
+  int64_t start_time_ns = common::GetTimestampNanoseconds();
+  std::vector<SweepResult> results =
+      RunInParallel(runs, report.workers, &report.stolen_runs);
+  report.wall_ms = common::NanosecondsToMilliseconds(
+      common::GetTimestampNanoseconds() - start_time_ns);
+  report.results.resize(sessions.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    report.results[order[i]] = results[i];
+    report.results[order[i]].accuracy.id =
+        sessions[order[i]].video_file_name;
+  }
+  return report;
+}
+
+nlohmann::json BatchReportToJson(const BatchReport& report,
+                                 const std::vector<BatchReport>& scaling) {
+  nlohmann::json sessions = nlohmann::json::array();
+  for (const SweepResult& result : report.results) {
+    nlohmann::json session = {
+        {"video", result.accuracy.id},
+        {"matched", result.accuracy.matched},
+        {"detected", result.accuracy.detected},
+        {"labels", result.accuracy.ground_truth},
+        {"precision", result.accuracy.GetPrecision()},
+        {"recall", result.accuracy.GetRecall()},
+        {"mean_latency_ms", result.mean_latency_ms},
+        {"cpu_ms_per_frame", result.cpu_ms_per_frame},
+        {"frames", result.frames},
+        {"wall_ms", result.wall_ms}};
+    if (!result.error.empty()) {
+      session["error"] = result.error;
+    }
+    sessions.push_back(session);
+  }
+  AccuracyResult total = report.GetTotalAccuracy();
+  const double serial_ms = report.GetSerialMilliseconds();
+  nlohmann::json json = {
+      {"sessions", sessions},
+      {"workers", report.workers},
+      {"wall_ms", report.wall_ms},
+      {"serial_ms", serial_ms},
+      {"stolen_runs", report.stolen_runs},
+      {"precision", total.GetPrecision()},
+      {"recall", total.GetRecall()}};
+  if (!scaling.empty()) {
+    nlohmann::json scaling_json = nlohmann::json::array();
+    for (const BatchReport& run : scaling) {
+      // The first run is on a single worker.
+      double speedup = scaling.front().wall_ms / run.wall_ms;
+      scaling_json.push_back({{"workers", run.workers},
+                              {"wall_ms", run.wall_ms},
+                              {"speedup", speedup},
+                              {"efficiency", speedup / run.workers}});
+    }
+    json["scaling"] = scaling_json;
+  }
+  return json;
+}
+}  // namespace bench
@@ -0,0 +1,61 @@
+#ifndef FINAL_PROJECT_BATCH_H
+#define FINAL_PROJECT_BATCH_H
+
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "sweep.h"
+
+namespace bench {
+
+/**
+ * Reads a corpus of labelled sessions from a JSON file of the form
+ * {"sessions": [{"video": file, "labels": file, "train_frames": n,
+ * "hsv": [lh, ls, lv, hh, hs, hv], "auto_hsv": bool}, ...]}. Only "video"
+ * and "labels" are required, and relative paths are relative to the corpus
+ * file. Throws std::runtime_error if a file cannot be read.
+ * @param file_name   the corpus file
+ * @param config      the parsed config every session is run with
+ */
+std::vector<SweepSession> LoadCorpus(const std::string& file_name,
+                                     const nlohmann::json& config);
+
+/**
+ * The results of running a corpus once, with a given number of workers.
+ */
+struct BatchReport {
+  std::vector<SweepResult> results;  // One per session, in corpus order
+  size_t workers;
+  double wall_ms;      // From the first session starting to the last ending
+  size_t stolen_runs;  // Sessions a worker took from another's queue
+
+  /**
+   * Returns the matched, detected and labelled presses of every session
+   * that ran.
+   */
+  AccuracyResult GetTotalAccuracy() const;
+
+  /**
+   * Returns the wall time of every session added up, i.e how long running
+   * them one after the other would have taken.
+   */
+  double GetSerialMilliseconds() const;
+};
+
+/**
+ * Runs every session of the corpus on a work stealing pool, with its own
+ * pipeline. The sessions with the largest video files are queued first, so
+ * that a long one does not start last.
+ */
+BatchReport RunBatch(const std::vector<SweepSession>& sessions,
+                     size_t workers);
+
+/**
+ * Converts a report into JSON. Each scaling report, if any, is the same
+ * corpus run with another number of workers.
+ */
+nlohmann::json BatchReportToJson(const BatchReport& report,
+                                 const std::vector<BatchReport>& scaling);
+}  // namespace bench
+#endif  // FINAL_PROJECT_BATCH_H
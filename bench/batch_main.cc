@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "batch.h"
+
+namespace {
+void PrintUsage() {
+  std::cerr << "Usage: gesture-piano-batch <corpus_file> [options]\n"
+            << "  --config <file>   the config every session is run with "
+               "(config.json)\n"
+            << "  --workers <n>     the number of sessions run at once (one "
+               "per core)\n"
+            << "  --scaling         also run the corpus on 1, 2, 4, ... "
+               "workers, and print how the wall time scales\n"
+            << "  --out <file>      write the report as JSON\n";
+}
+
+void PrintReport(const bench::BatchReport& report) {
+  std::cout << "  precision  recall  latency (ms)  cpu/frame (ms)  "
+               "wall (s)  video\n";
+  for (const bench::SweepResult& result : report.results) {
+    if (!result.error.empty()) {
+      std::cout << "  failed: " << result.error << "  " << result.accuracy.id
+                << "\n";
+      continue;
+    }
+    std::cout << std::setw(11) << result.accuracy.GetPrecision()
+              << std::setw(8) << result.accuracy.GetRecall() << std::setw(14);
+    if (result.mean_latency_ms < 0) {
+      std::cout << "-";
+    } else {
+      std::cout << result.mean_latency_ms;
+    }
+    std::cout << std::setw(16) << result.cpu_ms_per_frame << std::setw(10)
+              << result.wall_ms / 1000 << "  " << result.accuracy.id << "\n";
+  }
+  bench::AccuracyResult total = report.GetTotalAccuracy();
+  const double serial_ms = report.GetSerialMilliseconds();
+  std::cout << "Total: precision " << total.GetPrecision() << ", recall "
+            << total.GetRecall() << " over " << total.ground_truth
+            << " labelled presses\n";
+  std::cout << report.results.size() << " sessions on " << report.workers
+            << " workers in " << report.wall_ms / 1000 << " s, "
+            << serial_ms / 1000 << " s one after the other: "
+            << serial_ms / report.wall_ms << "x speedup ("
+            << 100 * serial_ms / report.wall_ms / report.workers
+            << "% per worker), " << report.stolen_runs
+            << " sessions stolen\n";
+}
+}  // namespace
+
+/**
+ * Runs every labelled session of a corpus through its own pipeline, many at
+ * once, and reports the accuracy and cost of each and of all of them.
+ */
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    PrintUsage();
+    return 1;
+  }
+  std::string corpus_file_name = argv[1];
+  std::string config_file_name = "config.json";
+  size_t workers = std::thread::hardware_concurrency();
+  bool measure_scaling = false;
+  std::string output_file_name;
+  for (int i = 2; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--config") == 0 && has_value) {
+      config_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--workers") == 0 && has_value) {
+      workers = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--scaling") == 0) {
+      measure_scaling = true;
+    } else if (std::strcmp(argv[i], "--out") == 0 && has_value) {
+      output_file_name = argv[++i];
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+  workers = std::max<size_t>(workers, 1);
+
+  std::ifstream config_stream(config_file_name);
+  if (!config_stream.is_open()) {
+    std::cerr << "Could not open the config " << config_file_name << "\n";
+    return 1;
+  }
+  std::vector<bench::SweepSession> sessions = bench::LoadCorpus(
+      corpus_file_name, nlohmann::json::parse(config_stream));
+
+  std::vector<bench::BatchReport> scaling;
+  if (measure_scaling) {
+    for (size_t scaling_workers = 1; scaling_workers < workers;
+         scaling_workers *= 2) {
+      std::cout << "Running on " << scaling_workers << " workers...\n";
+      scaling.push_back(bench::RunBatch(sessions, scaling_workers));
+    }
+  }
+  std::cout << "Running on " << workers << " workers...\n";
+  bench::BatchReport report = bench::RunBatch(sessions, workers);
+  if (measure_scaling) {
+    scaling.push_back(report);
+  }
+
+  std::cout << std::fixed << std::setprecision(3);
+  PrintReport(report);
+  if (measure_scaling) {
+    std::cout << "Scaling:\n  workers  wall (s)  speedup  efficiency\n";
+    for (const bench::BatchReport& run : scaling) {
+      double speedup = scaling.front().wall_ms / run.wall_ms;
+      std::cout << std::setw(9) << run.workers << std::setw(10)
+                << run.wall_ms / 1000 << std::setw(9) << speedup
+                << std::setw(11) << speedup / run.workers << "\n";
+    }
+  }
+
+  if (!output_file_name.empty()) {
+    std::ofstream ostream(output_file_name);
+    ostream << bench::BatchReportToJson(report, scaling).dump(2) << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,153 @@
+#include "bench_harness.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+#include "common/clock.h"
+
+namespace bench {
+
+namespace {
+const void* volatile escaped_pointer = nullptr;
+}  // namespace
+
+void EscapePointer(const void* pointer) {
+  escaped_pointer = pointer;
+}
+
+State::State(int64_t min_time_ns, size_t min_iterations)
+    : min_time_ns_(min_time_ns),
+      min_iterations_(min_iterations),
+      start_time_ns_(0),
+      iteration_start_ns_(0),
+      started_(false) {
+}
+
+bool State::KeepRunning() {
+  int64_t now_ns = common::GetTimestampNanoseconds();
+  if (!started_) {
+    started_ = true;
+    start_time_ns_ = now_ns;
+  } else {
+    samples_.push_back(now_ns - iteration_start_ns_);
+  }
+  if (samples_.size() >= min_iterations_ &&
+      now_ns - start_time_ns_ >= min_time_ns_) {
+    return false;
+  }
+  // Re-read the clock so that the bookkeeping above is not measured.
+  iteration_start_ns_ = common::GetTimestampNanoseconds();
+  return true;
+}
+
+void State::ResetIterationTimer() {
+  iteration_start_ns_ = common::GetTimestampNanoseconds();
+}
+
+const std::vector<int64_t>& State::GetSamples() const {
+  return samples_;
+}
+
+std::string Result::GetId() const {
+  std::string id = name;
+  for (const auto& parameter : parameters) {
+    id += "/" + parameter.first + "=" + std::to_string(parameter.second);
+  }
+  return id;
+}
+
+void Registry::Add(const std::string& name, const Parameters& parameters,
+                   const std::function<void(State&)>& body) {
+  benchmarks_.push_back({name, parameters, body});
+}
+
+std::vector<Result> Registry::Run(const std::string& filter, int min_time_ms,
+                                  size_t min_iterations) const {
+  std::vector<Result> results;
+  for (const Benchmark& benchmark : benchmarks_) {
+    Result result;
+    result.name = benchmark.name;
+    result.parameters = benchmark.parameters;
+    if (result.GetId().find(filter) == std::string::npos) {
+      continue;
+    }
+    State state(static_cast<int64_t>(min_time_ms) * 1000000, min_iterations);
+    benchmark.body(state);
+
+    std::vector<int64_t> samples = state.GetSamples();
+    if (samples.empty()) {
+      std::cerr << result.GetId() << " did not run any iterations\n";
+      continue;
+    }
+    std::sort(samples.begin(), samples.end());
+    result.iterations = samples.size();
+    result.min_ms = common::NanosecondsToMilliseconds(samples.front());
+    result.median_ms =
+        common::NanosecondsToMilliseconds(samples[samples.size() / 2]);
+    result.p90_ms =
+        common::NanosecondsToMilliseconds(samples[samples.size() * 9 / 10]);
+    result.max_ms = common::NanosecondsToMilliseconds(samples.back());
+    result.mean_ms = common::NanosecondsToMilliseconds(
+                         std::accumulate(samples.begin(), samples.end(),
+                                         static_cast<int64_t>(0))) /
+                     samples.size();
+    std::cout << std::left << std::setw(64) << result.GetId() << std::right
+              << std::fixed << std::setprecision(4) << std::setw(12)
+              << result.median_ms << " ms" << std::setw(10)
+              << result.iterations << " it\n";
+    results.push_back(result);
+  }
+  return results;
+}
+
+nlohmann::json ResultsToJson(const std::vector<Result>& results,
+                             double frame_budget_ms) {
+  nlohmann::json json_results = nlohmann::json::array();
+  for (const Result& result : results) {
+    nlohmann::json parameters = nlohmann::json::object();
+    for (const auto& parameter : result.parameters) {
+      parameters[parameter.first] = parameter.second;
+    }
+    json_results.push_back({{"id", result.GetId()},
+                            {"name", result.name},
+                            {"parameters", parameters},
+                            {"iterations", result.iterations},
+                            {"min_ms", result.min_ms},
+                            {"median_ms", result.median_ms},
+                            {"mean_ms", result.mean_ms},
+                            {"p90_ms", result.p90_ms},
+                            {"max_ms", result.max_ms},
+                            {"frame_budget_fraction",
+                             result.median_ms / frame_budget_ms}});
+  }
+  return {{"frame_budget_ms", frame_budget_ms}, {"results", json_results}};
+}
+
+int CompareWithBaseline(const std::vector<Result>& results,
+                        const nlohmann::json& baseline, double tolerance) {
+  int regressions = 0;
+  std::cout << "\nComparison with baseline (tolerance "
+            << std::setprecision(1) << tolerance * 100 << "%)\n";
+  for (const Result& result : results) {
+    for (const nlohmann::json& baseline_result : baseline["results"]) {
+      if (baseline_result["id"] != result.GetId()) {
+        continue;
+      }
+      double baseline_median_ms = baseline_result["median_ms"];
+      double change = result.median_ms / baseline_median_ms - 1;
+      bool regressed = change > tolerance;
+      regressions += regressed ? 1 : 0;
+      std::cout << std::left << std::setw(64) << result.GetId() << std::right
+                << std::setprecision(4) << std::setw(12) << baseline_median_ms
+                << " -> " << std::setw(10) << result.median_ms << " ms "
+                << std::showpos << std::setprecision(1) << std::setw(8)
+                << change * 100 << "%" << std::noshowpos
+                << (regressed ? "  REGRESSION" : "") << "\n";
+      break;
+    }
+  }
+  return regressions;
+}
+}  // namespace bench
@@ -0,0 +1,143 @@
+#ifndef FINAL_PROJECT_BENCH_HARNESS_H
+#define FINAL_PROJECT_BENCH_HARNESS_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace bench {
+
+/**
+ * Passed to every benchmark body. The body calls KeepRunning in a loop and
+ * does one iteration of the work it measures inside the loop.
+ */
+class State {
+ public:
+  /**
+   * @param min_time_ns     keep iterating for at least this long
+   * @param min_iterations  keep iterating for at least this many iterations
+   */
+  State(int64_t min_time_ns, size_t min_iterations);
+
+  /**
+   * Ends the timing of the previous iteration and decides whether to run
+   * another one.
+   * @return  true if the body should run another iteration
+   */
+  bool KeepRunning();
+
+  /**
+   * Excludes the time since the last KeepRunning call from the current
+   * iteration. Used for per-iteration setup which is not part of the work
+   * being measured.
+   */
+  void ResetIterationTimer();
+
+  const std::vector<int64_t>& GetSamples() const;
+
+ private:
+  const int64_t min_time_ns_;
+  const size_t min_iterations_;
+  int64_t start_time_ns_;
+  int64_t iteration_start_ns_;
+  bool started_;
+  std::vector<int64_t> samples_;  // Time taken by each iteration
+};
+
+/**
+ * The named parameters of one benchmark instance, e.g {{"width", 640}}.
+ */
+typedef std::vector<std::pair<std::string, int>> Parameters;
+
+/**
+ * The summary statistics of one benchmark instance.
+ */
+struct Result {
+  std::string name;
+  Parameters parameters;
+  size_t iterations;
+  double min_ms;
+  double median_ms;
+  double mean_ms;
+  double p90_ms;
+  double max_ms;
+
+  /**
+   * Returns the name and parameters as a single string, which identifies the
+   * instance in baseline files. E.g "ProcessImage/width=640/height=480"
+   */
+  std::string GetId() const;
+};
+
+/**
+ * Holds every registered benchmark instance and runs them.
+ */
+class Registry {
+ public:
+  /**
+   * Registers one instance of a benchmark.
+   * @param name          the name of the benchmarked function
+   * @param parameters    the parameters of this instance
+   * @param body          the benchmark body. Setup done before the first
+   *                      KeepRunning call is not measured.
+   */
+  void Add(const std::string& name, const Parameters& parameters,
+           const std::function<void(State&)>& body);
+
+  /**
+   * Runs every instance whose id contains filter.
+   * @param filter          only run instances whose id contains this string
+   * @param min_time_ms     the minimum time spent on each instance
+   * @param min_iterations  the minimum iterations of each instance
+   * @return                the results of the instances that were run
+   */
+  std::vector<Result> Run(const std::string& filter, int min_time_ms,
+                          size_t min_iterations) const;
+
+ private:
+  struct Benchmark {
+    std::string name;
+    Parameters parameters;
+    std::function<void(State&)> body;
+  };
+  std::vector<Benchmark> benchmarks_;
+};
+
+/**
+ * Serializes results to JSON, including the share of the frame budget each
+ * instance's median takes.
+ */
+nlohmann::json ResultsToJson(const std::vector<Result>& results,
+                             double frame_budget_ms);
+
+/**
+ * Compares results against a baseline produced by ResultsToJson, and prints
+ * the change of every instance that is in both.
+ * @param results     the current results
+ * @param baseline    the baseline JSON
+ * @param tolerance   the relative slowdown of the median that is still
+ *                    accepted, e.g 0.1 for 10%
+ * @return            the number of instances that regressed
+ */
+int CompareWithBaseline(const std::vector<Result>& results,
+                        const nlohmann::json& baseline, double tolerance);
+
+/**
+ * Stores the pointer somewhere the compiler cannot see through. Defined in its
+ * own translation unit so that calls to it cannot be optimized away.
+ */
+void EscapePointer(const void* pointer);
+
+/**
+ * Keeps the compiler from optimizing away a value computed by a benchmark.
+ */
+template <class T>
+void DoNotOptimize(const T& value) {
+  EscapePointer(&value);
+}
+}  // namespace bench
+#endif  // FINAL_PROJECT_BENCH_HARNESS_H
@@ -0,0 +1,170 @@
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "accuracy.h"
+#include "bench_harness.h"
+#include "pipeline_benchmarks.h"
+
+namespace {
+void PrintUsage() {
+  std::cerr << "Usage: gesture-piano-bench [options]\n"
+            << "  --filter <text>          only run benchmarks whose id "
+               "contains text\n"
+            << "  --min-time-ms <ms>       minimum time per benchmark (200)\n"
+            << "  --min-iterations <n>     minimum iterations per benchmark "
+               "(10)\n"
+            << "  --frame-budget-ms <ms>   the frame budget results are "
+               "compared to (16.6)\n"
+            << "  --notes <file>           the notes file (Notes.file)\n"
+            << "  --out <file>             write the results as JSON\n"
+            << "  --baseline <file>        compare with a previous --out "
+               "file\n"
+            << "  --tolerance <fraction>   accepted slowdown against the "
+               "baseline (0.1)\n"
+            << "  --accuracy <frames>      also measure detection accuracy on "
+               "synthetic hands, with sessions of the given length\n"
+            << "  --keypoint-model <file>  also benchmark this keypoint "
+               "network\n"
+            << "  --keypoint-int8 <file>   and its int8 version\n"
+            << "  --masks                  also compare the size of the "
+               "masks as images and as runs, and how much faster the hands "
+               "are found in the runs\n";
+}
+
+/**
+ * Prints what the benchmark masks take as images and as runs, in memory and
+ * on the bus at 30 frames per second, and the speed-up of finding the hands
+ * in the runs over finding them in the image, from the results of both
+ * ExtractHands benchmarks.
+ */
+void PrintMaskComparison(const std::vector<bench::MaskSizeResult>& sizes,
+                         const std::vector<bench::Result>& results) {
+  std::cout << "\nMasks as images and as runs\n"
+            << "  resolution  contours  image (KB)  runs (KB)  encoded (KB)"
+               "  bus at 30 fps (MB/s, image -> runs)\n"
+            << std::fixed << std::setprecision(1);
+  for (const bench::MaskSizeResult& size : sizes) {
+    std::cout << std::setw(6) << size.width << "x" << std::left
+              << std::setw(5) << size.height << std::right << std::setw(10)
+              << size.contours << std::setw(12) << size.mat_bytes / 1024.0
+              << std::setw(11) << size.run_bytes / 1024.0 << std::setw(14)
+              << size.encoded_bytes / 1024.0 << std::setw(10)
+              << size.mat_bytes * 30 / 1e6 << " -> "
+              << size.encoded_bytes * 30 / 1e6 << "\n";
+  }
+  std::cout << "\nExtractHands speed-up on runs (including building them)\n"
+            << std::setprecision(2);
+  for (const bench::Result& image_result : results) {
+    if (image_result.name != "HandExtractor::ExtractHands") {
+      continue;
+    }
+    for (const bench::Result& run_result : results) {
+      if (run_result.name == "HandExtractor::ExtractHandsFromRuns" &&
+          run_result.parameters == image_result.parameters) {
+        std::cout << "  " << std::left << std::setw(56)
+                  << image_result.GetId() << std::right
+                  << image_result.median_ms / run_result.median_ms << "x\n";
+      }
+    }
+  }
+}
+}  // namespace
+
+/**
+ * Runs the pipeline benchmarks. Exits with 2 if any benchmark is slower than
+ * the baseline by more than the tolerance, so that it can gate deployments.
+ */
+int main(int argc, char* argv[]) {
+  std::string filter;
+  int min_time_ms = 200;
+  size_t min_iterations = 10;
+  double frame_budget_ms = 16.6;
+  std::string notes_file_name = "Notes.file";
+  std::string output_file_name;
+  std::string baseline_file_name;
+  double tolerance = 0.1;
+  size_t accuracy_frames = 0;
+  gesturerecognition::KeypointModelSettings keypoint_model;
+  bool compare_masks = false;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--filter") == 0 && has_value) {
+      filter = argv[++i];
+    } else if (std::strcmp(argv[i], "--min-time-ms") == 0 && has_value) {
+      min_time_ms = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--min-iterations") == 0 && has_value) {
+      min_iterations = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--frame-budget-ms") == 0 && has_value) {
+      frame_budget_ms = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--notes") == 0 && has_value) {
+      notes_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--out") == 0 && has_value) {
+      output_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--baseline") == 0 && has_value) {
+      baseline_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--tolerance") == 0 && has_value) {
+      tolerance = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--accuracy") == 0 && has_value) {
+      accuracy_frames = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--keypoint-model") == 0 && has_value) {
+      keypoint_model.model_file = argv[++i];
+    } else if (std::strcmp(argv[i], "--keypoint-int8") == 0 && has_value) {
+      keypoint_model.int8_model_file = argv[++i];
+    } else if (std::strcmp(argv[i], "--masks") == 0) {
+      compare_masks = true;
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  bench::Registry registry;
+  bench::RegisterPipelineBenchmarks(registry, notes_file_name);
+  bench::RegisterKeypointBenchmarks(registry, keypoint_model);
+  std::vector<bench::Result> results =
+      registry.Run(filter, min_time_ms, min_iterations);
+  nlohmann::json json_results = bench::ResultsToJson(results, frame_budget_ms);
+
+  if (accuracy_frames > 0) {
+    std::vector<bench::AccuracyResult> accuracy_results =
+        bench::EvaluateAccuracy(accuracy_frames, 0);
+    std::cout << "\nAccuracy on synthetic hands\n" << std::fixed
+              << std::setprecision(3);
+    for (const bench::AccuracyResult& result : accuracy_results) {
+      std::cout << std::left << std::setw(32) << result.id
+                << " precision " << result.GetPrecision() << "  recall "
+                << result.GetRecall() << "  (" << result.matched << "/"
+                << result.detected << " detected, " << result.ground_truth
+                << " real)\n";
+    }
+    json_results["accuracy"] = bench::AccuracyToJson(accuracy_results);
+  }
+
+  if (compare_masks) {
+    std::vector<bench::MaskSizeResult> mask_sizes = bench::MeasureMaskSizes();
+    PrintMaskComparison(mask_sizes, results);
+    json_results["masks"] = bench::MaskSizesToJson(mask_sizes);
+  }
+
+  if (!output_file_name.empty()) {
+    std::ofstream output(output_file_name);
+    output << json_results.dump(2) << "\n";
+  }
+  if (!baseline_file_name.empty()) {
+    std::ifstream baseline_stream(baseline_file_name);
+    if (!baseline_stream.is_open()) {
+      std::cerr << "Could not open " << baseline_file_name << "\n";
+      return 1;
+    }
+    nlohmann::json baseline = nlohmann::json::parse(baseline_stream);
+    int regressions =
+        bench::CompareWithBaseline(results, baseline, tolerance);
+    if (regressions > 0) {
+      std::cerr << regressions << " benchmark(s) regressed\n";
+      return 2;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,566 @@
+#include "pipeline_benchmarks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "common/thread_policy.h"
+#include "gesturerecognition/calibration.h"
+#include "gesturerecognition/frame_gate.h"
+#include "gesturerecognition/frame_source.h"
+#include "gesturerecognition/gesture_wrapper.h"
+#include "gesturerecognition/hand_extractor.h"
+#include "gesturerecognition/hand_tracker.h"
+#include "gesturerecognition/hsv_estimator.h"
+#include "gesturerecognition/rle_mask.h"
+#include "gesturerecognition/skin_table.h"
+#include "gesturerecognition/synthetic_hands.h"
+#include "pianoapp/audio_backend.h"
+#include "pianoapp/piano_engine.h"
+
+namespace bench {
+
+namespace {
+const cv::Size RESOLUTIONS[] = {cv::Size(320, 240), cv::Size(640, 480),
+                                cv::Size(1280, 720), cv::Size(1920, 1080)};
+const int CONTOUR_COUNTS[] = {2, 16, 128};
+const int FINGER_COUNTS[] = {0, 3, 5};
+const float HAND_SCALE = 0.16f;  // Palm width as a fraction of the frame width
+// The filter graph of config.json.
+const char* const DEFAULT_FILTER_GRAPH = R"({
+  "output": "mask",
+  "nodes": [
+    {"name": "small_frame", "node": "segmentation_scale", "inputs": ["frame"]},
+    {"name": "skin", "node": "hsv_threshold", "inputs": ["small_frame"]},
+    {"name": "background", "node": "background_subtraction",
+     "inputs": ["frame"]},
+    {"name": "small_background", "node": "segmentation_scale",
+     "inputs": ["background"]},
+    {"name": "clean_skin", "node": "median_morphology", "inputs": ["skin"]},
+    {"name": "clean_background", "node": "median_morphology",
+     "inputs": ["small_background"]},
+    {"name": "small_mask", "node": "and",
+     "inputs": ["clean_skin", "clean_background"]},
+    {"name": "mask", "node": "resize_like", "inputs": ["small_mask", "frame"]}
+  ]
+})";
+
+gesturerecognition::Calibration CreateCalibration() {
+  return gesturerecognition::Calibration(0, 255, "hsv", "background",
+                                         "combined", 0.01, cv::Size(300, 800));
+}
+
+Parameters ResolutionParameters(const cv::Size& resolution) {
+  return {{"width", resolution.width}, {"height", resolution.height}};
+}
+
+/**
+ * Renders a mask of two hands at the default benchmark scale.
+ */
+gesturerecognition::SyntheticFrame RenderHands(
+    gesturerecognition::SyntheticHandGenerator& generator,
+    int number_of_fingers) {
+  auto hands = generator.CreateHandPair(number_of_fingers, HAND_SCALE);
+  return generator.Render(hands.first, hands.second, false);
+}
+
+/**
+ * Creates a mask with two hands and about contour_count - 2 noise specks
+ * (specks which land on a hand merge into it).
+ */
+cv::Mat CreateHandMask(const cv::Size& resolution, int contour_count,
+                       int number_of_fingers) {
+  gesturerecognition::SyntheticSceneSettings scene_settings;
+  scene_settings.resolution_ = resolution;
+  scene_settings.noise_specks_ = std::max(0, contour_count - 2);
+  scene_settings.seed_ = static_cast<uint64_t>(contour_count);
+  gesturerecognition::SyntheticHandGenerator generator(scene_settings);
+  return RenderHands(generator, number_of_fingers).mask_;
+}
+
+/**
+ * Creates a random BGR frame, which is the worst case for the filters.
+ */
+cv::Mat CreateNoiseFrame(const cv::Size& resolution) {
+  cv::Mat frame(resolution, CV_8UC3);
+  cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(256));
+  return frame;
+}
+
+/**
+ * Creates a random YUYV or NV12 frame.
+ */
+gesturerecognition::CapturedFrame CreateNoiseYUVFrame(
+    const cv::Size& resolution, gesturerecognition::PixelFormat format) {
+  gesturerecognition::CapturedFrame frame;
+  frame.format_ = format;
+  if (format == gesturerecognition::PixelFormat::YUYV) {
+    frame.data_.create(resolution, CV_8UC2);
+  } else {
+    frame.data_.create(resolution.height * 3 / 2, resolution.width, CV_8UC1);
+  }
+  cv::randu(frame.data_, cv::Scalar::all(0), cv::Scalar::all(256));
+  return frame;
+}
+
+/**
+ * Returns evenly spaced points, standing in for the finger tips of a hand.
+ */
+std::vector<cv::Point> CreateFingerTips(int number_of_fingers) {
+  std::vector<cv::Point> finger_tips;
+  for (int i = 0; i < number_of_fingers; ++i) {
+    finger_tips.push_back(cv::Point(100 + 40 * i, 100));
+  }
+  return finger_tips;
+}
+}  // namespace
+
+void RegisterPipelineBenchmarks(Registry& registry,
+                                const std::string& notes_file_name) {
+  for (const cv::Size& resolution : RESOLUTIONS) {
+    registry.Add("Calibration::FilterImageByHSV",
+                 ResolutionParameters(resolution), [resolution](State& state) {
+                   auto calibration = CreateCalibration();
+                   calibration.SetHSVRange(cv::Scalar(0, 30, 60),
+                                           cv::Scalar(20, 150, 255));
+                   cv::Mat frame = CreateNoiseFrame(resolution);
+                   while (state.KeepRunning()) {
+                     DoNotOptimize(calibration.FilterImageByHSV(frame));
+                   }
+                 });
+    // Stands in for FilterImageByHSV on YUV frames, which would otherwise be
+    // converted to BGR first.
+    for (int nv12 : {0, 1}) {
+      Parameters parameters = ResolutionParameters(resolution);
+      parameters.push_back({"nv12", nv12});
+      registry.Add(
+          "YCbCrSkinTable::Classify", parameters,
+          [resolution, nv12](State& state) {
+            gesturerecognition::YCbCrSkinTable skin_table;
+            skin_table.Build(cv::Scalar(0, 30, 60), cv::Scalar(20, 150, 255));
+            gesturerecognition::CapturedFrame frame = CreateNoiseYUVFrame(
+                resolution, nv12 ? gesturerecognition::PixelFormat::NV12
+                                 : gesturerecognition::PixelFormat::YUYV);
+            cv::Mat mask;
+            while (state.KeepRunning()) {
+              skin_table.Classify(frame, mask);
+              DoNotOptimize(mask.data);
+            }
+          });
+    }
+    registry.Add("Calibration::GetBackgroundSubtractedImage",
+                 ResolutionParameters(resolution), [resolution](State& state) {
+                   auto calibration = CreateCalibration();
+                   std::vector<cv::Mat> frames;
+                   for (int i = 0; i < 4; ++i) {
+                     frames.push_back(CreateNoiseFrame(resolution));
+                   }
+                   size_t frame_index = 0;
+                   while (state.KeepRunning()) {
+                     DoNotOptimize(calibration.GetBackgroundSubtractedImage(
+                         frames[frame_index++ % frames.size()]));
+                   }
+                 });
+    // The running Gaussian model, learning on the vision thread every frame
+    // (0) or on the learner's thread every few frames.
+    for (int async_interval : {0, 5}) {
+      Parameters parameters = ResolutionParameters(resolution);
+      parameters.push_back({"async_interval", async_interval});
+      registry.Add(
+          "Calibration::GetBackgroundSubtractedImage/running_gaussian",
+          parameters, [resolution, async_interval](State& state) {
+            gesturerecognition::Calibration calibration(
+                0, 255, "hsv", "background", "combined", 0.01,
+                cv::Size(300, 800),
+                gesturerecognition::BackgroundModelType::RUNNING_GAUSSIAN);
+            calibration.SetAsyncBackgroundUpdates(async_interval);
+            std::vector<cv::Mat> frames;
+            for (int i = 0; i < 4; ++i) {
+              frames.push_back(CreateNoiseFrame(resolution));
+            }
+            size_t frame_index = 0;
+            while (state.KeepRunning()) {
+              DoNotOptimize(calibration.GetBackgroundSubtractedImage(
+                  frames[frame_index++ % frames.size()]));
+            }
+          });
+    }
+    registry.Add("FrameGate::HasChanged", ResolutionParameters(resolution),
+                 [resolution](State& state) {
+                   gesturerecognition::FrameGate frame_gate(1.5, 4);
+                   cv::Mat frames[] = {CreateNoiseFrame(resolution),
+                                       CreateNoiseFrame(resolution)};
+                   std::vector<cv::Rect> no_regions;
+                   size_t frame_index = 0;
+                   while (state.KeepRunning()) {
+                     DoNotOptimize(frame_gate.HasChanged(
+                         frames[frame_index++ % 2], no_regions));
+                   }
+                 });
+    registry.Add("HSVEstimator::AddFrame", ResolutionParameters(resolution),
+                 [resolution](State& state) {
+                   gesturerecognition::HSVEstimator hsv_estimator;
+                   cv::Mat frame = CreateNoiseFrame(resolution);
+                   while (state.KeepRunning()) {
+                     hsv_estimator.AddFrame(frame);
+                   }
+                   DoNotOptimize(hsv_estimator.GetFramesAdded());
+                 });
+    registry.Add("Calibration::ProcessImage", ResolutionParameters(resolution),
+                 [resolution](State& state) {
+                   auto calibration = CreateCalibration();
+                   cv::Mat mask = CreateHandMask(resolution, 16, 5);
+                   while (state.KeepRunning()) {
+                     DoNotOptimize(calibration.ProcessImage(mask));
+                   }
+                 });
+    // The filters in their fixed order (0) or in the default filter graph on
+    // this many threads.
+    for (int graph_threads : {0, 1, 2}) {
+      Parameters parameters = ResolutionParameters(resolution);
+      parameters.push_back({"graph_threads", graph_threads});
+      registry.Add(
+          "Calibration::GetFinalFilterImage", parameters,
+          [resolution, graph_threads](State& state) {
+            auto calibration = CreateCalibration();
+            calibration.SetHSVRange(cv::Scalar(0, 30, 60),
+                                    cv::Scalar(20, 150, 255));
+            if (graph_threads > 0) {
+              calibration.SetFilterGraph(
+                  nlohmann::json::parse(DEFAULT_FILTER_GRAPH), graph_threads);
+            }
+            std::vector<cv::Mat> frames;
+            for (int i = 0; i < 4; ++i) {
+              frames.push_back(CreateNoiseFrame(resolution));
+            }
+            size_t frame_index = 0;
+            while (state.KeepRunning()) {
+              DoNotOptimize(calibration.GetFinalFilterImage(
+                  frames[frame_index++ % frames.size()]));
+            }
+          });
+    }
+    for (int contour_count : CONTOUR_COUNTS) {
+      for (int number_of_fingers : FINGER_COUNTS) {
+        Parameters parameters = ResolutionParameters(resolution);
+        parameters.push_back({"contours", contour_count});
+        parameters.push_back({"fingers", number_of_fingers});
+        registry.Add("HandExtractor::ExtractHands", parameters,
+                     [=](State& state) {
+                       gesturerecognition::HandExtractor hand_extractor;
+                       cv::Mat mask = CreateHandMask(resolution, contour_count,
+                                                     number_of_fingers);
+                       while (state.KeepRunning()) {
+                         DoNotOptimize(hand_extractor.ExtractHands(mask));
+                       }
+                     });
+        registry.Add(
+            "HandExtractor::ExtractHandsByColumnProfile", parameters,
+            [=](State& state) {
+              gesturerecognition::HandExtractor hand_extractor(
+                  gesturerecognition::FingerTipDetector::COLUMN_PROFILE);
+              cv::Mat mask = CreateHandMask(resolution, contour_count,
+                                            number_of_fingers);
+              while (state.KeepRunning()) {
+                DoNotOptimize(hand_extractor.ExtractHands(mask));
+              }
+            });
+        registry.Add(
+            "HandExtractor::ExtractHandsFromRuns", parameters,
+            [=](State& state) {
+              // The runs are built from the mask every frame, as the pipeline
+              // does, so this is what replaces ExtractHands.
+              gesturerecognition::HandExtractor hand_extractor;
+              cv::Mat mask = CreateHandMask(resolution, contour_count,
+                                            number_of_fingers);
+              gesturerecognition::RleMask runs;
+              while (state.KeepRunning()) {
+                runs.Assign(mask);
+                DoNotOptimize(hand_extractor.ExtractHands(runs));
+              }
+            });
+      }
+      Parameters parameters = ResolutionParameters(resolution);
+      parameters.push_back({"contours", contour_count});
+      registry.Add("RleMask::Assign", parameters, [=](State& state) {
+        cv::Mat mask = CreateHandMask(resolution, contour_count, 5);
+        gesturerecognition::RleMask runs;
+        while (state.KeepRunning()) {
+          runs.Assign(mask);
+          DoNotOptimize(runs);
+        }
+      });
+      registry.Add("RleMask::FindOuterContours", parameters,
+                   [=](State& state) {
+                     gesturerecognition::RleMask runs(
+                         CreateHandMask(resolution, contour_count, 5));
+                     while (state.KeepRunning()) {
+                       DoNotOptimize(runs.FindOuterContours(2));
+                     }
+                   });
+    }
+  }
+
+  for (int contour_count : {2, 16, 128, 1024}) {
+    registry.Add(
+        "HandExtractor::Find2LargestContours", {{"contours", contour_count}},
+        [contour_count](State& state) {
+          cv::Mat mask = CreateHandMask(cv::Size(1920, 1080), contour_count, 5);
+          std::vector<std::vector<cv::Point>> contours;
+          cv::findContours(mask, contours, cv::RETR_EXTERNAL,
+                           cv::CHAIN_APPROX_SIMPLE);
+          while (state.KeepRunning()) {
+            DoNotOptimize(
+                gesturerecognition::HandExtractor::Find2LargestContours(
+                    contours));
+          }
+        });
+  }
+
+  for (int number_of_fingers = 1; number_of_fingers <= 5;
+       ++number_of_fingers) {
+    for (int frames_to_track : {3, 6}) {
+      registry.Add(
+          "HandTracker::FindClickPoints",
+          {{"fingers", number_of_fingers}, {"frames", frames_to_track}},
+          [=](State& state) {
+            gesturerecognition::HandTracker hand_tracker(frames_to_track);
+            // Alternating between the open hand and the hand with its last
+            // finger bent makes every batch click or unclick a point.
+            gesturerecognition::SyntheticHandGenerator generator(
+                (gesturerecognition::SyntheticSceneSettings()));
+            auto open_frame = RenderHands(generator, number_of_fingers);
+            auto bent_frame = RenderHands(generator, number_of_fingers - 1);
+            gesturerecognition::Hand open_hand(open_frame.right_finger_tips_,
+                                               open_frame.right_palm_center_);
+            gesturerecognition::Hand bent_hand(bent_frame.right_finger_tips_,
+                                               bent_frame.right_palm_center_);
+            size_t frame_number = 0;
+            while (state.KeepRunning()) {
+              bool is_open = (frame_number++ / frames_to_track) % 2 == 0;
+              const gesturerecognition::Hand& hand =
+                  is_open ? open_hand : bent_hand;
+              DoNotOptimize(hand_tracker.FindClickPoints(hand));
+            }
+          });
+    }
+  }
+
+  for (int number_of_points : {5, 10, 100}) {
+    registry.Add("GestureWrapper::ConvertCoordinates",
+                 {{"points", number_of_points}},
+                 [number_of_points](State& state) {
+                   std::vector<cv::Point> points =
+                       CreateFingerTips(number_of_points);
+                   while (state.KeepRunning()) {
+                     DoNotOptimize(
+                         gesturerecognition::GestureWrapper::ConvertCoordinates(
+                             points, 480, 640, 900, 900));
+                   }
+                 });
+  }
+
+  for (int number_of_points : {0, 2, 10}) {
+    registry.Add(
+        "PianoEngine::Run", {{"points", number_of_points}},
+        [number_of_points, notes_file_name](State& state) {
+          piano::SilentAudioBackend audio_backend;
+          piano::PianoEngine piano_engine(
+              cv::Point(0, 0), 900, 900, 10,
+              piano::ReadNotesFileLayout(notes_file_name, 45, 3),
+              audio_backend);
+          std::vector<cv::Point> points;
+          for (int i = 0; i < number_of_points; ++i) {
+            points.push_back(cv::Point(45 + 80 * i, 100 + 300 * (i % 3)));
+          }
+          std::vector<cv::Point> no_points;
+          size_t frame_number = 0;
+          while (state.KeepRunning()) {
+            // Every other frame releases all keys, so both the press and the
+            // release path are measured.
+            piano_engine.Run(frame_number++ % 2 == 0 ? points : no_points);
+          }
+        });
+  }
+
+  // Full 88 key keyboards side by side. The keys under the points are found
+  // in the key map, so the time should not grow with the zones.
+  for (int zones : {1, 2, 4}) {
+    registry.Add(
+        "PianoEngine::Run/zones", {{"points", 10}, {"zones", zones}},
+        [zones](State& state) {
+          piano::KeyboardLayout layout;
+          for (int i = 0; i < zones; ++i) {
+            piano::KeyboardZone zone;
+            zone.region = cv::Rect2f(static_cast<float>(i) / zones, 0,
+                                     1.0f / zones, 1);
+            zone.rows = {piano::GetNoteRange("A0", 26),
+                         piano::GetNoteRange("F4", 26)};
+            layout.zones.push_back(zone);
+          }
+          piano::SilentAudioBackend audio_backend;
+          piano::PianoEngine piano_engine(cv::Point(0, 0), 900, 900, 10,
+                                          layout, audio_backend);
+          std::vector<cv::Point> points;
+          for (int i = 0; i < 10; ++i) {
+            points.push_back(cv::Point(45 + 80 * i, 100 + 450 * (i % 2)));
+          }
+          std::vector<cv::Point> no_points;
+          size_t frame_number = 0;
+          while (state.KeepRunning()) {
+            piano_engine.Run(frame_number++ % 2 == 0 ? points : no_points);
+          }
+        });
+  }
+
+  // How late a thread wakes up from a 1 ms sleep, the way the pipeline waits
+  // for its next frame, with the default and the fifo policy, and with every
+  // core idle or kept busy. The spread between the median and the max is the
+  // scheduling jitter. Without the privileges for fifo the policy falls back
+  // to the default one, and the fifo instances say so on stderr.
+  for (int fifo : {0, 1}) {
+    for (int load : {0, 1}) {
+      registry.Add(
+          "ThreadPolicy::SleepJitter", {{"fifo", fifo}, {"load", load}},
+          [fifo, load](State& state) {
+            std::atomic<bool> loading(true);
+            std::vector<std::thread> load_threads;
+            if (load) {
+              unsigned int cores =
+                  std::max(1u, std::thread::hardware_concurrency());
+              for (unsigned int i = 0; i < cores; ++i) {
+                load_threads.emplace_back([&loading] {
+                  while (loading.load(std::memory_order_relaxed)) {
+                  }
+                });
+              }
+            }
+            // Measured on a thread of its own, so that the policy does not
+            // stick to the thread running the other benchmarks.
+            std::thread sleeper([fifo, &state] {
+              common::ThreadPolicy policy;
+              if (fifo) {
+                policy.scheduling = common::SchedulingPolicy::FIFO;
+                policy.priority = 80;
+              }
+              common::AppliedThreadPolicy applied =
+                  common::ApplyThreadPolicy("gp-bench", policy, 0);
+              if (!applied.failures.empty()) {
+                std::cerr << applied.ToString() << "\n";
+              }
+              while (state.KeepRunning()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+              }
+            });
+            sleeper.join();
+            loading = false;
+            for (std::thread& load_thread : load_threads) {
+              load_thread.join();
+            }
+          });
+    }
+  }
+}
+void RegisterKeypointBenchmarks(
+    Registry& registry,
+    const gesturerecognition::KeypointModelSettings& model) {
+  for (int int8 : {0, 1}) {
+    gesturerecognition::KeypointModelSettings settings = model;
+    settings.use_int8 = int8 != 0;
+    if (settings.GetModelFile().empty()) {
+      continue;
+    }
+    for (const cv::Size& resolution :
+         {cv::Size(640, 480), cv::Size(1280, 720)}) {
+      for (int batched : {0, 1}) {
+        Parameters parameters = ResolutionParameters(resolution);
+        parameters.push_back({"int8", int8});
+        parameters.push_back({"batched", batched});
+        registry.Add(
+            "KeypointDetector::Detect", parameters,
+            [=](State& state) {
+              gesturerecognition::KeypointDetector detector(settings);
+              gesturerecognition::SyntheticSceneSettings scene_settings;
+              scene_settings.resolution_ = resolution;
+              gesturerecognition::SyntheticHandGenerator generator(
+                  scene_settings);
+              gesturerecognition::SyntheticFrame frame =
+                  RenderHands(generator, 5);
+              // The regions the detector would crop around the hands.
+              int palm_width = static_cast<int>(HAND_SCALE * resolution.width);
+              std::vector<gesturerecognition::Hand> hands(2);
+              hands[0].bounding_box_ =
+                  cv::Rect(frame.left_palm_center_.x - palm_width,
+                           frame.left_palm_center_.y - palm_width,
+                           2 * palm_width, 2 * palm_width);
+              hands[1].bounding_box_ =
+                  cv::Rect(frame.right_palm_center_.x - palm_width,
+                           frame.right_palm_center_.y - palm_width,
+                           2 * palm_width, 2 * palm_width);
+              std::vector<cv::Rect> regions =
+                  gesturerecognition::KeypointDetector::FindRegions(
+                      hands, resolution, settings.region_margin);
+              while (state.KeepRunning()) {
+                if (batched) {
+                  DoNotOptimize(detector.Detect(frame.frame_, regions, 0));
+                } else {
+                  for (const cv::Rect& region : regions) {
+                    DoNotOptimize(detector.Detect(frame.frame_, {region}, 0));
+                  }
+                }
+              }
+            });
+      }
+      Parameters parameters = ResolutionParameters(resolution);
+      parameters.push_back({"int8", int8});
+      registry.Add("AsyncKeypointDetector::Submit", parameters,
+                   [=](State& state) {
+                     gesturerecognition::AsyncKeypointDetector detector(
+                         settings);
+                     gesturerecognition::SyntheticSceneSettings scene_settings;
+                     scene_settings.resolution_ = resolution;
+                     gesturerecognition::SyntheticHandGenerator generator(
+                         scene_settings);
+                     cv::Mat frame = RenderHands(generator, 5).frame_;
+                     std::pair<gesturerecognition::Hand,
+                               gesturerecognition::Hand>
+                         hands;
+                     int64_t frame_number = 0;
+                     while (state.KeepRunning()) {
+                       detector.Submit(frame, ++frame_number);
+                       DoNotOptimize(detector.TakeResult(hands));
+                     }
+                   });
+    }
+  }
+}
+
+std::vector<MaskSizeResult> MeasureMaskSizes() {
+  std::vector<MaskSizeResult> results;
+  for (const cv::Size& resolution : RESOLUTIONS) {
+    for (int contour_count : CONTOUR_COUNTS) {
+      cv::Mat mask = CreateHandMask(resolution, contour_count, 5);
+      gesturerecognition::RleMask runs(mask);
+      results.push_back({resolution.width, resolution.height, contour_count,
+                         mask.total() * mask.elemSize(),
+                         runs.GetMemoryBytes(), runs.GetEncodedSize()});
+    }
+  }
+  return results;
+}
+
+nlohmann::json MaskSizesToJson(const std::vector<MaskSizeResult>& results) {
+  nlohmann::json json = nlohmann::json::array();
+  for (const MaskSizeResult& result : results) {
+    json.push_back({{"width", result.width},
+                    {"height", result.height},
+                    {"contours", result.contours},
+                    {"mat_bytes", result.mat_bytes},
+                    {"run_bytes", result.run_bytes},
+                    {"encoded_bytes", result.encoded_bytes}});
+  }
+  return json;
+}
+}  // namespace bench
@@ -0,0 +1,49 @@
+#ifndef FINAL_PROJECT_PIPELINE_BENCHMARKS_H
+#define FINAL_PROJECT_PIPELINE_BENCHMARKS_H
+
+#include "bench_harness.h"
+#include "gesturerecognition/keypoint_detector.h"
+
+namespace bench {
+
+/**
+ * Registers a benchmark for every function on the per-frame path of the
+ * pipeline, over a range of resolutions, contour counts and finger counts.
+ * @param registry          the registry to add the benchmarks to
+ * @param notes_file_name   the notes file used to set up the piano
+ */
+void RegisterPipelineBenchmarks(Registry& registry,
+                                const std::string& notes_file_name);
+
+/**
+ * Registers benchmarks of the keypoint network on rendered frames: one batched
+ * inference on both hand regions against one inference per region, and what
+ * handing frames to the asynchronous detector costs the pipeline thread.
+ * Nothing is registered for a model file which is not set.
+ * @param registry  the registry to add the benchmarks to
+ * @param model     the network, with both its float and its int8 file
+ */
+void RegisterKeypointBenchmarks(
+    Registry& registry, const gesturerecognition::KeypointModelSettings& model);
+
+/**
+ * What a benchmark mask takes as an 8 bit image and as runs.
+ */
+struct MaskSizeResult {
+  int width;
+  int height;
+  int contours;
+  size_t mat_bytes;      // Also what a MASK message carries
+  size_t run_bytes;      // RleMask::GetMemoryBytes
+  size_t encoded_bytes;  // What an RLE_MASK message or a recorded mask takes
+};
+
+/**
+ * Measures the size of the masks of the ExtractHands benchmarks, with five
+ * fingers, at every resolution and contour count.
+ */
+std::vector<MaskSizeResult> MeasureMaskSizes();
+
+nlohmann::json MaskSizesToJson(const std::vector<MaskSizeResult>& results);
+}  // namespace bench
+#endif  // FINAL_PROJECT_PIPELINE_BENCHMARKS_H
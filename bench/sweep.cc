@@ -0,0 +1,449 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+#include "common/clock.h"
+#include "common/metrics.h"
+#include "common/work_stealing_pool.h"
+#include "gesturerecognition/gesture_wrapper.h"
+#include "pianoapp/audio_backend.h"
+#include "pianoapp/piano_engine.h"
+
+namespace bench {
+
+namespace {
+const int64_t DEFAULT_FRAME_INTERVAL_NS = 1000000000 / 30;
+
+/**
+ * A press the pipeline played, and when.
+ */
+struct PlayedPress {
+  LabelledPress press;
+  int64_t trigger_ns;
+};
+
+/**
+ * Matches each press, in the order they were played, with the earliest label
+ * of its note that is not matched yet and whose window it is in.
+ * @return  the label each press matched, or -1 if it matched none
+ */
+std::vector<int> MatchPresses(const SweepSession& session,
+                              const std::vector<PlayedPress>& presses) {
+  std::vector<bool> is_matched(session.labels.size(), false);
+  std::vector<int> matches;
+  for (const PlayedPress& played : presses) {
+    int match = -1;
+    for (size_t i = 0; i < session.labels.size(); ++i) {
+      const LabelledPress& label = session.labels[i];
+      if (is_matched[i] || label.midi_note != played.press.midi_note ||
+          played.press.frame + session.max_early_frames < label.frame ||
+          played.press.frame > label.frame + session.max_delay_frames) {
+        continue;
+      }
+      if (match < 0 || label.frame < session.labels[match].frame) {
+        match = static_cast<int>(i);
+      }
+    }
+    if (match >= 0) {
+      is_matched[match] = true;
+    }
+    matches.push_back(match);
+  }
+  return matches;
+}
+
+/**
+ * Returns the latency a result is ranked by, which is worst if no press
+ * matched.
+ */
+double GetRankedLatency(const SweepResult& result) {
+  return result.mean_latency_ms < 0 ? std::numeric_limits<double>::infinity()
+                                    : result.mean_latency_ms;
+}
+
+/**
+ * Returns whether first beats second, see FindParetoFront.
+ */
+bool Dominates(const SweepResult& first, const SweepResult& second) {
+  double first_values[] = {first.accuracy.GetPrecision(),
+                           first.accuracy.GetRecall(), -GetRankedLatency(first),
+                           -first.cpu_ms_per_frame};
+  double second_values[] = {
+      second.accuracy.GetPrecision(), second.accuracy.GetRecall(),
+      -GetRankedLatency(second), -second.cpu_ms_per_frame};
+  bool is_better = false;
+  for (size_t i = 0; i < 4; ++i) {
+    if (first_values[i] < second_values[i]) {
+      return false;
+    }
+    is_better = is_better || first_values[i] > second_values[i];
+  }
+  return is_better;
+}
+}  // namespace
+
+std::vector<LabelledPress> LoadLabels(const std::string& file_name) {
+  std::ifstream istream(file_name);
+  if (!istream.is_open()) {
+    throw std::runtime_error("Could not open the labels " + file_name);
+  }
+  nlohmann::json json = nlohmann::json::parse(istream);
+  std::vector<LabelledPress> labels;
+  for (const nlohmann::json& label : json) {
+    labels.push_back(LabelledPress{label["frame"], label["note"]});
+  }
+  std::sort(labels.begin(), labels.end(),
+            [](const LabelledPress& first, const LabelledPress& second) {
+              return first.frame < second.frame;
+            });
+  return labels;
+}
+
+void SaveLabels(const std::string& file_name,
+                const std::vector<LabelledPress>& presses) {
+  nlohmann::json json = nlohmann::json::array();
+  for (const LabelledPress& press : presses) {
+    json.push_back({{"frame", press.frame}, {"note", press.midi_note}});
+  }
+  std::ofstream ostream(file_name);
+  if (!ostream.is_open()) {
+    throw std::runtime_error("Could not write the labels " + file_name);
+  }
+  ostream << json.dump(2) << "\n";
+}
+
+std::vector<SweepPoint> ExpandGrid(const nlohmann::json& grid) {
+  if (!grid.is_object()) {
+    throw std::invalid_argument("The sweep grid must be a JSON object");
+  }
+  std::vector<SweepPoint> points(1);
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    nlohmann::json values = it.value();
+    if (!values.is_array()) {
+      values = nlohmann::json::array({values});
+    }
+    if (values.empty()) {
+      throw std::invalid_argument("The sweep grid has no values for " +
+                                  it.key());
+    }
+    std::vector<SweepPoint> expanded;
+    for (const SweepPoint& point : points) {
+      for (const nlohmann::json& value : values) {
+        expanded.push_back(point);
+        expanded.back().push_back(std::make_pair(it.key(), value));
+      }
+    }
+    points.swap(expanded);
+  }
+  return points;
+}
+
+std::string SweepPointToString(const SweepPoint& point) {
+  std::string text;
+  for (const auto& value : point) {
+    text += (text.empty() ? "" : " ") + value.first + "=" +
+            value.second.dump();
+  }
+  return text;
+}
+
+SweepResult RunSweepPoint(const SweepSession& session, const SweepPoint& point,
+                          std::vector<LabelledPress>* presses) {
+  const int64_t start_time_ns = common::GetTimestampNanoseconds();
+  nlohmann::json config = session.config;
+  for (const auto& value : point) {
+    if (config.find(value.first) == config.end()) {
+      throw std::invalid_argument("Unknown setting " + value.first);
+    }
+    config[value.first] = value.second;
+  }
+  gesturerecognition::ProgramSettings settings =
+      gesturerecognition::ProgramSettings::FromJson(config);
+  settings.video_file_name = session.video_file_name;
+  settings.show_debug_windows = false;
+  settings.calibration_profile_file.clear();
+  settings.keypoint_model.model_file.clear();
+  settings.keypoint_model.int8_model_file.clear();
+  settings.bus_name.clear();
+  settings.mask_recording_file.clear();
+  // Both would move work off the worker's thread, or make it depend on how
+  // busy the machine is.
+  settings.async_background_update_frames = 0;
+  settings.frame_budget_ms = 0;
+  // The points already run on every core.
+  settings.filter_graph_threads = 1;
+
+  gesturerecognition::GestureWrapper gesture_wrapper(settings);
+  // Only the trackers' counts are read from it.
+  common::MetricsRegistry metrics;
+  gesture_wrapper.SetMetrics(&metrics);
+  if (session.has_hsv_range) {
+    gesture_wrapper.SetHSVRange(session.low_hsv, session.high_hsv);
+  }
+  piano::SilentAudioBackend audio_backend;
+  piano::PianoEngine piano_engine(
+      cv::Point(0, 0), settings.output_window_size.width,
+      settings.output_window_size.height, settings.row_margin,
+      piano::LoadKeyboardLayout(
+          settings.keyboard_layout_file, settings.piano_notes_file_name,
+          settings.number_of_white_keys, settings.number_of_rows),
+      audio_backend);
+  // The latency is measured in the time of the video, so that it does not
+  // depend on how many points run at once.
+  common::SyntheticClock clock;
+  const int64_t frame_interval_ns =
+      gesture_wrapper.GetSourceFrameInterval() > 0
+          ? gesture_wrapper.GetSourceFrameInterval()
+          : DEFAULT_FRAME_INTERVAL_NS;
+  gesture_wrapper.SetClock(clock);
+  piano_engine.SetClock(clock);
+
+  if (session.auto_hsv) {
+    gesture_wrapper.ToggleAutoHSVCalibration();
+  }
+  gesture_wrapper.ToggleBackgroundCalibration();
+  std::vector<PlayedPress> played_presses;
+  size_t frame_number = 0;
+  int64_t cpu_time_ns = 0;
+  size_t recognised_frames = 0;
+  size_t training_start_frame = 0;
+  while (true) {
+    if (gesture_wrapper.IsBackgroundTraining() &&
+        frame_number - training_start_frame >= session.train_frames) {
+      gesture_wrapper.ToggleGestureRecognitionMode();
+    }
+    clock.Advance(frame_interval_ns);
+    bool was_training = gesture_wrapper.IsBackgroundTraining();
+    int64_t cpu_start_ns = common::GetThreadCpuTimeNanoseconds();
+    const std::vector<cv::Point>& click_points = gesture_wrapper.Update();
+    if (gesture_wrapper.IsEndOfStream()) {
+      break;
+    }
+    piano_engine.Run(click_points, gesture_wrapper.GetLastCaptureTime(),
+                     gesture_wrapper.GetLastOnsetTimes());
+    if (gesture_wrapper.IsRecognitionMode()) {
+      cpu_time_ns += common::GetThreadCpuTimeNanoseconds() - cpu_start_ns;
+      ++recognised_frames;
+    }
+    if (!was_training && gesture_wrapper.IsBackgroundTraining()) {
+      training_start_frame = frame_number + 1;
+    }
+    for (const common::PressTiming& press :
+         piano_engine.GetLastPressTimings()) {
+      played_presses.push_back(PlayedPress{
+          LabelledPress{frame_number, press.midi_note}, press.trigger_ns});
+    }
+    ++frame_number;
+  }
+
+  SweepResult result;
+  result.point = point;
+  result.accuracy = AccuracyResult{SweepPointToString(point), 0,
+                                   played_presses.size(),
+                                   session.labels.size()};
+  result.frames = frame_number;
+  result.cpu_ms_per_frame =
+      recognised_frames == 0
+          ? 0
+          : common::NanosecondsToMilliseconds(cpu_time_ns) / recognised_frames;
+  std::vector<int> matches = MatchPresses(session, played_presses);
+  int64_t latency_sum_ns = 0;
+  for (size_t i = 0; i < matches.size(); ++i) {
+    if (matches[i] < 0) {
+      continue;
+    }
+    // The clock is advanced by one interval before every frame.
+    int64_t label_time_ns =
+        static_cast<int64_t>(session.labels[matches[i]].frame + 1) *
+        frame_interval_ns;
+    latency_sum_ns += played_presses[i].trigger_ns - label_time_ns;
+    ++result.accuracy.matched;
+  }
+  result.mean_latency_ms =
+      result.accuracy.matched == 0
+          ? -1
+          : common::NanosecondsToMilliseconds(latency_sum_ns) /
+                result.accuracy.matched;
+  result.predicted_presses =
+      metrics.GetCounter("tracker.predicted_presses").Get();
+  result.cancelled_presses =
+      metrics.GetCounter("tracker.cancelled_presses").Get();
+  const common::LatencyHistogram& lead_histogram =
+      metrics.GetHistogram("tracker.prediction_lead");
+  if (lead_histogram.GetCount() > 0) {
+    result.mean_prediction_lead_ms = lead_histogram.GetMean() / 1e6;
+  }
+  result.wall_ms = common::NanosecondsToMilliseconds(
+      common::GetTimestampNanoseconds() - start_time_ns);
+  if (presses != nullptr) {
+    presses->clear();
+    for (const PlayedPress& played : played_presses) {
+      presses->push_back(played.press);
+    }
+  }
+  return result;
+}
+
+std::vector<SweepResult> RunInParallel(const std::vector<SweepRun>& runs,
+                                       size_t workers, size_t* stolen_runs) {
+  std::vector<SweepResult> results(runs.size());
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    tasks.push_back([&runs, &results, i]() {
+      try {
+        results[i] = RunSweepPoint(*runs[i].session, runs[i].point);
+      } catch (std::exception& e) {
+        results[i].point = runs[i].point;
+        results[i].accuracy =
+            AccuracyResult{SweepPointToString(runs[i].point), 0, 0, 0};
+        results[i].error = e.what();
+      }
+    });
+  }
+  common::WorkStealingPool pool(std::max<size_t>(workers, 1));
+  int opencv_threads = cv::getNumThreads();
+  cv::setNumThreads(0);
+  pool.Run(tasks);
+  cv::setNumThreads(opencv_threads);
+  if (stolen_runs != nullptr) {
+    *stolen_runs = pool.GetStolenTasks();
+  }
+  return results;
+}
+
+std::vector<SweepResult> RunSweep(const SweepSession& session,
+                                  const std::vector<SweepPoint>& points,
+                                  size_t workers) {
+  std::vector<SweepRun> runs;
+  for (const SweepPoint& point : points) {
+    runs.push_back(SweepRun{&session, point});
+  }
+  return RunInParallel(runs, workers);
+}
+
+double SweepResult::GetFalsePositiveRate() const {
+  return accuracy.detected == 0
+             ? 0
+             : 1 - static_cast<double>(accuracy.matched) / accuracy.detected;
+}
+
+double TrackerComparison::GetLatencyGainMilliseconds() const {
+  if (batch.mean_latency_ms < 0 || predictive.mean_latency_ms < 0) {
+    return 0;
+  }
+  return batch.mean_latency_ms - predictive.mean_latency_ms;
+}
+
+std::vector<TrackerComparison> CompareTrackers(
+    const SweepSession& session, const std::vector<SweepPoint>& points,
+    size_t workers) {
+  const char* const TRACKER_MODES[] = {"batch", "predictive"};
+  std::vector<SweepRun> runs;
+  for (const SweepPoint& point : points) {
+    for (const auto& value : point) {
+      if (value.first == "tracker_mode") {
+        throw std::invalid_argument(
+            "The trackers are compared at points without a tracker_mode");
+      }
+    }
+    for (const char* tracker_mode : TRACKER_MODES) {
+      runs.push_back(SweepRun{&session, point});
+      runs.back().point.push_back(
+          std::make_pair(std::string("tracker_mode"), tracker_mode));
+    }
+  }
+  std::vector<SweepResult> results = RunInParallel(runs, workers);
+  std::vector<TrackerComparison> comparisons;
+  for (size_t i = 0; i + 1 < results.size(); i += 2) {
+    comparisons.push_back(TrackerComparison{results[i], results[i + 1]});
+  }
+  return comparisons;
+}
+
+nlohmann::json TrackerComparisonsToJson(
+    const std::vector<TrackerComparison>& comparisons) {
+  nlohmann::json json = nlohmann::json::array();
+  for (const TrackerComparison& comparison : comparisons) {
+    nlohmann::json entry = nlohmann::json::object();
+    for (const SweepResult* result :
+         {&comparison.batch, &comparison.predictive}) {
+      nlohmann::json values = nlohmann::json::object();
+      for (const auto& value : result->point) {
+        values[value.first] = value.second;
+      }
+      nlohmann::json mode = {
+          {"values", values},
+          {"matched", result->accuracy.matched},
+          {"detected", result->accuracy.detected},
+          {"labels", result->accuracy.ground_truth},
+          {"false_positive_rate", result->GetFalsePositiveRate()},
+          {"recall", result->accuracy.GetRecall()},
+          {"mean_latency_ms", result->mean_latency_ms},
+          {"predicted_presses", result->predicted_presses},
+          {"cancelled_presses", result->cancelled_presses},
+          {"mean_prediction_lead_ms", result->mean_prediction_lead_ms}};
+      if (!result->error.empty()) {
+        mode["error"] = result->error;
+      }
+      entry[result == &comparison.batch ? "batch" : "predictive"] = mode;
+    }
+    entry["latency_gain_ms"] = comparison.GetLatencyGainMilliseconds();
+    json.push_back(entry);
+  }
+  return json;
+}
+
+std::vector<size_t> FindParetoFront(const std::vector<SweepResult>& results) {
+  std::vector<size_t> front;
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (!results[i].error.empty()) {
+      continue;
+    }
+    bool is_beaten = false;
+    for (size_t j = 0; j < results.size() && !is_beaten; ++j) {
+      is_beaten = results[j].error.empty() && Dominates(results[j], results[i]);
+    }
+    if (!is_beaten) {
+      front.push_back(i);
+    }
+  }
+  return front;
+}
+
+nlohmann::json SweepResultsToJson(const std::vector<SweepResult>& results,
+                                  const std::vector<size_t>& pareto_front) {
+  nlohmann::json json = nlohmann::json::array();
+  for (size_t i = 0; i < results.size(); ++i) {
+    const SweepResult& result = results[i];
+    nlohmann::json values = nlohmann::json::object();
+    for (const auto& value : result.point) {
+      values[value.first] = value.second;
+    }
+    nlohmann::json entry = {
+        {"values", values},
+        {"matched", result.accuracy.matched},
+        {"detected", result.accuracy.detected},
+        {"labels", result.accuracy.ground_truth},
+        {"precision", result.accuracy.GetPrecision()},
+        {"recall", result.accuracy.GetRecall()},
+        {"mean_latency_ms", result.mean_latency_ms},
+        {"cpu_ms_per_frame", result.cpu_ms_per_frame},
+        {"frames", result.frames},
+        {"wall_ms", result.wall_ms},
+        {"predicted_presses", result.predicted_presses},
+        {"cancelled_presses", result.cancelled_presses},
+        {"mean_prediction_lead_ms", result.mean_prediction_lead_ms},
+        {"pareto", std::find(pareto_front.begin(), pareto_front.end(), i) !=
+                       pareto_front.end()}};
+    if (!result.error.empty()) {
+      entry["error"] = result.error;
+    }
+    json.push_back(entry);
+  }
+  return json;
+}
+}  // namespace bench
@@ -0,0 +1,187 @@
+#ifndef FINAL_PROJECT_SWEEP_H
+#define FINAL_PROJECT_SWEEP_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "accuracy.h"
+#include "nlohmann/json.hpp"
+
+namespace bench {
+
+/**
+ * A note that was played, or should have been, at a frame of a recorded
+ * session.
+ */
+struct LabelledPress {
+  size_t frame;
+  int midi_note;
+};
+
+/**
+ * Reads the presses of a session from a JSON array of
+ * {"frame": n, "note": midi_note} objects. Throws std::runtime_error if the
+ * file cannot be read.
+ */
+std::vector<LabelledPress> LoadLabels(const std::string& file_name);
+
+/**
+ * Writes presses in the format LoadLabels reads. Throws std::runtime_error if
+ * the file cannot be written.
+ */
+void SaveLabels(const std::string& file_name,
+                const std::vector<LabelledPress>& presses);
+
+/**
+ * The config keys a sweep changes, and the value of each.
+ */
+typedef std::vector<std::pair<std::string, nlohmann::json>> SweepPoint;
+
+/**
+ * Returns every combination of the values of a grid, e.g
+ * {"frames_to_track": [3, 6], "morphology_iterations": [1, 2, 3]} gives 6
+ * points. A key whose value is not an array only has that value. Throws
+ * std::invalid_argument if the grid is not an object or a key has no values.
+ */
+std::vector<SweepPoint> ExpandGrid(const nlohmann::json& grid);
+
+/**
+ * Returns the point as key=value pairs, e.g "frames_to_track=3 ...".
+ */
+std::string SweepPointToString(const SweepPoint& point);
+
+/**
+ * A recorded session and how the pipeline is run on it.
+ */
+struct SweepSession {
+  std::string video_file_name;
+  nlohmann::json config;  // The parsed config file the points change
+  size_t train_frames = 30;  // Frames the background is learnt from
+  bool has_hsv_range = false;
+  cv::Scalar low_hsv;
+  cv::Scalar high_hsv;
+  bool auto_hsv = false;
+  std::vector<LabelledPress> labels;
+  // A press matches a label of the same note from this many frames after it
+  // to this many frames before it.
+  size_t max_early_frames = 2;
+  size_t max_delay_frames = 15;
+};
+
+/**
+ * How the pipeline did on a session with the values of one point.
+ */
+struct SweepResult {
+  SweepPoint point;
+  // The presses that matched a label, all presses and all labels.
+  AccuracyResult accuracy;
+  // From the labelled frame to the note being played, in the time of the
+  // video, over the matched presses. Negative when none matched.
+  double mean_latency_ms = -1;
+  double cpu_ms_per_frame = 0;  // CPU time of the recognised frames
+  size_t frames = 0;
+  double wall_ms = 0;  // How long the run took
+  std::string error;  // Set if the pipeline could not be run
+  // Of the predictive tracker: the presses it fired, those no batch
+  // confirmed, and how much earlier than their batch the confirmed ones
+  // fired on average, negative when none was confirmed.
+  size_t predicted_presses = 0;
+  size_t cancelled_presses = 0;
+  double mean_prediction_lead_ms = -1;
+
+  /**
+   * Returns the fraction of the notes played that matched no label.
+   */
+  double GetFalsePositiveRate() const;
+};
+
+/**
+ * Replays the session through a pipeline of its own with the point's values,
+ * on the calling thread. Debug windows, calibration profiles, keypoint
+ * models, the bus, asynchronous background updates and quality control are
+ * turned off, so that a run only depends on its values and only uses the
+ * calling thread. Throws std::invalid_argument if the point has a key the
+ * config does not, and whatever the pipeline throws.
+ * @param session   the session
+ * @param point     the values to run with
+ * @param presses   if not null, set to every press that was played
+ */
+SweepResult RunSweepPoint(const SweepSession& session, const SweepPoint& point,
+                          std::vector<LabelledPress>* presses = nullptr);
+
+/**
+ * A session and the values to run it with.
+ */
+struct SweepRun {
+  const SweepSession* session;
+  SweepPoint point;
+};
+
+/**
+ * Runs every run on a work stealing pool, each worker running one pipeline
+ * at a time. OpenCV's own threads are turned off, so that each run is timed
+ * on a single core.
+ * @param runs          the runs, longest first for the best balance
+ * @param workers       the number of worker threads
+ * @param stolen_runs   if not null, set to how many runs a worker stole
+ *                      from another's queue
+ * @return              the result of each run, in the order of the runs. A
+ *                      run that failed has its error set.
+ */
+std::vector<SweepResult> RunInParallel(const std::vector<SweepRun>& runs,
+                                       size_t workers,
+                                       size_t* stolen_runs = nullptr);
+
+/**
+ * Runs every point of a session in parallel, see RunInParallel.
+ */
+std::vector<SweepResult> RunSweep(const SweepSession& session,
+                                  const std::vector<SweepPoint>& points,
+                                  size_t workers);
+
+/**
+ * A point run with the batch tracker and with the predictive one.
+ */
+struct TrackerComparison {
+  SweepResult batch;
+  SweepResult predictive;
+
+  /**
+   * Returns how much earlier, in milliseconds, the predictive tracker played
+   * the matched notes on average, or 0 if either matched none.
+   */
+  double GetLatencyGainMilliseconds() const;
+};
+
+/**
+ * Runs every point of a session with tracker_mode "batch" and with
+ * "predictive", in parallel, see RunInParallel. Throws std::invalid_argument
+ * if a point sets tracker_mode itself.
+ */
+std::vector<TrackerComparison> CompareTrackers(
+    const SweepSession& session, const std::vector<SweepPoint>& points,
+    size_t workers);
+
+/**
+ * Converts tracker comparisons into JSON.
+ */
+nlohmann::json TrackerComparisonsToJson(
+    const std::vector<TrackerComparison>& comparisons);
+
+/**
+ * Returns the indices of the results that no other result beats: one is
+ * beaten if another has at least its precision and recall and at most its
+ * latency and CPU time, and is better at one of them. Failed results are
+ * never on the front.
+ */
+std::vector<size_t> FindParetoFront(const std::vector<SweepResult>& results);
+
+/**
+ * Converts sweep results into JSON, marking those on the front.
+ */
+nlohmann::json SweepResultsToJson(const std::vector<SweepResult>& results,
+                                  const std::vector<size_t>& pareto_front);
+}  // namespace bench
+#endif  // FINAL_PROJECT_SWEEP_H
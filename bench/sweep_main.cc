@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "sweep.h"
+
+namespace {
+void PrintUsage() {
+  std::cerr << "Usage: gesture-piano-sweep <video_file> [options]\n"
+            << "  --labels <file>           the notes played in the video, as "
+               "[{\"frame\": n, \"note\": midi_note}, ...]\n"
+            << "  --grid <file>             the values of each config key to "
+               "sweep, as {\"key\": [value, ...], ...}\n"
+            << "  --config <file>           the config the grid changes "
+               "(config.json)\n"
+            << "  --train-frames <n>        frames used to learn the "
+               "background before recognition starts (30)\n"
+            << "  --hsv <lh ls lv hh hs hv> the HSV filter ranges\n"
+            << "  --auto-hsv                estimate the HSV filter ranges "
+               "from the hands in the boxes of the first frames\n"
+            << "  --workers <n>             the number of pipelines run at "
+               "once (one per core)\n"
+            << "  --max-early-frames <n>    how many frames before its label "
+               "a note still matches it (2)\n"
+            << "  --max-delay-frames <n>    how many frames after its label a "
+               "note still matches it (15)\n"
+            << "  --compare-trackers        run the config, or each point of "
+               "the grid, with the batch and the predictive tracker\n"
+            << "  --out <file>              write the results as JSON\n"
+            << "  --write-labels <file>     run the config once and write the "
+               "notes it played as labels, to be corrected by hand\n";
+}
+
+void PrintResult(const bench::SweepResult& result, bool is_on_front) {
+  std::cout << (is_on_front ? "* " : "  ");
+  if (!result.error.empty()) {
+    std::cout << std::setw(48) << std::left << ("failed: " + result.error)
+              << std::right;
+  } else {
+    std::cout << std::setw(10) << result.accuracy.GetPrecision()
+              << std::setw(8) << result.accuracy.GetRecall() << std::setw(14);
+    if (result.mean_latency_ms < 0) {
+      std::cout << "-";
+    } else {
+      std::cout << result.mean_latency_ms;
+    }
+    std::cout << std::setw(16) << result.cpu_ms_per_frame;
+  }
+  std::cout << "  " << bench::SweepPointToString(result.point) << "\n";
+}
+
+void PrintTrackerResult(const bench::SweepResult& result) {
+  if (!result.error.empty()) {
+    std::cout << "  failed: " << result.error << "\n";
+    return;
+  }
+  std::cout << std::setw(14);
+  if (result.mean_latency_ms < 0) {
+    std::cout << "-";
+  } else {
+    std::cout << result.mean_latency_ms;
+  }
+  std::cout << std::setw(17) << result.GetFalsePositiveRate() << std::setw(8)
+            << result.accuracy.GetRecall() << std::setw(11)
+            << result.predicted_presses << std::setw(11)
+            << result.cancelled_presses << std::setw(10);
+  if (result.mean_prediction_lead_ms < 0) {
+    std::cout << "-";
+  } else {
+    std::cout << result.mean_prediction_lead_ms;
+  }
+  std::cout << "  " << bench::SweepPointToString(result.point) << "\n";
+}
+
+/**
+ * Prints how much earlier the predictive tracker played the notes than the
+ * batch one at each point, and at what cost in notes nobody played.
+ */
+void PrintTrackerComparisons(
+    const std::vector<bench::TrackerComparison>& comparisons) {
+  std::cout << "  latency (ms)  false positives  recall  predicted  "
+               "cancelled  lead (ms)  values\n";
+  for (const bench::TrackerComparison& comparison : comparisons) {
+    PrintTrackerResult(comparison.batch);
+    PrintTrackerResult(comparison.predictive);
+    if (comparison.batch.error.empty() &&
+        comparison.predictive.error.empty()) {
+      std::cout << "  The predictive tracker played notes "
+                << comparison.GetLatencyGainMilliseconds()
+                << " ms earlier, with "
+                << 100 * comparison.predictive.GetFalsePositiveRate()
+                << "% false positives against "
+                << 100 * comparison.batch.GetFalsePositiveRate() << "%\n";
+    }
+  }
+}
+}  // namespace
+
+/**
+ * Replays a labelled session through the pipeline with every combination of
+ * the grid's config values, and prints how accurate and how costly each was.
+ * The combinations no other beats on every count are marked with a *.
+ */
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    PrintUsage();
+    return 1;
+  }
+  bench::SweepSession session;
+  session.video_file_name = argv[1];
+  std::string labels_file_name;
+  std::string grid_file_name;
+  std::string config_file_name = "config.json";
+  size_t workers = std::thread::hardware_concurrency();
+  std::string output_file_name;
+  std::string write_labels_file_name;
+  bool compare_trackers = false;
+  for (int i = 2; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--labels") == 0 && has_value) {
+      labels_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--grid") == 0 && has_value) {
+      grid_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--config") == 0 && has_value) {
+      config_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--train-frames") == 0 && has_value) {
+      session.train_frames = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--hsv") == 0 && i + 6 < argc) {
+      session.low_hsv =
+          cv::Scalar(std::stoi(argv[i + 1]), std::stoi(argv[i + 2]),
+                     std::stoi(argv[i + 3]));
+      session.high_hsv =
+          cv::Scalar(std::stoi(argv[i + 4]), std::stoi(argv[i + 5]),
+                     std::stoi(argv[i + 6]));
+      session.has_hsv_range = true;
+      i += 6;
+    } else if (std::strcmp(argv[i], "--auto-hsv") == 0) {
+      session.auto_hsv = true;
+    } else if (std::strcmp(argv[i], "--workers") == 0 && has_value) {
+      workers = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--max-early-frames") == 0 && has_value) {
+      session.max_early_frames = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--max-delay-frames") == 0 && has_value) {
+      session.max_delay_frames = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--compare-trackers") == 0) {
+      compare_trackers = true;
+    } else if (std::strcmp(argv[i], "--out") == 0 && has_value) {
+      output_file_name = argv[++i];
+    } else if (std::strcmp(argv[i], "--write-labels") == 0 && has_value) {
+      write_labels_file_name = argv[++i];
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  workers = std::max<size_t>(workers, 1);
+  std::ifstream config_stream(config_file_name);
+  if (!config_stream.is_open()) {
+    std::cerr << "Could not open the config " << config_file_name << "\n";
+    return 1;
+  }
+  session.config = nlohmann::json::parse(config_stream);
+
+  if (!write_labels_file_name.empty()) {
+    std::vector<bench::LabelledPress> presses;
+    bench::RunSweepPoint(session, bench::SweepPoint(), &presses);
+    bench::SaveLabels(write_labels_file_name, presses);
+    std::cout << "Wrote " << presses.size() << " labels to "
+              << write_labels_file_name << "\n";
+    return 0;
+  }
+  if (labels_file_name.empty() ||
+      (grid_file_name.empty() && !compare_trackers)) {
+    PrintUsage();
+    return 1;
+  }
+  session.labels = bench::LoadLabels(labels_file_name);
+  // The trackers are compared on the config alone unless there is a grid.
+  std::vector<bench::SweepPoint> points(1);
+  if (!grid_file_name.empty()) {
+    std::ifstream grid_stream(grid_file_name);
+    if (!grid_stream.is_open()) {
+      std::cerr << "Could not open the grid " << grid_file_name << "\n";
+      return 1;
+    }
+    points = bench::ExpandGrid(nlohmann::json::parse(grid_stream));
+  }
+  // A misspelt key would otherwise fail every point.
+  for (const auto& value : points.front()) {
+    if (session.config.find(value.first) == session.config.end()) {
+      std::cerr << "The config has no setting " << value.first << "\n";
+      return 1;
+    }
+  }
+
+  if (compare_trackers) {
+    std::cout << "Running " << points.size() << " points with both trackers "
+              << "on " << workers << " workers against "
+              << session.labels.size() << " labels\n";
+    std::vector<bench::TrackerComparison> comparisons =
+        bench::CompareTrackers(session, points, workers);
+    std::cout << std::fixed << std::setprecision(3);
+    PrintTrackerComparisons(comparisons);
+    if (!output_file_name.empty()) {
+      std::ofstream ostream(output_file_name);
+      ostream << bench::TrackerComparisonsToJson(comparisons).dump(2) << "\n";
+    }
+    return 0;
+  }
+  std::cout << "Running " << points.size() << " points on " << workers
+            << " workers against " << session.labels.size() << " labels\n";
+  std::vector<bench::SweepResult> results =
+      bench::RunSweep(session, points, workers);
+  std::vector<size_t> pareto_front = bench::FindParetoFront(results);
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "   precision  recall  latency (ms)  cpu/frame (ms)  values\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    bool is_on_front = std::find(pareto_front.begin(), pareto_front.end(),
+                                 i) != pareto_front.end();
+    PrintResult(results[i], is_on_front);
+  }
+  std::cout << pareto_front.size() << " of " << results.size()
+            << " points are on the Pareto front(*)\n";
+
+  if (!output_file_name.empty()) {
+    std::ofstream ostream(output_file_name);
+    ostream << bench::SweepResultsToJson(results, pareto_front).dump(2)
+            << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include "common/latency.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include "common/clock.h"
+
+namespace common {
+
+int64_t NoteLatency::GetTotal() const {
+  return capture_ns + vision_ns + tracker_hold_ns + audio_scheduling_ns;
+}
+
+std::string NoteLatency::ToString() const {
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(2) << "note " << midi_note
+         << " capture " << NanosecondsToMilliseconds(capture_ns)
+         << " vision " << NanosecondsToMilliseconds(vision_ns)
+         << " tracker_hold " << NanosecondsToMilliseconds(tracker_hold_ns)
+         << " audio_scheduling "
+         << NanosecondsToMilliseconds(audio_scheduling_ns) << " total "
+         << NanosecondsToMilliseconds(GetTotal()) << " ms";
+  return stream.str();
+}
+
+NoteLatency ComputeNoteLatency(const FrameTimestamps& frame,
+                               const PressTiming& press) {
+  NoteLatency latency;
+  latency.midi_note = press.midi_note;
+  latency.capture_ns = frame.capture_ns - frame.capture_start_ns;
+  latency.vision_ns = frame.vision_done_ns - frame.capture_ns;
+  // The press was already visible onset_ns, so the tracker held it back for
+  // every frame from then until the frame it was played from.
+  int64_t onset_ns = press.onset_ns != UNKNOWN_ONSET_NS ? press.onset_ns
+                                                        : press.capture_ns;
+  latency.tracker_hold_ns = (press.capture_ns - onset_ns) +
+                            (frame.tracking_done_ns - frame.vision_done_ns);
+  latency.audio_scheduling_ns = press.trigger_ns - frame.tracking_done_ns;
+  return latency;
+}
+
+NoteLatencyRecorder::NoteLatencyRecorder(MetricsRegistry& metrics)
+    : capture_histogram_(metrics.GetHistogram("latency.capture")),
+      vision_histogram_(metrics.GetHistogram("latency.vision")),
+      tracker_hold_histogram_(metrics.GetHistogram("latency.tracker_hold")),
+      audio_scheduling_histogram_(
+          metrics.GetHistogram("latency.audio_scheduling")),
+      total_histogram_(metrics.GetHistogram("latency.total")) {
+}
+
+void NoteLatencyRecorder::Record(const NoteLatency& latency) {
+  capture_histogram_.Record(latency.capture_ns);
+  vision_histogram_.Record(latency.vision_ns);
+  tracker_hold_histogram_.Record(latency.tracker_hold_ns);
+  audio_scheduling_histogram_.Record(latency.audio_scheduling_ns);
+  total_histogram_.Record(latency.GetTotal());
+}
+
+const LatencyHistogram& NoteLatencyRecorder::GetTotalHistogram() const {
+  return total_histogram_;
+}
+}  // namespace common
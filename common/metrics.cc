@@ -0,0 +1,259 @@
+#include "common/metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace common {
+
+const int LatencyHistogram::SUB_BUCKET_BITS;
+const int64_t LatencyHistogram::SUB_BUCKETS;
+const int LatencyHistogram::MAX_VALUE_BITS;
+const int64_t LatencyHistogram::MAX_VALUE;
+const size_t LatencyHistogram::NUMBER_OF_BUCKETS;
+
+namespace {
+/**
+ * Formats a duration in nanoseconds as milliseconds with two decimals.
+ */
+std::string FormatMilliseconds(int64_t nanoseconds) {
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(2)
+         << static_cast<double>(nanoseconds) / 1e6;
+  return stream.str();
+}
+}  // namespace
+
+Counter::Counter() : value_(0) {
+}
+
+void Counter::Increment(uint64_t amount) {
+  value_.fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint64_t Counter::Get() const {
+  return value_.load(std::memory_order_relaxed);
+}
+
+Gauge::Gauge() : value_(0) {
+}
+
+void Gauge::Set(double value) {
+  value_.store(value, std::memory_order_relaxed);
+}
+
+double Gauge::Get() const {
+  return value_.load(std::memory_order_relaxed);
+}
+
+LatencyHistogram::LatencyHistogram() : count_(0), sum_(0), max_(0) {
+  for (std::atomic<uint64_t>& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t LatencyHistogram::GetBucketIndex(int64_t value) {
+  if (value < SUB_BUCKETS) {
+    return static_cast<size_t>(value);
+  }
+  // The position of the highest set bit picks the power of two range, and the
+  // SUB_BUCKET_BITS bits below it pick the bucket inside that range.
+  int highest_bit = SUB_BUCKET_BITS;
+  while ((value >> (highest_bit + 1)) != 0) {
+    ++highest_bit;
+  }
+  int shift = highest_bit - SUB_BUCKET_BITS;
+  int64_t sub_bucket = (value >> shift) - SUB_BUCKETS;
+  return static_cast<size_t>((shift + 1) * SUB_BUCKETS + sub_bucket);
+}
+
+int64_t LatencyHistogram::GetBucketValue(size_t index) {
+  if (index < static_cast<size_t>(SUB_BUCKETS)) {
+    return static_cast<int64_t>(index);
+  }
+  int shift = static_cast<int>(index / SUB_BUCKETS) - 1;
+  int64_t sub_bucket = static_cast<int64_t>(index % SUB_BUCKETS);
+  int64_t lowest_value = (SUB_BUCKETS + sub_bucket) << shift;
+  return lowest_value + (int64_t(1) << shift) / 2;
+}
+
+void LatencyHistogram::Record(int64_t value_ns) {
+  if (value_ns < 0) {
+    value_ns = 0;
+  } else if (value_ns > MAX_VALUE) {
+    value_ns = MAX_VALUE;
+  }
+  buckets_[GetBucketIndex(value_ns)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value_ns, std::memory_order_relaxed);
+  int64_t max = max_.load(std::memory_order_relaxed);
+  while (value_ns > max &&
+         !max_.compare_exchange_weak(max, value_ns,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+  return count_.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::GetMax() const {
+  return max_.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::GetMean() const {
+  uint64_t count = GetCount();
+  if (count == 0) {
+    return 0;
+  }
+  return static_cast<double>(sum_.load(std::memory_order_relaxed)) / count;
+}
+
+int64_t LatencyHistogram::GetPercentile(double percentile) const {
+  // The buckets may be written to while we read them, so we count them again
+  // instead of using count_.
+  uint64_t counts[NUMBER_OF_BUCKETS];
+  uint64_t total = 0;
+  for (size_t i = 0; i < NUMBER_OF_BUCKETS; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(percentile / 100 * total + 0.5);
+  rank = std::max<uint64_t>(1, std::min(rank, total));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < NUMBER_OF_BUCKETS; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      // The middle of the bucket may be above the largest recorded value.
+      return std::min(GetBucketValue(i), GetMax());
+    }
+  }
+  return GetMax();
+}
+
+Counter& MetricsRegistry::GetCounter(const std::string& name) {
+  std::lock_guard<std::mutex> lock(registration_mutex_);
+  std::unique_ptr<Counter>& counter = counters_[name];
+  if (!counter) {
+    counter.reset(new Counter());
+  }
+  return *counter;
+}
+
+Gauge& MetricsRegistry::GetGauge(const std::string& name) {
+  std::lock_guard<std::mutex> lock(registration_mutex_);
+  std::unique_ptr<Gauge>& gauge = gauges_[name];
+  if (!gauge) {
+    gauge.reset(new Gauge());
+  }
+  return *gauge;
+}
+
+LatencyHistogram& MetricsRegistry::GetHistogram(const std::string& name) {
+  std::lock_guard<std::mutex> lock(registration_mutex_);
+  std::unique_ptr<LatencyHistogram>& histogram = histograms_[name];
+  if (!histogram) {
+    histogram.reset(new LatencyHistogram());
+  }
+  return *histogram;
+}
+
+nlohmann::json MetricsRegistry::ToJson() const {
+  std::lock_guard<std::mutex> lock(registration_mutex_);
+  nlohmann::json json = {{"counters", nlohmann::json::object()},
+                         {"gauges", nlohmann::json::object()},
+                         {"histograms", nlohmann::json::object()}};
+  for (const auto& pair : counters_) {
+    json["counters"][pair.first] = pair.second->Get();
+  }
+  for (const auto& pair : gauges_) {
+    json["gauges"][pair.first] = pair.second->Get();
+  }
+  for (const auto& pair : histograms_) {
+    const LatencyHistogram& histogram = *pair.second;
+    json["histograms"][pair.first] = {
+        {"count", histogram.GetCount()},
+        {"mean_ms", histogram.GetMean() / 1e6},
+        {"p50_ms", histogram.GetPercentile(50) / 1e6},
+        {"p90_ms", histogram.GetPercentile(90) / 1e6},
+        {"p99_ms", histogram.GetPercentile(99) / 1e6},
+        {"max_ms", histogram.GetMax() / 1e6}};
+  }
+  return json;
+}
+
+std::vector<std::string> MetricsRegistry::GetOverlayLines() const {
+  std::lock_guard<std::mutex> lock(registration_mutex_);
+  std::vector<std::string> lines;
+  for (const auto& pair : gauges_) {
+    std::ostringstream stream;
+    stream << pair.first << " " << std::fixed << std::setprecision(1)
+           << pair.second->Get();
+    lines.push_back(stream.str());
+  }
+  for (const auto& pair : counters_) {
+    lines.push_back(pair.first + " " + std::to_string(pair.second->Get()));
+  }
+  for (const auto& pair : histograms_) {
+    const LatencyHistogram& histogram = *pair.second;
+    lines.push_back(pair.first + " p50 " +
+                    FormatMilliseconds(histogram.GetPercentile(50)) +
+                    " p99 " + FormatMilliseconds(histogram.GetPercentile(99)) +
+                    " max " + FormatMilliseconds(histogram.GetMax()) + " ms");
+  }
+  return lines;
+}
+
+MetricsFileWriter::MetricsFileWriter(const MetricsRegistry& registry,
+                                     const std::string& file_name,
+                                     int dump_interval_ms,
+                                     ThreadPolicies* thread_policies)
+    : registry_(registry),
+      file_name_(file_name),
+      dump_interval_ms_(dump_interval_ms),
+      thread_policies_(thread_policies),
+      running_(true) {
+  if (dump_interval_ms <= 0) {
+    throw std::invalid_argument("The dump interval must be positive!");
+  }
+  write_thread_ = std::thread(&MetricsFileWriter::WriteLoop, this);
+}
+
+MetricsFileWriter::~MetricsFileWriter() {
+  {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    running_ = false;
+  }
+  write_condition_.notify_all();
+  write_thread_.join();
+  WriteFile();
+}
+
+void MetricsFileWriter::WriteLoop() {
+  if (thread_policies_ != nullptr) {
+    thread_policies_->Apply(METRICS_THREAD);
+  }
+  std::unique_lock<std::mutex> lock(write_mutex_);
+  while (running_) {
+    write_condition_.wait_for(lock,
+                              std::chrono::milliseconds(dump_interval_ms_));
+    if (!running_) {
+      break;
+    }
+    lock.unlock();
+    WriteFile();
+    lock.lock();
+  }
+}
+
+void MetricsFileWriter::WriteFile() {
+  std::ofstream file(file_name_, std::ios::trunc);
+  file << registry_.ToJson().dump(2) << "\n";
+}
+}  // namespace common
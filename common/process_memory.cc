@@ -0,0 +1,23 @@
+#include "common/process_memory.h"
+
+#ifdef __linux__
+#include <unistd.h>
+
+#include <fstream>
+#endif
+
+namespace common {
+
+int64_t GetResidentMemoryBytes() {
+#ifdef __linux__
+  // The total program size, then the resident size, both in pages.
+  std::ifstream statm("/proc/self/statm");
+  int64_t total_pages;
+  int64_t resident_pages;
+  if (statm >> total_pages >> resident_pages) {
+    return resident_pages * sysconf(_SC_PAGESIZE);
+  }
+#endif
+  return -1;
+}
+}  // namespace common
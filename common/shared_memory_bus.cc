@@ -0,0 +1,377 @@
+#include "common/shared_memory_bus.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace common {
+
+// Readers in other processes share these atomics, so they must not be
+// implemented with a lock.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "The bus needs lock free 32 and 64 bit atomics");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "The futex word must be a plain 32 bit integer");
+
+/**
+ * The start of the shared memory, followed by the ring.
+ */
+struct BusHeader {
+  std::atomic<uint32_t> magic;  // Written last, once the bus is ready
+  uint32_t version;
+  uint64_t capacity;  // The bytes in the ring
+  // Where the last published message ends, counting from the first message
+  // ever published, so it never wraps around.
+  std::atomic<uint64_t> write_position;
+  // Messages which start before this may be being overwritten.
+  std::atomic<uint64_t> reclaim_position;
+  std::atomic<uint32_t> publish_count;  // The futex word readers wait on
+  std::atomic<uint32_t> closed;
+};
+
+namespace {
+/**
+ * Precedes every message in the ring.
+ */
+struct RecordHeader {
+  uint32_t type;
+  uint32_t size;
+  uint64_t sequence;
+  int64_t timestamp_ns;
+};
+
+const uint32_t BUS_MAGIC = 0x47504231;  // "GPB1"
+const uint32_t BUS_VERSION = 1;
+const size_t RECORD_ALIGNMENT = 8;
+const size_t MIN_CAPACITY = 4096;
+// The ring starts on its own cache line.
+const size_t RING_OFFSET = (sizeof(BusHeader) + 63) / 64 * 64;
+
+uint64_t AlignUp(uint64_t bytes) {
+  return (bytes + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+}
+
+/**
+ * Wakes every reader waiting for a message.
+ */
+void WakeReaders(BusHeader* header) {
+  header->publish_count.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&header->publish_count),
+          FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+#ifndef _WIN32
+/**
+ * Throws std::runtime_error with the message and the description of errno.
+ */
+void ThrowBusError(const std::string& message) {
+  throw std::runtime_error(message + ": " + std::strerror(errno));
+}
+#endif
+}  // namespace
+
+SharedMemoryBusWriter::SharedMemoryBusWriter(const std::string& name,
+                                             size_t capacity)
+    : name_(name),
+      memory_(nullptr),
+      memory_size_(0),
+      header_(nullptr),
+      ring_(nullptr),
+      write_position_(0),
+      message_end_(0),
+      next_sequence_(0),
+      writing_(false) {
+  if (capacity < MIN_CAPACITY) {
+    throw std::invalid_argument("The bus must hold at least 4 KB!");
+  }
+#ifdef _WIN32
+  throw std::runtime_error("The bus " + name +
+                           " needs POSIX shared memory, which Windows lacks");
+#else
+  // A bus left behind by a writer that crashed.
+  shm_unlink(name.c_str());
+  int file_descriptor =
+      shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  if (file_descriptor == -1) {
+    ThrowBusError("Could not create the bus " + name);
+  }
+  const uint64_t ring_bytes = AlignUp(capacity);
+  memory_size_ = RING_OFFSET + ring_bytes;
+  if (ftruncate(file_descriptor, static_cast<off_t>(memory_size_)) == -1) {
+    int error = errno;
+    close(file_descriptor);
+    shm_unlink(name.c_str());
+    errno = error;
+    ThrowBusError("Could not size the bus " + name);
+  }
+  memory_ = mmap(nullptr, memory_size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 file_descriptor, 0);
+  close(file_descriptor);
+  if (memory_ == MAP_FAILED) {
+    memory_ = nullptr;
+    shm_unlink(name.c_str());
+    ThrowBusError("Could not map the bus " + name);
+  }
+  header_ = new (memory_) BusHeader;
+  header_->version = BUS_VERSION;
+  header_->capacity = ring_bytes;
+  header_->write_position.store(0, std::memory_order_relaxed);
+  header_->reclaim_position.store(0, std::memory_order_relaxed);
+  header_->publish_count.store(0, std::memory_order_relaxed);
+  header_->closed.store(0, std::memory_order_relaxed);
+  ring_ = static_cast<unsigned char*>(memory_) + RING_OFFSET;
+  header_->magic.store(BUS_MAGIC, std::memory_order_release);
+#endif
+}
+
+SharedMemoryBusWriter::~SharedMemoryBusWriter() {
+#ifndef _WIN32
+  header_->closed.store(1, std::memory_order_release);
+  WakeReaders(header_);
+  munmap(memory_, memory_size_);
+  shm_unlink(name_.c_str());
+#endif
+}
+
+unsigned char* SharedMemoryBusWriter::BeginMessage(BusMessageType type,
+                                                   size_t size,
+                                                   int64_t timestamp_ns) {
+  if (writing_) {
+    throw std::logic_error("The last message on the bus was not ended!");
+  }
+  if (size > GetMaxMessageSize()) {
+    throw std::invalid_argument("The message is too big for the bus!");
+  }
+  const uint64_t capacity = header_->capacity;
+  const uint64_t length = AlignUp(sizeof(RecordHeader) + size);
+  // Messages never wrap around the end of the ring.
+  const uint64_t space_to_end = capacity - write_position_ % capacity;
+  const uint64_t start =
+      space_to_end < length ? write_position_ + space_to_end : write_position_;
+  message_end_ = start + length;
+  if (message_end_ > capacity) {
+    // Readers must see that the bytes are reclaimed before any of them
+    // changes.
+    header_->reclaim_position.store(message_end_ - capacity,
+                                    std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  if (start != write_position_ && space_to_end >= sizeof(RecordHeader)) {
+    RecordHeader padding = {static_cast<uint32_t>(BusMessageType::PADDING), 0,
+                            0, 0};
+    std::memcpy(ring_ + write_position_ % capacity, &padding,
+                sizeof(padding));
+  }
+  RecordHeader record = {static_cast<uint32_t>(type),
+                         static_cast<uint32_t>(size), next_sequence_++,
+                         timestamp_ns};
+  unsigned char* record_start = ring_ + start % capacity;
+  std::memcpy(record_start, &record, sizeof(record));
+  writing_ = true;
+  return record_start + sizeof(RecordHeader);
+}
+
+void SharedMemoryBusWriter::EndMessage() {
+  if (!writing_) {
+    throw std::logic_error("No message on the bus was begun!");
+  }
+  writing_ = false;
+  write_position_ = message_end_;
+  header_->write_position.store(write_position_, std::memory_order_release);
+  WakeReaders(header_);
+}
+
+void SharedMemoryBusWriter::Publish(BusMessageType type, const void* data,
+                                    size_t size, int64_t timestamp_ns) {
+  unsigned char* payload = BeginMessage(type, size, timestamp_ns);
+  if (size > 0) {
+    std::memcpy(payload, data, size);
+  }
+  EndMessage();
+}
+
+size_t SharedMemoryBusWriter::GetMaxMessageSize() const {
+  // The padding before a message is shorter than the message, so the two only
+  // reach back into the message before if messages can be over a third of
+  // the ring.
+  return header_->capacity / 3 / RECORD_ALIGNMENT * RECORD_ALIGNMENT -
+         sizeof(RecordHeader);
+}
+
+uint64_t SharedMemoryBusWriter::GetPublishedMessages() const {
+  return next_sequence_;
+}
+
+SharedMemoryBusReader::SharedMemoryBusReader(const std::string& name)
+    : memory_(nullptr),
+      memory_size_(0),
+      header_(nullptr),
+      ring_(nullptr),
+      read_position_(0),
+      next_sequence_(0),
+      has_read_(false),
+      overruns_(0),
+      lost_messages_(0) {
+#ifdef _WIN32
+  throw std::runtime_error("The bus " + name +
+                           " needs POSIX shared memory, which Windows lacks");
+#else
+  int file_descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+  if (file_descriptor == -1) {
+    ThrowBusError("Could not open the bus " + name);
+  }
+  struct stat status;
+  if (fstat(file_descriptor, &status) == -1) {
+    int error = errno;
+    close(file_descriptor);
+    errno = error;
+    ThrowBusError("Could not open the bus " + name);
+  }
+  memory_size_ = static_cast<size_t>(status.st_size);
+  if (memory_size_ < RING_OFFSET) {
+    close(file_descriptor);
+    throw std::runtime_error(name + " is not a bus, or is not ready yet");
+  }
+  memory_ = mmap(nullptr, memory_size_, PROT_READ, MAP_SHARED,
+                 file_descriptor, 0);
+  close(file_descriptor);
+  if (memory_ == MAP_FAILED) {
+    memory_ = nullptr;
+    ThrowBusError("Could not map the bus " + name);
+  }
+  header_ = static_cast<const BusHeader*>(memory_);
+  if (header_->magic.load(std::memory_order_acquire) != BUS_MAGIC ||
+      header_->version != BUS_VERSION ||
+      RING_OFFSET + header_->capacity > memory_size_) {
+    munmap(memory_, memory_size_);
+    throw std::runtime_error(name + " is not a bus of this version, or is "
+                                    "not ready yet");
+  }
+  ring_ = static_cast<const unsigned char*>(memory_) + RING_OFFSET;
+  read_position_ = header_->write_position.load(std::memory_order_acquire);
+#endif
+}
+
+SharedMemoryBusReader::~SharedMemoryBusReader() {
+#ifndef _WIN32
+  munmap(memory_, memory_size_);
+#endif
+}
+
+BusReadResult SharedMemoryBusReader::Next(BusMessage& message) {
+  const uint64_t capacity = header_->capacity;
+  while (true) {
+    const uint64_t write_position =
+        header_->write_position.load(std::memory_order_acquire);
+    if (read_position_ == write_position) {
+      return header_->closed.load(std::memory_order_acquire)
+                 ? BusReadResult::CLOSED
+                 : BusReadResult::NO_MESSAGE;
+    }
+    if (read_position_ <
+        header_->reclaim_position.load(std::memory_order_acquire)) {
+      return Overrun();
+    }
+    const uint64_t space_to_end = capacity - read_position_ % capacity;
+    if (space_to_end < sizeof(RecordHeader)) {
+      read_position_ += space_to_end;
+      continue;
+    }
+    RecordHeader record;
+    std::memcpy(&record, ring_ + read_position_ % capacity, sizeof(record));
+    // The header is only whole if it was not reclaimed while we copied it.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (read_position_ <
+        header_->reclaim_position.load(std::memory_order_relaxed)) {
+      return Overrun();
+    }
+    if (record.type == static_cast<uint32_t>(BusMessageType::PADDING)) {
+      read_position_ += space_to_end;
+      continue;
+    }
+    message.type = static_cast<BusMessageType>(record.type);
+    message.sequence = record.sequence;
+    message.timestamp_ns = record.timestamp_ns;
+    message.data = ring_ + read_position_ % capacity + sizeof(RecordHeader);
+    message.size = record.size;
+    message.position = read_position_;
+    if (has_read_ && record.sequence > next_sequence_) {
+      lost_messages_ += record.sequence - next_sequence_;
+    }
+    next_sequence_ = record.sequence + 1;
+    has_read_ = true;
+    read_position_ += AlignUp(sizeof(RecordHeader) + record.size);
+    return BusReadResult::MESSAGE;
+  }
+}
+
+BusReadResult SharedMemoryBusReader::Overrun() {
+  ++overruns_;
+  read_position_ = header_->write_position.load(std::memory_order_acquire);
+  return BusReadResult::OVERRUN;
+}
+
+bool SharedMemoryBusReader::IsValid(const BusMessage& message) const {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return message.position >=
+         header_->reclaim_position.load(std::memory_order_relaxed);
+}
+
+bool SharedMemoryBusReader::Wait(int timeout_ms) {
+  const uint32_t publish_count =
+      header_->publish_count.load(std::memory_order_acquire);
+  auto has_news = [this]() {
+    return header_->write_position.load(std::memory_order_acquire) !=
+               read_position_ ||
+           header_->closed.load(std::memory_order_acquire) != 0;
+  };
+  if (has_news()) {
+    return true;
+  }
+#ifdef __linux__
+  // Returns as soon as the count differs from the one we saw, so a message
+  // published since is not missed.
+  timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+  syscall(SYS_futex,
+          reinterpret_cast<const uint32_t*>(&header_->publish_count),
+          FUTEX_WAIT, publish_count, &timeout, nullptr, 0);
+#else
+  // Without futexes, the count is polled.
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (header_->publish_count.load(std::memory_order_acquire) ==
+             publish_count &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+#endif
+  return has_news();
+}
+
+uint64_t SharedMemoryBusReader::GetOverruns() const {
+  return overruns_;
+}
+
+uint64_t SharedMemoryBusReader::GetLostMessages() const {
+  return lost_messages_;
+}
+}  // namespace common
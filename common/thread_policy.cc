@@ -0,0 +1,296 @@
+#include "common/thread_policy.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/capability.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace common {
+
+namespace {
+// Pages are at least this big, so touching every this many bytes touches
+// every page.
+const size_t PREFAULT_STRIDE = 4096;
+const size_t STACK_CHUNK_BYTES = 16 * 1024;
+// Linux keeps at most this many characters of a thread name.
+const size_t MAX_THREAD_NAME_LENGTH = 15;
+
+std::string JoinCpus(const std::vector<int>& cpus) {
+  std::ostringstream stream;
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    stream << (i > 0 ? "," : "") << cpus[i];
+  }
+  return stream.str();
+}
+
+#ifdef __linux__
+int ToNativePolicy(SchedulingPolicy policy) {
+  switch (policy) {
+    case SchedulingPolicy::FIFO:
+      return SCHED_FIFO;
+    case SchedulingPolicy::ROUND_ROBIN:
+      return SCHED_RR;
+    default:
+      return SCHED_OTHER;
+  }
+}
+
+/**
+ * Returns whether the process may lock more memory than its memlock limit.
+ */
+bool CanLockPastLimit() {
+  __user_cap_header_struct header;
+  header.version = _LINUX_CAPABILITY_VERSION_3;
+  header.pid = 0;
+  __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3];
+  if (syscall(SYS_capget, &header, data) != 0) {
+    return false;
+  }
+  return (data[CAP_TO_INDEX(CAP_IPC_LOCK)].effective &
+          CAP_TO_MASK(CAP_IPC_LOCK)) != 0;
+}
+#endif
+}  // namespace
+
+SchedulingPolicy ParseSchedulingPolicy(const std::string& name) {
+  if (name == "other") {
+    return SchedulingPolicy::OTHER;
+  }
+  if (name == "fifo") {
+    return SchedulingPolicy::FIFO;
+  }
+  if (name == "rr") {
+    return SchedulingPolicy::ROUND_ROBIN;
+  }
+  throw std::invalid_argument("Unknown scheduling policy " + name);
+}
+
+std::string ToString(SchedulingPolicy policy) {
+  switch (policy) {
+    case SchedulingPolicy::FIFO:
+      return "fifo";
+    case SchedulingPolicy::ROUND_ROBIN:
+      return "rr";
+    default:
+      return "other";
+  }
+}
+
+std::string AppliedThreadPolicy::ToString() const {
+  std::ostringstream stream;
+  stream << thread_name << ": cpus "
+         << (cpus.empty() ? "any" : JoinCpus(cpus)) << ", "
+         << common::ToString(scheduling);
+  if (scheduling != SchedulingPolicy::OTHER) {
+    stream << " " << priority;
+  }
+  for (const std::string& failure : failures) {
+    stream << " (" << failure << ")";
+  }
+  return stream.str();
+}
+
+ThreadPolicyConfig ThreadPolicyConfig::FromJson(const nlohmann::json& json) {
+  ThreadPolicyConfig config;
+  config.lock_memory = json["lock_memory"];
+  config.prefault_stack_bytes =
+      static_cast<size_t>(json["prefault_stack_kb"]) * 1024;
+  for (auto it = json["threads"].begin(); it != json["threads"].end(); ++it) {
+    ThreadPolicy policy;
+    policy.cpus = (*it)["cpus"].get<std::vector<int>>();
+    policy.scheduling = ParseSchedulingPolicy((*it)["scheduling"]);
+    policy.priority = (*it)["priority"];
+    config.threads[it.key()] = policy;
+  }
+  return config;
+}
+
+ThreadPolicies::ThreadPolicies(const ThreadPolicyConfig& config)
+    : config_(config) {
+}
+
+AppliedThreadPolicy ThreadPolicies::Apply(const std::string& role) {
+  auto it = config_.threads.find(role);
+  AppliedThreadPolicy applied = ApplyThreadPolicy(
+      "gp-" + role, it != config_.threads.end() ? it->second : ThreadPolicy(),
+      config_.prefault_stack_bytes);
+  std::lock_guard<std::mutex> lock(report_mutex_);
+  // A role whose thread was restarted is only reported once.
+  for (AppliedThreadPolicy& previous : applied_) {
+    if (previous.thread_name == applied.thread_name) {
+      previous = applied;
+      return applied;
+    }
+  }
+  applied_.push_back(applied);
+  return applied;
+}
+
+bool ThreadPolicies::LockMemory() {
+  if (!config_.lock_memory) {
+    return true;
+  }
+  std::string detail;
+  bool locked = LockProcessMemory(detail);
+  std::lock_guard<std::mutex> lock(report_mutex_);
+  memory_report_ = locked ? "memory: locked" : "memory: not locked";
+  if (!detail.empty()) {
+    memory_report_ += " (" + detail + ")";
+  }
+  return locked;
+}
+
+std::vector<std::string> ThreadPolicies::GetReport() const {
+  std::lock_guard<std::mutex> lock(report_mutex_);
+  std::vector<std::string> lines;
+  if (!memory_report_.empty()) {
+    lines.push_back(memory_report_);
+  }
+  for (const AppliedThreadPolicy& applied : applied_) {
+    lines.push_back(applied.ToString());
+  }
+  return lines;
+}
+
+#ifdef __linux__
+AppliedThreadPolicy ApplyThreadPolicy(const std::string& thread_name,
+                                      const ThreadPolicy& policy,
+                                      size_t prefault_stack_bytes) {
+  AppliedThreadPolicy applied;
+  applied.thread_name = thread_name.substr(0, MAX_THREAD_NAME_LENGTH);
+  pthread_t thread = pthread_self();
+  int error = pthread_setname_np(thread, applied.thread_name.c_str());
+  if (error != 0) {
+    applied.failures.push_back(std::string("not named: ") +
+                               std::strerror(error));
+  }
+
+  if (!policy.cpus.empty()) {
+    const long cpu_count = sysconf(_SC_NPROCESSORS_CONF);
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    std::vector<int> cpus;
+    for (int cpu : policy.cpus) {
+      if (cpu >= 0 && cpu < cpu_count && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpu_set);
+        cpus.push_back(cpu);
+      } else {
+        applied.failures.push_back("there is no cpu " + std::to_string(cpu));
+      }
+    }
+    if (!cpus.empty()) {
+      error = pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set);
+      if (error == 0) {
+        applied.cpus = cpus;
+      } else {
+        applied.failures.push_back("not pinned to cpus " + JoinCpus(cpus) +
+                                   ": " + std::strerror(error));
+      }
+    }
+  }
+
+  if (policy.scheduling != SchedulingPolicy::OTHER) {
+    const int native_policy = ToNativePolicy(policy.scheduling);
+    sched_param parameters;
+    std::memset(&parameters, 0, sizeof(parameters));
+    parameters.sched_priority =
+        std::min(std::max(policy.priority,
+                          sched_get_priority_min(native_policy)),
+                 sched_get_priority_max(native_policy));
+    error = pthread_setschedparam(thread, native_policy, &parameters);
+    if (error == 0) {
+      applied.scheduling = policy.scheduling;
+      applied.priority = parameters.sched_priority;
+    } else {
+      // The thread keeps the default time sharing policy.
+      applied.failures.push_back(
+          "no " + ToString(policy.scheduling) + " " +
+          std::to_string(parameters.sched_priority) + ": " +
+          std::strerror(error) +
+          (error == EPERM ? ", it needs CAP_SYS_NICE or an rtprio limit"
+                          : ""));
+    }
+  }
+
+  if (prefault_stack_bytes > 0) {
+    PrefaultStack(prefault_stack_bytes);
+  }
+  return applied;
+}
+
+bool LockProcessMemory(std::string& detail) {
+  rlimit limit;
+  const bool limited = getrlimit(RLIMIT_MEMLOCK, &limit) == 0 &&
+                       limit.rlim_cur != RLIM_INFINITY && !CanLockPastLimit();
+  // Under a limit, locking future pages would make the next thread whose
+  // stack does not fit fail to start.
+  if (mlockall(limited ? MCL_CURRENT : MCL_CURRENT | MCL_FUTURE) == 0) {
+    if (limited) {
+      detail = "future pages are not locked under a memlock limit of " +
+               std::to_string(limit.rlim_cur / 1024) + " KB";
+    }
+    return true;
+  }
+  const int error = errno;
+  detail = std::strerror(error);
+  if (error == EPERM || error == ENOMEM) {
+    detail += ", it needs CAP_IPC_LOCK or a higher memlock limit";
+  }
+  return false;
+}
+#else
+AppliedThreadPolicy ApplyThreadPolicy(const std::string& thread_name,
+                                      const ThreadPolicy& policy,
+                                      size_t prefault_stack_bytes) {
+  AppliedThreadPolicy applied;
+  applied.thread_name = thread_name.substr(0, MAX_THREAD_NAME_LENGTH);
+  if (!policy.cpus.empty() ||
+      policy.scheduling != SchedulingPolicy::OTHER) {
+    applied.failures.push_back("thread policies are only applied on Linux");
+  }
+  if (prefault_stack_bytes > 0) {
+    PrefaultStack(prefault_stack_bytes);
+  }
+  return applied;
+}
+
+bool LockProcessMemory(std::string& detail) {
+  detail = "memory is only locked on Linux";
+  return false;
+}
+#endif
+
+void PrefaultStack(size_t bytes) {
+  unsigned char chunk[STACK_CHUNK_BYTES];
+  if (bytes > STACK_CHUNK_BYTES) {
+    PrefaultStack(bytes - STACK_CHUNK_BYTES);
+  }
+  // Writing after the recursive call keeps it from being a tail call, which
+  // would reuse this chunk.
+  volatile unsigned char* bytes_to_touch = chunk;
+  for (size_t i = 0; i < STACK_CHUNK_BYTES; i += PREFAULT_STRIDE) {
+    bytes_to_touch[i] = 0;
+  }
+}
+
+void PrefaultBuffer(void* data, size_t bytes) {
+  volatile unsigned char* bytes_to_touch = static_cast<unsigned char*>(data);
+  for (size_t i = 0; i < bytes; i += PREFAULT_STRIDE) {
+    bytes_to_touch[i] = bytes_to_touch[i];
+  }
+  if (bytes > 0) {
+    bytes_to_touch[bytes - 1] = bytes_to_touch[bytes - 1];
+  }
+}
+}  // namespace common
@@ -0,0 +1,92 @@
+#include "common/work_stealing_pool.h"
+
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace common {
+
+WorkStealingPool::WorkStealingPool(size_t workers)
+    : WORKERS_(workers), queues_(workers), stolen_tasks_(0) {
+  if (workers == 0) {
+    throw std::invalid_argument("A work stealing pool needs a worker");
+  }
+}
+
+void WorkStealingPool::Run(const std::vector<std::function<void()>>& tasks) {
+  // A Run cut short must not leave indices of its tasks for this one.
+  for (TaskQueue& queue : queues_) {
+    queue.tasks.clear();
+  }
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    queues_[i % WORKERS_].tasks.push_back(i);
+  }
+  stolen_tasks_ = 0;
+  std::vector<std::exception_ptr> errors(WORKERS_);
+  std::vector<std::thread> threads;
+  for (size_t worker = 0; worker < WORKERS_; ++worker) {
+    threads.push_back(std::thread([this, worker, &tasks, &errors]() {
+      RunWorker(worker, tasks, errors[worker]);
+    }));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (const std::exception_ptr& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+size_t WorkStealingPool::GetWorkerCount() const {
+  return WORKERS_;
+}
+
+size_t WorkStealingPool::GetStolenTasks() const {
+  return stolen_tasks_;
+}
+
+void WorkStealingPool::RunWorker(
+    size_t worker, const std::vector<std::function<void()>>& tasks,
+    std::exception_ptr& error) {
+  size_t task;
+  while (TakeTask(worker, task)) {
+    try {
+      tasks[task]();
+    } catch (...) {
+      // The worker goes on with its queue, so that every task still runs.
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+}
+
+bool WorkStealingPool::TakeTask(size_t worker, size_t& task) {
+  {
+    TaskQueue& own_queue = queues_[worker];
+    std::lock_guard<std::mutex> lock(own_queue.mutex);
+    if (!own_queue.tasks.empty()) {
+      task = own_queue.tasks.front();
+      own_queue.tasks.pop_front();
+      return true;
+    }
+  }
+  // Tasks are never added while running, so once every other queue has been
+  // found empty there is nothing left to do.
+  for (size_t i = 1; i < WORKERS_; ++i) {
+    TaskQueue& victim = queues_[(worker + i) % WORKERS_];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      // The back holds the tasks the victim would only reach last.
+      task = victim.tasks.back();
+      victim.tasks.pop_back();
+      std::lock_guard<std::mutex> stolen_lock(stolen_tasks_mutex_);
+      ++stolen_tasks_;
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace common
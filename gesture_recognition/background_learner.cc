@@ -0,0 +1,109 @@
+#include "gesturerecognition/background_learner.h"
+
+#include "common/clock.h"
+
+namespace gesturerecognition {
+
+BackgroundLearner::BackgroundLearner(const BackgroundModel& model,
+                                     common::ThreadPolicies* thread_policies)
+    : model_(model.Clone()),
+      snapshot_(std::make_shared<const BackgroundModel>(model.Clone())),
+      pending_learning_rate_(0),
+      has_pending_frame_(false),
+      is_learning_(false),
+      running_(true),
+      thread_policies_(thread_policies),
+      update_counter_(nullptr),
+      dropped_update_counter_(nullptr),
+      update_histogram_(nullptr) {
+  learn_thread_ = std::thread(&BackgroundLearner::LearnLoop, this);
+}
+
+BackgroundLearner::~BackgroundLearner() {
+  {
+    std::lock_guard<std::mutex> lock(learn_mutex_);
+    running_ = false;
+  }
+  learn_condition_.notify_all();
+  learn_thread_.join();
+}
+
+std::shared_ptr<const BackgroundModel> BackgroundLearner::GetSnapshot() const {
+  return std::atomic_load(&snapshot_);
+}
+
+bool BackgroundLearner::Learn(const cv::Mat& input_image,
+                              double learning_rate,
+                              const cv::Mat& update_mask) {
+  {
+    std::lock_guard<std::mutex> lock(learn_mutex_);
+    if (has_pending_frame_ || is_learning_) {
+      common::Counter* dropped_update_counter = dropped_update_counter_.load();
+      if (dropped_update_counter != nullptr) {
+        dropped_update_counter->Increment();
+      }
+      return false;
+    }
+    // The caller reuses its buffers for the next frame, so we copy them.
+    input_image.copyTo(pending_image_);
+    update_mask.copyTo(pending_mask_);
+    pending_learning_rate_ = learning_rate;
+    has_pending_frame_ = true;
+  }
+  learn_condition_.notify_one();
+  return true;
+}
+
+void BackgroundLearner::SetMetrics(common::MetricsRegistry* metrics) {
+  if (metrics == nullptr) {
+    update_counter_ = nullptr;
+    dropped_update_counter_ = nullptr;
+    update_histogram_ = nullptr;
+    return;
+  }
+  update_counter_ = &metrics->GetCounter("background.updates");
+  dropped_update_counter_ = &metrics->GetCounter("background.dropped_updates");
+  update_histogram_ = &metrics->GetHistogram("background.update");
+}
+
+void BackgroundLearner::LearnLoop() {
+  if (thread_policies_ != nullptr) {
+    thread_policies_->Apply(common::BACKGROUND_THREAD);
+  }
+  cv::Mat image;
+  cv::Mat update_mask;
+  std::unique_lock<std::mutex> lock(learn_mutex_);
+  while (true) {
+    learn_condition_.wait(lock,
+                          [this] { return !running_ || has_pending_frame_; });
+    if (!running_) {
+      return;
+    }
+    // Swapping only exchanges the headers, and leaves the buffers of the
+    // last frame for Learn to copy the next one into.
+    cv::swap(image, pending_image_);
+    cv::swap(update_mask, pending_mask_);
+    double learning_rate = pending_learning_rate_;
+    has_pending_frame_ = false;
+    is_learning_ = true;
+    lock.unlock();
+
+    int64_t start_time_ns = common::GetTimestampNanoseconds();
+    model_.Update(image, learning_rate, update_mask);
+    std::atomic_store(&snapshot_,
+                      std::make_shared<const BackgroundModel>(model_.Clone()));
+    common::LatencyHistogram* update_histogram = update_histogram_.load();
+    if (update_histogram != nullptr) {
+      update_histogram->Record(common::GetTimestampNanoseconds() -
+                               start_time_ns);
+    }
+    common::Counter* update_counter = update_counter_.load();
+    if (update_counter != nullptr) {
+      update_counter->Increment();
+    }
+
+    lock.lock();
+    is_learning_ = false;
+  }
+}
+}  // namespace gesturerecognition
@@ -0,0 +1,190 @@
+#include "gesturerecognition/background_model.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace gesturerecognition {
+
+namespace {
+// The same limits on the variance as MOG2 uses.
+const float INITIAL_VARIANCE = 15;
+const float MIN_VARIANCE = 4;
+const float MAX_VARIANCE = 75;
+
+/**
+ * Returns whether the model can learn images of the given type.
+ */
+bool IsSupportedType(int type) {
+  return type == CV_8UC1 || type == CV_8UC3;
+}
+}  // namespace
+
+BackgroundModel::BackgroundModel(double variance_threshold)
+    : variance_threshold_(variance_threshold), frames_learnt_(0) {
+}
+
+void BackgroundModel::Apply(const cv::Mat& input_image,
+                            cv::Mat& foreground_mask, double learning_rate) {
+  ComputeForeground(input_image, foreground_mask);
+  Update(input_image, learning_rate);
+}
+
+void BackgroundModel::ComputeForeground(const cv::Mat& input_image,
+                                        cv::Mat& foreground_mask) const {
+  CV_Assert(IsSupportedType(input_image.type()));
+  foreground_mask.create(input_image.size(), CV_8UC1);
+  if (!Matches(input_image)) {
+    foreground_mask.setTo(255);
+    return;
+  }
+  const int channels = input_image.channels();
+  const float threshold = static_cast<float>(variance_threshold_);
+  for (int row = 0; row < input_image.rows; ++row) {
+    const uchar* pixel = input_image.ptr<uchar>(row);
+    const float* mean = mean_.ptr<float>(row);
+    const float* variance = variance_.ptr<float>(row);
+    uchar* mask = foreground_mask.ptr<uchar>(row);
+    for (int col = 0; col < input_image.cols; ++col) {
+      float distance = 0;
+      for (int channel = 0; channel < channels; ++channel) {
+        float difference = pixel[channels * col + channel] -
+                           mean[channels * col + channel];
+        distance += difference * difference;
+      }
+      mask[col] = distance > threshold * variance[col] ? 255 : 0;
+    }
+  }
+}
+
+void BackgroundModel::Update(const cv::Mat& input_image, double learning_rate,
+                             const cv::Mat& update_mask) {
+  CV_Assert(IsSupportedType(input_image.type()));
+  if (!Matches(input_image)) {
+    Reset(input_image);
+    return;
+  }
+  const int channels = input_image.channels();
+  const float rate = static_cast<float>(learning_rate);
+  for (int row = 0; row < input_image.rows; ++row) {
+    const uchar* pixel = input_image.ptr<uchar>(row);
+    const uchar* mask =
+        update_mask.empty() ? nullptr : update_mask.ptr<uchar>(row);
+    float* mean = mean_.ptr<float>(row);
+    float* variance = variance_.ptr<float>(row);
+    for (int col = 0; col < input_image.cols; ++col) {
+      if (mask != nullptr && mask[col] == 0) {
+        continue;
+      }
+      float distance = 0;
+      for (int channel = 0; channel < channels; ++channel) {
+        float difference = pixel[channels * col + channel] -
+                           mean[channels * col + channel];
+        mean[channels * col + channel] += rate * difference;
+        distance += difference * difference;
+      }
+      // The variance is shared by the channels, so it follows their average.
+      variance[col] += rate * (distance / channels - variance[col]);
+      variance[col] =
+          std::min(MAX_VARIANCE, std::max(MIN_VARIANCE, variance[col]));
+    }
+  }
+  ++frames_learnt_;
+}
+
+bool BackgroundModel::Matches(const cv::Mat& input_image) const {
+  return mean_.size() == input_image.size() &&
+         mean_.channels() == input_image.channels();
+}
+
+void BackgroundModel::Reset(const cv::Mat& input_image) {
+  input_image.convertTo(mean_, CV_32F);
+  variance_.create(input_image.size(), CV_32FC1);
+  variance_.setTo(INITIAL_VARIANCE);
+  frames_learnt_ = 1;
+}
+
+BackgroundModel BackgroundModel::Clone() const {
+  BackgroundModel clone(variance_threshold_);
+  clone.mean_ = mean_.clone();
+  clone.variance_ = variance_.clone();
+  clone.frames_learnt_ = frames_learnt_;
+  return clone;
+}
+
+bool BackgroundModel::IsEmpty() const {
+  return mean_.empty();
+}
+
+cv::Size BackgroundModel::GetSize() const {
+  return mean_.size();
+}
+
+int BackgroundModel::GetChannels() const {
+  return mean_.empty() ? 0 : mean_.channels();
+}
+
+uint64_t BackgroundModel::GetFramesLearnt() const {
+  return frames_learnt_;
+}
+
+double BackgroundModel::GetMeanVariance() const {
+  return variance_.empty() ? 0 : cv::mean(variance_)[0];
+}
+
+void BackgroundModel::GetMeanImage(cv::Mat& image) const {
+  if (mean_.empty()) {
+    image.release();
+    return;
+  }
+  mean_.convertTo(image, CV_8U);
+}
+
+void BackgroundModel::Write(std::ostream& stream) const {
+  int32_t rows = mean_.rows;
+  int32_t cols = mean_.cols;
+  int32_t channels = GetChannels();
+  stream.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+  stream.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
+  stream.write(reinterpret_cast<const char*>(&channels), sizeof(channels));
+  stream.write(reinterpret_cast<const char*>(&frames_learnt_),
+               sizeof(frames_learnt_));
+  // Both matrices are created whole, so their rows are contiguous.
+  if (!mean_.empty()) {
+    stream.write(reinterpret_cast<const char*>(mean_.data),
+                 mean_.total() * mean_.elemSize());
+    stream.write(reinterpret_cast<const char*>(variance_.data),
+                 variance_.total() * variance_.elemSize());
+  }
+}
+
+void BackgroundModel::Read(std::istream& stream) {
+  int32_t rows = 0;
+  int32_t cols = 0;
+  int32_t channels = 0;
+  uint64_t frames_learnt = 0;
+  stream.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+  stream.read(reinterpret_cast<char*>(&cols), sizeof(cols));
+  stream.read(reinterpret_cast<char*>(&channels), sizeof(channels));
+  stream.read(reinterpret_cast<char*>(&frames_learnt), sizeof(frames_learnt));
+  if (!stream || rows < 0 || cols < 0 ||
+      (rows > 0 && cols > 0 && channels != 1 && channels != 3)) {
+    throw std::invalid_argument("The stream does not hold a background model!");
+  }
+  cv::Mat mean;
+  cv::Mat variance;
+  if (rows > 0 && cols > 0) {
+    mean.create(rows, cols, CV_32FC(channels));
+    variance.create(rows, cols, CV_32FC1);
+    stream.read(reinterpret_cast<char*>(mean.data),
+                mean.total() * mean.elemSize());
+    stream.read(reinterpret_cast<char*>(variance.data),
+                variance.total() * variance.elemSize());
+    if (!stream) {
+      throw std::invalid_argument("The background model is cut short!");
+    }
+  }
+  mean_ = mean;
+  variance_ = variance;
+  frames_learnt_ = frames_learnt;
+}
+}  // namespace gesturerecognition
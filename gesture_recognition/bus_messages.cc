@@ -0,0 +1,193 @@
+#include "gesturerecognition/bus_messages.h"
+
+#include <cstring>
+
+namespace gesturerecognition {
+
+namespace {
+/**
+ * Precedes the pixels of FRAME and MASK messages, which follow it row after
+ * row without padding.
+ */
+struct ImageHeader {
+  int32_t rows;
+  int32_t cols;
+  int32_t type;          // The OpenCV type
+  int32_t pixel_format;  // A PixelFormat, BGR for masks
+};
+
+/**
+ * A hand in a HANDS message. The two hands are followed by the finger tips
+ * of the first, then those of the second, as x and y pairs.
+ */
+struct HandRecord {
+  int32_t center_x;
+  int32_t center_y;
+  int32_t box_x;
+  int32_t box_y;
+  int32_t box_width;
+  int32_t box_height;
+  int64_t capture_time_ns;
+  uint32_t finger_count;
+  uint32_t reserved;
+};
+
+void PublishImage(common::SharedMemoryBusWriter& bus,
+                  common::BusMessageType type, const cv::Mat& image,
+                  PixelFormat format, int64_t capture_time_ns) {
+  const size_t image_bytes = image.total() * image.elemSize();
+  unsigned char* payload =
+      bus.BeginMessage(type, sizeof(ImageHeader) + image_bytes,
+                       capture_time_ns);
+  ImageHeader header = {image.rows, image.cols, image.type(),
+                        static_cast<int32_t>(format)};
+  std::memcpy(payload, &header, sizeof(header));
+  // Copies the pixels straight into the bus, dropping any row padding.
+  cv::Mat destination(image.rows, image.cols, image.type(),
+                      payload + sizeof(ImageHeader));
+  image.copyTo(destination);
+  bus.EndMessage();
+}
+
+bool ReadImage(const common::BusMessage& message, cv::Mat& image,
+               PixelFormat& format) {
+  if (message.size < sizeof(ImageHeader)) {
+    return false;
+  }
+  ImageHeader header;
+  std::memcpy(&header, message.data, sizeof(header));
+  // Every frame and mask of the pipeline has 8 bit channels.
+  if (header.rows <= 0 || header.cols <= 0 ||
+      (header.type != CV_8UC1 && header.type != CV_8UC2 &&
+       header.type != CV_8UC3) ||
+      header.pixel_format < 0 ||
+      header.pixel_format > static_cast<int32_t>(PixelFormat::NV12)) {
+    return false;
+  }
+  const uint64_t channels = header.type == CV_8UC1   ? 1
+                            : header.type == CV_8UC2 ? 2
+                                                     : 3;
+  if (sizeof(ImageHeader) + static_cast<uint64_t>(header.rows) *
+                                header.cols * channels !=
+      message.size) {
+    return false;
+  }
+  // The bus is mapped read only, so the pixels must not be written to.
+  image = cv::Mat(header.rows, header.cols, header.type,
+                  const_cast<unsigned char*>(message.data) +
+                      sizeof(ImageHeader));
+  format = static_cast<PixelFormat>(header.pixel_format);
+  return true;
+}
+
+HandRecord ToRecord(const Hand& hand) {
+  HandRecord record = {hand.center_of_palm_.x,
+                       hand.center_of_palm_.y,
+                       hand.bounding_box_.x,
+                       hand.bounding_box_.y,
+                       hand.bounding_box_.width,
+                       hand.bounding_box_.height,
+                       hand.capture_time_ns_,
+                       static_cast<uint32_t>(hand.finger_tips_.size()),
+                       0};
+  return record;
+}
+}  // namespace
+
+void PublishFrame(common::SharedMemoryBusWriter& bus,
+                  const CapturedFrame& frame, int64_t capture_time_ns) {
+  PublishImage(bus, common::BusMessageType::FRAME, frame.data_, frame.format_,
+               capture_time_ns);
+}
+
+void PublishMask(common::SharedMemoryBusWriter& bus, const cv::Mat& mask,
+                 int64_t capture_time_ns) {
+  PublishImage(bus, common::BusMessageType::MASK, mask, PixelFormat::BGR,
+               capture_time_ns);
+}
+
+void PublishRleMask(common::SharedMemoryBusWriter& bus, const RleMask& mask,
+                    int64_t capture_time_ns) {
+  // The mask is encoded straight into the bus.
+  mask.Encode(bus.BeginMessage(common::BusMessageType::RLE_MASK,
+                               mask.GetEncodedSize(), capture_time_ns));
+  bus.EndMessage();
+}
+
+void PublishHands(common::SharedMemoryBusWriter& bus,
+                  const std::pair<Hand, Hand>& hands,
+                  int64_t capture_time_ns) {
+  const Hand* both_hands[] = {&hands.first, &hands.second};
+  size_t size = 2 * sizeof(HandRecord);
+  for (const Hand* hand : both_hands) {
+    size += hand->finger_tips_.size() * 2 * sizeof(int32_t);
+  }
+  unsigned char* payload =
+      bus.BeginMessage(common::BusMessageType::HANDS, size, capture_time_ns);
+  for (const Hand* hand : both_hands) {
+    HandRecord record = ToRecord(*hand);
+    std::memcpy(payload, &record, sizeof(record));
+    payload += sizeof(record);
+  }
+  for (const Hand* hand : both_hands) {
+    for (const cv::Point& finger_tip : hand->finger_tips_) {
+      int32_t point[] = {finger_tip.x, finger_tip.y};
+      std::memcpy(payload, point, sizeof(point));
+      payload += sizeof(point);
+    }
+  }
+  bus.EndMessage();
+}
+
+bool ReadFrame(const common::BusMessage& message, CapturedFrame& frame) {
+  if (message.type != common::BusMessageType::FRAME ||
+      !ReadImage(message, frame.data_, frame.format_)) {
+    return false;
+  }
+  frame.timestamp_ns_ = message.timestamp_ns;
+  return true;
+}
+
+bool ReadMask(const common::BusMessage& message, cv::Mat& mask) {
+  PixelFormat format;
+  return message.type == common::BusMessageType::MASK &&
+         ReadImage(message, mask, format);
+}
+
+bool ReadRleMask(const common::BusMessage& message, RleMask& mask) {
+  return message.type == common::BusMessageType::RLE_MASK &&
+         mask.Decode(message.data, message.size);
+}
+
+bool ReadHands(const common::BusMessage& message,
+               std::pair<Hand, Hand>& hands) {
+  if (message.type != common::BusMessageType::HANDS ||
+      message.size < 2 * sizeof(HandRecord)) {
+    return false;
+  }
+  HandRecord records[2];
+  std::memcpy(records, message.data, sizeof(records));
+  const size_t finger_count =
+      static_cast<size_t>(records[0].finger_count) + records[1].finger_count;
+  if (message.size != sizeof(records) + finger_count * 2 * sizeof(int32_t)) {
+    return false;
+  }
+  const unsigned char* finger_tips = message.data + sizeof(records);
+  Hand* both_hands[] = {&hands.first, &hands.second};
+  for (size_t i = 0; i < 2; ++i) {
+    Hand& hand = *both_hands[i];
+    hand.center_of_palm_ = cv::Point(records[i].center_x, records[i].center_y);
+    hand.bounding_box_ = cv::Rect(records[i].box_x, records[i].box_y,
+                                  records[i].box_width, records[i].box_height);
+    hand.capture_time_ns_ = records[i].capture_time_ns;
+    hand.finger_tips_.clear();
+    for (uint32_t j = 0; j < records[i].finger_count; ++j) {
+      int32_t point[2];
+      std::memcpy(point, finger_tips, sizeof(point));
+      finger_tips += sizeof(point);
+      hand.finger_tips_.push_back(cv::Point(point[0], point[1]));
+    }
+  }
+  return true;
+}
+}  // namespace gesturerecognition
@@ -3,29 +3,273 @@
 //
 #include "gesturerecognition/calibration.h"
 
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
 namespace gesturerecognition {
+
+namespace {
+const char PROFILE_MAGIC[4] = {'G', 'P', 'C', 'P'};
+const uint32_t PROFILE_FILE_VERSION = 2;
+
+/**
+ * Throws std::invalid_argument unless a node was given at least count inputs.
+ */
+void CheckInputCount(const std::vector<const cv::Mat *> &inputs, size_t count,
+                     const std::string &kind) {
+  if (inputs.size() < count) {
+    throw std::invalid_argument("A " + kind + " node needs " +
+                                std::to_string(count) + " inputs");
+  }
+}
+
+/**
+ * Scales an image by the segmentation scale, like GetFinalFilterImage does
+ * before the HSV filter. Masks are scaled without mixing their values.
+ */
+class SegmentationScaleNode : public FilterNode {
+ public:
+  explicit SegmentationScaleNode(const Calibration &calibration)
+      : calibration_(calibration) {}
+
+  void Run(const std::vector<const cv::Mat *> &inputs,
+           cv::Mat &output) override {
+    CheckInputCount(inputs, 1, "segmentation_scale");
+    double scale = calibration_.GetFilterQuality().segmentation_scale;
+    const cv::Mat &input = *inputs[0];
+    if (scale >= 1) {
+      output = input;
+      return;
+    }
+    cv::resize(input, output, cv::Size(), scale, scale,
+               input.channels() > 1 ? cv::INTER_AREA : cv::INTER_NEAREST);
+  }
+
+  bool MayForwardInput() const override {
+    return true;
+  }
+
+ private:
+  const Calibration &calibration_;
+};
+
+/**
+ * Thresholds a BGR image by the HSV ranges, like FilterImageByHSV.
+ */
+class HSVThresholdNode : public FilterNode {
+ public:
+  explicit HSVThresholdNode(const Calibration &calibration)
+      : calibration_(calibration) {}
+
+  void Run(const std::vector<const cv::Mat *> &inputs,
+           cv::Mat &output) override {
+    CheckInputCount(inputs, 1, "hsv_threshold");
+    std::pair<cv::Scalar, cv::Scalar> range = calibration_.GetHSVRange();
+    cv::cvtColor(*inputs[0], hsv_image_, cv::COLOR_BGR2HSV);
+    cv::inRange(hsv_image_, range.first, range.second, output);
+  }
+
+ private:
+  const Calibration &calibration_;
+  cv::Mat hsv_image_;  // Reused for every frame
+};
+
+/**
+ * Finds the foreground of an image with the background model. The model
+ * always runs at full size, so this should be given the frame.
+ */
+class BackgroundSubtractionNode : public FilterNode {
+ public:
+  explicit BackgroundSubtractionNode(Calibration &calibration)
+      : calibration_(calibration) {}
+
+  void Run(const std::vector<const cv::Mat *> &inputs,
+           cv::Mat &output) override {
+    CheckInputCount(inputs, 1, "background_subtraction");
+    // Copied, as the mask is kept for the frames which reuse it while the
+    // graph writes other images into the output's buffer.
+    calibration_.SubtractBackground(*inputs[0]).copyTo(output);
+  }
+
+ private:
+  Calibration &calibration_;
+};
+
+/**
+ * Cleans up a mask like ProcessImage, with the median blur, the opening and
+ * closing or both. The kernel size and the iterations follow the filter
+ * quality unless the parameters fix them as "median_kernel_size" and
+ * "morphology_iterations".
+ */
+class CleanMaskNode : public FilterNode {
+ public:
+  CleanMaskNode(const Calibration &calibration,
+                const nlohmann::json &parameters, bool use_median,
+                bool use_morphology)
+      : calibration_(calibration),
+        USE_MEDIAN_(use_median),
+        USE_MORPHOLOGY_(use_morphology),
+        median_kernel_size_(-1),
+        morphology_iterations_(-1) {
+    if (parameters.find("median_kernel_size") != parameters.end()) {
+      median_kernel_size_ = parameters["median_kernel_size"];
+      if (median_kernel_size_ < 1 || median_kernel_size_ % 2 == 0) {
+        throw std::invalid_argument("The median kernel size must be odd!");
+      }
+    }
+    if (parameters.find("morphology_iterations") != parameters.end()) {
+      morphology_iterations_ = parameters["morphology_iterations"];
+      if (morphology_iterations_ < 0) {
+        throw std::invalid_argument(
+            "The morphology iterations must not be negative!");
+      }
+    }
+  }
+
+  void Run(const std::vector<const cv::Mat *> &inputs,
+           cv::Mat &output) override {
+    CheckInputCount(inputs, 1, "mask cleaning");
+    const FilterQuality &quality = calibration_.GetFilterQuality();
+    int kernel_size = median_kernel_size_ >= 0 ? median_kernel_size_
+                                               : quality.median_kernel_size;
+    int iterations = morphology_iterations_ >= 0
+                         ? morphology_iterations_
+                         : quality.morphology_iterations;
+    if (USE_MEDIAN_ && kernel_size > 1) {
+      cv::medianBlur(*inputs[0], output, kernel_size);
+    } else {
+      inputs[0]->copyTo(output);
+    }
+    if (USE_MORPHOLOGY_ && iterations > 0) {
+      cv::morphologyEx(output, output, cv::MORPH_OPEN, cv::Mat(),
+                       cv::Point(-1, -1), iterations);
+      cv::morphologyEx(output, output, cv::MORPH_CLOSE, cv::Mat(),
+                       cv::Point(-1, -1), iterations);
+    }
+  }
+
+ private:
+  const Calibration &calibration_;
+  const bool USE_MEDIAN_;
+  const bool USE_MORPHOLOGY_;
+  int median_kernel_size_;     // -1 follows the filter quality
+  int morphology_iterations_;  // -1 follows the filter quality
+};
+
+/**
+ * Combines masks of the same size with bitwise AND or OR.
+ */
+class BitwiseNode : public FilterNode {
+ public:
+  explicit BitwiseNode(bool use_and) : USE_AND_(use_and) {}
+
+  void Run(const std::vector<const cv::Mat *> &inputs,
+           cv::Mat &output) override {
+    CheckInputCount(inputs, 2, USE_AND_ ? "and" : "or");
+    for (const cv::Mat *input : inputs) {
+      if (input->size() != inputs[0]->size()) {
+        throw std::invalid_argument("Combined masks must be the same size!");
+      }
+    }
+    if (USE_AND_) {
+      cv::bitwise_and(*inputs[0], *inputs[1], output);
+    } else {
+      cv::bitwise_or(*inputs[0], *inputs[1], output);
+    }
+    for (size_t i = 2; i < inputs.size(); ++i) {
+      if (USE_AND_) {
+        cv::bitwise_and(output, *inputs[i], output);
+      } else {
+        cv::bitwise_or(output, *inputs[i], output);
+      }
+    }
+  }
+
+ private:
+  const bool USE_AND_;
+};
+
+/**
+ * Scales a mask to the size of its second input, e.g the frame, without
+ * mixing its values.
+ */
+class ResizeLikeNode : public FilterNode {
+ public:
+  void Run(const std::vector<const cv::Mat *> &inputs,
+           cv::Mat &output) override {
+    CheckInputCount(inputs, 2, "resize_like");
+    if (inputs[0]->size() == inputs[1]->size()) {
+      output = *inputs[0];
+      return;
+    }
+    cv::resize(*inputs[0], output, inputs[1]->size(), 0, 0,
+               cv::INTER_NEAREST);
+  }
+
+  bool MayForwardInput() const override {
+    return true;
+  }
+};
+}  // namespace
+
+BackgroundModelType ParseBackgroundModelType(const std::string &name) {
+  if (name == "mog2") {
+    return BackgroundModelType::MOG2;
+  }
+  if (name == "running_gaussian") {
+    return BackgroundModelType::RUNNING_GAUSSIAN;
+  }
+  throw std::invalid_argument("Unknown background model " + name);
+}
+
 Calibration::Calibration(int min_filter_limit, int max_filter_limit,
                          const std::string &hsv_window_name,
                          const std::string &bgsub_window_name,
                          const std::string &combined_window_name,
-                         double learning_rate, cv::Size hsv_window_size)
-    : low_hue_(min_filter_limit),
+                         double learning_rate, cv::Size hsv_window_size,
+                         BackgroundModelType background_model_type)
+    : hsv_window_name_(hsv_window_name),
+      train_background(false),
+      calibrate_hsv(false),
+      bg_subtraction_window_name_(bgsub_window_name),
+      final_filter_window_name_(combined_window_name),
+      background_subtraction_learning_rate(learning_rate),
+      background_model_type_(background_model_type),
+      low_hue_(min_filter_limit),
       low_saturation_(min_filter_limit),
       low_value_(min_filter_limit),
       high_hue_(max_filter_limit),
       high_saturation_(max_filter_limit),
       high_value_(max_filter_limit),
-      bg_subtraction_window_name_(bgsub_window_name),
-      hsv_window_name_(hsv_window_name),
-      final_filter_window_name_(combined_window_name),
-      background_subtraction_learning_rate(learning_rate),
-      train_background(false),
-      calibrate_hsv(false),
-      hsv_window_size_(std::move(hsv_window_size)) {
-  background_subtractor_ = cv::createBackgroundSubtractorMOG2();
+      hsv_window_size_(std::move(hsv_window_size)),
+      frames_since_background_update_(0),
+      async_update_interval_(0),
+      frames_since_async_update_(0),
+      metrics_(nullptr),
+      thread_policies_(nullptr) {
+  if (background_model_type_ == BackgroundModelType::MOG2) {
+    background_subtractor_ = cv::createBackgroundSubtractorMOG2();
+  }
 }
 cv::Mat Calibration::GetBackgroundSubtractedImage(const cv::Mat &input_image) {
   cv::Mat foreground_mask;
+  if (background_model_type_ == BackgroundModelType::RUNNING_GAUSSIAN) {
+    if (!train_background && async_update_interval_ > 0) {
+      return GetAsyncBackgroundSubtractedImage(input_image);
+    }
+    double learning_rate = background_subtraction_learning_rate / 1000;
+    if (train_background) {
+      // The first frames are averaged equally, like MOG2 does, so that the
+      // model does not take 1 / learning_rate frames to settle.
+      learning_rate =
+          std::max(background_subtraction_learning_rate,
+                   1.0 / (background_model_.GetFramesLearnt() + 1));
+    }
+    background_model_.Apply(input_image, foreground_mask, learning_rate);
+    return foreground_mask;
+  }
   if (train_background) {
     background_subtractor_->apply(input_image, foreground_mask,
                                   background_subtraction_learning_rate);
@@ -39,29 +283,335 @@ cv::Mat Calibration::GetBackgroundSubtractedImage(const cv::Mat &input_image) {
   return foreground_mask;
 }
 
+cv::Mat Calibration::GetAsyncBackgroundSubtractedImage(
+    const cv::Mat &input_image) {
+  if (!background_learner_) {
+    background_learner_.reset(
+        new BackgroundLearner(background_model_, thread_policies_));
+    background_learner_->SetMetrics(metrics_);
+    frames_since_async_update_ = 0;
+  }
+  cv::Mat foreground_mask;
+  background_learner_->GetSnapshot()->ComputeForeground(input_image,
+                                                        foreground_mask);
+  if (++frames_since_async_update_ < async_update_interval_) {
+    return foreground_mask;
+  }
+  update_mask_.create(input_image.size(), CV_8UC1);
+  update_mask_.setTo(255);
+  const cv::Rect frame_rect(cv::Point(0, 0), input_image.size());
+  for (const cv::Rect &region : hand_regions_) {
+    int margin_x = static_cast<int>(region.width * HAND_REGION_MARGIN_);
+    int margin_y = static_cast<int>(region.height * HAND_REGION_MARGIN_);
+    cv::Rect grown_region(region.x - margin_x, region.y - margin_y,
+                          region.width + 2 * margin_x,
+                          region.height + 2 * margin_y);
+    update_mask_(grown_region & frame_rect).setTo(0);
+  }
+  // One update stands in for all the frames of the interval, so the
+  // background changes as fast as when every frame is learnt.
+  if (background_learner_->Learn(
+          input_image,
+          background_subtraction_learning_rate / 1000 * async_update_interval_,
+          update_mask_)) {
+    frames_since_async_update_ = 0;
+  }
+  return foreground_mask;
+}
+
+void Calibration::StopBackgroundLearner() {
+  if (!background_learner_) {
+    return;
+  }
+  background_model_ = background_learner_->GetSnapshot()->Clone();
+  background_learner_.reset();
+}
+
+void Calibration::SetAsyncBackgroundUpdates(int interval_frames) {
+  if (interval_frames < 0) {
+    throw std::invalid_argument("The update interval must not be negative!");
+  }
+  async_update_interval_ = interval_frames;
+  if (interval_frames == 0) {
+    StopBackgroundLearner();
+  }
+}
+
+void Calibration::SetHandRegions(const std::vector<cv::Rect> &hand_regions) {
+  hand_regions_ = hand_regions;
+}
+
+void Calibration::SetMetrics(common::MetricsRegistry *metrics) {
+  metrics_ = metrics;
+  if (background_learner_) {
+    background_learner_->SetMetrics(metrics);
+  }
+  if (filter_graph_) {
+    filter_graph_->SetMetrics(metrics);
+  }
+}
+
+void Calibration::SetThreadPolicies(common::ThreadPolicies *thread_policies) {
+  thread_policies_ = thread_policies;
+  if (filter_graph_) {
+    filter_graph_->SetThreadPolicies(thread_policies);
+  }
+}
+
+void Calibration::RegisterFilterNodes(FilterNodeRegistry &registry) {
+  registry.Add("segmentation_scale", [this](const nlohmann::json &) {
+    return std::unique_ptr<FilterNode>(new SegmentationScaleNode(*this));
+  });
+  registry.Add("hsv_threshold", [this](const nlohmann::json &) {
+    return std::unique_ptr<FilterNode>(new HSVThresholdNode(*this));
+  });
+  registry.Add("background_subtraction", [this](const nlohmann::json &) {
+    return std::unique_ptr<FilterNode>(new BackgroundSubtractionNode(*this));
+  });
+  registry.Add("median_morphology", [this](const nlohmann::json &parameters) {
+    return std::unique_ptr<FilterNode>(
+        new CleanMaskNode(*this, parameters, true, true));
+  });
+  registry.Add("median", [this](const nlohmann::json &parameters) {
+    return std::unique_ptr<FilterNode>(
+        new CleanMaskNode(*this, parameters, true, false));
+  });
+  registry.Add("morphology", [this](const nlohmann::json &parameters) {
+    return std::unique_ptr<FilterNode>(
+        new CleanMaskNode(*this, parameters, false, true));
+  });
+  registry.Add("and", [](const nlohmann::json &) {
+    return std::unique_ptr<FilterNode>(new BitwiseNode(true));
+  });
+  registry.Add("or", [](const nlohmann::json &) {
+    return std::unique_ptr<FilterNode>(new BitwiseNode(false));
+  });
+  registry.Add("resize_like", [](const nlohmann::json &) {
+    return std::unique_ptr<FilterNode>(new ResizeLikeNode());
+  });
+}
+
+void Calibration::SetFilterGraph(const nlohmann::json &description,
+                                 size_t threads) {
+  if (description.is_null() || description.empty()) {
+    filter_graph_.reset();
+    return;
+  }
+  FilterNodeRegistry registry;
+  RegisterFilterNodes(registry);
+  filter_graph_.reset(new FilterGraph(description, registry, threads));
+  filter_graph_->SetMetrics(metrics_);
+  filter_graph_->SetThreadPolicies(thread_policies_);
+}
+
+const FilterGraph *Calibration::GetFilterGraph() const {
+  return filter_graph_.get();
+}
+
 cv::Mat Calibration::GetFinalFilterImage(const cv::Mat &input_image) {
+  if (filter_graph_) {
+    return filter_graph_->Run(input_image);
+  }
+  SubtractBackground(input_image);
+  if (filter_quality_.segmentation_scale >= 1) {
+    return CombineMasks(FilterImageByHSV(input_image));
+  }
+
+  cv::Mat small_image;
+  cv::resize(input_image, small_image, cv::Size(),
+             filter_quality_.segmentation_scale,
+             filter_quality_.segmentation_scale, cv::INTER_AREA);
+  return CombineMasks(FilterImageByHSV(small_image));
+}
+
+cv::Mat Calibration::GetFinalFilterImage(const CapturedFrame &frame) {
+  if (frame.format_ == PixelFormat::BGR) {
+    return GetFinalFilterImage(frame.data_);
+  }
+  // The background is learnt from the luma alone, and the skin is found
+  // straight from Y, Cb and Cr, so the frame is never converted.
+  SubtractBackground(GetLuma(frame));
+  skin_table_.Build(cv::Scalar(low_hue_, low_saturation_, low_value_),
+                    cv::Scalar(high_hue_, high_saturation_, high_value_));
+  cv::Mat skin_mask;
+  skin_table_.Classify(frame, skin_mask);
+  if (filter_quality_.segmentation_scale < 1) {
+    cv::resize(skin_mask, skin_mask, cv::Size(),
+               filter_quality_.segmentation_scale,
+               filter_quality_.segmentation_scale, cv::INTER_NEAREST);
+  }
+  return CombineMasks(skin_mask);
+}
+
+const cv::Mat &Calibration::SubtractBackground(const cv::Mat &input_image) {
+  // The background model always runs at full size, as changing the size of
+  // its input would make it forget the background it has learnt.
+  ++frames_since_background_update_;
+  if (last_background_mask_.empty() || train_background ||
+      frames_since_background_update_ >=
+          filter_quality_.background_update_interval) {
+    last_background_mask_ = GetBackgroundSubtractedImage(input_image);
+    frames_since_background_update_ = 0;
+  }
+  return last_background_mask_;
+}
+
+cv::Mat Calibration::CombineMasks(const cv::Mat &skin_mask) {
   cv::Mat final_output;
-  auto background_subtracted_image = GetBackgroundSubtractedImage(input_image);
-  auto hsv_threshold = FilterImageByHSV(input_image);
-  cv::bitwise_and(ProcessImage(hsv_threshold),
-                  ProcessImage(background_subtracted_image), final_output);
-  // Bitwise_and gets an image which contains common pixels between
-  // background_subtracted and hsv threshold images.
+  if (skin_mask.size() == last_background_mask_.size()) {
+    // Bitwise_and gets an image which contains common pixels between
+    // background_subtracted and hsv threshold images.
+    cv::bitwise_and(ProcessImage(skin_mask),
+                    ProcessImage(last_background_mask_), final_output);
+    return final_output;
+  }
+  cv::Mat small_background_mask;
+  cv::resize(last_background_mask_, small_background_mask, skin_mask.size(),
+             0, 0, cv::INTER_NEAREST);
+  cv::bitwise_and(ProcessImage(skin_mask), ProcessImage(small_background_mask),
+                  final_output);
+  cv::resize(final_output, final_output, last_background_mask_.size(), 0, 0,
+             cv::INTER_NEAREST);
   return final_output;
 }
+
+void Calibration::SetFilterQuality(const FilterQuality &filter_quality) {
+  if (filter_quality.median_kernel_size % 2 == 0 ||
+      filter_quality.morphology_iterations < 0 ||
+      filter_quality.segmentation_scale <= 0 ||
+      filter_quality.background_update_interval < 1) {
+    throw std::invalid_argument("Invalid filter quality settings!");
+  }
+  filter_quality_ = filter_quality;
+}
+
+const FilterQuality &Calibration::GetFilterQuality() const {
+  return filter_quality_;
+}
+
+bool Calibration::SaveProfile(const std::string &file_name) const {
+  std::ofstream stream(file_name, std::ios::binary | std::ios::trunc);
+  const int32_t hsv_values[] = {low_hue_,  low_saturation_,  low_value_,
+                                high_hue_, high_saturation_, high_value_};
+  uint8_t model_type = static_cast<uint8_t>(background_model_type_);
+  stream.write(PROFILE_MAGIC, sizeof(PROFILE_MAGIC));
+  stream.write(reinterpret_cast<const char *>(&PROFILE_FILE_VERSION),
+               sizeof(PROFILE_FILE_VERSION));
+  stream.write(reinterpret_cast<const char *>(hsv_values), sizeof(hsv_values));
+  stream.write(reinterpret_cast<const char *>(&model_type),
+               sizeof(model_type));
+  if (background_model_type_ == BackgroundModelType::RUNNING_GAUSSIAN) {
+    if (background_learner_) {
+      background_learner_->GetSnapshot()->Write(stream);
+    } else {
+      background_model_.Write(stream);
+    }
+  }
+  return static_cast<bool>(stream);
+}
+
+bool Calibration::LoadProfile(const std::string &file_name) {
+  std::ifstream stream(file_name, std::ios::binary);
+  if (!stream.is_open()) {
+    return false;
+  }
+  char magic[sizeof(PROFILE_MAGIC)];
+  uint32_t version = 0;
+  int32_t hsv_values[6];
+  uint8_t model_type = 0;
+  stream.read(magic, sizeof(magic));
+  stream.read(reinterpret_cast<char *>(&version), sizeof(version));
+  stream.read(reinterpret_cast<char *>(hsv_values), sizeof(hsv_values));
+  stream.read(reinterpret_cast<char *>(&model_type), sizeof(model_type));
+  if (!stream || !std::equal(magic, magic + sizeof(magic), PROFILE_MAGIC) ||
+      version != PROFILE_FILE_VERSION) {
+    throw std::invalid_argument(file_name + " is not a calibration profile!");
+  }
+  if (model_type == static_cast<uint8_t>(background_model_type_) &&
+      background_model_type_ == BackgroundModelType::RUNNING_GAUSSIAN) {
+    // The learner would otherwise keep learning its own model.
+    background_learner_.reset();
+    background_model_.Read(stream);
+    last_background_mask_.release();
+  }
+  SetHSVRange(cv::Scalar(hsv_values[0], hsv_values[1], hsv_values[2]),
+              cv::Scalar(hsv_values[3], hsv_values[4], hsv_values[5]));
+  return true;
+}
+
+bool Calibration::HasTrainedBackground(const cv::Size &size,
+                                       int channels) const {
+  if (background_model_type_ != BackgroundModelType::RUNNING_GAUSSIAN) {
+    return false;
+  }
+  const BackgroundModel &model = background_learner_
+                                     ? *background_learner_->GetSnapshot()
+                                     : background_model_;
+  return model.GetSize() == size && model.GetChannels() == channels;
+}
+
+double Calibration::GetLastForegroundFraction() const {
+  if (last_background_mask_.empty()) {
+    return 0;
+  }
+  return static_cast<double>(cv::countNonZero(last_background_mask_)) /
+         last_background_mask_.total();
+}
+
+BackgroundModelState Calibration::GetBackgroundModelState() const {
+  BackgroundModelState state;
+  if (background_model_type_ == BackgroundModelType::MOG2) {
+    background_subtractor_->getBackgroundImage(state.background_image);
+    return state;
+  }
+  // While the model learns on its own thread, its latest snapshot is the
+  // model.
+  std::shared_ptr<const BackgroundModel> snapshot;
+  if (background_learner_) {
+    snapshot = background_learner_->GetSnapshot();
+  }
+  const BackgroundModel& model = snapshot ? *snapshot : background_model_;
+  state.frames_learnt = model.GetFramesLearnt();
+  state.mean_variance = model.GetMeanVariance();
+  model.GetMeanImage(state.background_image);
+  return state;
+}
+
+const cv::Mat &Calibration::GetLastBackgroundMask() const {
+  return last_background_mask_;
+}
+
 bool Calibration::IsHSVCalibrating() {
   return calibrate_hsv;
 }
 
+void Calibration::SetHSVRange(const cv::Scalar &low, const cv::Scalar &high) {
+  low_hue_ = static_cast<int>(low[0]);
+  low_saturation_ = static_cast<int>(low[1]);
+  low_value_ = static_cast<int>(low[2]);
+  high_hue_ = static_cast<int>(high[0]);
+  high_saturation_ = static_cast<int>(high[1]);
+  high_value_ = static_cast<int>(high[2]);
+}
+
+std::pair<cv::Scalar, cv::Scalar> Calibration::GetHSVRange() const {
+  return std::make_pair(cv::Scalar(low_hue_, low_saturation_, low_value_),
+                        cv::Scalar(high_hue_, high_saturation_, high_value_));
+}
+
 void Calibration::SetHSVCalibration(bool boolean) {
   calibrate_hsv = boolean;
 }
 
-bool Calibration::IsBackgroundTraining() {
+bool Calibration::IsBackgroundTraining() const {
   return train_background;
 }
 
 void Calibration::SetBackgroundTraining(bool boolean) {
+  if (boolean) {
+    // Training learns every frame, on this thread.
+    StopBackgroundLearner();
+  }
   train_background = boolean;
 }
 
@@ -97,13 +647,29 @@ void Calibration::CreateTrackbars(int max_value) {
                      on_high_V_thresh_trackbar, this);
 }
 
+void Calibration::UpdateTrackbars() {
+  cv::setTrackbarPos("Low H", hsv_window_name_, low_hue_);
+  cv::setTrackbarPos("High H", hsv_window_name_, high_hue_);
+  cv::setTrackbarPos("Low S", hsv_window_name_, low_saturation_);
+  cv::setTrackbarPos("High S", hsv_window_name_, high_saturation_);
+  cv::setTrackbarPos("Low V", hsv_window_name_, low_value_);
+  cv::setTrackbarPos("High V", hsv_window_name_, high_value_);
+}
+
 cv::Mat Calibration::ProcessImage(const cv::Mat &input_image) {
   cv::Mat processed_image;
-  cv::medianBlur(input_image, processed_image, 5);
-  morphologyEx(processed_image, processed_image, cv::MORPH_OPEN, cv::Mat(),
-               cv::Point(-1, -1), 3);
-  morphologyEx(processed_image, processed_image, cv::MORPH_CLOSE, cv::Mat(),
-               cv::Point(-1, -1), 3);
+  if (filter_quality_.median_kernel_size > 1) {
+    cv::medianBlur(input_image, processed_image,
+                   filter_quality_.median_kernel_size);
+  } else {
+    processed_image = input_image.clone();
+  }
+  if (filter_quality_.morphology_iterations > 0) {
+    morphologyEx(processed_image, processed_image, cv::MORPH_OPEN, cv::Mat(),
+                 cv::Point(-1, -1), filter_quality_.morphology_iterations);
+    morphologyEx(processed_image, processed_image, cv::MORPH_CLOSE, cv::Mat(),
+                 cv::Point(-1, -1), filter_quality_.morphology_iterations);
+  }
   return processed_image;
 }
 
@@ -0,0 +1,226 @@
+#include "gesturerecognition/capture_device.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "common/clock.h"
+
+namespace gesturerecognition {
+
+namespace {
+/**
+ * Returns the number of bytes in a frame of the given format and size.
+ */
+size_t GetFrameBytes(PixelFormat format, const cv::Size& frame_size) {
+  size_t pixels = static_cast<size_t>(frame_size.area());
+  return format == PixelFormat::YUYV ? 2 * pixels : pixels * 3 / 2;
+}
+}  // namespace
+
+FileCaptureDevice::FileCaptureDevice(const std::string& file_name,
+                                     PixelFormat format,
+                                     const cv::Size& frame_size,
+                                     double frames_per_second,
+                                     size_t buffer_count, bool paced)
+    : file_(file_name, std::ios::binary),
+      format_(format),
+      frame_size_(frame_size),
+      frames_per_second_(frames_per_second),
+      paced_(paced),
+      frame_bytes_(GetFrameBytes(format, frame_size)),
+      next_sequence_(0),
+      start_time_ns_(0),
+      end_of_file_(false) {
+  if (format == PixelFormat::BGR) {
+    throw std::invalid_argument("A YUV file must hold YUYV or NV12 frames!");
+  }
+  if (frame_size.width <= 0 || frame_size.height <= 0 ||
+      frame_size.width % 2 != 0 || frame_size.height % 2 != 0) {
+    throw std::invalid_argument("YUV frames must have an even size!");
+  }
+  if (buffer_count < 2) {
+    throw std::invalid_argument("A capture device needs at least 2 buffers!");
+  }
+  if (paced && frames_per_second <= 0) {
+    throw std::invalid_argument("A paced device needs a frame rate!");
+  }
+  buffers_.assign(buffer_count, std::vector<uchar>(frame_bytes_));
+  for (size_t i = 0; i < buffer_count; ++i) {
+    queued_buffers_.push_back(i);
+  }
+}
+
+bool FileCaptureDevice::Dequeue(DeviceBuffer& buffer) {
+  if (!paced_) {
+    if (filled_buffers_.empty() && !end_of_file_) {
+      if (queued_buffers_.empty()) {
+        throw std::logic_error("Every buffer of the device is dequeued!");
+      }
+      CaptureFrame(common::GetTimestampNanoseconds());
+    }
+  } else {
+    if (start_time_ns_ == 0) {
+      start_time_ns_ = common::GetTimestampNanoseconds();
+    }
+    while (filled_buffers_.empty() && !end_of_file_) {
+      if (queued_buffers_.empty()) {
+        throw std::logic_error("Every buffer of the device is dequeued!");
+      }
+      int64_t now_ns = common::GetTimestampNanoseconds();
+      CaptureDueFrames(now_ns);
+      if (filled_buffers_.empty() && !end_of_file_) {
+        std::this_thread::sleep_for(
+            std::chrono::nanoseconds(GetNextFrameTime() - now_ns));
+      }
+    }
+  }
+  if (filled_buffers_.empty()) {
+    return false;
+  }
+  buffer = filled_buffers_.front();
+  filled_buffers_.pop_front();
+  return true;
+}
+
+void FileCaptureDevice::CaptureFrame(int64_t timestamp_ns) {
+  if (queued_buffers_.empty()) {
+    file_.ignore(static_cast<std::streamsize>(frame_bytes_));
+  } else {
+    size_t index = queued_buffers_.front();
+    file_.read(reinterpret_cast<char*>(buffers_[index].data()),
+               static_cast<std::streamsize>(frame_bytes_));
+    if (file_) {
+      queued_buffers_.pop_front();
+      DeviceBuffer buffer;
+      buffer.index_ = index;
+      buffer.data_ = buffers_[index].data();
+      buffer.bytes_used_ = frame_bytes_;
+      buffer.sequence_ = next_sequence_;
+      buffer.timestamp_ns_ = timestamp_ns;
+      filled_buffers_.push_back(buffer);
+    }
+  }
+  if (!file_) {
+    end_of_file_ = true;
+    return;
+  }
+  ++next_sequence_;
+}
+
+void FileCaptureDevice::CaptureDueFrames(int64_t now_ns) {
+  // Catches up on every frame that came while we were away, like the driver
+  // would have.
+  while (!end_of_file_ && GetNextFrameTime() <= now_ns) {
+    CaptureFrame(GetNextFrameTime());
+  }
+}
+
+int64_t FileCaptureDevice::GetNextFrameTime() const {
+  return start_time_ns_ +
+         static_cast<int64_t>(next_sequence_ * 1e9 / frames_per_second_);
+}
+
+void FileCaptureDevice::Queue(size_t index) {
+  if (index >= buffers_.size()) {
+    throw std::invalid_argument("The device has no such buffer!");
+  }
+  if (paced_ && start_time_ns_ != 0) {
+    // The frames that came before the buffer was queued were dropped, or
+    // filled other buffers, and must not fill this one.
+    CaptureDueFrames(common::GetTimestampNanoseconds());
+  }
+  queued_buffers_.push_back(index);
+}
+
+PixelFormat FileCaptureDevice::GetPixelFormat() const {
+  return format_;
+}
+
+cv::Size FileCaptureDevice::GetFrameSize() const {
+  return frame_size_;
+}
+
+size_t FileCaptureDevice::GetBytesPerLine() const {
+  return format_ == PixelFormat::YUYV ? 2 * frame_size_.width
+                                      : frame_size_.width;
+}
+
+double FileCaptureDevice::GetFramesPerSecond() const {
+  return frames_per_second_;
+}
+
+size_t FileCaptureDevice::GetBufferCount() const {
+  return buffers_.size();
+}
+
+DeviceFrameSource::DeviceFrameSource(std::unique_ptr<CaptureDevice> device)
+    : device_(std::move(device)),
+      holds_buffer_(false),
+      frames_read_(0),
+      last_sequence_(0),
+      dropped_frames_(0) {
+  if (device_->GetPixelFormat() == PixelFormat::BGR) {
+    throw std::invalid_argument("Capture devices must deliver YUV frames!");
+  }
+  const cv::Size frame_size = device_->GetFrameSize();
+  frame_rows_ = device_->GetPixelFormat() == PixelFormat::NV12
+                    ? frame_size.height * 3 / 2
+                    : frame_size.height;
+  frame_bytes_ = frame_rows_ * device_->GetBytesPerLine();
+}
+
+DeviceFrameSource::~DeviceFrameSource() {
+  if (holds_buffer_) {
+    device_->Queue(buffer_.index_);
+  }
+}
+
+bool DeviceFrameSource::Read(CapturedFrame& frame) {
+  if (holds_buffer_) {
+    device_->Queue(buffer_.index_);
+    holds_buffer_ = false;
+  }
+  // A buffer the device could not fill completely is handed straight back.
+  do {
+    if (!device_->Dequeue(buffer_)) {
+      return false;
+    }
+    if (buffer_.bytes_used_ < frame_bytes_) {
+      device_->Queue(buffer_.index_);
+    }
+  } while (buffer_.bytes_used_ < frame_bytes_);
+  holds_buffer_ = true;
+
+  if (frames_read_ > 0 && buffer_.sequence_ > last_sequence_ + 1) {
+    dropped_frames_ += buffer_.sequence_ - last_sequence_ - 1;
+  }
+  last_sequence_ = buffer_.sequence_;
+  ++frames_read_;
+
+  const PixelFormat format = device_->GetPixelFormat();
+  frame.format_ = format;
+  frame.data_ = cv::Mat(static_cast<int>(frame_rows_),
+                        device_->GetFrameSize().width,
+                        format == PixelFormat::YUYV ? CV_8UC2 : CV_8UC1,
+                        buffer_.data_, device_->GetBytesPerLine());
+  frame.timestamp_ns_ = buffer_.timestamp_ns_;
+  return true;
+}
+
+double DeviceFrameSource::GetFramesPerSecond() const {
+  return device_->GetFramesPerSecond();
+}
+
+cv::Size DeviceFrameSource::GetFrameSize() const {
+  return device_->GetFrameSize();
+}
+
+bool DeviceFrameSource::CountsDroppedFrames() const {
+  return true;
+}
+
+uint64_t DeviceFrameSource::GetDroppedFrames() const {
+  return dropped_frames_;
+}
+}  // namespace gesturerecognition
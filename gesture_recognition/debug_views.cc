@@ -0,0 +1,128 @@
+#include "gesturerecognition/debug_views.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace gesturerecognition {
+
+DebugViews::DebugViews(double refresh_rate,
+                       const std::string& tiled_window_name,
+                       const cv::Size& tile_size)
+    : refresh_interval_ns_(
+          refresh_rate > 0 ? static_cast<int64_t>(1e9 / refresh_rate) : 0),
+      last_shown_ns_(0),
+      tiled_window_name_(tiled_window_name),
+      tile_size_(tile_size),
+      tiled_window_open_(false) {
+  if (!tiled_window_name.empty() &&
+      (tile_size.width <= 0 || tile_size.height <= 0)) {
+    throw std::invalid_argument("The tiles must not be empty!");
+  }
+}
+
+void DebugViews::AddView(const std::string& name,
+                         const RenderFunction& render) {
+  views_.push_back({name, render, false, cv::Mat()});
+}
+
+void DebugViews::SetViewOpen(const std::string& name, bool open) {
+  View& view = FindView(name);
+  if (view.open_ == open) {
+    return;
+  }
+  view.open_ = open;
+  if (!open) {
+    view.image_.release();
+    if (tiled_window_name_.empty()) {
+      cv::destroyWindow(name);
+    }
+  }
+  // The next Show renders the views as they are now.
+  last_shown_ns_ = 0;
+}
+
+bool DebugViews::IsViewOpen(const std::string& name) const {
+  return FindView(name).open_;
+}
+
+bool DebugViews::Show(int64_t now_ns) {
+  if (last_shown_ns_ != 0 && now_ns - last_shown_ns_ < refresh_interval_ns_) {
+    return false;
+  }
+  std::vector<View*> open_views;
+  for (View& view : views_) {
+    if (view.open_) {
+      open_views.push_back(&view);
+    }
+  }
+  if (open_views.empty()) {
+    if (tiled_window_open_) {
+      cv::destroyWindow(tiled_window_name_);
+      tiled_window_open_ = false;
+    }
+    return false;
+  }
+  last_shown_ns_ = now_ns;
+  for (View* view : open_views) {
+    view->render_(view->image_);
+  }
+  if (!tiled_window_name_.empty()) {
+    ShowTiled(open_views);
+    return true;
+  }
+  for (View* view : open_views) {
+    if (!view->image_.empty()) {
+      cv::imshow(view->name_, view->image_);
+    }
+  }
+  return true;
+}
+
+void DebugViews::ShowTiled(const std::vector<View*>& open_views) {
+  const int columns = static_cast<int>(
+      std::ceil(std::sqrt(static_cast<double>(open_views.size()))));
+  const int rows = (static_cast<int>(open_views.size()) + columns - 1) /
+                   columns;
+  tiled_image_.create(rows * tile_size_.height, columns * tile_size_.width,
+                      CV_8UC3);
+  tiled_image_.setTo(cv::Scalar::all(0));
+  for (size_t i = 0; i < open_views.size(); ++i) {
+    const cv::Mat& image = open_views[i]->image_;
+    if (image.empty()) {
+      continue;
+    }
+    cv::resize(image, tile_, tile_size_, 0, 0, cv::INTER_NEAREST);
+    if (tile_.channels() == 1) {
+      cv::cvtColor(tile_, tile_, cv::COLOR_GRAY2BGR);
+    }
+    cv::putText(tile_, open_views[i]->name_, cv::Point(5, 20),
+                cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 255));
+    const int column = static_cast<int>(i) % columns;
+    const int row = static_cast<int>(i) / columns;
+    cv::Mat tile_area = tiled_image_(
+        cv::Rect(column * tile_size_.width, row * tile_size_.height,
+                 tile_size_.width, tile_size_.height));
+    tile_.copyTo(tile_area);
+  }
+  cv::imshow(tiled_window_name_, tiled_image_);
+  tiled_window_open_ = true;
+}
+
+DebugViews::View& DebugViews::FindView(const std::string& name) {
+  for (View& view : views_) {
+    if (view.name_ == name) {
+      return view;
+    }
+  }
+  throw std::invalid_argument("There is no debug view " + name);
+}
+
+const DebugViews::View& DebugViews::FindView(const std::string& name) const {
+  for (const View& view : views_) {
+    if (view.name_ == name) {
+      return view;
+    }
+  }
+  throw std::invalid_argument("There is no debug view " + name);
+}
+}  // namespace gesturerecognition
@@ -0,0 +1,362 @@
+#include "gesturerecognition/filter_graph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "common/clock.h"
+
+namespace gesturerecognition {
+
+namespace {
+const char* const FRAME_INPUT_NAME = "frame";
+
+/**
+ * Orders the nodes the output depends on so that every node comes after its
+ * inputs. Throws std::invalid_argument on a cycle.
+ * @param inputs  the inputs of every node, negative for the frame
+ * @param node    the node whose inputs are visited
+ * @param states  0 unvisited, 1 being visited, 2 done, for every node
+ * @param order   the nodes, appended once their inputs are
+ */
+void AppendInDependencyOrder(const std::vector<std::vector<int>>& inputs,
+                             const std::vector<std::string>& names, int node,
+                             std::vector<int>& states,
+                             std::vector<int>& order) {
+  if (states[node] == 2) {
+    return;
+  }
+  if (states[node] == 1) {
+    throw std::invalid_argument("The filter graph has a cycle through " +
+                                names[node]);
+  }
+  states[node] = 1;
+  for (int input : inputs[node]) {
+    if (input >= 0) {
+      AppendInDependencyOrder(inputs, names, input, states, order);
+    }
+  }
+  states[node] = 2;
+  order.push_back(node);
+}
+}  // namespace
+
+void FilterNodeRegistry::Add(const std::string& kind, const Factory& factory) {
+  factories_[kind] = factory;
+}
+
+std::unique_ptr<FilterNode> FilterNodeRegistry::Create(
+    const std::string& kind, const nlohmann::json& parameters) const {
+  auto factory = factories_.find(kind);
+  if (factory == factories_.end()) {
+    throw std::invalid_argument("Unknown filter node " + kind);
+  }
+  return factory->second(parameters);
+}
+
+std::vector<std::string> FilterNodeRegistry::GetKinds() const {
+  std::vector<std::string> kinds;
+  for (const auto& factory : factories_) {
+    kinds.push_back(factory.first);
+  }
+  return kinds;
+}
+
+const int FilterGraph::FRAME_INPUT;
+
+FilterGraph::FilterGraph(const nlohmann::json& description,
+                         const FilterNodeRegistry& registry, size_t threads)
+    : output_node_(0),
+      THREADS_(std::max<size_t>(threads, 1)),
+      thread_policies_(nullptr),
+      level_tasks_(nullptr),
+      next_task_(0),
+      unfinished_tasks_(0),
+      level_generation_(0),
+      stopping_(false) {
+  if (!description.is_object() ||
+      description.find("nodes") == description.end() ||
+      !description["nodes"].is_array() ||
+      description.find("output") == description.end()) {
+    throw std::invalid_argument("A filter graph needs nodes and an output");
+  }
+  const nlohmann::json& descriptions = description["nodes"];
+  std::vector<std::string> names;
+  std::map<std::string, int> indices;
+  for (const nlohmann::json& node : descriptions) {
+    std::string name = node["name"];
+    if (name == FRAME_INPUT_NAME || indices.count(name) > 0) {
+      throw std::invalid_argument("Filter node name " + name +
+                                  " is taken");
+    }
+    indices[name] = static_cast<int>(names.size());
+    names.push_back(name);
+  }
+  std::vector<std::vector<int>> inputs;
+  for (const nlohmann::json& node : descriptions) {
+    std::vector<int> node_inputs;
+    for (const nlohmann::json& input : node["inputs"]) {
+      std::string input_name = input;
+      if (input_name == FRAME_INPUT_NAME) {
+        node_inputs.push_back(FRAME_INPUT);
+      } else if (indices.count(input_name) > 0) {
+        node_inputs.push_back(indices[input_name]);
+      } else {
+        throw std::invalid_argument("Unknown filter graph input " +
+                                    input_name);
+      }
+    }
+    inputs.push_back(node_inputs);
+  }
+  std::string output_name = description["output"];
+  if (indices.count(output_name) == 0) {
+    throw std::invalid_argument("Unknown filter graph output " + output_name);
+  }
+
+  // Only the nodes the output depends on are scheduled, by level and then
+  // in the order they are described.
+  std::vector<int> states(names.size(), 0);
+  std::vector<int> order;
+  AppendInDependencyOrder(inputs, names, indices[output_name], states, order);
+  std::vector<size_t> levels(names.size(), 0);
+  for (int node : order) {
+    for (int input : inputs[node]) {
+      if (input >= 0) {
+        levels[node] = std::max(levels[node], levels[input] + 1);
+      }
+    }
+  }
+  std::sort(order.begin(), order.end(), [&levels](int first, int second) {
+    return levels[first] != levels[second] ? levels[first] < levels[second]
+                                           : first < second;
+  });
+  std::vector<int> scheduled_index(names.size(), -1);
+  for (size_t i = 0; i < order.size(); ++i) {
+    scheduled_index[order[i]] = static_cast<int>(i);
+  }
+  for (int described_node : order) {
+    const nlohmann::json& node_description = descriptions[described_node];
+    Node node;
+    node.name = names[described_node];
+    nlohmann::json parameters = nlohmann::json::object();
+    if (node_description.find("parameters") != node_description.end()) {
+      parameters = node_description["parameters"];
+    }
+    node.filter = registry.Create(node_description["node"], parameters);
+    for (int input : inputs[described_node]) {
+      node.inputs.push_back(input >= 0 ? scheduled_index[input] : FRAME_INPUT);
+    }
+    node.level = levels[described_node];
+    node.buffer = 0;
+    node.last_ms = 0;
+    node.histogram = nullptr;
+    if (node.level >= levels_.size()) {
+      levels_.resize(node.level + 1);
+    }
+    levels_[node.level].push_back(nodes_.size());
+    nodes_.push_back(std::move(node));
+  }
+  output_node_ = scheduled_index[indices[output_name]];
+
+  // An image is needed from its node's level to the last level that reads
+  // it, or that reads a node which may forward it. The output is needed
+  // after the last level.
+  const size_t AFTER_LAST_LEVEL = levels_.size();
+  std::vector<size_t> last_use(nodes_.size(), 0);
+  for (size_t node = 0; node < nodes_.size(); ++node) {
+    last_use[node] = nodes_[node].level;
+    for (int input : nodes_[node].inputs) {
+      if (input >= 0) {
+        last_use[input] = std::max(last_use[input], nodes_[node].level);
+      }
+    }
+  }
+  last_use[output_node_] = AFTER_LAST_LEVEL;
+  for (size_t node = nodes_.size(); node-- > 0;) {
+    int first_input = nodes_[node].inputs.empty() ? FRAME_INPUT
+                                                  : nodes_[node].inputs[0];
+    if (first_input >= 0 && nodes_[node].filter->MayForwardInput()) {
+      last_use[first_input] =
+          std::max(last_use[first_input], last_use[node]);
+    }
+  }
+  // Each node takes the first buffer whose last image is no longer needed.
+  std::vector<size_t> buffer_free_after;
+  for (size_t node = 0; node < nodes_.size(); ++node) {
+    size_t buffer = 0;
+    while (buffer < buffer_free_after.size() &&
+           (buffer_free_after[buffer] >= nodes_[node].level ||
+            buffer_free_after[buffer] == AFTER_LAST_LEVEL)) {
+      ++buffer;
+    }
+    if (buffer == buffer_free_after.size()) {
+      buffer_free_after.push_back(0);
+    }
+    buffer_free_after[buffer] = last_use[node];
+    nodes_[node].buffer = buffer;
+  }
+  buffers_.resize(buffer_free_after.size());
+  for (size_t buffer = 0; buffer < buffer_free_after.size(); ++buffer) {
+    if (buffer_free_after[buffer] == AFTER_LAST_LEVEL) {
+      final_buffers_.push_back(buffer);
+    }
+  }
+
+  outputs_.resize(nodes_.size());
+  for (const Node& node : nodes_) {
+    std::vector<const cv::Mat*> node_inputs;
+    for (int input : node.inputs) {
+      node_inputs.push_back(input >= 0 ? &outputs_[input] : &frame_);
+    }
+    node_inputs_.push_back(node_inputs);
+  }
+}
+
+FilterGraph::~FilterGraph() {
+  {
+    std::lock_guard<std::mutex> lock(level_mutex_);
+    stopping_ = true;
+  }
+  level_condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+cv::Mat FilterGraph::Run(const cv::Mat& frame) {
+  if (workers_.empty()) {
+    for (size_t i = 1; i < THREADS_; ++i) {
+      workers_.push_back(std::thread(&FilterGraph::WorkerLoop, this));
+    }
+  }
+  frame_ = frame;
+  // The caller may still hold the images of the last frame in these.
+  for (size_t buffer : final_buffers_) {
+    buffers_[buffer].release();
+  }
+  for (const std::vector<size_t>& level : levels_) {
+    for (size_t node : level) {
+      outputs_[node] = buffers_[nodes_[node].buffer];
+    }
+    if (THREADS_ == 1 || level.size() == 1) {
+      for (size_t node : level) {
+        RunNode(node);
+      }
+    } else {
+      {
+        std::lock_guard<std::mutex> lock(level_mutex_);
+        level_tasks_ = &level;
+        next_task_ = 0;
+        unfinished_tasks_ = level.size();
+        error_ = nullptr;
+        ++level_generation_;
+      }
+      level_condition_.notify_all();
+      RunLevelTasks();
+      std::exception_ptr error;
+      {
+        std::unique_lock<std::mutex> lock(level_mutex_);
+        done_condition_.wait(lock, [this] { return unfinished_tasks_ == 0; });
+        level_tasks_ = nullptr;
+        error = error_;
+      }
+      if (error) {
+        frame_.release();
+        std::rethrow_exception(error);
+      }
+    }
+    for (size_t node : level) {
+      // A node which forwarded its input leaves its buffer as it was. Any
+      // other may have reallocated it, and the next node to share it should
+      // start from the new one.
+      const cv::Mat& output = outputs_[node];
+      bool forwarded = nodes_[node].filter->MayForwardInput() &&
+                       !node_inputs_[node].empty() &&
+                       output.datastart == node_inputs_[node][0]->datastart;
+      if (!forwarded) {
+        buffers_[nodes_[node].buffer] = output;
+      }
+    }
+  }
+  frame_.release();
+  return outputs_[output_node_];
+}
+
+std::vector<FilterNodeTiming> FilterGraph::GetNodeTimings() const {
+  std::vector<FilterNodeTiming> timings;
+  for (const Node& node : nodes_) {
+    timings.push_back({node.name, node.last_ms});
+  }
+  return timings;
+}
+
+size_t FilterGraph::GetLevelCount() const {
+  return levels_.size();
+}
+
+size_t FilterGraph::GetBufferCount() const {
+  return buffers_.size();
+}
+
+void FilterGraph::SetMetrics(common::MetricsRegistry* metrics) {
+  for (Node& node : nodes_) {
+    node.histogram = metrics == nullptr
+                         ? nullptr
+                         : &metrics->GetHistogram("filter_graph." + node.name);
+  }
+}
+
+void FilterGraph::SetThreadPolicies(common::ThreadPolicies* thread_policies) {
+  thread_policies_ = thread_policies;
+}
+
+void FilterGraph::RunNode(size_t node) {
+  int64_t start_time_ns = common::GetTimestampNanoseconds();
+  nodes_[node].filter->Run(node_inputs_[node], outputs_[node]);
+  int64_t elapsed_ns = common::GetTimestampNanoseconds() - start_time_ns;
+  nodes_[node].last_ms = common::NanosecondsToMilliseconds(elapsed_ns);
+  if (nodes_[node].histogram != nullptr) {
+    nodes_[node].histogram->Record(elapsed_ns);
+  }
+}
+
+void FilterGraph::RunLevelTasks() {
+  std::unique_lock<std::mutex> lock(level_mutex_);
+  while (level_tasks_ != nullptr && next_task_ < level_tasks_->size()) {
+    size_t node = (*level_tasks_)[next_task_++];
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      RunNode(node);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    if (error && !error_) {
+      error_ = error;
+    }
+    if (--unfinished_tasks_ == 0) {
+      done_condition_.notify_all();
+    }
+  }
+}
+
+void FilterGraph::WorkerLoop() {
+  if (thread_policies_ != nullptr) {
+    thread_policies_->Apply(common::FILTER_THREAD);
+  }
+  uint64_t seen_generation = 0;
+  std::unique_lock<std::mutex> lock(level_mutex_);
+  while (true) {
+    level_condition_.wait(lock, [this, &seen_generation] {
+      return stopping_ || level_generation_ != seen_generation;
+    });
+    if (stopping_) {
+      return;
+    }
+    seen_generation = level_generation_;
+    lock.unlock();
+    RunLevelTasks();
+    lock.lock();
+  }
+}
+}  // namespace gesturerecognition
@@ -0,0 +1,352 @@
+#include "gesturerecognition/finger_predictor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace gesturerecognition {
+
+namespace {
+// Of the jerk that changes the acceleration, in pixels^2 / s^5. A bending
+// finger tip reaches a few thousand pixels per second squared within a few
+// frames.
+const double JERK_NOISE_DENSITY = 1e8;
+const double INITIAL_VELOCITY_VARIANCE = 1e4;
+const double INITIAL_ACCELERATION_VARIANCE = 1e6;
+const double DEFAULT_FRAME_SECONDS = 1.0 / 30;
+// Frames a track needs before its velocity is trusted to fire a press.
+const size_t MIN_OBSERVATIONS = 3;
+}  // namespace
+
+FingerKalmanFilter::FingerKalmanFilter(double distance,
+                                       double measurement_noise)
+    : state_{distance, 0, 0},
+      covariance_{{measurement_noise * measurement_noise, 0, 0},
+                  {0, INITIAL_VELOCITY_VARIANCE, 0},
+                  {0, 0, INITIAL_ACCELERATION_VARIANCE}},
+      measurement_variance_(measurement_noise * measurement_noise) {
+}
+
+void FingerKalmanFilter::Predict(double seconds) {
+  const double t = seconds;
+  const double transition[3][3] = {
+      {1, t, t * t / 2}, {0, 1, t}, {0, 0, 1}};
+  double state[3] = {0, 0, 0};
+  double product[3][3] = {};
+  for (int i = 0; i < 3; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      state[i] += transition[i][k] * state_[k];
+      for (int j = 0; j < 3; ++j) {
+        product[i][j] += transition[i][k] * covariance_[k][j];
+      }
+    }
+  }
+  // The noise of a jerk that is constant over the step.
+  const double t2 = t * t;
+  const double t3 = t2 * t;
+  const double noise[3][3] = {{t3 * t2 / 20, t2 * t2 / 8, t3 / 6},
+                              {t2 * t2 / 8, t3 / 3, t2 / 2},
+                              {t3 / 6, t2 / 2, t}};
+  for (int i = 0; i < 3; ++i) {
+    state_[i] = state[i];
+    for (int j = 0; j < 3; ++j) {
+      double value = JERK_NOISE_DENSITY * noise[i][j];
+      for (int k = 0; k < 3; ++k) {
+        value += product[i][k] * transition[j][k];
+      }
+      covariance_[i][j] = value;
+    }
+  }
+}
+
+void FingerKalmanFilter::Correct(double distance) {
+  // Only the distance is measured, so the gain is the first column of the
+  // covariance over the variance of the innovation.
+  const double innovation_variance = covariance_[0][0] + measurement_variance_;
+  const double innovation = distance - state_[0];
+  double gain[3];
+  for (int i = 0; i < 3; ++i) {
+    gain[i] = covariance_[i][0] / innovation_variance;
+    state_[i] += gain[i] * innovation;
+  }
+  const double first_row[3] = {covariance_[0][0], covariance_[0][1],
+                               covariance_[0][2]};
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      covariance_[i][j] -= gain[i] * first_row[j];
+    }
+  }
+}
+
+double FingerKalmanFilter::GetDistance() const {
+  return state_[0];
+}
+
+double FingerKalmanFilter::GetVelocity() const {
+  return state_[1];
+}
+
+double FingerKalmanFilter::GetAcceleration() const {
+  return state_[2];
+}
+
+double FingerKalmanFilter::Extrapolate(double seconds) const {
+  return state_[0] + state_[1] * seconds + state_[2] * seconds * seconds / 2;
+}
+
+FingerPredictor::FingerPredictor(const PredictiveOnsetSettings& settings,
+                                 int max_change_in_finger_position)
+    : SETTINGS_(settings),
+      MAX_CHANGE_IN_FINGER_POSITION_(max_change_in_finger_position),
+      next_track_id_(0),
+      predicted_counter_(nullptr),
+      confirmed_counter_(nullptr),
+      cancelled_counter_(nullptr),
+      lead_histogram_(nullptr) {
+}
+
+void FingerPredictor::Update(const Hand& hand,
+                             const std::vector<cv::Point>& click_points,
+                             int64_t batch_onset_ns,
+                             std::vector<cv::Point>& points,
+                             std::vector<int64_t>& onset_times) {
+  FollowTips(hand);
+  ResolvePresses(click_points, hand.capture_time_ns_,
+                 hand.bounding_box_.width);
+  FirePresses(hand.capture_time_ns_);
+
+  points.clear();
+  onset_times.clear();
+  for (const cv::Point& click_point : click_points) {
+    auto confirmed = std::find_if(
+        confirmed_presses_.begin(), confirmed_presses_.end(),
+        [&click_point](const ConfirmedPress& press) {
+          return press.batch_point == click_point;
+        });
+    if (confirmed == confirmed_presses_.end()) {
+      points.push_back(click_point);
+      onset_times.push_back(batch_onset_ns);
+    } else {
+      // The note keeps sounding on the key it fired on.
+      points.push_back(confirmed->point);
+      onset_times.push_back(confirmed->fired_ns);
+    }
+  }
+  for (const PredictedPress& press : pending_presses_) {
+    points.push_back(press.point);
+    onset_times.push_back(press.fired_ns);
+  }
+}
+
+size_t FingerPredictor::GetPendingPressCount() const {
+  return pending_presses_.size();
+}
+
+void FingerPredictor::SetMetrics(common::MetricsRegistry* metrics) {
+  if (metrics == nullptr) {
+    predicted_counter_ = confirmed_counter_ = cancelled_counter_ = nullptr;
+    lead_histogram_ = nullptr;
+    return;
+  }
+  predicted_counter_ = &metrics->GetCounter("tracker.predicted_presses");
+  confirmed_counter_ = &metrics->GetCounter("tracker.confirmed_presses");
+  cancelled_counter_ = &metrics->GetCounter("tracker.cancelled_presses");
+  lead_histogram_ = &metrics->GetHistogram("tracker.prediction_lead");
+}
+
+void FingerPredictor::FollowTips(const Hand& hand) {
+  for (Track& track : tracks_) {
+    track.seen = false;
+  }
+  const std::vector<cv::Point>& tips = hand.finger_tips_;
+  // Without a palm there is nothing to measure the bend from.
+  const bool has_palm = hand.center_of_palm_.x != ERROR_NUMBER;
+  if (has_palm) {
+    // Each tip goes to the nearest track, the closest pairs first.
+    std::vector<std::pair<double, std::pair<size_t, size_t>>> pairs;
+    for (size_t i = 0; i < tracks_.size(); ++i) {
+      for (size_t j = 0; j < tips.size(); ++j) {
+        double distance = FindEuclideanDistance(tracks_[i].tip, tips[j]);
+        if (distance <= MAX_CHANGE_IN_FINGER_POSITION_) {
+          pairs.push_back(std::make_pair(distance, std::make_pair(i, j)));
+        }
+      }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    std::vector<bool> is_tip_taken(tips.size(), false);
+    for (const auto& pair : pairs) {
+      Track& track = tracks_[pair.second.first];
+      size_t tip = pair.second.second;
+      if (track.seen || is_tip_taken[tip]) {
+        continue;
+      }
+      is_tip_taken[tip] = true;
+      double distance = FindEuclideanDistance(tips[tip], hand.center_of_palm_);
+      double seconds = (hand.capture_time_ns_ - track.last_seen_ns) / 1e9;
+      if (seconds <= 0) {
+        seconds = DEFAULT_FRAME_SECONDS;
+      }
+      if (track.missed_frames > 0) {
+        // Its velocity from before the gap says nothing about now.
+        track.filter =
+            FingerKalmanFilter(distance, SETTINGS_.measurement_noise_px);
+        track.observations = 1;
+      } else {
+        track.filter.Predict(seconds);
+        track.filter.Correct(distance);
+        ++track.observations;
+      }
+      track.tip = tips[tip];
+      track.last_seen_ns = hand.capture_time_ns_;
+      track.missed_frames = 0;
+      track.seen = true;
+      // The finger has to straighten before it can fire another press.
+      if (track.has_fired && HasStraightened(track)) {
+        track.has_fired = false;
+      }
+      // Measured rather than filtered, as the filter overshoots a tip which
+      // stops.
+      if (!track.has_fired) {
+        track.rest_distance =
+            GetRestDistance(track.rest_distance, distance, seconds);
+      }
+    }
+    for (size_t tip = 0; tip < tips.size(); ++tip) {
+      if (is_tip_taken[tip]) {
+        continue;
+      }
+      double distance = FindEuclideanDistance(tips[tip], hand.center_of_palm_);
+      tracks_.push_back(Track{
+          next_track_id_++, tips[tip],
+          FingerKalmanFilter(distance, SETTINGS_.measurement_noise_px),
+          distance, hand.capture_time_ns_, 1, 0, true, false});
+    }
+  }
+  for (Track& track : tracks_) {
+    if (!track.seen) {
+      ++track.missed_frames;
+    }
+  }
+  tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(),
+                               [this](const Track& track) {
+                                 return track.missed_frames >
+                                        SETTINGS_.confirm_frames;
+                               }),
+                tracks_.end());
+}
+
+void FingerPredictor::ResolvePresses(
+    const std::vector<cv::Point>& click_points, int64_t capture_time_ns,
+    int hand_width) {
+  // A bent tip is found at most the threshold nearer the palm than where the
+  // batch saw it last, but a small hand's neighbouring tips may be nearer.
+  double max_distance =
+      MAX_CHANGE_IN_FINGER_POSITION_ + SETTINGS_.bend_threshold_px;
+  if (hand_width > 0) {
+    max_distance = std::min(
+        max_distance, SETTINGS_.confirm_radius_by_hand_width * hand_width);
+  }
+  for (const cv::Point& click_point : click_points) {
+    if (std::find(last_click_points_.begin(), last_click_points_.end(),
+                  click_point) != last_click_points_.end()) {
+      continue;
+    }
+    auto closest = pending_presses_.end();
+    double closest_distance = max_distance;
+    for (auto it = pending_presses_.begin(); it != pending_presses_.end();
+         ++it) {
+      double distance = FindEuclideanDistance(it->point, click_point);
+      if (distance <= closest_distance) {
+        closest = it;
+        closest_distance = distance;
+      }
+    }
+    if (closest == pending_presses_.end()) {
+      continue;
+    }
+    confirmed_presses_.push_back(
+        ConfirmedPress{click_point, closest->point, closest->fired_ns});
+    if (confirmed_counter_ != nullptr) {
+      confirmed_counter_->Increment();
+      lead_histogram_->Record(capture_time_ns - closest->fired_ns);
+    }
+    pending_presses_.erase(closest);
+  }
+
+  for (auto it = pending_presses_.begin(); it != pending_presses_.end();) {
+    ++it->frames_waited;
+    const Track* track = FindTrack(it->track_id);
+    bool has_straightened =
+        track != nullptr && track->seen && HasStraightened(*track);
+    if (it->frames_waited > SETTINGS_.confirm_frames || has_straightened) {
+      if (cancelled_counter_ != nullptr) {
+        cancelled_counter_->Increment();
+      }
+      it = pending_presses_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  confirmed_presses_.erase(
+      std::remove_if(confirmed_presses_.begin(), confirmed_presses_.end(),
+                     [&click_points](const ConfirmedPress& press) {
+                       return std::find(click_points.begin(),
+                                        click_points.end(),
+                                        press.batch_point) ==
+                              click_points.end();
+                     }),
+      confirmed_presses_.end());
+  last_click_points_ = click_points;
+}
+
+void FingerPredictor::FirePresses(int64_t capture_time_ns) {
+  const double horizon_seconds = SETTINGS_.horizon_ms / 1000;
+  for (Track& track : tracks_) {
+    // The tip has to be bending already, by more than it jitters.
+    if (!track.seen || track.has_fired ||
+        track.observations < MIN_OBSERVATIONS ||
+        track.filter.GetVelocity() >= 0 ||
+        track.rest_distance - track.filter.GetDistance() <=
+            SETTINGS_.measurement_noise_px) {
+      continue;
+    }
+    double predicted_bend =
+        track.rest_distance - track.filter.Extrapolate(horizon_seconds);
+    if (predicted_bend < SETTINGS_.bend_threshold_px) {
+      continue;
+    }
+    track.has_fired = true;
+    pending_presses_.push_back(
+        PredictedPress{track.id, track.tip, capture_time_ns, 0});
+    if (predicted_counter_ != nullptr) {
+      predicted_counter_->Increment();
+    }
+  }
+}
+
+FingerPredictor::Track* FingerPredictor::FindTrack(uint64_t id) {
+  for (Track& track : tracks_) {
+    if (track.id == id) {
+      return &track;
+    }
+  }
+  return nullptr;
+}
+
+double FingerPredictor::GetRestDistance(double rest_distance,
+                                        double distance,
+                                        double seconds) const {
+  if (distance >= rest_distance || SETTINGS_.rest_decay_ms <= 0) {
+    return std::max(rest_distance, distance);
+  }
+  return distance + (rest_distance - distance) *
+                        std::exp(-seconds * 1000 / SETTINGS_.rest_decay_ms);
+}
+
+bool FingerPredictor::HasStraightened(const Track& track) const {
+  return track.filter.GetVelocity() >= 0 &&
+         track.rest_distance - track.filter.GetDistance() <
+             SETTINGS_.bend_threshold_px / 2;
+}
+}  // namespace gesturerecognition
@@ -0,0 +1,68 @@
+#include "gesturerecognition/frame_gate.h"
+
+#include <stdexcept>
+
+namespace gesturerecognition {
+
+FrameGate::FrameGate(double threshold, int subsample_step)
+    : threshold_(threshold),
+      subsample_step_(subsample_step),
+      last_difference_(0) {
+  if (subsample_step < 1) {
+    throw std::invalid_argument("The subsample step must be at least 1!");
+  }
+}
+
+bool FrameGate::HasChanged(const cv::Mat& input_image,
+                           const std::vector<cv::Rect>& regions) {
+  // Nearest neighbour resizing picks single pixels without averaging them,
+  // which is the cheapest way to subsample.
+  cv::resize(input_image, subsampled_,
+             cv::Size(input_image.cols / subsample_step_,
+                      input_image.rows / subsample_step_),
+             0, 0, cv::INTER_NEAREST);
+  if (reference_.size() != subsampled_.size() ||
+      reference_.type() != subsampled_.type()) {
+    subsampled_.copyTo(reference_);
+    last_difference_ = 0;
+    return true;
+  }
+
+  const cv::Rect frame_rect(cv::Point(0, 0), subsampled_.size());
+  double difference_sum = 0;
+  double compared_values = 0;
+  for (const cv::Rect& region : regions) {
+    cv::Rect subsampled_region(region.x / subsample_step_,
+                               region.y / subsample_step_,
+                               region.width / subsample_step_ + 1,
+                               region.height / subsample_step_ + 1);
+    subsampled_region &= frame_rect;
+    if (subsampled_region.area() == 0) {
+      continue;
+    }
+    difference_sum += cv::norm(subsampled_(subsampled_region),
+                               reference_(subsampled_region), cv::NORM_L1);
+    compared_values +=
+        static_cast<double>(subsampled_region.area()) * subsampled_.channels();
+  }
+  if (compared_values == 0) {
+    difference_sum = cv::norm(subsampled_, reference_, cv::NORM_L1);
+    compared_values =
+        static_cast<double>(subsampled_.total()) * subsampled_.channels();
+  }
+  last_difference_ = difference_sum / compared_values;
+  if (last_difference_ <= threshold_) {
+    return false;
+  }
+  cv::swap(reference_, subsampled_);
+  return true;
+}
+
+void FrameGate::Reset() {
+  reference_.release();
+}
+
+double FrameGate::GetLastDifference() const {
+  return last_difference_;
+}
+}  // namespace gesturerecognition
@@ -0,0 +1,128 @@
+#include "gesturerecognition/frame_source.h"
+
+#include <stdexcept>
+
+namespace gesturerecognition {
+
+PixelFormat ParsePixelFormat(const std::string& name) {
+  if (name == "bgr") {
+    return PixelFormat::BGR;
+  }
+  if (name == "yuyv") {
+    return PixelFormat::YUYV;
+  }
+  if (name == "nv12") {
+    return PixelFormat::NV12;
+  }
+  throw std::invalid_argument("Unknown pixel format " + name);
+}
+
+cv::Size GetFrameSize(const CapturedFrame& frame) {
+  if (frame.format_ == PixelFormat::NV12) {
+    return cv::Size(frame.data_.cols, frame.data_.rows * 2 / 3);
+  }
+  return frame.data_.size();
+}
+
+cv::Mat GetLuma(const CapturedFrame& frame) {
+  cv::Mat luma;
+  switch (frame.format_) {
+    case PixelFormat::BGR:
+      cv::cvtColor(frame.data_, luma, cv::COLOR_BGR2GRAY);
+      break;
+    case PixelFormat::YUYV:
+      // Every pixel's first channel is its Y.
+      cv::extractChannel(frame.data_, luma, 0);
+      break;
+    case PixelFormat::NV12:
+      luma = frame.data_.rowRange(0, GetFrameSize(frame).height);
+      break;
+  }
+  return luma;
+}
+
+cv::Mat ConvertToBGR(const CapturedFrame& frame) {
+  cv::Mat bgr_image;
+  switch (frame.format_) {
+    case PixelFormat::BGR:
+      bgr_image = frame.data_;
+      break;
+    case PixelFormat::YUYV:
+      cv::cvtColor(frame.data_, bgr_image, cv::COLOR_YUV2BGR_YUYV);
+      break;
+    case PixelFormat::NV12:
+      cv::cvtColor(frame.data_, bgr_image, cv::COLOR_YUV2BGR_NV12);
+      break;
+  }
+  return bgr_image;
+}
+
+void FlipFrame(const CapturedFrame& frame, CapturedFrame& flipped_frame) {
+  flipped_frame.format_ = frame.format_;
+  flipped_frame.data_.create(frame.data_.size(), frame.data_.type());
+  if (frame.format_ == PixelFormat::BGR) {
+    cv::flip(frame.data_, flipped_frame.data_, 1);
+    return;
+  }
+  if (frame.format_ == PixelFormat::NV12) {
+    // Each U and V pair covers two pixels, so the chroma plane is flipped as
+    // pairs.
+    int height = GetFrameSize(frame).height;
+    cv::Mat flipped_luma = flipped_frame.data_.rowRange(0, height);
+    cv::flip(frame.data_.rowRange(0, height), flipped_luma, 1);
+    cv::Mat flipped_chroma =
+        flipped_frame.data_.rowRange(height, frame.data_.rows).reshape(2);
+    cv::flip(frame.data_.rowRange(height, frame.data_.rows).reshape(2),
+             flipped_chroma, 1);
+    return;
+  }
+  // A YUYV macropixel Y0 U Y1 V holds two pixels sharing their chroma, so
+  // the macropixels are reversed and the two Ys inside each are swapped.
+  const int macropixels = frame.data_.cols / 2;
+  for (int row = 0; row < frame.data_.rows; ++row) {
+    const uchar* source = frame.data_.ptr<uchar>(row);
+    uchar* destination = flipped_frame.data_.ptr<uchar>(row);
+    for (int i = 0; i < macropixels; ++i) {
+      const uchar* macropixel = source + 4 * (macropixels - 1 - i);
+      destination[4 * i] = macropixel[2];
+      destination[4 * i + 1] = macropixel[1];
+      destination[4 * i + 2] = macropixel[0];
+      destination[4 * i + 3] = macropixel[3];
+    }
+  }
+}
+
+OpenCVFrameSource::OpenCVFrameSource(int camera_number)
+    : video_capture_(camera_number) {
+}
+
+OpenCVFrameSource::OpenCVFrameSource(const std::string& video_file_name)
+    : video_capture_(video_file_name), video_file_name_(video_file_name) {
+}
+
+bool OpenCVFrameSource::Read(CapturedFrame& frame) {
+  frame.format_ = PixelFormat::BGR;
+  frame.timestamp_ns_ = 0;
+  video_capture_ >> frame.data_;
+  return !frame.data_.empty();
+}
+
+double OpenCVFrameSource::GetFramesPerSecond() const {
+  return video_capture_.get(cv::CAP_PROP_FPS);
+}
+
+cv::Size OpenCVFrameSource::GetFrameSize() const {
+  return cv::Size(
+      static_cast<int>(video_capture_.get(cv::CAP_PROP_FRAME_WIDTH)),
+      static_cast<int>(video_capture_.get(cv::CAP_PROP_FRAME_HEIGHT)));
+}
+
+bool OpenCVFrameSource::Rewind() {
+  if (video_file_name_.empty()) {
+    return false;
+  }
+  // Reopening works with every container, unlike seeking to frame 0.
+  video_capture_.release();
+  return video_capture_.open(video_file_name_);
+}
+}  // namespace gesturerecognition
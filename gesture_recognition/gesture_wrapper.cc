@@ -4,80 +4,316 @@
 
 #include "gesturerecognition/gesture_wrapper.h"
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
 namespace gesturerecognition {
 
 GestureWrapper::GestureWrapper(const ProgramSettings& settings)
-    : calibration_(0, settings.maximum_hsv_limit, settings.hsv_window_name,
-                   settings.background_sub_window_name,
-                   settings.combined_window_name,
-                   settings.background_learning_rate, settings.hsv_window_size),
-      OUTPUT_WINDOW_SIZE_(settings.output_window_size),
-      LINE_TYPE_(settings.line_type),
-      left_hand_tracker_((settings.frames_to_track)),
-      right_hand_tracker_(settings.frames_to_track),
-      recognition_mode_(false),
-      video_capture_(settings.camera_number),
-      hand_extractor_(),
+    : CONVEX_HULL_WINDOW_NAME_(settings.convex_hull_window_name),
+      FINGER_TIP_CIRCLE_RADIUS_(settings.finger_tip_circle_radius),
+      FINGER_TIP_CIRCLE_THICKNESS_(settings.finger_tip_circle_thickness),
       HSV_WINDOW_NAME_(settings.hsv_window_name),
       BACKGROUND_SUB_WINDOW_NAME_(settings.background_sub_window_name),
       COMBINED_WINDOW_NAME_(settings.combined_window_name),
-      CONVEX_HULL_WINDOW_NAME_(settings.convex_hull_window_name),
-      FINGER_TIP_CIRCLE_RADIUS_(settings.finger_tip_circle_radius),
-      FINGER_TIP_CIRCLE_THICKNESS_(settings.finger_tip_circle_thickness),
-      PIANO_CIRCLE_RADIUS(settings.piano_circle_radius) {
+      OUTPUT_WINDOW_SIZE_(settings.output_window_size),
+      LINE_TYPE_(settings.line_type),
+      SHOW_DEBUG_WINDOWS_(settings.show_debug_windows),
+      PROFILE_FILE_NAME_(settings.calibration_profile_file),
+      PROFILE_CHECK_FRAMES_(settings.profile_check_frames),
+      PROFILE_MAX_FOREGROUND_FRACTION_(
+          settings.profile_max_foreground_fraction),
+      AUTO_HSV_CALIBRATION_FRAMES_(settings.auto_hsv_calibration_frames),
+      PIXEL_FORMAT_(ParsePixelFormat(settings.capture_pixel_format)),
+      USE_RLE_MASKS_(settings.rle_masks),
+      hand_extractor_(ParseFingerTipDetector(settings.finger_tip_detector),
+                      settings.hand_extractor),
+      calibration_(0, settings.maximum_hsv_limit, settings.hsv_window_name,
+                   settings.background_sub_window_name,
+                   settings.combined_window_name,
+                   settings.background_learning_rate, settings.hsv_window_size,
+                   ParseBackgroundModelType(settings.background_model)),
+      hsv_estimator_(),
+      auto_hsv_calibrating_(false),
+      recognition_mode_(false),
+      left_hand_tracker_(settings.frames_to_track,
+                         settings.max_change_in_finger_position),
+      right_hand_tracker_(settings.frames_to_track,
+                          settings.max_change_in_finger_position),
+      image_converted_(false),
+      capture_time_ns_(0),
+      end_of_stream_(false),
+      clock_(&common::GetSteadyClock()),
+      draw_debug_overlays_(true),
+      pending_drawing_ms_(0),
+      profile_loaded_(false),
+      profile_check_frames_left_(0),
+      profile_foreground_fraction_sum_(0),
+      startup_time_ns_(common::GetTimestampNanoseconds()),
+      time_to_playable_ns_(0),
+      frames_read_(0),
+      frames_to_playable_(0),
+      frame_skipped_(false),
+      skipped_frames_(0),
+      is_video_file_(!settings.video_file_name.empty()),
+      source_dropped_frames_(0),
+      source_frame_interval_ns_(0),
+      smoothed_frame_interval_ns_(0),
+      frame_counter_(nullptr),
+      dropped_frame_counter_(nullptr),
+      fps_gauge_(nullptr),
+      frame_interval_histogram_(nullptr),
+      update_histogram_(nullptr),
+      time_to_playable_gauge_(nullptr),
+      profile_rejection_counter_(nullptr),
+      skipped_frame_counter_(nullptr),
+      bus_(nullptr) {
+  if (PIXEL_FORMAT_ != PixelFormat::BGR) {
+    std::unique_ptr<CaptureDevice> device;
+    if (is_video_file_) {
+      device.reset(new FileCaptureDevice(
+          settings.video_file_name, PIXEL_FORMAT_, settings.yuv_frame_size,
+          settings.yuv_frames_per_second, settings.capture_buffer_count,
+          settings.capture_paced));
+    } else {
+      device.reset(new V4L2Device(
+          "/dev/video" + std::to_string(settings.camera_number), PIXEL_FORMAT_,
+          settings.yuv_frame_size, settings.yuv_frames_per_second,
+          settings.capture_buffer_count));
+    }
+    frame_source_.reset(new DeviceFrameSource(std::move(device)));
+  } else if (is_video_file_) {
+    frame_source_.reset(new OpenCVFrameSource(settings.video_file_name));
+  } else {
+    frame_source_.reset(new OpenCVFrameSource(settings.camera_number));
+  }
+  FilterQuality filter_quality;
+  filter_quality.morphology_iterations = settings.morphology_iterations;
+  calibration_.SetFilterQuality(filter_quality);
+  calibration_.SetAsyncBackgroundUpdates(
+      settings.async_background_update_frames);
+  calibration_.SetFilterGraph(settings.filter_graph,
+                              settings.filter_graph_threads);
+  if (settings.tracker_mode == "predictive") {
+    left_hand_tracker_.SetPredictiveOnset(settings.predictive_onset);
+    right_hand_tracker_.SetPredictiveOnset(settings.predictive_onset);
+  } else if (settings.tracker_mode != "batch") {
+    throw std::invalid_argument("Unknown tracker mode " +
+                                settings.tracker_mode);
+  }
+  if (!settings.keypoint_model.GetModelFile().empty()) {
+    keypoint_detector_.reset(
+        new AsyncKeypointDetector(settings.keypoint_model));
+  }
+  if (SHOW_DEBUG_WINDOWS_) {
+    CreateDebugViews(settings);
+  }
+  if (settings.frame_gate_threshold > 0) {
+    frame_gate_.reset(new FrameGate(settings.frame_gate_threshold,
+                                    settings.frame_gate_subsample));
+  }
+  if (settings.frame_budget_ms > 0) {
+    quality_controller_.reset(new QualityController(
+        settings.frame_budget_ms, settings.quality_window_frames,
+        settings.quality_restore_fraction));
+  }
+  double source_fps = frame_source_->GetFramesPerSecond();
+  if (source_fps > 0) {
+    source_frame_interval_ns_ = static_cast<int64_t>(1e9 / source_fps);
+  }
+  if (!settings.mask_recording_file.empty()) {
+    mask_recording_.open(settings.mask_recording_file,
+                         std::ios::binary | std::ios::trunc);
+    if (!mask_recording_.is_open()) {
+      throw std::runtime_error("Could not open " +
+                               settings.mask_recording_file);
+    }
+  }
+  if (!PROFILE_FILE_NAME_.empty()) {
+    LoadCalibrationProfile();
+  }
+}
+
+bool GestureWrapper::LoadCalibrationProfile() {
+  profile_loaded_ = calibration_.LoadProfile(PROFILE_FILE_NAME_);
+  if (!profile_loaded_) {
+    return false;
+  }
+  // YUV frames are learnt by their luma alone.
+  int channels = PIXEL_FORMAT_ == PixelFormat::BGR ? 3 : 1;
+  if (calibration_.HasTrainedBackground(frame_source_->GetFrameSize(),
+                                        channels)) {
+    calibration_.SetBackgroundTraining(false);
+    calibration_.SetHSVCalibration(false);
+    recognition_mode_ = true;
+    profile_check_frames_left_ = PROFILE_CHECK_FRAMES_;
+    profile_foreground_fraction_sum_ = 0;
+  }
+  return true;
+}
+
+bool GestureWrapper::SaveCalibrationProfile() const {
+  if (PROFILE_FILE_NAME_.empty()) {
+    return false;
+  }
+  if (!calibration_.SaveProfile(PROFILE_FILE_NAME_)) {
+    std::cerr << "Could not write the calibration profile "
+              << PROFILE_FILE_NAME_ << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool GestureWrapper::IsProfileLoaded() const {
+  return profile_loaded_;
+}
+
+bool GestureWrapper::IsBackgroundTraining() const {
+  return calibration_.IsBackgroundTraining();
+}
+
+int64_t GestureWrapper::GetTimeToPlayable() const {
+  return time_to_playable_ns_;
+}
+
+bool GestureWrapper::WasLastFrameSkipped() const {
+  return frame_skipped_;
+}
+
+size_t GestureWrapper::GetSkippedFrames() const {
+  return skipped_frames_;
+}
+
+size_t GestureWrapper::GetFramesToPlayable() const {
+  return frames_to_playable_;
 }
 
 void GestureWrapper::ToggleGestureRecognitionMode() {
+  bool was_calibrating =
+      calibration_.IsBackgroundTraining() || calibration_.IsHSVCalibrating();
+  profile_check_frames_left_ = 0;
   calibration_.SetBackgroundTraining(false);
   calibration_.SetHSVCalibration(false);
   recognition_mode_ = !recognition_mode_;
-  if (!recognition_mode_) {
-    cv::destroyWindow(CONVEX_HULL_WINDOW_NAME_);
+  if (was_calibrating) {
+    SaveCalibrationProfile();
   }
 }
 void GestureWrapper::ToggleBackgroundCalibration() {
   recognition_mode_ = false;
+  profile_check_frames_left_ = 0;
   calibration_.SetBackgroundTraining(!calibration_.IsBackgroundTraining());
   if (!calibration_.IsBackgroundTraining()) {
-    cv::destroyWindow(BACKGROUND_SUB_WINDOW_NAME_);
+    SaveCalibrationProfile();
   }
   return;
 }
 
 void GestureWrapper::ToggleHSVCalibration() {
   recognition_mode_ = false;
+  profile_check_frames_left_ = 0;
   calibration_.SetHSVCalibration(!calibration_.IsHSVCalibrating());
   if (!calibration_.IsHSVCalibrating()) {
-    cv::destroyWindow(HSV_WINDOW_NAME_);
-    return;
+    SaveCalibrationProfile();
+  }
+  if (SHOW_DEBUG_WINDOWS_ && calibration_.IsHSVCalibrating()) {
+    calibration_.CreateTrackbars(255);
   }
-  calibration_.CreateTrackbars(255);
 }
 
-void GestureWrapper::Draw() {
-  cv::imshow(COMBINED_WINDOW_NAME_, combined_filter_image_);
+void GestureWrapper::ToggleAutoHSVCalibration() {
+  recognition_mode_ = false;
+  profile_check_frames_left_ = 0;
+  auto_hsv_calibrating_ = !auto_hsv_calibrating_;
+  hsv_estimator_.Reset();
+}
 
-  if (recognition_mode_) {
-    cv::imshow(CONVEX_HULL_WINDOW_NAME_, convex_hull_image_);
+bool GestureWrapper::IsAutoHSVCalibrating() const {
+  return auto_hsv_calibrating_;
+}
 
-    for (auto pt : right_finger_tips) {
-      ci::gl::color(ci::Color("blue"));
-      ci::gl::drawSolidCircle(piano::ConvertToVec2(pt),
-                              static_cast<float>(PIANO_CIRCLE_RADIUS));
-    }
-    for (auto pt : left_finger_tips) {
-      ci::gl::color(ci::Color("pink"));
-      ci::gl::drawSolidCircle(piano::ConvertToVec2(pt),
-                              static_cast<float>(PIANO_CIRCLE_RADIUS));
-    }
+std::vector<cv::Rect> GestureWrapper::GetAutoHSVBoxes() const {
+  std::vector<cv::Rect> boxes;
+  if (!auto_hsv_calibrating_ || frame_size_.area() == 0) {
+    return boxes;
+  }
+  for (const cv::Rect& box : HSVEstimator::GetHandBoxes(frame_size_)) {
+    std::vector<cv::Point> corners = ConvertCoordinates(
+        {box.tl(), box.br()}, frame_size_.height, frame_size_.width,
+        OUTPUT_WINDOW_SIZE_.height, OUTPUT_WINDOW_SIZE_.width);
+    boxes.push_back(cv::Rect(corners[0], corners[1]));
+  }
+  return boxes;
+}
+
+void GestureWrapper::UpdateAutoHSVCalibration() {
+  hsv_estimator_.AddFrame(GetBGRImage());
+  if (hsv_estimator_.GetFramesAdded() < AUTO_HSV_CALIBRATION_FRAMES_) {
+    return;
+  }
+  auto_hsv_calibrating_ = false;
+  cv::Scalar low;
+  cv::Scalar high;
+  if (!hsv_estimator_.EstimateRange(low, high)) {
+    std::cerr << "No hands were found in the boxes, the HSV ranges were not "
+                 "changed"
+              << std::endl;
+    return;
   }
-  if (calibration_.IsHSVCalibrating()) {
-    cv::imshow(HSV_WINDOW_NAME_, hsv_filter_image_);
+  calibration_.SetHSVRange(low, high);
+  if (SHOW_DEBUG_WINDOWS_ && calibration_.IsHSVCalibrating()) {
+    calibration_.UpdateTrackbars();
+  }
+  SaveCalibrationProfile();
+}
+
+void GestureWrapper::SetHSVRange(const cv::Scalar& low,
+                                 const cv::Scalar& high) {
+  calibration_.SetHSVRange(low, high);
+}
+
+std::pair<cv::Scalar, cv::Scalar> GestureWrapper::GetHSVRange() const {
+  return calibration_.GetHSVRange();
+}
+
+void GestureWrapper::Draw() {
+  if (!debug_views_ || combined_filter_image_.empty()) {
+    return;
   }
-  if (calibration_.IsBackgroundTraining()) {
-    cv::imshow(BACKGROUND_SUB_WINDOW_NAME_, background_subtracted_image_);
+  debug_views_->SetViewOpen(COMBINED_WINDOW_NAME_, true);
+  debug_views_->SetViewOpen(CONVEX_HULL_WINDOW_NAME_,
+                            recognition_mode_ && draw_debug_overlays_);
+  debug_views_->SetViewOpen(HSV_WINDOW_NAME_, calibration_.IsHSVCalibrating());
+  debug_views_->SetViewOpen(BACKGROUND_SUB_WINDOW_NAME_,
+                            calibration_.IsBackgroundTraining());
+  int64_t start_ns = common::GetTimestampNanoseconds();
+  if (debug_views_->Show(start_ns)) {
+    pending_drawing_ms_ += common::NanosecondsToMilliseconds(
+        common::GetTimestampNanoseconds() - start_ns);
   }
 }
+
+void GestureWrapper::CreateDebugViews(const ProgramSettings& settings) {
+  debug_views_.reset(new DebugViews(
+      settings.debug_view_fps,
+      settings.debug_views_tiled ? settings.debug_tiled_window_name : "",
+      settings.debug_tile_size));
+  debug_views_->AddView(COMBINED_WINDOW_NAME_, [this](cv::Mat& view) {
+    view = combined_filter_image_;
+  });
+  debug_views_->AddView(CONVEX_HULL_WINDOW_NAME_, [this](cv::Mat& view) {
+    GetBGRImage().copyTo(view);
+    DrawHandFeatures(view, last_hands_.first, COLOR_1);
+    DrawHandFeatures(view, last_hands_.second, COLOR_2);
+  });
+  debug_views_->AddView(HSV_WINDOW_NAME_, [this](cv::Mat& view) {
+    view = calibration_.FilterImageByHSV(GetBGRImage());
+  });
+  debug_views_->AddView(BACKGROUND_SUB_WINDOW_NAME_, [this](cv::Mat& view) {
+    view = calibration_.GetLastBackgroundMask();
+  });
+}
 std::vector<cv::Point> GestureWrapper::ConvertCoordinates(
     const std::vector<cv::Point>& points, int input_height, int input_width,
     int ext_window_height, int ext_window_width) {
@@ -90,34 +326,397 @@ std::vector<cv::Point> GestureWrapper::ConvertCoordinates(
   }
   return converted_points;
 }
+int64_t GestureWrapper::GetLastCaptureTime() const {
+  return capture_time_ns_;
+}
+
+const common::FrameTimestamps& GestureWrapper::GetLastFrameTimestamps() const {
+  return frame_timestamps_;
+}
+
+const std::vector<int64_t>& GestureWrapper::GetLastOnsetTimes() const {
+  return merged_onset_times_;
+}
+
+int64_t GestureWrapper::GetSourceFrameInterval() const {
+  return source_frame_interval_ns_;
+}
+
+bool GestureWrapper::IsReadingVideoFile() const {
+  return is_video_file_;
+}
+
+bool GestureWrapper::CountsDroppedFrames() const {
+  return frame_source_->CountsDroppedFrames();
+}
+
+uint64_t GestureWrapper::GetDroppedFrames() const {
+  return frame_source_->GetDroppedFrames();
+}
+
+void GestureWrapper::SetClock(const common::Clock& clock) {
+  clock_ = &clock;
+}
+
+const StageTimings& GestureWrapper::GetLastStageTimings() const {
+  return stage_timings_;
+}
+
+std::vector<FilterNodeTiming> GestureWrapper::GetFilterNodeTimings() const {
+  const FilterGraph* filter_graph = calibration_.GetFilterGraph();
+  if (filter_graph == nullptr) {
+    return std::vector<FilterNodeTiming>();
+  }
+  return filter_graph->GetNodeTimings();
+}
+
+bool GestureWrapper::IsEndOfStream() const {
+  return end_of_stream_;
+}
+
+bool GestureWrapper::RewindVideo() {
+  if (!frame_source_->Rewind()) {
+    return false;
+  }
+  end_of_stream_ = false;
+  return true;
+}
+
+PipelineState GestureWrapper::GetPipelineState() const {
+  PipelineState state;
+  state.held_hands = left_hand_tracker_.GetHeldHandCount() +
+                     right_hand_tracker_.GetHeldHandCount();
+  state.click_points = left_hand_tracker_.GetClickPointCount() +
+                       right_hand_tracker_.GetClickPointCount();
+  state.foreground_fraction = calibration_.GetLastForegroundFraction();
+  state.background = calibration_.GetBackgroundModelState();
+  return state;
+}
+
+bool GestureWrapper::IsRecognitionMode() const {
+  return recognition_mode_;
+}
+
+const std::vector<cv::Point>& GestureWrapper::GetLeftFingerTips() const {
+  return left_finger_tips;
+}
+
+const std::vector<cv::Point>& GestureWrapper::GetRightFingerTips() const {
+  return right_finger_tips;
+}
+
+void GestureWrapper::SetMetrics(common::MetricsRegistry* metrics) {
+  calibration_.SetMetrics(metrics);
+  left_hand_tracker_.SetMetrics(metrics);
+  right_hand_tracker_.SetMetrics(metrics);
+  if (quality_controller_) {
+    quality_controller_->SetMetrics(metrics);
+  }
+  if (keypoint_detector_) {
+    keypoint_detector_->SetMetrics(metrics);
+  }
+  stage_histograms_.clear();
+  if (metrics == nullptr) {
+    frame_counter_ = dropped_frame_counter_ = nullptr;
+    fps_gauge_ = nullptr;
+    frame_interval_histogram_ = update_histogram_ = nullptr;
+    time_to_playable_gauge_ = nullptr;
+    profile_rejection_counter_ = nullptr;
+    skipped_frame_counter_ = nullptr;
+    return;
+  }
+  frame_counter_ = &metrics->GetCounter("capture.frames");
+  dropped_frame_counter_ = &metrics->GetCounter("capture.dropped_frames");
+  fps_gauge_ = &metrics->GetGauge("capture.fps");
+  frame_interval_histogram_ = &metrics->GetHistogram("capture.frame_interval");
+  update_histogram_ = &metrics->GetHistogram("gesture.update");
+  skipped_frame_counter_ = &metrics->GetCounter("gate.skipped_frames");
+  time_to_playable_gauge_ = &metrics->GetGauge("startup.time_to_playable_ms");
+  profile_rejection_counter_ = &metrics->GetCounter("profile.rejections");
+  for (const char* stage :
+       {"capture", "filter", "extraction", "tracking", "drawing"}) {
+    stage_histograms_.push_back(
+        &metrics->GetHistogram(std::string("gesture.") + stage));
+  }
+}
+
+void GestureWrapper::SetThreadPolicies(
+    common::ThreadPolicies* thread_policies) {
+  calibration_.SetThreadPolicies(thread_policies);
+  if (keypoint_detector_) {
+    keypoint_detector_->SetThreadPolicies(thread_policies);
+  }
+}
+
+void GestureWrapper::SetBus(common::SharedMemoryBusWriter* bus) {
+  bus_ = bus;
+}
+
 const std::vector<cv::Point>& GestureWrapper::Update() {
-  video_capture_ >> image;
+  int64_t previous_capture_time_ns = capture_time_ns_;
+  const std::vector<cv::Point>& click_points = ProcessFrame();
+  if (end_of_stream_) {
+    return click_points;
+  }
+  ++frames_read_;
+  if (time_to_playable_ns_ == 0) {
+    UpdateTimeToPlayable();
+  }
+  if (frame_counter_ != nullptr) {
+    RecordMetrics(previous_capture_time_ns);
+  }
+  if (frame_skipped_) {
+    ++skipped_frames_;
+    if (skipped_frame_counter_ != nullptr) {
+      skipped_frame_counter_->Increment();
+    }
+  }
+  if (quality_controller_) {
+    UpdateQuality();
+  }
+  return click_points;
+}
+
+void GestureWrapper::UpdateQuality() {
+  // Capturing mostly waits for the camera, which a lower quality would not
+  // speed up, so only the processing stages count towards the budget.
+  double processing_ms = stage_timings_.filter_ms +
+                         stage_timings_.extraction_ms +
+                         stage_timings_.tracking_ms + stage_timings_.drawing_ms;
+  if (quality_controller_->Update(processing_ms)) {
+    const QualityLevel& level = quality_controller_->GetQualityLevel();
+    calibration_.SetFilterQuality(level.filter_quality);
+    draw_debug_overlays_ = level.draw_debug_overlays;
+  }
+}
+
+void GestureWrapper::CheckProfileDrift() {
+  profile_foreground_fraction_sum_ += calibration_.GetLastForegroundFraction();
+  if (--profile_check_frames_left_ > 0) {
+    return;
+  }
+  double foreground_fraction =
+      profile_foreground_fraction_sum_ / PROFILE_CHECK_FRAMES_;
+  if (foreground_fraction <= PROFILE_MAX_FOREGROUND_FRACTION_) {
+    return;
+  }
+  // The camera has moved or the lighting has changed since the profile was
+  // saved, so its background would let too much through.
+  std::cerr << "The calibration profile does not match the scene("
+            << foreground_fraction * 100
+            << "% foreground), learning the background again" << std::endl;
+  if (profile_rejection_counter_ != nullptr) {
+    profile_rejection_counter_->Increment();
+  }
+  recognition_mode_ = false;
+  calibration_.SetBackgroundTraining(true);
+}
+
+void GestureWrapper::UpdateTimeToPlayable() {
+  if (!recognition_mode_ || profile_check_frames_left_ > 0) {
+    return;
+  }
+  time_to_playable_ns_ = common::GetTimestampNanoseconds() - startup_time_ns_;
+  frames_to_playable_ = frames_read_;
+  if (time_to_playable_gauge_ != nullptr) {
+    time_to_playable_gauge_->Set(
+        common::NanosecondsToMilliseconds(time_to_playable_ns_));
+  }
+}
+
+size_t GestureWrapper::GetQualityLevel() const {
+  return quality_controller_ ? quality_controller_->GetLevel() : 0;
+}
+
+void GestureWrapper::RecordMetrics(int64_t previous_capture_time_ns) {
+  frame_counter_->Increment();
+  const double stage_milliseconds[] = {
+      stage_timings_.capture_ms, stage_timings_.filter_ms,
+      stage_timings_.extraction_ms, stage_timings_.tracking_ms,
+      stage_timings_.drawing_ms};
+  double total_ms = 0;
+  for (size_t i = 0; i < stage_histograms_.size(); ++i) {
+    stage_histograms_[i]->Record(
+        static_cast<int64_t>(stage_milliseconds[i] * 1e6));
+    total_ms += stage_milliseconds[i];
+  }
+  update_histogram_->Record(static_cast<int64_t>(total_ms * 1e6));
+
+  if (frame_source_->CountsDroppedFrames()) {
+    uint64_t dropped_frames = frame_source_->GetDroppedFrames();
+    if (dropped_frames > source_dropped_frames_) {
+      dropped_frame_counter_->Increment(dropped_frames -
+                                        source_dropped_frames_);
+      source_dropped_frames_ = dropped_frames;
+    }
+  }
+  if (previous_capture_time_ns == 0) {
+    return;
+  }
+  int64_t frame_interval_ns = capture_time_ns_ - previous_capture_time_ns;
+  frame_interval_histogram_->Record(frame_interval_ns);
+  if (smoothed_frame_interval_ns_ == 0) {
+    smoothed_frame_interval_ns_ = static_cast<double>(frame_interval_ns);
+  } else {
+    smoothed_frame_interval_ns_ +=
+        FRAME_INTERVAL_SMOOTHING_ *
+        (frame_interval_ns - smoothed_frame_interval_ns_);
+  }
+  if (smoothed_frame_interval_ns_ > 0) {
+    fps_gauge_->Set(1e9 / smoothed_frame_interval_ns_);
+  }
+  // Video files are read as fast as we can, so they never drop frames.
+  if (!is_video_file_ && !frame_source_->CountsDroppedFrames() &&
+      source_frame_interval_ns_ > 0) {
+    // A gap of n camera frame intervals means n - 1 frames were never read.
+    int64_t missed_frames = static_cast<int64_t>(
+        std::llround(static_cast<double>(frame_interval_ns) /
+                     source_frame_interval_ns_)) - 1;
+    if (missed_frames > 0) {
+      dropped_frame_counter_->Increment(static_cast<uint64_t>(missed_frames));
+    }
+  }
+}
+
+const std::vector<cv::Point>& GestureWrapper::ProcessFrame() {
+  stage_timings_ = StageTimings();
+  frame_timestamps_ = common::FrameTimestamps();
+  merged_click_points.clear();
+  merged_onset_times_.clear();
+  if (end_of_stream_) {
+    return merged_click_points;
+  }
+  // The debug views are drawn between Updates, and count towards the frame
+  // that follows.
+  stage_timings_.drawing_ms = pending_drawing_ms_;
+  pending_drawing_ms_ = 0;
+  int64_t stage_start_ns = common::GetTimestampNanoseconds();
+  frame_timestamps_.capture_start_ns = clock_->GetTimestampNanoseconds();
+  bool frame_read = frame_source_->Read(captured_frame_);
+  capture_time_ns_ = clock_->GetTimestampNanoseconds();
+  if (!frame_read) {
+    frame_timestamps_.capture_ns = capture_time_ns_;
+    end_of_stream_ = true;
+    return merged_click_points;
+  }
+  // The device's timestamps are on the steady clock, so they can only be
+  // used when the pipeline is too.
+  if (captured_frame_.timestamp_ns_ != 0 &&
+      clock_ == &common::GetSteadyClock()) {
+    capture_time_ns_ = captured_frame_.timestamp_ns_;
+    // A frame which waited in a queued buffer was captured before it was
+    // asked for, and its wait is part of the vision stage.
+    frame_timestamps_.capture_start_ns =
+        std::min(frame_timestamps_.capture_start_ns, capture_time_ns_);
+  }
+  frame_timestamps_.capture_ns = capture_time_ns_;
 
   // We laterally invert the image.
-  cv::flip(image, image, 1);
+  FlipFrame(captured_frame_, frame_);
+  frame_size_ = GetFrameSize(frame_);
+  image_converted_ = false;
+  if (bus_ != nullptr) {
+    PublishFrame(*bus_, frame_, capture_time_ns_);
+  }
+  int64_t stage_end_ns = common::GetTimestampNanoseconds();
+  stage_timings_.capture_ms =
+      common::NanosecondsToMilliseconds(stage_end_ns - stage_start_ns);
 
-  convex_hull_image_ = image.clone();
-  combined_filter_image_ = calibration_.GetFinalFilterImage(image);
+  stage_start_ns = stage_end_ns;
+  frame_skipped_ = false;
+  if (frame_gate_) {
+    // Calibration needs every frame, so only recognition is gated.
+    if (recognition_mode_ && !calibration_.IsBackgroundTraining() &&
+        !calibration_.IsHSVCalibrating() && !auto_hsv_calibrating_ &&
+        profile_check_frames_left_ == 0) {
+      frame_skipped_ =
+          !frame_gate_->HasChanged(GetBackgroundInput(), gate_regions_);
+    } else {
+      frame_gate_->Reset();
+    }
+  }
+  // The keypoint network finds the hands in the frame itself, so once the
+  // calibration is done it needs no mask.
+  bool uses_keypoints = keypoint_detector_ && recognition_mode_ &&
+                        profile_check_frames_left_ == 0 &&
+                        !auto_hsv_calibrating_;
+  if (!frame_skipped_ && !uses_keypoints) {
+    combined_filter_image_ = calibration_.GetFinalFilterImage(frame_);
+    bool is_recording_masks = mask_recording_.is_open();
+    if (USE_RLE_MASKS_ || is_recording_masks) {
+      combined_filter_runs_.Assign(combined_filter_image_);
+    }
+    if (is_recording_masks) {
+      mask_recording_.write(reinterpret_cast<const char*>(&capture_time_ns_),
+                            sizeof(capture_time_ns_));
+      combined_filter_runs_.Write(mask_recording_);
+    }
+    if (bus_ != nullptr) {
+      if (USE_RLE_MASKS_) {
+        PublishRleMask(*bus_, combined_filter_runs_, capture_time_ns_);
+      } else {
+        PublishMask(*bus_, combined_filter_image_, capture_time_ns_);
+      }
+    }
+  }
 
-  if (calibration_.IsHSVCalibrating()) {
-    hsv_filter_image_ = calibration_.FilterImageByHSV(image);
+  if (profile_check_frames_left_ > 0) {
+    CheckProfileDrift();
   }
-  if (calibration_.IsBackgroundTraining()) {
-    background_subtracted_image_ =
-        calibration_.GetBackgroundSubtractedImage(image);
+  if (auto_hsv_calibrating_) {
+    UpdateAutoHSVCalibration();
   }
+  stage_end_ns = common::GetTimestampNanoseconds();
+  stage_timings_.filter_ms =
+      common::NanosecondsToMilliseconds(stage_end_ns - stage_start_ns);
 
   if (recognition_mode_) {
-    auto hand_pair = hand_extractor_.ExtractHands(combined_filter_image_);
+    stage_start_ns = stage_end_ns;
+    std::pair<Hand, Hand> hand_pair;
+    if (frame_skipped_) {
+      // The trackers still see one pair of hands per frame, so they hold a
+      // press for the same time whether or not frames are skipped.
+      hand_pair = last_hands_;
+      hand_pair.first.capture_time_ns_ = capture_time_ns_;
+      hand_pair.second.capture_time_ns_ = capture_time_ns_;
+    } else if (uses_keypoints) {
+      // The network runs behind the pipeline: this frame is handed to it,
+      // and the hands of the newest frame it finished are used, with the
+      // capture time of that frame. Until it finishes another one, the
+      // trackers keep seeing the last hands it found.
+      keypoint_detector_->Submit(GetBGRImage(), capture_time_ns_);
+      if (keypoint_detector_->TakeResult(last_hands_)) {
+        UpdateHandRegions();
+      }
+      hand_pair = last_hands_;
+    } else if (USE_RLE_MASKS_) {
+      hand_pair = hand_extractor_.ExtractHands(combined_filter_runs_,
+                                               capture_time_ns_);
+      last_hands_ = hand_pair;
+      UpdateHandRegions();
+    } else {
+      hand_pair = hand_extractor_.ExtractHands(combined_filter_image_,
+                                               capture_time_ns_);
+      last_hands_ = hand_pair;
+      UpdateHandRegions();
+    }
+    if (bus_ != nullptr) {
+      PublishHands(*bus_, hand_pair, capture_time_ns_);
+    }
     gesturerecognition::Hand& hand_1 = hand_pair.first;
     gesturerecognition::Hand& hand_2 = hand_pair.second;
     left_finger_tips = ConvertCoordinates(
-        hand_1.finger_tips_, image.size[0], image.size[1],
+        hand_1.finger_tips_, frame_size_.height, frame_size_.width,
         OUTPUT_WINDOW_SIZE_.height, OUTPUT_WINDOW_SIZE_.width);
     right_finger_tips = ConvertCoordinates(
-        hand_2.finger_tips_, image.size[0], image.size[1],
+        hand_2.finger_tips_, frame_size_.height, frame_size_.width,
         OUTPUT_WINDOW_SIZE_.height, OUTPUT_WINDOW_SIZE_.width);
-    ;
+    frame_timestamps_.vision_done_ns = clock_->GetTimestampNanoseconds();
+    stage_end_ns = common::GetTimestampNanoseconds();
+    stage_timings_.extraction_ms =
+        common::NanosecondsToMilliseconds(stage_end_ns - stage_start_ns);
+
+    stage_start_ns = stage_end_ns;
     // We get the left click points first and add to merge_click_points.
     merged_click_points = std::move(left_hand_tracker_.FindClickPoints(hand_1));
 
@@ -130,44 +729,75 @@ const std::vector<cv::Point>& GestureWrapper::Update() {
     merged_click_points.insert(merged_click_points.end(),
                                std::make_move_iterator(right_click_pts.begin()),
                                std::make_move_iterator(right_click_pts.end()));
+    // Every point gets the onset of its hand's last batch, which is when the
+    // points that batch clicked were first pressed, or the time a predicted
+    // press fired.
+    merged_onset_times_ = left_hand_tracker_.GetClickOnsetTimes();
+    const std::vector<int64_t>& right_onset_times =
+        right_hand_tracker_.GetClickOnsetTimes();
+    merged_onset_times_.insert(merged_onset_times_.end(),
+                               right_onset_times.begin(),
+                               right_onset_times.end());
+    frame_timestamps_.tracking_done_ns = clock_->GetTimestampNanoseconds();
+    stage_end_ns = common::GetTimestampNanoseconds();
+    stage_timings_.tracking_ms =
+        common::NanosecondsToMilliseconds(stage_end_ns - stage_start_ns);
 
-    for (size_t i = 0; i < hand_1.finger_tips_.size(); ++i) {
-      // We iterate through each finger tip and draw them on the convex hull
-      // image
-      circle(convex_hull_image_, hand_1.finger_tips_.at(i),
-             FINGER_TIP_CIRCLE_RADIUS_, COLOR_1, FINGER_TIP_CIRCLE_THICKNESS_,
-             LINE_TYPE_);
-      putText(convex_hull_image_, std::to_string(i),
-              cv::Point(hand_1.finger_tips_.at(i).x,
-                        hand_1.finger_tips_.at(i).y + 20),
-              cv::FONT_HERSHEY_SIMPLEX, 1, COLOR_1, cv::LINE_8, false);
-      line(convex_hull_image_, hand_1.finger_tips_[i], hand_1.center_of_palm_,
-           COLOR_1, FINGER_TIP_CIRCLE_THICKNESS_ / 3, LINE_TYPE_);
-    }
-    for (size_t i = 0; i < hand_2.finger_tips_.size(); ++i) {
-      // We iterate through each finger tip and draw them on the convex hull
-      // image
-      circle(convex_hull_image_, hand_2.finger_tips_.at(i),
-             FINGER_TIP_CIRCLE_RADIUS_, COLOR_2, FINGER_TIP_CIRCLE_THICKNESS_,
-             LINE_TYPE_);
-      putText(convex_hull_image_, std::to_string(i),
-              cv::Point(hand_2.finger_tips_.at(i).x,
-                        hand_2.finger_tips_.at(i).y + 20),
-              cv::FONT_HERSHEY_SIMPLEX, 1, COLOR_2, cv::LINE_8, false);
-      line(convex_hull_image_, hand_2.finger_tips_[i], hand_2.center_of_palm_,
-           COLOR_2, FINGER_TIP_CIRCLE_THICKNESS_ / 3, LINE_TYPE_);
-    }
 
     // We translate the click points to the desired coordinate system and return
     // them
     merged_click_points = ConvertCoordinates(
-        merged_click_points, image.size[0], image.size[1],
+        merged_click_points, frame_size_.height, frame_size_.width,
         OUTPUT_WINDOW_SIZE_.height, OUTPUT_WINDOW_SIZE_.width);
     return merged_click_points;
   }
-  // Merging the two arrays into one.
-  merged_click_points.clear();
+  last_hands_ = std::pair<Hand, Hand>();
+  UpdateHandRegions();
   return merged_click_points;
 }
 
+void GestureWrapper::UpdateHandRegions() {
+  const cv::Rect& left_box = last_hands_.first.bounding_box_;
+  const cv::Rect& right_box = last_hands_.second.bounding_box_;
+  calibration_.SetHandRegions({left_box, right_box});
+  gate_regions_.clear();
+  // A hand that was not found could appear anywhere, so then the gate
+  // compares whole frames.
+  if (left_box.area() > 0 && right_box.area() > 0) {
+    gate_regions_.push_back(left_box);
+    gate_regions_.push_back(right_box);
+  }
+}
+
+const cv::Mat& GestureWrapper::GetBGRImage() {
+  if (!image_converted_) {
+    image = ConvertToBGR(frame_);
+    image_converted_ = true;
+  }
+  return image;
+}
+
+cv::Mat GestureWrapper::GetBackgroundInput() const {
+  if (frame_.format_ == PixelFormat::BGR) {
+    return frame_.data_;
+  }
+  return GetLuma(frame_);
+}
+
+void GestureWrapper::DrawHandFeatures(cv::Mat& image, const Hand& hand,
+                                      const cv::Scalar& color) {
+  for (size_t i = 0; i < hand.finger_tips_.size(); ++i) {
+    // We iterate through each finger tip and draw them on the convex hull
+    // image
+    circle(image, hand.finger_tips_.at(i), FINGER_TIP_CIRCLE_RADIUS_, color,
+           FINGER_TIP_CIRCLE_THICKNESS_, LINE_TYPE_);
+    putText(image, std::to_string(i),
+            cv::Point(hand.finger_tips_.at(i).x,
+                      hand.finger_tips_.at(i).y + 20),
+            cv::FONT_HERSHEY_SIMPLEX, 1, color, cv::LINE_8, false);
+    line(image, hand.finger_tips_[i], hand.center_of_palm_, color,
+         FINGER_TIP_CIRCLE_THICKNESS_ / 3, LINE_TYPE_);
+  }
+}
+
 }  // namespace gesturerecognition
\ No newline at end of file
@@ -4,9 +4,34 @@
 
 #include "gesturerecognition/hand_extractor.h"
 
+#include <algorithm>
+#include <stdexcept>
+
 namespace gesturerecognition {
 
-HandExtractor::HandExtractor() {
+FingerTipDetector ParseFingerTipDetector(const std::string& name) {
+  if (name == "convexity_defects") {
+    return FingerTipDetector::CONVEXITY_DEFECTS;
+  }
+  if (name == "column_profile") {
+    return FingerTipDetector::COLUMN_PROFILE;
+  }
+  throw std::invalid_argument("Unknown finger tip detector " + name);
+}
+
+HandExtractor::HandExtractor(FingerTipDetector detector,
+                             const HandExtractorSettings& settings)
+    : detector_(detector),
+      MAX_ANGLE_BETWEEN_FINGERS_(settings.max_angle_between_fingers),
+      LOWEST_FINGER_RATIO(settings.lowest_finger_ratio),
+      MIN_HAND_SIZE(settings.min_hand_size),
+      MIN_FINGER_PROMINENCE_RATIO(settings.min_finger_prominence_ratio),
+      MAX_FINGER_WIDTH_RATIO(settings.max_finger_width_ratio),
+      MIN_FINGER_WIDTH_RATIO(settings.min_finger_width_ratio) {
+  if (LOWEST_FINGER_RATIO <= 0 || MIN_FINGER_PROMINENCE_RATIO <= 0 ||
+      MAX_FINGER_WIDTH_RATIO <= 0 || MIN_FINGER_WIDTH_RATIO <= 0) {
+    throw std::invalid_argument("Invalid hand extractor settings!");
+  }
 }
 
 std::pair<int, int> HandExtractor::Find2LargestContours(
@@ -43,19 +68,45 @@ std::pair<int, int> HandExtractor::Find2LargestContours(
   return std::make_pair(max_1_index, max_2_index);
 }
 
-std::pair<Hand, Hand> HandExtractor::ExtractHands(const cv::Mat& input_image) {
+std::pair<Hand, Hand> HandExtractor::ExtractHands(const cv::Mat& input_image,
+                                                  int64_t capture_time_ns) {
+  if (detector_ == FingerTipDetector::COLUMN_PROFILE) {
+    return ExtractHandsByColumnProfile(input_image, capture_time_ns);
+  }
+  std::vector<std::vector<cv::Point>> contours;
+  try {
+    // Cloning the image as findContours will change it
+    cv::findContours(input_image.clone(), contours, cv::RETR_EXTERNAL,
+                     cv::CHAIN_APPROX_SIMPLE);
+  } catch (cv::Exception& e) {
+    Hand hand;
+    hand.capture_time_ns_ = capture_time_ns;
+    return std::make_pair(hand, hand);
+  }
+  return ExtractHandsFromContours(contours, capture_time_ns);
+}
+
+std::pair<Hand, Hand> HandExtractor::ExtractHands(const RleMask& mask,
+                                                  int64_t capture_time_ns) {
+  if (detector_ == FingerTipDetector::COLUMN_PROFILE) {
+    mask.ToMat(decoded_mask_);
+    return ExtractHandsByColumnProfile(decoded_mask_, capture_time_ns);
+  }
+  // Only the two largest blobs can be hands, so the others are not traced.
+  return ExtractHandsFromContours(mask.FindOuterContours(2), capture_time_ns);
+}
+
+std::pair<Hand, Hand> HandExtractor::ExtractHandsFromContours(
+    const std::vector<std::vector<cv::Point>>& contours,
+    int64_t capture_time_ns) {
   using namespace cv;
-  Mat clone = input_image.clone(); /*Cloning the image as findContours will
-                                    change it*/
-  std::vector<std::vector<Point>> contours;
   try {
-    findContours(input_image.clone(), contours, RETR_EXTERNAL,
-                 CHAIN_APPROX_SIMPLE);
     std::pair<int, int> max_contour_indices = Find2LargestContours(contours);
 
     if (max_contour_indices.first == ERROR_NUMBER) {
       // Returning a default hand object if there is no contour.
       Hand hand;
+      hand.capture_time_ns_ = capture_time_ns;
       return std::make_pair(hand, hand);
     }
 
@@ -63,6 +114,10 @@ std::pair<Hand, Hand> HandExtractor::ExtractHands(const cv::Mat& input_image) {
     std::vector<cv::Point> contour_2 = contours[max_contour_indices.second];
     Hand hand_1(FindHandFeatures(contour_1));
     Hand hand_2(FindHandFeatures(contour_2));
+    hand_1.capture_time_ns_ = capture_time_ns;
+    hand_2.capture_time_ns_ = capture_time_ns;
+    hand_1.bounding_box_ = boundingRect(contour_1);
+    hand_2.bounding_box_ = boundingRect(contour_2);
     if (hand_1.center_of_palm_.x > hand_2.center_of_palm_.x) {
       // We make sure to return left hand as 1st element in pair, and right as
       // 2nd
@@ -71,8 +126,103 @@ std::pair<Hand, Hand> HandExtractor::ExtractHands(const cv::Mat& input_image) {
     return std::make_pair(hand_1, hand_2);
   } catch (cv::Exception& e) {
     Hand hand;
+    hand.capture_time_ns_ = capture_time_ns;
+    return std::make_pair(hand, hand);
+  }
+}
+
+std::pair<Hand, Hand> HandExtractor::ExtractHandsByColumnProfile(
+    const cv::Mat& input_image, int64_t capture_time_ns) {
+  Hand hands[2];
+  hands[0].capture_time_ns_ = capture_time_ns;
+  hands[1].capture_time_ns_ = capture_time_ns;
+  try {
+    int number_of_labels = cv::connectedComponentsWithStats(
+        input_image, labels_, stats_, centroids_, 8, CV_32S);
+    // Label 0 is the background.
+    int largest_label = ERROR_NUMBER;
+    int second_largest_label = ERROR_NUMBER;
+    for (int label = 1; label < number_of_labels; ++label) {
+      int area = stats_.at<int>(label, cv::CC_STAT_AREA);
+      if (largest_label == ERROR_NUMBER ||
+          area > stats_.at<int>(largest_label, cv::CC_STAT_AREA)) {
+        second_largest_label = largest_label;
+        largest_label = label;
+      } else if (second_largest_label == ERROR_NUMBER ||
+                 area > stats_.at<int>(second_largest_label,
+                                       cv::CC_STAT_AREA)) {
+        second_largest_label = label;
+      }
+    }
+    if (largest_label == ERROR_NUMBER) {
+      return std::make_pair(hands[0], hands[1]);
+    }
+    if (second_largest_label == ERROR_NUMBER) {
+      // Like with the contours, a single blob is taken for both hands.
+      second_largest_label = largest_label;
+    }
+
+    int labels[] = {largest_label, second_largest_label};
+    for (int i = 0; i < 2; ++i) {
+      cv::Rect bounding_box(stats_.at<int>(labels[i], cv::CC_STAT_LEFT),
+                            stats_.at<int>(labels[i], cv::CC_STAT_TOP),
+                            stats_.at<int>(labels[i], cv::CC_STAT_WIDTH),
+                            stats_.at<int>(labels[i], cv::CC_STAT_HEIGHT));
+      hands[i].bounding_box_ = bounding_box;
+      hands[i].center_of_palm_ = FindCenterOfRectangle(bounding_box);
+      if (stats_.at<int>(labels[i], cv::CC_STAT_AREA) > MIN_HAND_SIZE) {
+        hands[i].finger_tips_ =
+            FindColumnProfileFingerTips(labels[i], bounding_box);
+      }
+    }
+  } catch (cv::Exception& e) {
+    Hand hand;
+    hand.capture_time_ns_ = capture_time_ns;
     return std::make_pair(hand, hand);
   }
+  if (hands[0].center_of_palm_.x > hands[1].center_of_palm_.x) {
+    return std::make_pair(hands[1], hands[0]);
+  }
+  return std::make_pair(hands[0], hands[1]);
+}
+
+std::vector<cv::Point> HandExtractor::FindColumnProfileFingerTips(
+    int label, const cv::Rect& bounding_box) {
+  // How far the topmost pixel of the hand in each column is above the bottom
+  // of its bounding box. A connected component has a pixel in every column of
+  // its bounding box, so each one is found.
+  column_heights_.assign(bounding_box.width, 0);
+  int columns_left = bounding_box.width;
+  for (int row = bounding_box.y;
+       row < bounding_box.y + bounding_box.height && columns_left > 0; ++row) {
+    const int* row_labels = labels_.ptr<int>(row) + bounding_box.x;
+    for (int column = 0; column < bounding_box.width; ++column) {
+      if (column_heights_[column] == 0 && row_labels[column] == label) {
+        column_heights_[column] = bounding_box.y + bounding_box.height - row;
+        --columns_left;
+      }
+    }
+  }
+
+  std::vector<ProfilePeak> peaks = FindProfilePeaks(
+      column_heights_,
+      std::max(1, bounding_box.height / MIN_FINGER_PROMINENCE_RATIO),
+      std::max(2, bounding_box.width / MIN_FINGER_WIDTH_RATIO),
+      bounding_box.width / MAX_FINGER_WIDTH_RATIO);
+  // Like with the convexity defects, tips too far down are not fingers.
+  int lowest_y_coordinate_of_finger =
+      FindCenterOfRectangle(bounding_box).y +
+      bounding_box.height / LOWEST_FINGER_RATIO;
+  std::vector<cv::Point> finger_tips;
+  for (const ProfilePeak& peak : peaks) {
+    cv::Point finger_tip(bounding_box.x + peak.position,
+                         bounding_box.y + bounding_box.height -
+                             column_heights_[peak.position]);
+    if (finger_tip.y <= lowest_y_coordinate_of_finger) {
+      finger_tips.push_back(finger_tip);
+    }
+  }
+  return finger_tips;
 }
 
 std::pair<std::vector<cv::Point>, cv::Point> HandExtractor::FindHandFeatures(
@@ -162,7 +312,7 @@ std::vector<cv::Point> HandExtractor::FindFingerDefects(
     std::vector<cv::Point> contour) {
   std::vector<cv::Point> finger_tips;
   int number_of_fingers = 0;
-  for (int i = 0; i < convexity_defects.size(); ++i) {
+  for (size_t i = 0; i < convexity_defects.size(); ++i) {
     /*The start point and end points are the fingertips of the two fingers that
       make up a convexity defect. The far point is the middle point in the
       convexity defect. The end point of one convexity defect is the start
@@ -183,4 +333,66 @@ std::vector<cv::Point> HandExtractor::FindFingerDefects(
   return finger_tips;
 }
 
+std::vector<ProfilePeak> FindProfilePeaks(const std::vector<int>& profile,
+                                          int min_prominence, int min_width,
+                                          int max_width) {
+  const int size = static_cast<int>(profile.size());
+  std::vector<ProfilePeak> peaks;
+  int start = 0;
+  while (start < size) {
+    // A peak's top may be flat, so it is the run of equal values from start
+    // to end.
+    int end = start;
+    while (end + 1 < size && profile[end + 1] == profile[start]) {
+      ++end;
+    }
+    int height = profile[start];
+    bool is_peak = (start == 0 || profile[start - 1] < height) &&
+                   (end == size - 1 || profile[end + 1] < height);
+    if (is_peak) {
+      // Its bases are the lowest points on either side before the profile
+      // rises above it again. They are only looked for within max_width, so
+      // that a finger standing on the palm is measured from the palm rather
+      // than from the edges of the hand.
+      int bases[2];
+      for (int side = 0; side < 2; ++side) {
+        int step = side == 0 ? -1 : 1;
+        int base = height;
+        int column = side == 0 ? start - 1 : end + 1;
+        for (int distance = 0; distance < max_width; ++distance) {
+          if (column < 0 || column >= size) {
+            base = 0;  // Beyond the profile there is nothing
+            break;
+          }
+          if (profile[column] > height) {
+            break;
+          }
+          base = std::min(base, profile[column]);
+          column += step;
+        }
+        bases[side] = base;
+      }
+      int prominence = height - std::max(bases[0], bases[1]);
+      if (prominence >= min_prominence) {
+        // Its width is measured halfway between its top and its higher base.
+        double level = height - prominence / 2.0;
+        int left = start;
+        while (left > 0 && profile[left - 1] > level) {
+          --left;
+        }
+        int right = end;
+        while (right < size - 1 && profile[right + 1] > level) {
+          ++right;
+        }
+        int width = right - left + 1;
+        if (width >= min_width && width <= max_width) {
+          peaks.push_back({(start + end) / 2, prominence, width});
+        }
+      }
+    }
+    start = end + 1;
+  }
+  return peaks;
+}
+
 }  // namespace gesturerecognition
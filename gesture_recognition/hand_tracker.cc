@@ -4,8 +4,18 @@
 #include "gesturerecognition/hand_tracker.h"
 
 namespace gesturerecognition {
-HandTracker::HandTracker(size_t number_of_frames)
-    : number_of_frames_(number_of_frames), previous_batch_hand() {
+HandTracker::HandTracker(size_t number_of_frames,
+                         int max_change_in_finger_position)
+    : number_of_frames_(number_of_frames),
+      previous_batch_hand(),
+      last_finger_count_(ERROR_NUMBER),
+      last_finger_count_onset_ns_(0),
+      last_batch_onset_ns_(0),
+      MAX_CHANGE_IN_FINGER_POSITION_(max_change_in_finger_position),
+      metrics_(nullptr),
+      batch_counter_(nullptr),
+      click_counter_(nullptr),
+      unclick_counter_(nullptr) {
 }
 
 bool ComparePoints(cv::Point point_1, cv::Point point_2) {
@@ -13,16 +23,79 @@ bool ComparePoints(cv::Point point_1, cv::Point point_2) {
 }
 
 std::vector<cv::Point> HandTracker::FindClickPoints(const Hand& hand) {
+  if (hand.getNumberOfFingers() != last_finger_count_) {
+    last_finger_count_ = hand.getNumberOfFingers();
+    last_finger_count_onset_ns_ = hand.capture_time_ns_;
+  }
   hands.push_back(hand);
+  finger_count_onset_times_.push_back(last_finger_count_onset_ns_);
   if (hands.size() == number_of_frames_) {
     size_t frequent_number_of_fingers = FindMostFrequentFingerNumber(hands);
-    current_batch_hand =
-        hands[GetLatestReferenceFrame(hands, frequent_number_of_fingers)];
+    int reference_frame =
+        GetLatestReferenceFrame(hands, frequent_number_of_fingers);
+    current_batch_hand = hands[reference_frame];
+    last_batch_onset_ns_ = finger_count_onset_times_[reference_frame];
+    size_t previous_number_of_clicks = click_points.size();
     AnalyseHand(MAX_CHANGE_IN_FINGER_POSITION_);
+    if (batch_counter_ != nullptr) {
+      batch_counter_->Increment();
+      if (click_points.size() > previous_number_of_clicks) {
+        click_counter_->Increment(click_points.size() -
+                                  previous_number_of_clicks);
+      } else {
+        unclick_counter_->Increment(previous_number_of_clicks -
+                                    click_points.size());
+      }
+    }
     previous_batch_hand = current_batch_hand;
     hands.clear();
+    finger_count_onset_times_.clear();
+  }
+  if (!predictor_) {
+    click_onset_times_.assign(click_points.size(), last_batch_onset_ns_);
+    return click_points;
+  }
+  std::vector<cv::Point> points;
+  predictor_->Update(hand, click_points, last_batch_onset_ns_, points,
+                     click_onset_times_);
+  return points;
+}
+
+void HandTracker::SetPredictiveOnset(const PredictiveOnsetSettings& settings) {
+  predictor_.reset(
+      new FingerPredictor(settings, MAX_CHANGE_IN_FINGER_POSITION_));
+  predictor_->SetMetrics(metrics_);
+}
+
+const std::vector<int64_t>& HandTracker::GetClickOnsetTimes() const {
+  return click_onset_times_;
+}
+
+int64_t HandTracker::GetLastBatchOnsetTime() const {
+  return last_batch_onset_ns_;
+}
+
+size_t HandTracker::GetHeldHandCount() const {
+  return hands.size();
+}
+
+size_t HandTracker::GetClickPointCount() const {
+  return click_points.size() +
+         (predictor_ ? predictor_->GetPendingPressCount() : 0);
+}
+
+void HandTracker::SetMetrics(common::MetricsRegistry* metrics) {
+  metrics_ = metrics;
+  if (predictor_) {
+    predictor_->SetMetrics(metrics);
+  }
+  if (metrics == nullptr) {
+    batch_counter_ = click_counter_ = unclick_counter_ = nullptr;
+    return;
   }
-  return click_points;
+  batch_counter_ = &metrics->GetCounter("tracker.batches");
+  click_counter_ = &metrics->GetCounter("tracker.clicks");
+  unclick_counter_ = &metrics->GetCounter("tracker.unclicks");
 }
 
 void HandTracker::UpdatePoints(
@@ -54,9 +127,10 @@ void HandTracker::UnclickFingers(
   int points_unclicked = 0;
 
   for (int current_hand_finger_index = 0;
-       current_hand_finger_index < current_finger_tips.size();
+       current_hand_finger_index < static_cast<int>(current_finger_tips.size());
        ++current_hand_finger_index) {
-    if (previous_hand_finger_index >= previous_finger_tips.size()) {
+    if (previous_hand_finger_index >=
+        static_cast<int>(previous_finger_tips.size())) {
       // This means the right-most finger in the previous hand was unclicked.
       auto point_to_remove = current_finger_tips.at(current_hand_finger_index);
       int index_to_remove =
@@ -84,7 +158,7 @@ void HandTracker::UnclickFingers(
         // previous and current batch hands
         --previous_hand_finger_index;
       }
-      if (points_unclicked == size_difference) {
+      if (static_cast<size_t>(points_unclicked) == size_difference) {
         // Once we've unclicked the necessary amount of points, we can
         // break the loop
         break;
@@ -101,9 +175,11 @@ void HandTracker::ClickFingers(
   int points_clicked = 0;
   int current_hand_finger_index = 0;
   for (int previous_hand_finger_index = 0;
-       previous_hand_finger_index < previous_finger_tips.size();
+       previous_hand_finger_index <
+       static_cast<int>(previous_finger_tips.size());
        ++previous_hand_finger_index) {
-    if (current_hand_finger_index >= current_finger_tips.size()) {
+    if (current_hand_finger_index >=
+        static_cast<int>(current_finger_tips.size())) {
       // This means the right-most finger in the previous hand was pressed.
       auto point_to_click = previous_finger_tips.at(previous_hand_finger_index);
       click_points.push_back(point_to_click);
@@ -122,7 +198,7 @@ void HandTracker::ClickFingers(
       // current fingertips, so that we compare the same type of fingers in
       // previous and current batch hands
       --current_hand_finger_index;
-      if (points_clicked == (size_difference)) {
+      if (static_cast<size_t>(points_clicked) == size_difference) {
         // Once we've pressed the necessary amount of points, we can
         // break the loop
         break;
@@ -0,0 +1,168 @@
+#include "gesturerecognition/hsv_estimator.h"
+
+#include <stdexcept>
+
+namespace gesturerecognition {
+
+const int HSVEstimator::HUE_BINS;
+const int HSVEstimator::SATURATION_BINS;
+const int HSVEstimator::VALUE_BINS;
+
+namespace {
+const int HUE_LIMIT = 180;
+const int SATURATION_VALUE_LIMIT = 256;
+// The boxes, as fractions of the frame. The frames are mirrored, so the left
+// box is where the user sees their left hand.
+const float BOX_LEFT_X[] = {0.1f, 0.6f};
+const float BOX_WIDTH = 0.3f;
+const float BOX_TOP_Y = 0.4f;
+const float BOX_HEIGHT = 0.5f;
+
+/**
+ * Returns the first and the last bin of the smallest range which leaves out
+ * at most (1 - coverage) / 2 of the counts at each end.
+ */
+std::pair<int, int> FindCoveredBins(const std::vector<double>& counts,
+                                    double coverage) {
+  double total = 0;
+  for (double count : counts) {
+    total += count;
+  }
+  double tail = total * (1 - coverage) / 2;
+  int first = 0;
+  double skipped = 0;
+  while (first + 1 < static_cast<int>(counts.size()) &&
+         skipped + counts[first] <= tail) {
+    skipped += counts[first++];
+  }
+  int last = static_cast<int>(counts.size()) - 1;
+  skipped = 0;
+  while (last > first && skipped + counts[last] <= tail) {
+    skipped += counts[last--];
+  }
+  return std::make_pair(first, last);
+}
+}  // namespace
+
+HSVEstimator::HSVEstimator(double hand_coverage)
+    : hand_coverage_(hand_coverage), frames_added_(0) {
+  if (hand_coverage <= 0 || hand_coverage > 1) {
+    throw std::invalid_argument("The hand coverage must be in (0, 1]!");
+  }
+  Reset();
+}
+
+std::vector<cv::Rect> HSVEstimator::GetHandBoxes(const cv::Size& frame_size) {
+  std::vector<cv::Rect> boxes;
+  for (float left_x : BOX_LEFT_X) {
+    boxes.push_back(cv::Rect(static_cast<int>(left_x * frame_size.width),
+                             static_cast<int>(BOX_TOP_Y * frame_size.height),
+                             static_cast<int>(BOX_WIDTH * frame_size.width),
+                             static_cast<int>(BOX_HEIGHT * frame_size.height)));
+  }
+  return boxes;
+}
+
+void HSVEstimator::AddFrame(const cv::Mat& input_image) {
+  cv::Mat frame_hsv;
+  cv::cvtColor(input_image, frame_hsv, cv::COLOR_BGR2HSV);
+  cv::Mat hand_mask = cv::Mat::zeros(input_image.size(), CV_8UC1);
+  for (const cv::Rect& box : GetHandBoxes(input_image.size())) {
+    hand_mask(box).setTo(255);
+  }
+  cv::Mat background_mask;
+  cv::bitwise_not(hand_mask, background_mask);
+
+  const int channels[] = {0, 1, 2};
+  const int histogram_sizes[] = {HUE_BINS, SATURATION_BINS, VALUE_BINS};
+  const float hue_range[] = {0, HUE_LIMIT};
+  const float saturation_value_range[] = {0, SATURATION_VALUE_LIMIT};
+  const float* ranges[] = {hue_range, saturation_value_range,
+                           saturation_value_range};
+  cv::calcHist(&frame_hsv, 1, channels, hand_mask, hand_histogram_, 3,
+               histogram_sizes, ranges, true, true);
+  cv::calcHist(&frame_hsv, 1, channels, background_mask,
+               background_histogram_, 2, histogram_sizes, ranges, true, true);
+  ++frames_added_;
+}
+
+bool HSVEstimator::EstimateRange(cv::Scalar& low, cv::Scalar& high) const {
+  if (frames_added_ == 0) {
+    return false;
+  }
+  std::vector<double> hand_counts(HUE_BINS * SATURATION_BINS, 0);
+  double hand_total = 0;
+  double background_total = 0;
+  for (int hue = 0; hue < HUE_BINS; ++hue) {
+    for (int saturation = 0; saturation < SATURATION_BINS; ++saturation) {
+      const float* values = hand_histogram_.ptr<float>(hue, saturation);
+      for (int value = 0; value < VALUE_BINS; ++value) {
+        hand_counts[hue * SATURATION_BINS + saturation] += values[value];
+      }
+      hand_total += hand_counts[hue * SATURATION_BINS + saturation];
+      background_total +=
+          background_histogram_.at<float>(hue, saturation);
+    }
+  }
+  if (hand_total == 0) {
+    return false;
+  }
+
+  // The boxes also hold some background around the hands, but its colors
+  // are more common outside the boxes, so they are left out here.
+  std::vector<double> hue_counts(HUE_BINS, 0);
+  std::vector<double> saturation_counts(SATURATION_BINS, 0);
+  std::vector<double> value_counts(VALUE_BINS, 0);
+  for (int hue = 0; hue < HUE_BINS; ++hue) {
+    for (int saturation = 0; saturation < SATURATION_BINS; ++saturation) {
+      double hand_count = hand_counts[hue * SATURATION_BINS + saturation];
+      double background_fraction =
+          background_total > 0
+              ? background_histogram_.at<float>(hue, saturation) /
+                    background_total
+              : 0;
+      if (hand_count == 0 || hand_count / hand_total <= background_fraction) {
+        continue;
+      }
+      hue_counts[hue] += hand_count;
+      saturation_counts[saturation] += hand_count;
+      const float* values = hand_histogram_.ptr<float>(hue, saturation);
+      for (int value = 0; value < VALUE_BINS; ++value) {
+        value_counts[value] += values[value];
+      }
+    }
+  }
+  std::pair<int, int> hue_bins = FindCoveredBins(hue_counts, hand_coverage_);
+  if (hue_counts[hue_bins.first] == 0) {
+    return false;
+  }
+  std::pair<int, int> saturation_bins =
+      FindCoveredBins(saturation_counts, hand_coverage_);
+  std::pair<int, int> value_bins =
+      FindCoveredBins(value_counts, hand_coverage_);
+
+  const int hue_bin_width = HUE_LIMIT / HUE_BINS;
+  const int saturation_bin_width = SATURATION_VALUE_LIMIT / SATURATION_BINS;
+  const int value_bin_width = SATURATION_VALUE_LIMIT / VALUE_BINS;
+  low = cv::Scalar(hue_bins.first * hue_bin_width,
+                   saturation_bins.first * saturation_bin_width,
+                   value_bins.first * value_bin_width);
+  high = cv::Scalar((hue_bins.second + 1) * hue_bin_width - 1,
+                    (saturation_bins.second + 1) * saturation_bin_width - 1,
+                    (value_bins.second + 1) * value_bin_width - 1);
+  return true;
+}
+
+void HSVEstimator::Reset() {
+  const int histogram_sizes[] = {HUE_BINS, SATURATION_BINS, VALUE_BINS};
+  hand_histogram_.create(3, histogram_sizes, CV_32F);
+  hand_histogram_.setTo(0);
+  background_histogram_.create(2, histogram_sizes, CV_32F);
+  background_histogram_.setTo(0);
+  frames_added_ = 0;
+}
+
+size_t HSVEstimator::GetFramesAdded() const {
+  return frames_added_;
+}
+}  // namespace gesturerecognition
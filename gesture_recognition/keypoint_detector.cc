@@ -0,0 +1,291 @@
+#include "gesturerecognition/keypoint_detector.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "common/clock.h"
+
+namespace gesturerecognition {
+
+namespace {
+const int HAND_KEYPOINTS = 21;
+const int FINGER_TIP_KEYPOINTS[] = {4, 8, 12, 16, 20};
+// The wrist and the base of every finger, whose mean is the palm's center.
+const int PALM_KEYPOINTS[] = {0, 1, 5, 9, 13, 17};
+
+cv::dnn::Net LoadNetwork(const KeypointModelSettings& settings) {
+  const std::string& file_name = settings.GetModelFile();
+  if (file_name.empty()) {
+    throw std::invalid_argument(settings.use_int8
+                                    ? "No int8 keypoint model file was given"
+                                    : "No keypoint model file was given");
+  }
+  cv::dnn::Net net;
+  try {
+    net = cv::dnn::readNet(file_name);
+  } catch (cv::Exception& e) {
+    throw std::runtime_error("Could not load the keypoint model " + file_name +
+                             ": " + e.what());
+  }
+  if (net.empty()) {
+    throw std::runtime_error("Could not load the keypoint model " + file_name);
+  }
+  net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+  net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+  return net;
+}
+}  // namespace
+
+const std::string& KeypointModelSettings::GetModelFile() const {
+  return use_int8 ? int8_model_file : model_file;
+}
+
+KeypointDetector::KeypointDetector(const KeypointModelSettings& settings)
+    : settings_(settings), net_(LoadNetwork(settings)) {
+}
+
+std::vector<Hand> KeypointDetector::Detect(const cv::Mat& frame,
+                                           const std::vector<cv::Rect>& regions,
+                                           int64_t capture_time_ns) {
+  std::vector<Hand> hands(regions.size());
+  std::vector<size_t> cropped_hands;  // The hand each crop is of
+  std::vector<cv::Rect> crop_regions;
+  crops_.clear();
+  const cv::Rect frame_region(0, 0, frame.cols, frame.rows);
+  for (size_t i = 0; i < regions.size(); ++i) {
+    hands[i].capture_time_ns_ = capture_time_ns;
+    cv::Rect region = regions[i] & frame_region;
+    if (region.area() > 0) {
+      crops_.push_back(frame(region));
+      cropped_hands.push_back(i);
+      crop_regions.push_back(region);
+    }
+  }
+  if (crops_.empty()) {
+    return hands;
+  }
+
+  // Every crop goes through the network in a single batch.
+  input_blob_ = cv::dnn::blobFromImages(crops_, settings_.input_scale,
+                                        settings_.input_size, cv::Scalar(),
+                                        settings_.swap_red_blue, false);
+  net_.setInput(input_blob_);
+  cv::Mat heatmaps = net_.forward();
+  if (heatmaps.dims != 4 ||
+      heatmaps.size[0] != static_cast<int>(crops_.size()) ||
+      heatmaps.size[1] < HAND_KEYPOINTS || heatmaps.type() != CV_32F) {
+    throw std::runtime_error(
+        "The keypoint model must output 21 float heatmaps per crop");
+  }
+  cv::Size heatmap_size(heatmaps.size[3], heatmaps.size[2]);
+  for (size_t i = 0; i < crops_.size(); ++i) {
+    Hand hand = DecodeHand(heatmaps.ptr<float>(static_cast<int>(i)),
+                           heatmap_size, crop_regions[i]);
+    hand.capture_time_ns_ = capture_time_ns;
+    hands[cropped_hands[i]] = hand;
+  }
+  return hands;
+}
+
+std::vector<cv::Rect> KeypointDetector::FindRegions(
+    const std::vector<Hand>& last_hands, const cv::Size& frame_size,
+    double margin) {
+  const cv::Rect frame_region(cv::Point(0, 0), frame_size);
+  std::vector<cv::Rect> regions;
+  for (size_t i = 0; i < 2; ++i) {
+    const cv::Rect* box =
+        i < last_hands.size() ? &last_hands[i].bounding_box_ : nullptr;
+    if (box == nullptr || box->area() == 0) {
+      regions.push_back(cv::Rect(i == 0 ? 0 : frame_size.width / 2, 0,
+                                 frame_size.width / 2, frame_size.height));
+      continue;
+    }
+    int side = static_cast<int>(std::max(box->width, box->height) *
+                                (1 + 2 * margin));
+    cv::Rect region(box->x + box->width / 2 - side / 2,
+                    box->y + box->height / 2 - side / 2, side, side);
+    regions.push_back(region & frame_region);
+  }
+  return regions;
+}
+
+const KeypointModelSettings& KeypointDetector::GetSettings() const {
+  return settings_;
+}
+
+Hand KeypointDetector::DecodeHand(const float* heatmaps,
+                                  const cv::Size& heatmap_size,
+                                  const cv::Rect& region) const {
+  // Where each keypoint is in the frame, and whether it was seen.
+  cv::Point keypoints[HAND_KEYPOINTS];
+  bool is_visible[HAND_KEYPOINTS];
+  std::vector<cv::Point> visible_keypoints;
+  const double scale_x = static_cast<double>(region.width) / heatmap_size.width;
+  const double scale_y =
+      static_cast<double>(region.height) / heatmap_size.height;
+  for (int keypoint = 0; keypoint < HAND_KEYPOINTS; ++keypoint) {
+    // OpenCV only reads the heatmap here, despite the non const pointer.
+    cv::Mat heatmap(heatmap_size, CV_32F,
+                    const_cast<float*>(heatmaps) +
+                        keypoint * heatmap_size.area());
+    double confidence;
+    cv::Point peak;
+    cv::minMaxLoc(heatmap, nullptr, &confidence, nullptr, &peak);
+    keypoints[keypoint] =
+        cv::Point(region.x + static_cast<int>((peak.x + 0.5) * scale_x),
+                  region.y + static_cast<int>((peak.y + 0.5) * scale_y));
+    is_visible[keypoint] = confidence >= settings_.confidence_threshold;
+    if (is_visible[keypoint]) {
+      visible_keypoints.push_back(keypoints[keypoint]);
+    }
+  }
+
+  Hand hand;
+  cv::Point palm_sum(0, 0);
+  int palm_points = 0;
+  for (int keypoint : PALM_KEYPOINTS) {
+    if (is_visible[keypoint]) {
+      palm_sum += keypoints[keypoint];
+      ++palm_points;
+    }
+  }
+  if (palm_points == 0) {
+    // Without a palm whatever was seen is not taken for a hand.
+    return hand;
+  }
+  hand.center_of_palm_ = palm_sum / palm_points;
+  for (int keypoint : FINGER_TIP_KEYPOINTS) {
+    if (is_visible[keypoint]) {
+      hand.finger_tips_.push_back(keypoints[keypoint]);
+    }
+  }
+  hand.bounding_box_ = cv::boundingRect(visible_keypoints);
+  return hand;
+}
+
+AsyncKeypointDetector::AsyncKeypointDetector(
+    const KeypointModelSettings& settings)
+    : detector_(settings),
+      last_hands_(2),
+      pending_capture_time_ns_(0),
+      has_pending_frame_(false),
+      running_(true),
+      has_result_(false),
+      thread_policies_(nullptr),
+      dropped_frame_counter_(nullptr),
+      inference_histogram_(nullptr) {
+}
+
+AsyncKeypointDetector::~AsyncKeypointDetector() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  condition_.notify_all();
+  if (inference_thread_.joinable()) {
+    inference_thread_.join();
+  }
+}
+
+bool AsyncKeypointDetector::Submit(const cv::Mat& frame,
+                                   int64_t capture_time_ns) {
+  if (!inference_thread_.joinable()) {
+    inference_thread_ =
+        std::thread(&AsyncKeypointDetector::InferenceLoop, this);
+  }
+  bool replaced_frame;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    replaced_frame = has_pending_frame_;
+    // The caller reuses its buffers for the next frame, so we copy it.
+    frame.copyTo(pending_frame_);
+    pending_capture_time_ns_ = capture_time_ns;
+    has_pending_frame_ = true;
+  }
+  condition_.notify_one();
+  if (replaced_frame) {
+    common::Counter* dropped_frame_counter = dropped_frame_counter_.load();
+    if (dropped_frame_counter != nullptr) {
+      dropped_frame_counter->Increment();
+    }
+  }
+  return !replaced_frame;
+}
+
+bool AsyncKeypointDetector::TakeResult(std::pair<Hand, Hand>& hands) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  if (!has_result_) {
+    return false;
+  }
+  hands = result_;
+  has_result_ = false;
+  return true;
+}
+
+void AsyncKeypointDetector::SetThreadPolicies(
+    common::ThreadPolicies* thread_policies) {
+  thread_policies_ = thread_policies;
+}
+
+void AsyncKeypointDetector::SetMetrics(common::MetricsRegistry* metrics) {
+  if (metrics == nullptr) {
+    dropped_frame_counter_ = nullptr;
+    inference_histogram_ = nullptr;
+    return;
+  }
+  dropped_frame_counter_ = &metrics->GetCounter("keypoints.dropped_frames");
+  inference_histogram_ = &metrics->GetHistogram("keypoints.inference");
+}
+
+void AsyncKeypointDetector::InferenceLoop() {
+  if (thread_policies_ != nullptr) {
+    thread_policies_->Apply(common::KEYPOINT_THREAD);
+  }
+  cv::Mat frame;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(lock, [this] { return !running_ || has_pending_frame_; });
+    if (!running_) {
+      return;
+    }
+    // Swapping leaves the buffer of the last frame for Submit to copy the
+    // next one into.
+    cv::swap(frame, pending_frame_);
+    int64_t capture_time_ns = pending_capture_time_ns_;
+    has_pending_frame_ = false;
+    lock.unlock();
+
+    int64_t start_time_ns = common::GetTimestampNanoseconds();
+    std::vector<cv::Rect> regions = KeypointDetector::FindRegions(
+        last_hands_, frame.size(), detector_.GetSettings().region_margin);
+    try {
+      last_hands_ = detector_.Detect(frame, regions, capture_time_ns);
+    } catch (...) {
+      // A model whose outputs do not fit fails on every frame, so the thread
+      // stops and the vision thread is told.
+      lock.lock();
+      error_ = std::current_exception();
+      return;
+    }
+    std::pair<Hand, Hand> hands(last_hands_[0], last_hands_[1]);
+    // The regions overlap, so a hand may have been found in the other's.
+    if (hands.first.center_of_palm_.x > hands.second.center_of_palm_.x &&
+        hands.second.center_of_palm_.x >= 0) {
+      std::swap(hands.first, hands.second);
+    }
+    common::LatencyHistogram* inference_histogram =
+        inference_histogram_.load();
+    if (inference_histogram != nullptr) {
+      inference_histogram->Record(common::GetTimestampNanoseconds() -
+                                  start_time_ns);
+    }
+
+    lock.lock();
+    result_ = hands;
+    has_result_ = true;
+  }
+}
+}  // namespace gesturerecognition
@@ -0,0 +1,108 @@
+#include "gesturerecognition/quality_controller.h"
+
+#include <stdexcept>
+
+namespace gesturerecognition {
+
+namespace {
+std::vector<QualityLevel> CreateQualityLevels() {
+  std::vector<QualityLevel> levels;
+  QualityLevel level;
+  level.draw_debug_overlays = true;
+  levels.push_back(level);  // Full quality
+
+  level.filter_quality.morphology_iterations = 2;
+  levels.push_back(level);
+
+  level.filter_quality.median_kernel_size = 3;
+  levels.push_back(level);
+
+  level.filter_quality.morphology_iterations = 1;
+  level.filter_quality.segmentation_scale = 0.5;
+  levels.push_back(level);
+
+  level.filter_quality.background_update_interval = 2;
+  levels.push_back(level);
+
+  level.filter_quality.background_update_interval = 4;
+  levels.push_back(level);
+
+  level.draw_debug_overlays = false;
+  levels.push_back(level);
+  return levels;
+}
+}  // namespace
+
+QualityController::QualityController(double frame_budget_ms,
+                                     size_t window_frames,
+                                     double restore_fraction)
+    : frame_budget_ms_(frame_budget_ms),
+      window_frames_(window_frames),
+      restore_fraction_(restore_fraction),
+      level_(0),
+      window_total_ms_(0),
+      window_size_(0),
+      level_gauge_(nullptr),
+      degradation_counter_(nullptr),
+      restoration_counter_(nullptr) {
+  if (frame_budget_ms <= 0 || window_frames == 0 || restore_fraction <= 0 ||
+      restore_fraction >= 1) {
+    throw std::invalid_argument("Invalid quality controller settings!");
+  }
+}
+
+bool QualityController::Update(double frame_time_ms) {
+  window_total_ms_ += frame_time_ms;
+  if (++window_size_ < window_frames_) {
+    return false;
+  }
+  double mean_frame_time_ms = window_total_ms_ / window_size_;
+  window_total_ms_ = 0;
+  window_size_ = 0;
+
+  if (mean_frame_time_ms > frame_budget_ms_ &&
+      level_ + 1 < GetQualityLevels().size()) {
+    ++level_;
+    if (degradation_counter_ != nullptr) {
+      degradation_counter_->Increment();
+    }
+  } else if (mean_frame_time_ms < frame_budget_ms_ * restore_fraction_ &&
+             level_ > 0) {
+    --level_;
+    if (restoration_counter_ != nullptr) {
+      restoration_counter_->Increment();
+    }
+  } else {
+    return false;
+  }
+  if (level_gauge_ != nullptr) {
+    level_gauge_->Set(static_cast<double>(level_));
+  }
+  return true;
+}
+
+size_t QualityController::GetLevel() const {
+  return level_;
+}
+
+const QualityLevel& QualityController::GetQualityLevel() const {
+  return GetQualityLevels()[level_];
+}
+
+void QualityController::SetMetrics(common::MetricsRegistry* metrics) {
+  if (metrics == nullptr) {
+    level_gauge_ = nullptr;
+    degradation_counter_ = restoration_counter_ = nullptr;
+    return;
+  }
+  level_gauge_ = &metrics->GetGauge("quality.level");
+  degradation_counter_ = &metrics->GetCounter("quality.degradations");
+  restoration_counter_ = &metrics->GetCounter("quality.restorations");
+  level_gauge_->Set(static_cast<double>(level_));
+}
+
+const std::vector<QualityLevel>& QualityController::GetQualityLevels() {
+  static const std::vector<QualityLevel> levels = CreateQualityLevels();
+  return levels;
+}
+}  // namespace gesturerecognition
@@ -0,0 +1,540 @@
+#include "gesturerecognition/rle_mask.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace gesturerecognition {
+
+namespace {
+// The neighbours of a pixel in the order of OpenCV's chain codes, counter
+// clockwise from the right (y grows downwards).
+const int NEIGHBOUR_DX[] = {1, 1, 0, -1, -1, -1, 0, 1};
+const int NEIGHBOUR_DY[] = {0, -1, -1, -1, 0, 1, 1, 1};
+const int LEFT = 4;
+// A stream holding a larger encoding than this is taken to be corrupt.
+const uint32_t MAX_ENCODED_SIZE = 1u << 30;
+
+uint64_t LoadWord(const uchar* data) {
+  uint64_t word;
+  std::memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+/**
+ * Returns whether a word has a zero byte.
+ */
+bool HasZeroByte(uint64_t word) {
+  return ((word - 0x0101010101010101ull) & ~word & 0x8080808080808080ull) !=
+         0;
+}
+
+size_t GetVarintSize(uint32_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+unsigned char* WriteVarint(uint32_t value, unsigned char* data) {
+  while (value >= 0x80) {
+    *data++ = static_cast<unsigned char>(value | 0x80);
+    value >>= 7;
+  }
+  *data++ = static_cast<unsigned char>(value);
+  return data;
+}
+
+/**
+ * Reads a variable length integer and moves data past it.
+ * @return  false if it runs past end or does not fit in 32 bits
+ */
+bool ReadVarint(const unsigned char*& data, const unsigned char* end,
+                uint32_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (data == end) {
+      return false;
+    }
+    unsigned char byte = *data++;
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return shift < 28 || byte < 0x10;
+    }
+  }
+  return false;
+}
+
+/**
+ * Finds the root of a run in a union find forest, halving the path on the
+ * way.
+ */
+size_t FindRoot(std::vector<size_t>& parents, size_t run) {
+  while (parents[run] != run) {
+    parents[run] = parents[parents[run]];
+    run = parents[run];
+  }
+  return run;
+}
+}  // namespace
+
+RleMask::RleMask() : size_(), runs_(), row_starts_(1, 0) {
+}
+
+RleMask::RleMask(const cv::Mat& mask) : RleMask() {
+  Assign(mask);
+}
+
+void RleMask::Assign(const cv::Mat& mask) {
+  if (mask.type() != CV_8UC1) {
+    throw std::invalid_argument("Only 8 bit single channel masks are encoded");
+  }
+  Reset(mask.size());
+  const int cols = mask.cols;
+  for (int row = 0; row < mask.rows; ++row) {
+    const uchar* pixels = mask.ptr<uchar>(row);
+    int x = 0;
+    while (x < cols) {
+      // The background is skipped a word at a time, as is the inside of a run.
+      while (x + 8 <= cols && LoadWord(pixels + x) == 0) {
+        x += 8;
+      }
+      while (x < cols && pixels[x] == 0) {
+        ++x;
+      }
+      if (x == cols) {
+        break;
+      }
+      MaskRun run;
+      run.start = x;
+      while (x + 8 <= cols && !HasZeroByte(LoadWord(pixels + x))) {
+        x += 8;
+      }
+      while (x < cols && pixels[x] != 0) {
+        ++x;
+      }
+      run.end = x;
+      runs_.push_back(run);
+    }
+    row_starts_.push_back(static_cast<uint32_t>(runs_.size()));
+  }
+}
+
+void RleMask::ToMat(cv::Mat& mask) const {
+  mask.create(size_, CV_8UC1);
+  mask.setTo(cv::Scalar(0));
+  for (int row = 0; row < size_.height; ++row) {
+    uchar* pixels = mask.ptr<uchar>(row);
+    std::pair<const MaskRun*, const MaskRun*> row_runs = GetRowRuns(row);
+    for (const MaskRun* run = row_runs.first; run != row_runs.second; ++run) {
+      std::memset(pixels + run->start, 255, run->end - run->start);
+    }
+  }
+}
+
+cv::Size RleMask::GetSize() const {
+  return size_;
+}
+
+bool RleMask::IsEmpty() const {
+  return size_.width <= 0 || size_.height <= 0;
+}
+
+size_t RleMask::GetRunCount() const {
+  return runs_.size();
+}
+
+std::pair<const MaskRun*, const MaskRun*> RleMask::GetRowRuns(int row) const {
+  const MaskRun* runs = runs_.data();
+  return std::make_pair(runs + row_starts_[row], runs + row_starts_[row + 1]);
+}
+
+bool RleMask::IsForeground(int x, int y) const {
+  if (x < 0 || y < 0 || x >= size_.width || y >= size_.height) {
+    return false;
+  }
+  std::pair<const MaskRun*, const MaskRun*> row_runs = GetRowRuns(y);
+  // The last run which starts at or before x.
+  const MaskRun* run = std::upper_bound(
+      row_runs.first, row_runs.second, x,
+      [](int column, const MaskRun& other) { return column < other.start; });
+  return run != row_runs.first && x < (run - 1)->end;
+}
+
+int64_t RleMask::GetArea() const {
+  int64_t area = 0;
+  for (const MaskRun& run : runs_) {
+    area += run.end - run.start;
+  }
+  return area;
+}
+
+cv::Rect RleMask::GetBoundingBox() const {
+  int top = -1;
+  int bottom = -1;
+  int left = size_.width;
+  int right = 0;
+  for (int row = 0; row < size_.height; ++row) {
+    std::pair<const MaskRun*, const MaskRun*> row_runs = GetRowRuns(row);
+    if (row_runs.first == row_runs.second) {
+      continue;
+    }
+    if (top < 0) {
+      top = row;
+    }
+    bottom = row;
+    // The runs of a row are sorted, so only its first and last one matter.
+    left = std::min(left, row_runs.first->start);
+    right = std::max(right, (row_runs.second - 1)->end);
+  }
+  if (top < 0) {
+    return cv::Rect();
+  }
+  return cv::Rect(left, top, right - left, bottom - top + 1);
+}
+
+RleMask RleMask::And(const RleMask& other) const {
+  if (size_ != other.size_) {
+    throw std::invalid_argument("Only masks of the same size can be combined");
+  }
+  RleMask result;
+  result.Reset(size_);
+  for (int row = 0; row < size_.height; ++row) {
+    std::pair<const MaskRun*, const MaskRun*> first = GetRowRuns(row);
+    std::pair<const MaskRun*, const MaskRun*> second = other.GetRowRuns(row);
+    while (first.first != first.second && second.first != second.second) {
+      MaskRun overlap;
+      overlap.start = std::max(first.first->start, second.first->start);
+      overlap.end = std::min(first.first->end, second.first->end);
+      if (overlap.start < overlap.end) {
+        result.runs_.push_back(overlap);
+      }
+      // The run which ends first cannot overlap any later run of the other.
+      if (first.first->end < second.first->end) {
+        ++first.first;
+      } else {
+        ++second.first;
+      }
+    }
+    result.row_starts_.push_back(static_cast<uint32_t>(result.runs_.size()));
+  }
+  return result;
+}
+
+RleMask RleMask::Or(const RleMask& other) const {
+  if (size_ != other.size_) {
+    throw std::invalid_argument("Only masks of the same size can be combined");
+  }
+  RleMask result;
+  result.Reset(size_);
+  for (int row = 0; row < size_.height; ++row) {
+    std::pair<const MaskRun*, const MaskRun*> first = GetRowRuns(row);
+    std::pair<const MaskRun*, const MaskRun*> second = other.GetRowRuns(row);
+    size_t row_start = result.runs_.size();
+    while (first.first != first.second || second.first != second.second) {
+      // The runs are merged in the order they start, and each is joined to
+      // the last one if they overlap or touch.
+      const MaskRun* next;
+      if (second.first == second.second ||
+          (first.first != first.second &&
+           first.first->start <= second.first->start)) {
+        next = first.first++;
+      } else {
+        next = second.first++;
+      }
+      if (result.runs_.size() > row_start &&
+          next->start <= result.runs_.back().end) {
+        result.runs_.back().end = std::max(result.runs_.back().end, next->end);
+      } else {
+        result.runs_.push_back(*next);
+      }
+    }
+    result.row_starts_.push_back(static_cast<uint32_t>(result.runs_.size()));
+  }
+  return result;
+}
+
+std::vector<std::vector<cv::Point>> RleMask::FindOuterContours(
+    size_t max_contours) const {
+  std::vector<std::pair<size_t, int64_t>> blobs = FindBlobs();
+  if (blobs.empty()) {
+    return std::vector<std::vector<cv::Point>>();
+  }
+  // The pixel left of the top left one of a blob is in the background around
+  // it, which is a hole of another blob unless it reaches the border.
+  std::vector<bool> open_gaps = FindOpenGaps();
+  blobs.erase(std::remove_if(blobs.begin(), blobs.end(),
+                             [&](const std::pair<size_t, int64_t>& blob) {
+                               return !open_gaps[blob.first +
+                                                 GetRunRow(blob.first)];
+                             }),
+              blobs.end());
+  std::stable_sort(blobs.begin(), blobs.end(),
+                   [](const std::pair<size_t, int64_t>& first,
+                      const std::pair<size_t, int64_t>& second) {
+                     return first.second > second.second;
+                   });
+  if (max_contours > 0 && blobs.size() > max_contours) {
+    blobs.resize(max_contours);
+  }
+  std::vector<std::vector<cv::Point>> contours;
+  for (const std::pair<size_t, int64_t>& blob : blobs) {
+    // The first run of a blob holds its top left pixel, which is on its outer
+    // boundary.
+    size_t run = blob.first;
+    contours.push_back(
+        TraceBoundary(cv::Point(runs_[run].start, GetRunRow(run))));
+  }
+  return contours;
+}
+
+size_t RleMask::GetMemoryBytes() const {
+  return runs_.size() * sizeof(MaskRun) +
+         row_starts_.size() * sizeof(uint32_t);
+}
+
+size_t RleMask::GetEncodedSize() const {
+  size_t size = GetVarintSize(size_.width) + GetVarintSize(size_.height);
+  for (int row = 0; row < size_.height; ++row) {
+    std::pair<const MaskRun*, const MaskRun*> row_runs = GetRowRuns(row);
+    size += GetVarintSize(
+        static_cast<uint32_t>(row_runs.second - row_runs.first));
+    int32_t last_end = 0;
+    for (const MaskRun* run = row_runs.first; run != row_runs.second; ++run) {
+      size += GetVarintSize(run->start - last_end) +
+              GetVarintSize(run->end - run->start);
+      last_end = run->end;
+    }
+  }
+  return size;
+}
+
+void RleMask::Encode(unsigned char* data) const {
+  data = WriteVarint(size_.width, data);
+  data = WriteVarint(size_.height, data);
+  for (int row = 0; row < size_.height; ++row) {
+    std::pair<const MaskRun*, const MaskRun*> row_runs = GetRowRuns(row);
+    data = WriteVarint(
+        static_cast<uint32_t>(row_runs.second - row_runs.first), data);
+    int32_t last_end = 0;
+    for (const MaskRun* run = row_runs.first; run != row_runs.second; ++run) {
+      data = WriteVarint(run->start - last_end, data);
+      data = WriteVarint(run->end - run->start, data);
+      last_end = run->end;
+    }
+  }
+}
+
+bool RleMask::Decode(const unsigned char* data, size_t size) {
+  const unsigned char* end = data + size;
+  uint32_t width;
+  uint32_t height;
+  Reset(cv::Size());
+  if (!ReadVarint(data, end, width) || !ReadVarint(data, end, height) ||
+      width > INT32_MAX || height > INT32_MAX ||
+      (width == 0) != (height == 0) || height > size) {
+    return false;
+  }
+  Reset(cv::Size(static_cast<int>(width), static_cast<int>(height)));
+  for (uint32_t row = 0; row < height; ++row) {
+    uint32_t run_count;
+    if (!ReadVarint(data, end, run_count) || run_count > width) {
+      Reset(cv::Size());
+      return false;
+    }
+    uint32_t last_end = 0;
+    for (uint32_t i = 0; i < run_count; ++i) {
+      uint32_t gap;
+      uint32_t length;
+      // Runs which touch the last one would have been a single run.
+      if (!ReadVarint(data, end, gap) || !ReadVarint(data, end, length) ||
+          (gap == 0 && i > 0) || length == 0 || gap > width - last_end ||
+          length > width - last_end - gap) {
+        Reset(cv::Size());
+        return false;
+      }
+      MaskRun run;
+      run.start = static_cast<int32_t>(last_end + gap);
+      run.end = static_cast<int32_t>(run.start + length);
+      runs_.push_back(run);
+      last_end = run.end;
+    }
+    row_starts_.push_back(static_cast<uint32_t>(runs_.size()));
+  }
+  if (data != end) {
+    Reset(cv::Size());
+    return false;
+  }
+  return true;
+}
+
+void RleMask::Write(std::ostream& stream) const {
+  std::vector<unsigned char> data(GetEncodedSize());
+  Encode(data.data());
+  uint32_t size = static_cast<uint32_t>(data.size());
+  stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+void RleMask::Read(std::istream& stream) {
+  uint32_t size = 0;
+  stream.read(reinterpret_cast<char*>(&size), sizeof(size));
+  if (!stream || size > MAX_ENCODED_SIZE) {
+    throw std::invalid_argument("The stream does not hold a mask!");
+  }
+  std::vector<unsigned char> data(size);
+  stream.read(reinterpret_cast<char*>(data.data()), size);
+  if (!stream || !Decode(data.data(), data.size())) {
+    throw std::invalid_argument("The stream does not hold a mask!");
+  }
+}
+
+void RleMask::Reset(const cv::Size& size) {
+  size_ = size;
+  runs_.clear();
+  row_starts_.assign(1, 0);
+}
+
+std::vector<std::pair<size_t, int64_t>> RleMask::FindBlobs() const {
+  std::vector<size_t> parents(runs_.size());
+  std::iota(parents.begin(), parents.end(), 0);
+  for (int row = 1; row < size_.height; ++row) {
+    size_t above = row_starts_[row - 1];
+    const size_t above_end = row_starts_[row];
+    for (size_t run = row_starts_[row]; run < row_starts_[row + 1]; ++run) {
+      // Diagonal neighbours touch, so a run joins the runs above it which
+      // reach from one column before it to one column after it. The runs
+      // above that end before it cannot touch any later run either.
+      while (above < above_end && runs_[above].end < runs_[run].start) {
+        ++above;
+      }
+      for (size_t other = above;
+           other < above_end && runs_[other].start <= runs_[run].end;
+           ++other) {
+        size_t first_root = FindRoot(parents, run);
+        size_t second_root = FindRoot(parents, other);
+        // The earlier run stays the root, so that it is the blob's first.
+        parents[std::max(first_root, second_root)] =
+            std::min(first_root, second_root);
+      }
+    }
+  }
+  std::vector<std::pair<size_t, int64_t>> blobs;
+  std::vector<size_t> blob_of_root(runs_.size());
+  for (size_t run = 0; run < runs_.size(); ++run) {
+    size_t root = FindRoot(parents, run);
+    if (root == run) {
+      blob_of_root[run] = blobs.size();
+      blobs.push_back(std::make_pair(run, 0));
+    }
+    blobs[blob_of_root[root]].second += runs_[run].end - runs_[run].start;
+  }
+  return blobs;
+}
+
+std::vector<bool> RleMask::FindOpenGaps() const {
+  const size_t gap_count = runs_.size() + size_.height;
+  std::vector<size_t> parents(gap_count);
+  std::iota(parents.begin(), parents.end(), 0);
+  std::vector<bool> open(gap_count, false);
+  for (int row = 0; row < size_.height; ++row) {
+    const size_t run_count = row_starts_[row + 1] - row_starts_[row];
+    size_t above = 0;
+    const size_t above_count =
+        row > 0 ? row_starts_[row] - row_starts_[row - 1] : 0;
+    for (size_t gap = 0; gap <= run_count; ++gap) {
+      const size_t index = row_starts_[row] + row + gap;
+      MaskRun columns = GetGap(row, gap);
+      // A gap is only empty before a run starting at the left edge or after
+      // one ending at the right edge, where the outside of the mask is.
+      open[index] = columns.start == columns.end || row == 0 ||
+                    row == size_.height - 1 || columns.start == 0 ||
+                    columns.end == size_.width;
+      if (row == 0 || columns.start == columns.end) {
+        continue;
+      }
+      // Background is 4-connected, so the gaps above join it if they share a
+      // column with it. Those which end before it cannot reach a later gap.
+      while (above <= above_count &&
+             GetGap(row - 1, above).end <= columns.start) {
+        ++above;
+      }
+      for (size_t other = above;
+           other <= above_count && GetGap(row - 1, other).start < columns.end;
+           ++other) {
+        size_t first_root = FindRoot(parents, index);
+        size_t second_root =
+            FindRoot(parents, row_starts_[row - 1] + row - 1 + other);
+        if (first_root != second_root) {
+          parents[first_root] = second_root;
+          open[second_root] = open[second_root] || open[first_root];
+        }
+      }
+    }
+  }
+  for (size_t gap = 0; gap < gap_count; ++gap) {
+    open[gap] = open[FindRoot(parents, gap)];
+  }
+  return open;
+}
+
+MaskRun RleMask::GetGap(int row, size_t gap) const {
+  const size_t first_run = row_starts_[row];
+  const size_t run_count = row_starts_[row + 1] - first_run;
+  MaskRun columns;
+  columns.start = gap == 0 ? 0 : runs_[first_run + gap - 1].end;
+  columns.end = gap == run_count ? size_.width : runs_[first_run + gap].start;
+  return columns;
+}
+
+int RleMask::GetRunRow(size_t run) const {
+  return static_cast<int>(
+      std::upper_bound(row_starts_.begin(), row_starts_.end(), run) -
+      row_starts_.begin() - 1);
+}
+
+std::vector<cv::Point> RleMask::TraceBoundary(const cv::Point& start) const {
+  // This is the border following of cv::findContours for an outer border,
+  // with the pixels looked up in the runs instead of in an image.
+  std::vector<cv::Point> contour;
+  // The pixel left of the start is background, so the last pixel of the
+  // boundary is found by looking clockwise from there.
+  int direction = LEFT;
+  cv::Point last;
+  do {
+    direction = (direction + 7) & 7;
+    last = cv::Point(start.x + NEIGHBOUR_DX[direction],
+                     start.y + NEIGHBOUR_DY[direction]);
+  } while (!IsForeground(last.x, last.y) && direction != LEFT);
+  if (direction == LEFT) {
+    contour.push_back(start);  // The blob is a single pixel
+    return contour;
+  }
+
+  cv::Point current = start;
+  int last_direction = direction ^ 4;
+  for (;;) {
+    // The next pixel is the first foreground one counter clockwise from the
+    // one we came from.
+    cv::Point next;
+    do {
+      direction = (direction + 1) & 7;
+      next = cv::Point(current.x + NEIGHBOUR_DX[direction],
+                       current.y + NEIGHBOUR_DY[direction]);
+    } while (!IsForeground(next.x, next.y));
+    if (direction != last_direction) {
+      contour.push_back(current);
+    }
+    last_direction = direction;
+    if (next == start && current == last) {
+      break;
+    }
+    current = next;
+    direction = (direction + 4) & 7;
+  }
+  return contour;
+}
+}  // namespace gesturerecognition
@@ -0,0 +1,82 @@
+#include "gesturerecognition/skin_table.h"
+
+#include <stdexcept>
+
+namespace gesturerecognition {
+
+const int YCbCrSkinTable::BITS_PER_COMPONENT;
+const int YCbCrSkinTable::LEVELS;
+
+YCbCrSkinTable::YCbCrSkinTable()
+    : table_(LEVELS * LEVELS * LEVELS, 0),
+      low_(cv::Scalar::all(-1)),
+      high_(cv::Scalar::all(-1)) {
+}
+
+void YCbCrSkinTable::Build(const cv::Scalar& low, const cv::Scalar& high) {
+  if (low == low_ && high == high_) {
+    return;
+  }
+  // Every entry becomes one YUYV macropixel, with the value in the middle of
+  // its quantisation step for both pixels. Row y * LEVELS + cb holds every
+  // cr for that y and cb.
+  const int shift = 8 - BITS_PER_COMPONENT;
+  const int half_step = 1 << (shift - 1);
+  cv::Mat yuyv_entries(LEVELS * LEVELS, 2 * LEVELS, CV_8UC2);
+  for (int y = 0; y < LEVELS; ++y) {
+    for (int cb = 0; cb < LEVELS; ++cb) {
+      uchar* row = yuyv_entries.ptr<uchar>(y * LEVELS + cb);
+      for (int cr = 0; cr < LEVELS; ++cr) {
+        row[4 * cr] = row[4 * cr + 2] =
+            static_cast<uchar>((y << shift) + half_step);
+        row[4 * cr + 1] = static_cast<uchar>((cb << shift) + half_step);
+        row[4 * cr + 3] = static_cast<uchar>((cr << shift) + half_step);
+      }
+    }
+  }
+  cv::Mat bgr_entries;
+  cv::Mat hsv_entries;
+  cv::Mat skin_entries;
+  cv::cvtColor(yuyv_entries, bgr_entries, cv::COLOR_YUV2BGR_YUYV);
+  cv::cvtColor(bgr_entries, hsv_entries, cv::COLOR_BGR2HSV);
+  cv::inRange(hsv_entries, low, high, skin_entries);
+  for (int row = 0; row < skin_entries.rows; ++row) {
+    const uchar* skin = skin_entries.ptr<uchar>(row);
+    for (int cr = 0; cr < LEVELS; ++cr) {
+      table_[row * LEVELS + cr] = skin[2 * cr];
+    }
+  }
+  low_ = low;
+  high_ = high;
+}
+
+void YCbCrSkinTable::Classify(const CapturedFrame& frame,
+                              cv::Mat& mask) const {
+  const cv::Size size = GetFrameSize(frame);
+  mask.create(size, CV_8UC1);
+  if (frame.format_ == PixelFormat::YUYV) {
+    for (int row = 0; row < size.height; ++row) {
+      const uchar* pixels = frame.data_.ptr<uchar>(row);
+      uchar* skin = mask.ptr<uchar>(row);
+      for (int col = 0; col + 1 < size.width; col += 2) {
+        const uchar* macropixel = pixels + 2 * col;
+        skin[col] = Lookup(macropixel[0], macropixel[1], macropixel[3]);
+        skin[col + 1] = Lookup(macropixel[2], macropixel[1], macropixel[3]);
+      }
+    }
+    return;
+  }
+  if (frame.format_ != PixelFormat::NV12) {
+    throw std::invalid_argument("Only YUYV and NV12 frames can be classified!");
+  }
+  for (int row = 0; row < size.height; ++row) {
+    const uchar* luma = frame.data_.ptr<uchar>(row);
+    const uchar* chroma = frame.data_.ptr<uchar>(size.height + row / 2);
+    uchar* skin = mask.ptr<uchar>(row);
+    for (int col = 0; col < size.width; ++col) {
+      const uchar* chroma_pair = chroma + (col & ~1);
+      skin[col] = Lookup(luma[col], chroma_pair[0], chroma_pair[1]);
+    }
+  }
+}
+}  // namespace gesturerecognition
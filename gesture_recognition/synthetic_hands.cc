@@ -0,0 +1,296 @@
+#include "gesturerecognition/synthetic_hands.h"
+
+#include "gesturerecognition/hand_extractor.h"
+
+namespace gesturerecognition {
+
+namespace {
+// The shape of a hand whose thumb is on the left, relative to its palm width.
+// The fingers are listed from the left to the right.
+const float FINGER_BASE_X[FINGERS_PER_HAND] = {-0.5f, -0.3f, -0.1f, 0.1f,
+                                               0.3f};
+const float FINGER_BASE_Y[FINGERS_PER_HAND] = {-0.05f, -0.45f, -0.45f, -0.45f,
+                                               -0.45f};
+const float FINGER_ANGLE_DEGREES[FINGERS_PER_HAND] = {-50, -8, -3, 3, 8};
+const float FINGER_LENGTH[FINGERS_PER_HAND] = {0.55f, 0.8f, 0.9f, 0.85f, 0.65f};
+const float FINGER_WIDTH[FINGERS_PER_HAND] = {0.2f, 0.16f, 0.16f, 0.16f,
+                                              0.15f};
+const float PALM_HEIGHT_BY_WIDTH = 0.9f;
+const float BENT_FINGER_LENGTH_RATIO = 0.25f;
+
+/**
+ * Rotates the offset(in hand coordinates) by the hand's rotation, and moves it
+ * to the hand's position in the image.
+ */
+cv::Point2f ToImageCoordinates(const SyntheticHand& hand, float offset_x,
+                               float offset_y) {
+  float angle = static_cast<float>(hand.rotation_degrees_ * CV_PI / 180);
+  float x = offset_x * hand.palm_width_;
+  float y = offset_y * hand.palm_width_;
+  return cv::Point2f(
+      hand.palm_center_.x + x * std::cos(angle) - y * std::sin(angle),
+      hand.palm_center_.y + x * std::sin(angle) + y * std::cos(angle));
+}
+
+/**
+ * Returns the index of the finger in the shape tables above. Left hands are
+ * the mirror image of right hands.
+ */
+int GetShapeIndex(const SyntheticHand& hand, int finger) {
+  return hand.is_left_ ? FINGERS_PER_HAND - 1 - finger : finger;
+}
+
+/**
+ * Returns the point at the given fraction of the finger's length, in image
+ * coordinates.
+ */
+cv::Point2f GetPointOnFinger(const SyntheticHand& hand, int finger,
+                             float length_ratio) {
+  int shape_index = GetShapeIndex(hand, finger);
+  float mirror = hand.is_left_ ? -1.0f : 1.0f;
+  float angle =
+      static_cast<float>(FINGER_ANGLE_DEGREES[shape_index] * CV_PI / 180);
+  float length = FINGER_LENGTH[shape_index] * length_ratio;
+  return ToImageCoordinates(
+      hand,
+      mirror * (FINGER_BASE_X[shape_index] + length * std::sin(angle)),
+      FINGER_BASE_Y[shape_index] - length * std::cos(angle));
+}
+}  // namespace
+
+SyntheticHand::SyntheticHand()
+    : palm_center_(0, 0),
+      palm_width_(100),
+      rotation_degrees_(0),
+      is_left_(false) {
+  for (bool& extended : extended_fingers_) {
+    extended = true;
+  }
+}
+
+SyntheticSceneSettings::SyntheticSceneSettings()
+    : resolution_(640, 480),
+      noise_specks_(0),
+      clutter_objects_(0),
+      pixel_noise_(0),
+      skin_color_(120, 150, 220),
+      background_color_(60, 60, 60),
+      seed_(0) {
+}
+
+SyntheticSessionSettings::SyntheticSessionSettings()
+    : number_of_frames_(300),
+      frames_per_second_(30),
+      press_duration_frames_(10),
+      press_probability_(0.02),
+      drift_pixels_(1),
+      render_frames_(false) {
+}
+
+SyntheticHandGenerator::SyntheticHandGenerator(
+    const SyntheticSceneSettings& settings)
+    : settings_(settings),
+      rng_(settings.seed_),
+      background_(settings.resolution_, CV_8UC3, settings.background_color_) {
+  int max_object_size = std::max(2, settings_.resolution_.width / 8);
+  for (int i = 0; i < settings_.clutter_objects_; ++i) {
+    cv::Scalar color(rng_.uniform(0, 256), rng_.uniform(0, 256),
+                     rng_.uniform(0, 256));
+    cv::Point corner(rng_.uniform(0, settings_.resolution_.width),
+                     rng_.uniform(0, settings_.resolution_.height));
+    cv::Size size(rng_.uniform(1, max_object_size),
+                  rng_.uniform(1, max_object_size));
+    if (i % 2 == 0) {
+      cv::rectangle(background_, cv::Rect(corner, size), color, cv::FILLED);
+    } else {
+      cv::ellipse(background_, corner, size, rng_.uniform(0, 180), 0, 360,
+                  color, cv::FILLED);
+    }
+  }
+}
+
+std::pair<SyntheticHand, SyntheticHand> SyntheticHandGenerator::CreateHandPair(
+    int extended_fingers, float scale) const {
+  SyntheticHand left_hand;
+  SyntheticHand right_hand;
+  left_hand.is_left_ = true;
+  float palm_width = scale * settings_.resolution_.width;
+  float palm_y = settings_.resolution_.height * 0.7f;
+  left_hand.palm_center_ =
+      cv::Point2f(settings_.resolution_.width * 0.27f, palm_y);
+  right_hand.palm_center_ =
+      cv::Point2f(settings_.resolution_.width * 0.73f, palm_y);
+  left_hand.palm_width_ = palm_width;
+  right_hand.palm_width_ = palm_width;
+  for (int finger = 0; finger < FINGERS_PER_HAND; ++finger) {
+    // The thumb is finger 0 of the right hand and finger 4 of the left hand.
+    right_hand.extended_fingers_[finger] = finger < extended_fingers;
+    left_hand.extended_fingers_[finger] =
+        FINGERS_PER_HAND - 1 - finger < extended_fingers;
+  }
+  return std::make_pair(left_hand, right_hand);
+}
+
+std::vector<cv::Point> SyntheticHandGenerator::GetFingerTipPositions(
+    const SyntheticHand& hand) const {
+  std::vector<cv::Point> finger_tips;
+  for (int finger = 0; finger < FINGERS_PER_HAND; ++finger) {
+    int shape_index = GetShapeIndex(hand, finger);
+    // The finger ends in a half circle, so its tip is half a finger width
+    // further out than the end of its center line.
+    float tip_ratio =
+        1 + FINGER_WIDTH[shape_index] / 2 / FINGER_LENGTH[shape_index];
+    finger_tips.push_back(GetPointOnFinger(hand, finger, tip_ratio));
+  }
+  return finger_tips;
+}
+
+std::vector<cv::Point> SyntheticHandGenerator::DrawHand(
+    const SyntheticHand& hand, cv::Mat& mask) {
+  float half_height = PALM_HEIGHT_BY_WIDTH / 2;
+  std::vector<cv::Point> palm{ToImageCoordinates(hand, -0.5f, -half_height),
+                              ToImageCoordinates(hand, 0.5f, -half_height),
+                              ToImageCoordinates(hand, 0.5f, half_height),
+                              ToImageCoordinates(hand, -0.5f, half_height)};
+  cv::fillConvexPoly(mask, palm, cv::Scalar(255));
+
+  std::vector<cv::Point> all_finger_tips = GetFingerTipPositions(hand);
+  std::vector<cv::Point> extended_finger_tips;
+  for (int finger = 0; finger < FINGERS_PER_HAND; ++finger) {
+    int shape_index = GetShapeIndex(hand, finger);
+    int thickness = std::max(
+        1, static_cast<int>(FINGER_WIDTH[shape_index] * hand.palm_width_));
+    float length_ratio =
+        hand.extended_fingers_[finger] ? 1 : BENT_FINGER_LENGTH_RATIO;
+    cv::Point base = GetPointOnFinger(hand, finger, 0);
+    cv::Point end = GetPointOnFinger(hand, finger, length_ratio);
+    cv::line(mask, base, end, cv::Scalar(255), thickness);
+    cv::circle(mask, end, thickness / 2, cv::Scalar(255), cv::FILLED);
+    if (hand.extended_fingers_[finger]) {
+      extended_finger_tips.push_back(all_finger_tips[finger]);
+    }
+  }
+  return extended_finger_tips;
+}
+
+cv::Mat SyntheticHandGenerator::RenderFrame(const cv::Mat& mask) {
+  cv::Mat frame = background_.clone();
+  frame.setTo(settings_.skin_color_, mask);
+  if (settings_.pixel_noise_ > 0) {
+    cv::Mat noise(frame.size(), CV_16SC3);
+    cv::randn(noise, cv::Scalar::all(0),
+              cv::Scalar::all(settings_.pixel_noise_));
+    cv::Mat noisy_frame;
+    frame.convertTo(noisy_frame, CV_16SC3);
+    cv::add(noisy_frame, noise, noisy_frame);
+    noisy_frame.convertTo(frame, CV_8UC3);
+  }
+  return frame;
+}
+
+SyntheticFrame SyntheticHandGenerator::Render(const SyntheticHand& left_hand,
+                                              const SyntheticHand& right_hand,
+                                              bool render_frame) {
+  SyntheticFrame synthetic_frame;
+  synthetic_frame.mask_ = cv::Mat::zeros(settings_.resolution_, CV_8UC1);
+  int speck_radius = std::max(1, settings_.resolution_.width / 320);
+  for (int i = 0; i < settings_.noise_specks_; ++i) {
+    cv::circle(synthetic_frame.mask_,
+               cv::Point(rng_.uniform(0, settings_.resolution_.width),
+                         rng_.uniform(0, settings_.resolution_.height)),
+               speck_radius, cv::Scalar(255), cv::FILLED);
+  }
+  synthetic_frame.left_finger_tips_ =
+      DrawHand(left_hand, synthetic_frame.mask_);
+  synthetic_frame.right_finger_tips_ =
+      DrawHand(right_hand, synthetic_frame.mask_);
+  synthetic_frame.left_palm_center_ = left_hand.palm_center_;
+  synthetic_frame.right_palm_center_ = right_hand.palm_center_;
+  synthetic_frame.timestamp_ns_ = 0;
+  if (render_frame) {
+    synthetic_frame.frame_ = RenderFrame(synthetic_frame.mask_);
+  }
+  return synthetic_frame;
+}
+
+SyntheticSession SyntheticHandGenerator::GenerateSession(
+    const SyntheticSessionSettings& settings) {
+  SyntheticSession session;
+  std::pair<SyntheticHand, SyntheticHand> hands =
+      CreateHandPair(FINGERS_PER_HAND, 0.16f);
+  SyntheticHand* hand_pointers[] = {&hands.first, &hands.second};
+  const cv::Point2f start_positions[] = {hands.first.palm_center_,
+                                         hands.second.palm_center_};
+  // The finger each hand has bent, and the frame it is straightened again.
+  int bent_finger[] = {ERROR_NUMBER, ERROR_NUMBER};
+  size_t release_frame[] = {0, 0};
+  float max_drift = settings.drift_pixels_ * 10;
+
+  for (size_t frame_number = 0; frame_number < settings.number_of_frames_;
+       ++frame_number) {
+    int64_t timestamp_ns = static_cast<int64_t>(
+        frame_number * 1e9 / settings.frames_per_second_);
+    for (int hand_index = 0; hand_index < 2; ++hand_index) {
+      SyntheticHand& hand = *hand_pointers[hand_index];
+      // Random walk of the palm, kept close to where it started.
+      hand.palm_center_.x = std::min(
+          std::max(hand.palm_center_.x +
+                       rng_.uniform(-settings.drift_pixels_,
+                                    settings.drift_pixels_),
+                   start_positions[hand_index].x - max_drift),
+          start_positions[hand_index].x + max_drift);
+      hand.palm_center_.y = std::min(
+          std::max(hand.palm_center_.y +
+                       rng_.uniform(-settings.drift_pixels_,
+                                    settings.drift_pixels_),
+                   start_positions[hand_index].y - max_drift),
+          start_positions[hand_index].y + max_drift);
+
+      int& finger = bent_finger[hand_index];
+      if (finger != ERROR_NUMBER && frame_number >= release_frame[hand_index]) {
+        hand.extended_fingers_[finger] = true;
+        session.press_events_.push_back(
+            {timestamp_ns, frame_number, hand.is_left_, finger, false,
+             GetFingerTipPositions(hand)[finger]});
+        finger = ERROR_NUMBER;
+      } else if (finger == ERROR_NUMBER &&
+                 rng_.uniform(0.0, 1.0) < settings.press_probability_) {
+        finger = rng_.uniform(0, FINGERS_PER_HAND);
+        hand.extended_fingers_[finger] = false;
+        release_frame[hand_index] =
+            frame_number + settings.press_duration_frames_;
+        session.press_events_.push_back(
+            {timestamp_ns, frame_number, hand.is_left_, finger, true,
+             GetFingerTipPositions(hand)[finger]});
+      }
+    }
+    session.frames_.push_back(
+        Render(hands.first, hands.second, settings.render_frames_));
+    session.frames_.back().timestamp_ns_ = timestamp_ns;
+  }
+  return session;
+}
+
+int CountMatchedPoints(const std::vector<cv::Point>& detected,
+                       const std::vector<cv::Point>& ground_truth,
+                       double max_distance) {
+  std::vector<bool> is_matched(ground_truth.size(), false);
+  int matched_points = 0;
+  for (const cv::Point& point : detected) {
+    int closest_index = ERROR_NUMBER;
+    double closest_distance = max_distance;
+    for (size_t i = 0; i < ground_truth.size(); ++i) {
+      double distance = FindEuclideanDistance(point, ground_truth[i]);
+      if (!is_matched[i] && distance <= closest_distance) {
+        closest_index = static_cast<int>(i);
+        closest_distance = distance;
+      }
+    }
+    if (closest_index != ERROR_NUMBER) {
+      is_matched[closest_index] = true;
+      ++matched_points;
+    }
+  }
+  return matched_points;
+}
+}  // namespace gesturerecognition
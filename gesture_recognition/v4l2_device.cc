@@ -0,0 +1,267 @@
+#include "gesturerecognition/v4l2_device.h"
+
+#include <stdexcept>
+
+#include "common/thread_policy.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace gesturerecognition {
+
+#ifdef __linux__
+namespace {
+/**
+ * Calls ioctl again for as long as it is interrupted by a signal.
+ */
+int RetryIoctl(int file_descriptor, unsigned long request, void* argument) {
+  int result;
+  do {
+    result = ioctl(file_descriptor, request, argument);
+  } while (result == -1 && errno == EINTR);
+  return result;
+}
+
+/**
+ * Throws std::runtime_error with the message and the description of errno.
+ */
+void ThrowDeviceError(const std::string& message) {
+  throw std::runtime_error(message + ": " + std::strerror(errno));
+}
+}  // namespace
+
+V4L2Device::V4L2Device(const std::string& device_name, PixelFormat format,
+                       const cv::Size& frame_size, double frames_per_second,
+                       size_t buffer_count)
+    : file_descriptor_(-1),
+      format_(format),
+      frame_size_(frame_size),
+      bytes_per_line_(0),
+      frames_per_second_(0),
+      streaming_(false) {
+  if (format == PixelFormat::BGR) {
+    throw std::invalid_argument("V4L2 devices capture YUYV or NV12 frames!");
+  }
+  if (buffer_count < 2) {
+    throw std::invalid_argument("A capture device needs at least 2 buffers!");
+  }
+  file_descriptor_ = open(device_name.c_str(), O_RDWR | O_NONBLOCK);
+  if (file_descriptor_ == -1) {
+    ThrowDeviceError("Could not open " + device_name);
+  }
+  // Everything after this closes the device if it fails.
+  try {
+    v4l2_capability capability;
+    std::memset(&capability, 0, sizeof(capability));
+    if (RetryIoctl(file_descriptor_, VIDIOC_QUERYCAP, &capability) == -1) {
+      ThrowDeviceError(device_name + " is not a V4L2 device");
+    }
+    if (!(capability.capabilities & V4L2_CAP_VIDEO_CAPTURE) ||
+        !(capability.capabilities & V4L2_CAP_STREAMING)) {
+      throw std::runtime_error(device_name + " cannot stream video");
+    }
+
+    const uint32_t pixel_format = format == PixelFormat::YUYV
+                                      ? V4L2_PIX_FMT_YUYV
+                                      : V4L2_PIX_FMT_NV12;
+    v4l2_format device_format;
+    std::memset(&device_format, 0, sizeof(device_format));
+    device_format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    device_format.fmt.pix.width = static_cast<uint32_t>(frame_size.width);
+    device_format.fmt.pix.height = static_cast<uint32_t>(frame_size.height);
+    device_format.fmt.pix.pixelformat = pixel_format;
+    device_format.fmt.pix.field = V4L2_FIELD_NONE;
+    if (RetryIoctl(file_descriptor_, VIDIOC_S_FMT, &device_format) == -1) {
+      ThrowDeviceError("Could not set the format of " + device_name);
+    }
+    // The driver picks the nearest format it supports.
+    if (device_format.fmt.pix.pixelformat != pixel_format) {
+      throw std::runtime_error(device_name + " cannot capture this format");
+    }
+    frame_size_ = cv::Size(static_cast<int>(device_format.fmt.pix.width),
+                           static_cast<int>(device_format.fmt.pix.height));
+    bytes_per_line_ = device_format.fmt.pix.bytesperline;
+
+    // Not every driver lets the frame rate be set, so failing is fine.
+    v4l2_streamparm stream_parameters;
+    std::memset(&stream_parameters, 0, sizeof(stream_parameters));
+    stream_parameters.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    stream_parameters.parm.capture.timeperframe.numerator = 1000;
+    stream_parameters.parm.capture.timeperframe.denominator =
+        static_cast<uint32_t>(frames_per_second * 1000);
+    RetryIoctl(file_descriptor_, VIDIOC_S_PARM, &stream_parameters);
+    if (RetryIoctl(file_descriptor_, VIDIOC_G_PARM, &stream_parameters) == 0 &&
+        stream_parameters.parm.capture.timeperframe.numerator > 0) {
+      frames_per_second_ =
+          static_cast<double>(
+              stream_parameters.parm.capture.timeperframe.denominator) /
+          stream_parameters.parm.capture.timeperframe.numerator;
+    }
+
+    v4l2_requestbuffers request;
+    std::memset(&request, 0, sizeof(request));
+    request.count = static_cast<uint32_t>(buffer_count);
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    if (RetryIoctl(file_descriptor_, VIDIOC_REQBUFS, &request) == -1) {
+      ThrowDeviceError(device_name + " does not support mapped buffers");
+    }
+    if (request.count < 2) {
+      throw std::runtime_error(device_name + " gave too few buffers");
+    }
+    for (uint32_t i = 0; i < request.count; ++i) {
+      v4l2_buffer buffer;
+      std::memset(&buffer, 0, sizeof(buffer));
+      buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      buffer.memory = V4L2_MEMORY_MMAP;
+      buffer.index = i;
+      if (RetryIoctl(file_descriptor_, VIDIOC_QUERYBUF, &buffer) == -1) {
+        ThrowDeviceError("Could not query a buffer of " + device_name);
+      }
+      void* start = mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, file_descriptor_, buffer.m.offset);
+      if (start == MAP_FAILED) {
+        ThrowDeviceError("Could not map a buffer of " + device_name);
+      }
+      buffers_.push_back({start, buffer.length});
+      // Maps the pages now, rather than while the first frames are read.
+      common::PrefaultBuffer(start, buffer.length);
+    }
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      Queue(i);
+    }
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (RetryIoctl(file_descriptor_, VIDIOC_STREAMON, &type) == -1) {
+      ThrowDeviceError("Could not start streaming from " + device_name);
+    }
+    streaming_ = true;
+  } catch (...) {
+    Close();
+    throw;
+  }
+}
+
+V4L2Device::~V4L2Device() {
+  Close();
+}
+
+void V4L2Device::Close() {
+  if (streaming_) {
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    RetryIoctl(file_descriptor_, VIDIOC_STREAMOFF, &type);
+    streaming_ = false;
+  }
+  for (const MappedBuffer& buffer : buffers_) {
+    munmap(buffer.start_, buffer.length_);
+  }
+  buffers_.clear();
+  if (file_descriptor_ != -1) {
+    close(file_descriptor_);
+    file_descriptor_ = -1;
+  }
+}
+
+bool V4L2Device::Dequeue(DeviceBuffer& buffer) {
+  v4l2_buffer device_buffer;
+  std::memset(&device_buffer, 0, sizeof(device_buffer));
+  device_buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  device_buffer.memory = V4L2_MEMORY_MMAP;
+  while (RetryIoctl(file_descriptor_, VIDIOC_DQBUF, &device_buffer) == -1) {
+    if (errno != EAGAIN) {
+      return false;
+    }
+    pollfd poll_descriptor = {file_descriptor_, POLLIN, 0};
+    int result;
+    do {
+      result = poll(&poll_descriptor, 1, DEQUEUE_TIMEOUT_MS_);
+    } while (result == -1 && errno == EINTR);
+    if (result <= 0) {
+      return false;
+    }
+  }
+  buffer.index_ = device_buffer.index;
+  buffer.data_ = static_cast<uchar*>(buffers_[device_buffer.index].start_);
+  // A frame the driver flagged as corrupted is treated as an empty one.
+  buffer.bytes_used_ =
+      device_buffer.flags & V4L2_BUF_FLAG_ERROR ? 0 : device_buffer.bytesused;
+  buffer.sequence_ = device_buffer.sequence;
+  buffer.timestamp_ns_ = 0;
+  if ((device_buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+      V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+    buffer.timestamp_ns_ =
+        static_cast<int64_t>(device_buffer.timestamp.tv_sec) * 1000000000 +
+        static_cast<int64_t>(device_buffer.timestamp.tv_usec) * 1000;
+  }
+  return true;
+}
+
+void V4L2Device::Queue(size_t index) {
+  if (index >= buffers_.size()) {
+    throw std::invalid_argument("The device has no such buffer!");
+  }
+  v4l2_buffer device_buffer;
+  std::memset(&device_buffer, 0, sizeof(device_buffer));
+  device_buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  device_buffer.memory = V4L2_MEMORY_MMAP;
+  device_buffer.index = static_cast<uint32_t>(index);
+  if (RetryIoctl(file_descriptor_, VIDIOC_QBUF, &device_buffer) == -1) {
+    ThrowDeviceError("Could not queue a capture buffer");
+  }
+}
+#else
+V4L2Device::V4L2Device(const std::string& device_name, PixelFormat format,
+                       const cv::Size& frame_size, double frames_per_second,
+                       size_t buffer_count)
+    : file_descriptor_(-1),
+      format_(format),
+      frame_size_(frame_size),
+      bytes_per_line_(0),
+      frames_per_second_(frames_per_second),
+      streaming_(false) {
+  (void)buffer_count;
+  throw std::runtime_error("V4L2 is only available on Linux, so " +
+                           device_name + " cannot be opened");
+}
+
+V4L2Device::~V4L2Device() {
+}
+
+void V4L2Device::Close() {
+}
+
+bool V4L2Device::Dequeue(DeviceBuffer&) {
+  return false;
+}
+
+void V4L2Device::Queue(size_t) {
+}
+#endif
+
+PixelFormat V4L2Device::GetPixelFormat() const {
+  return format_;
+}
+
+cv::Size V4L2Device::GetFrameSize() const {
+  return frame_size_;
+}
+
+size_t V4L2Device::GetBytesPerLine() const {
+  return bytes_per_line_;
+}
+
+double V4L2Device::GetFramesPerSecond() const {
+  return frames_per_second_;
+}
+
+size_t V4L2Device::GetBufferCount() const {
+  return buffers_.size();
+}
+}  // namespace gesturerecognition
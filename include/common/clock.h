@@ -0,0 +1,95 @@
+#ifndef FINAL_PROJECT_CLOCK_H
+#define FINAL_PROJECT_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace common {
+
+/**
+ * Returns the current time of the steady clock in nanoseconds. Every
+ * timestamp in the pipeline(capture times, note trigger times, stage timings)
+ * is taken with this function so that they can be compared with each other.
+ */
+inline int64_t GetTimestampNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * Converts a duration in nanoseconds to milliseconds.
+ */
+inline double NanosecondsToMilliseconds(int64_t nanoseconds) {
+  return static_cast<double>(nanoseconds) / 1e6;
+}
+
+/**
+ * Returns the CPU time the calling thread has used in nanoseconds, or the
+ * process' CPU time where threads are not timed separately.
+ */
+inline int64_t GetThreadCpuTimeNanoseconds() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  timespec time;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0) {
+    return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+  }
+#endif
+  return static_cast<int64_t>(std::clock()) * 1000000000 / CLOCKS_PER_SEC;
+}
+
+/**
+ * A source of timestamps in nanoseconds. The pipeline takes its timestamps
+ * from a Clock so that replays can run on a synthetic clock and produce the
+ * same timings every time.
+ */
+class Clock {
+ public:
+  virtual ~Clock() = default;
+  virtual int64_t GetTimestampNanoseconds() const = 0;
+};
+
+/**
+ * The steady clock, i.e common::GetTimestampNanoseconds.
+ */
+class SteadyClock : public Clock {
+ public:
+  int64_t GetTimestampNanoseconds() const override {
+    return common::GetTimestampNanoseconds();
+  }
+};
+
+/**
+ * A clock that only moves when it is told to, e.g by one frame interval per
+ * frame of a recorded video. Work done between two ticks takes no time on
+ * this clock, so only the latency added by the algorithms(e.g frames held by
+ * the hand tracker) is measured.
+ */
+class SyntheticClock : public Clock {
+ public:
+  explicit SyntheticClock(int64_t start_time_ns = 0) : time_ns_(start_time_ns) {
+  }
+  int64_t GetTimestampNanoseconds() const override {
+    return time_ns_;
+  }
+  void Advance(int64_t duration_ns) {
+    time_ns_ += duration_ns;
+  }
+  void Set(int64_t time_ns) {
+    time_ns_ = time_ns;
+  }
+
+ private:
+  int64_t time_ns_;
+};
+
+/**
+ * Returns the clock used by default by everything that takes a Clock.
+ */
+inline const Clock& GetSteadyClock() {
+  static const SteadyClock steady_clock;
+  return steady_clock;
+}
+}  // namespace common
+#endif  // FINAL_PROJECT_CLOCK_H
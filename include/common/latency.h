@@ -0,0 +1,91 @@
+#ifndef FINAL_PROJECT_LATENCY_H
+#define FINAL_PROJECT_LATENCY_H
+
+#include <cstdint>
+#include <string>
+
+#include "common/metrics.h"
+
+namespace common {
+
+/**
+ * The times at which one frame passed each point of GestureWrapper::Update,
+ * taken from the pipeline's Clock.
+ */
+struct FrameTimestamps {
+  int64_t capture_start_ns = 0;  // When the frame was requested
+  int64_t capture_ns = 0;        // When the frame arrived: its capture time
+  int64_t vision_done_ns = 0;    // When its hands had been extracted
+  int64_t tracking_done_ns = 0;  // When both hand trackers had seen it
+};
+
+// The onset of a press whose first frame is not known. Any other value,
+// including 0, is a time: a synthetic clock starts at 0.
+const int64_t UNKNOWN_ONSET_NS = -1;
+
+/**
+ * The times behind a single key press, taken from the pipeline's Clock.
+ */
+struct PressTiming {
+  int midi_note;
+  // Capture time of the first frame showing the press, or UNKNOWN_ONSET_NS
+  int64_t onset_ns;
+  int64_t capture_ns;  // Capture time of the frame the press was played from
+  int64_t trigger_ns;  // When the voice was started
+};
+
+/**
+ * How long each part of the pipeline delayed a note, in nanoseconds. The
+ * parts add up to the time from the finger being bent to the note starting.
+ */
+struct NoteLatency {
+  int midi_note;
+  int64_t capture_ns;           // Reading the frame from the camera
+  int64_t vision_ns;            // Filtering and extracting the hands
+  int64_t tracker_hold_ns;      // Frames the tracker waited for, and tracking
+  int64_t audio_scheduling_ns;  // From the tracker's decision to the voice
+
+  int64_t GetTotal() const;
+
+  /**
+   * Returns the latencies as a line of text, in milliseconds.
+   */
+  std::string ToString() const;
+};
+
+/**
+ * Splits the latency of a press into its parts.
+ * @param frame   the timestamps of the frame the press was played from
+ * @param press   the timing of the press
+ * @return        the latency of each part
+ */
+NoteLatency ComputeNoteLatency(const FrameTimestamps& frame,
+                               const PressTiming& press);
+
+/**
+ * Records note latencies into the latency.* histograms of a registry.
+ */
+class NoteLatencyRecorder {
+ public:
+  /**
+   * Constructor.
+   * @param metrics   the registry to record into. Must outlive the recorder.
+   */
+  explicit NoteLatencyRecorder(MetricsRegistry& metrics);
+
+  void Record(const NoteLatency& latency);
+
+  /**
+   * Returns the histogram of the total latency of every note.
+   */
+  const LatencyHistogram& GetTotalHistogram() const;
+
+ private:
+  LatencyHistogram& capture_histogram_;
+  LatencyHistogram& vision_histogram_;
+  LatencyHistogram& tracker_hold_histogram_;
+  LatencyHistogram& audio_scheduling_histogram_;
+  LatencyHistogram& total_histogram_;
+};
+}  // namespace common
+#endif  // FINAL_PROJECT_LATENCY_H
@@ -0,0 +1,168 @@
+#ifndef FINAL_PROJECT_METRICS_H
+#define FINAL_PROJECT_METRICS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/thread_policy.h"
+#include "nlohmann/json.hpp"
+
+namespace common {
+
+/**
+ * A value that only goes up, such as the number of frames captured.
+ */
+class Counter {
+ public:
+  Counter();
+  void Increment(uint64_t amount = 1);
+  uint64_t Get() const;
+
+ private:
+  std::atomic<uint64_t> value_;
+};
+
+/**
+ * A value that is overwritten, such as the current frame rate.
+ */
+class Gauge {
+ public:
+  Gauge();
+  void Set(double value);
+  double Get() const;
+
+ private:
+  std::atomic<double> value_;
+};
+
+/**
+ * A histogram of durations in nanoseconds with a bounded relative error, in
+ * the style of HdrHistogram. Every power of two range is split into
+ * SUB_BUCKETS linear buckets, so a percentile is off by at most
+ * 1 / (2 * SUB_BUCKETS) of its value. Recording is a few relaxed atomic
+ * operations and never allocates or blocks.
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  /**
+   * Adds a duration to the histogram. Negative durations count as 0, and
+   * durations above MAX_VALUE count as MAX_VALUE.
+   * @param value_ns  the duration in nanoseconds
+   */
+  void Record(int64_t value_ns);
+
+  uint64_t GetCount() const;
+  int64_t GetMax() const;
+  double GetMean() const;
+
+  /**
+   * Returns the value below which the given percentage of the durations lie.
+   * @param percentile  between 0 and 100
+   * @return            the duration in nanoseconds, or 0 if it is empty.
+   */
+  int64_t GetPercentile(double percentile) const;
+
+  static const int SUB_BUCKET_BITS = 5;
+  static const int64_t SUB_BUCKETS = int64_t(1) << SUB_BUCKET_BITS;
+  static const int MAX_VALUE_BITS = 40;  // About 18 minutes
+  static const int64_t MAX_VALUE = (int64_t(1) << MAX_VALUE_BITS) - 1;
+  static const size_t NUMBER_OF_BUCKETS =
+      (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+ private:
+  /**
+   * Returns the index of the bucket that value falls in.
+   */
+  static size_t GetBucketIndex(int64_t value);
+
+  /**
+   * Returns the value in the middle of a bucket.
+   */
+  static int64_t GetBucketValue(size_t index);
+
+  std::atomic<uint64_t> buckets_[NUMBER_OF_BUCKETS];
+  std::atomic<uint64_t> count_;
+  std::atomic<int64_t> sum_;
+  std::atomic<int64_t> max_;
+};
+
+/**
+ * Holds every named counter, gauge and histogram of the program. Looking a
+ * metric up by name takes a lock, so callers on the per-frame path look their
+ * metrics up once and keep the returned reference, which stays valid for the
+ * lifetime of the registry. Updating a metric is lock-free.
+ */
+class MetricsRegistry {
+ public:
+  /**
+   * Returns the metric with the given name, creating it on first use.
+   */
+  Counter& GetCounter(const std::string& name);
+  Gauge& GetGauge(const std::string& name);
+  LatencyHistogram& GetHistogram(const std::string& name);
+
+  /**
+   * Returns every metric as JSON. Histograms are reported in milliseconds.
+   */
+  nlohmann::json ToJson() const;
+
+  /**
+   * Returns one short line of text per metric, to be drawn on screen.
+   */
+  std::vector<std::string> GetOverlayLines() const;
+
+ private:
+  mutable std::mutex registration_mutex_;
+  std::map<std::string, std::unique_ptr<Counter>> counters_;
+  std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+  std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms_;
+};
+
+/**
+ * Writes the registry as JSON to a file every few seconds, from a background
+ * thread, and once more when it is destroyed.
+ */
+class MetricsFileWriter {
+ public:
+  /**
+   * Constructor. Starts the writing thread.
+   * @param registry            the metrics to write. Must outlive the writer.
+   * @param file_name           the file to overwrite with every dump
+   * @param dump_interval_ms    how often the file is rewritten
+   * @param thread_policies     applied to the writing thread as the metrics
+   *                            thread, unless it is nullptr. Must outlive the
+   *                            writer.
+   */
+  MetricsFileWriter(const MetricsRegistry& registry,
+                    const std::string& file_name, int dump_interval_ms,
+                    ThreadPolicies* thread_policies = nullptr);
+
+  /**
+   * Stops the writing thread and writes the final values.
+   */
+  ~MetricsFileWriter();
+
+ private:
+  void WriteLoop();
+  void WriteFile();
+
+  const MetricsRegistry& registry_;
+  const std::string file_name_;
+  const int dump_interval_ms_;
+  ThreadPolicies* const thread_policies_;
+  bool running_;  // Guarded by write_mutex_
+  std::mutex write_mutex_;
+  std::condition_variable write_condition_;  // Wakes the thread on exit
+  std::thread write_thread_;
+};
+}  // namespace common
+#endif  // FINAL_PROJECT_METRICS_H
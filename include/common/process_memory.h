@@ -0,0 +1,14 @@
+#ifndef FINAL_PROJECT_PROCESS_MEMORY_H
+#define FINAL_PROJECT_PROCESS_MEMORY_H
+
+#include <cstdint>
+
+namespace common {
+
+/**
+ * Returns the resident set size of the process in bytes, i.e how much of its
+ * memory is in RAM, or -1 where it is not known. Only Linux reports it.
+ */
+int64_t GetResidentMemoryBytes();
+}  // namespace common
+#endif  // FINAL_PROJECT_PROCESS_MEMORY_H
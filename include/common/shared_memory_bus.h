@@ -0,0 +1,175 @@
+#ifndef FINAL_PROJECT_SHARED_MEMORY_BUS_H
+#define FINAL_PROJECT_SHARED_MEMORY_BUS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace common {
+
+struct BusHeader;
+
+/**
+ * What a message on the bus holds. Its payload layout is defined by whoever
+ * publishes it, e.g gesturerecognition/bus_messages.h.
+ */
+enum class BusMessageType : uint32_t {
+  PADDING = 0,  // Fills the end of the ring, never returned to readers
+  FRAME = 1,
+  MASK = 2,
+  HANDS = 3,
+  NOTE_EVENT = 4,
+  RLE_MASK = 5  // A mask as runs, see gesturerecognition::RleMask
+};
+
+/**
+ * A message read from the bus. Its data points into the shared memory, so it
+ * is only guaranteed to be whole if SharedMemoryBusReader::IsValid still
+ * returns true after it was used.
+ */
+struct BusMessage {
+  BusMessageType type;
+  uint64_t sequence;  // Counts every message the writer published
+  int64_t timestamp_ns;
+  const unsigned char* data;
+  size_t size;
+  uint64_t position;  // Where it starts in the ring, for IsValid
+};
+
+/**
+ * Publishes messages into a ring buffer in POSIX shared memory, which any
+ * number of SharedMemoryBusReaders, in any process, read in place. The writer
+ * never waits for readers: it overwrites the oldest messages, and a reader
+ * which falls a whole ring behind is told so. Only one thread may publish.
+ */
+class SharedMemoryBusWriter {
+ public:
+  /**
+   * Creates the shared memory, replacing any left behind under the same name.
+   * Throws std::invalid_argument if the capacity is under 4 KB, and
+   * std::runtime_error if it cannot be created.
+   * @param name        the POSIX name, e.g /gesture-piano
+   * @param capacity    the bytes of messages the ring holds
+   */
+  SharedMemoryBusWriter(const std::string& name, size_t capacity);
+
+  /**
+   * Tells the readers the bus is closed, and removes the shared memory name.
+   * Readers which have it open keep their mapping.
+   */
+  ~SharedMemoryBusWriter();
+
+  SharedMemoryBusWriter(const SharedMemoryBusWriter&) = delete;
+  SharedMemoryBusWriter& operator=(const SharedMemoryBusWriter&) = delete;
+
+  /**
+   * Reserves a message in the ring, for the caller to write its payload into
+   * directly. Throws std::invalid_argument if it is bigger than
+   * GetMaxMessageSize, and std::logic_error if the last message was not
+   * ended.
+   * @return    where the size bytes of the payload go
+   */
+  unsigned char* BeginMessage(BusMessageType type, size_t size,
+                              int64_t timestamp_ns);
+
+  /**
+   * Publishes the message reserved by BeginMessage and wakes the readers.
+   */
+  void EndMessage();
+
+  /**
+   * Copies the payload into a message and publishes it.
+   */
+  void Publish(BusMessageType type, const void* data, size_t size,
+               int64_t timestamp_ns);
+
+  /**
+   * Returns the largest payload a message can have, which is a little under a
+   * third of the capacity, so that publishing a message never overwrites the
+   * one before it.
+   */
+  size_t GetMaxMessageSize() const;
+
+  uint64_t GetPublishedMessages() const;
+
+ private:
+  const std::string name_;
+  void* memory_;
+  size_t memory_size_;
+  BusHeader* header_;
+  unsigned char* ring_;
+  uint64_t write_position_;  // Where the last published message ends
+  uint64_t message_end_;     // Where the message being written ends
+  uint64_t next_sequence_;
+  bool writing_;  // Between BeginMessage and EndMessage
+};
+
+/**
+ * The result of SharedMemoryBusReader::Next.
+ */
+enum class BusReadResult {
+  MESSAGE,     // The next message was read
+  NO_MESSAGE,  // Every published message has been read
+  OVERRUN,     // The writer overwrote messages before they were read
+  CLOSED       // Every message has been read and the writer is gone
+};
+
+/**
+ * Reads the messages of a SharedMemoryBusWriter in place, from the first one
+ * published after it was opened. Reading never blocks the writer.
+ */
+class SharedMemoryBusReader {
+ public:
+  /**
+   * Maps the bus read only. Throws std::runtime_error if there is no bus
+   * with the name, or it was made by an incompatible version.
+   */
+  explicit SharedMemoryBusReader(const std::string& name);
+  ~SharedMemoryBusReader();
+
+  SharedMemoryBusReader(const SharedMemoryBusReader&) = delete;
+  SharedMemoryBusReader& operator=(const SharedMemoryBusReader&) = delete;
+
+  /**
+   * Reads the next message. On an overrun, the reader skips every message
+   * published so far, and the messages it missed are counted in
+   * GetLostMessages once the next one is read.
+   * @param message     set to the message if MESSAGE is returned
+   */
+  BusReadResult Next(BusMessage& message);
+
+  /**
+   * Returns whether the writer has not started overwriting the message yet.
+   * Call it after using the message's data: if it returns false, the data
+   * that was used may have been torn.
+   */
+  bool IsValid(const BusMessage& message) const;
+
+  /**
+   * Waits until a message is published or the writer is closed.
+   * @param timeout_ms  the most to wait
+   * @return            false if it timed out
+   */
+  bool Wait(int timeout_ms);
+
+  uint64_t GetOverruns() const;
+  uint64_t GetLostMessages() const;
+
+ private:
+  /**
+   * Skips every message published so far, after the writer lapped us.
+   */
+  BusReadResult Overrun();
+
+  void* memory_;
+  size_t memory_size_;
+  const BusHeader* header_;
+  const unsigned char* ring_;
+  uint64_t read_position_;
+  uint64_t next_sequence_;  // The sequence the next message should have
+  bool has_read_;           // Whether next_sequence_ is known
+  uint64_t overruns_;
+  uint64_t lost_messages_;
+};
+}  // namespace common
+#endif  // FINAL_PROJECT_SHARED_MEMORY_BUS_H
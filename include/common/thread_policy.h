@@ -0,0 +1,150 @@
+#ifndef FINAL_PROJECT_THREAD_POLICY_H
+#define FINAL_PROJECT_THREAD_POLICY_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace common {
+
+// The roles of the threads a policy can be given for.
+// Captures the frames, runs the vision stages and triggers the notes.
+const char* const PIPELINE_THREAD = "pipeline";
+const char* const AUDIO_THREAD = "audio";  // Mixes the playing voices
+const char* const BACKGROUND_THREAD = "background";  // BackgroundLearner
+const char* const RECORDER_THREAD = "recorder";  // PerformanceRecorder
+const char* const METRICS_THREAD = "metrics";  // MetricsFileWriter
+// AsyncKeypointDetector
+const char* const KEYPOINT_THREAD = "keypoints";
+// The workers of a FilterGraph
+const char* const FILTER_THREAD = "filter";
+
+enum class SchedulingPolicy { OTHER, FIFO, ROUND_ROBIN };
+
+/**
+ * Parses "other", "fifo" or "rr". Throws std::invalid_argument otherwise.
+ */
+SchedulingPolicy ParseSchedulingPolicy(const std::string& name);
+
+std::string ToString(SchedulingPolicy policy);
+
+/**
+ * What a thread asks the OS for.
+ */
+struct ThreadPolicy {
+  std::vector<int> cpus;  // The cores it may run on. Empty runs on any core
+  SchedulingPolicy scheduling = SchedulingPolicy::OTHER;
+  int priority = 0;  // The real-time priority, for FIFO and ROUND_ROBIN only
+};
+
+/**
+ * What a thread actually got, which is less than it asked for when the
+ * process lacks the privileges or the cores do not exist.
+ */
+struct AppliedThreadPolicy {
+  std::string thread_name;
+  std::vector<int> cpus;  // The cores it is pinned to, empty if it is not
+  SchedulingPolicy scheduling = SchedulingPolicy::OTHER;
+  int priority = 0;
+  std::vector<std::string> failures;  // What could not be applied, and why
+
+  /**
+   * E.g "gp-audio: cpus 2, fifo 70".
+   */
+  std::string ToString() const;
+};
+
+/**
+ * The policy of every thread role, and how the process memory is handled.
+ */
+struct ThreadPolicyConfig {
+  // Locks the pages of the process in memory, so that no thread ever waits
+  // for a page to be read back from swap. See LockProcessMemory.
+  bool lock_memory = false;
+  // Touched on every thread a policy is applied to, so that its stack does
+  // not fault in later. Must be well below the thread's stack size.
+  size_t prefault_stack_bytes = 0;
+  std::map<std::string, ThreadPolicy> threads;  // By role
+
+  /**
+   * Reads lock_memory, prefault_stack_kb and threads, which maps each role
+   * to its cpus, scheduling and priority. Roles which are left out keep the
+   * OS defaults. Throws std::invalid_argument on an unknown scheduling
+   * policy.
+   */
+  static ThreadPolicyConfig FromJson(const nlohmann::json& json);
+};
+
+/**
+ * Applies the configured policies to the threads of the pipeline, each from
+ * the thread itself, and keeps what was applied so that it can be reported.
+ * Nothing fails for lack of privileges: the thread keeps the OS default for
+ * whatever it could not get. Thread safe.
+ */
+class ThreadPolicies {
+ public:
+  explicit ThreadPolicies(const ThreadPolicyConfig& config);
+
+  /**
+   * Names the calling thread gp-<role>, pins it, sets its scheduling policy
+   * and prefaults its stack. Applying a role again, from a thread which
+   * replaced the last one, replaces it in the report.
+   * @param role    one of the thread roles, e.g AUDIO_THREAD
+   * @return        the policy it got
+   */
+  AppliedThreadPolicy Apply(const std::string& role);
+
+  /**
+   * Locks the process memory if the config asks for it.
+   * @return    false if it asked for it and it failed
+   */
+  bool LockMemory();
+
+  /**
+   * Returns one line for the memory lock, if it was asked for, and one for
+   * every thread a policy was applied to.
+   */
+  std::vector<std::string> GetReport() const;
+
+ private:
+  const ThreadPolicyConfig config_;
+  mutable std::mutex report_mutex_;
+  std::string memory_report_;  // Empty until LockMemory asked for a lock
+  std::vector<AppliedThreadPolicy> applied_;
+};
+
+/**
+ * Applies the policy to the calling thread.
+ * @param thread_name             at most 15 characters are kept
+ * @param policy                  the policy to ask for
+ * @param prefault_stack_bytes    the stack to prefault
+ * @return                        the policy it got
+ */
+AppliedThreadPolicy ApplyThreadPolicy(const std::string& thread_name,
+                                      const ThreadPolicy& policy,
+                                      size_t prefault_stack_bytes);
+
+/**
+ * Locks every current page of the process in memory, and every future one
+ * unless the process is held to a memlock limit.
+ * @param detail    set to the reason if it fails, or to what was not locked
+ * @return          whether the memory was locked
+ */
+bool LockProcessMemory(std::string& detail);
+
+/**
+ * Touches the next bytes of the calling thread's stack.
+ */
+void PrefaultStack(size_t bytes);
+
+/**
+ * Touches every page of the buffer, leaving its contents as they were, so that
+ * the first real access does not page fault.
+ */
+void PrefaultBuffer(void* data, size_t bytes);
+}  // namespace common
+#endif  // FINAL_PROJECT_THREAD_POLICY_H
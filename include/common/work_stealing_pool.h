@@ -0,0 +1,73 @@
+#ifndef FINAL_PROJECT_WORK_STEALING_POOL_H
+#define FINAL_PROJECT_WORK_STEALING_POOL_H
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace common {
+
+/**
+ * Runs a batch of independent tasks on a fixed number of threads. The tasks
+ * are dealt out to a queue per worker, which takes them from the front of its
+ * own queue. A worker whose queue runs dry steals from the back of another's,
+ * so a worker stuck on a long task does not hold back the ones queued behind
+ * it. Tasks are meant to be coarse, e.g a whole recorded session each.
+ */
+class WorkStealingPool {
+ public:
+  /**
+   * Constructor. Throws std::invalid_argument if workers is 0.
+   * @param workers   the number of threads Run runs the tasks on
+   */
+  explicit WorkStealingPool(size_t workers);
+
+  /**
+   * Runs every task and returns once all of them have finished. The tasks
+   * are dealt out in order, so putting the longest first balances the
+   * workers best. If tasks throw, the rest still run and one of their
+   * exceptions is rethrown once they are done.
+   */
+  void Run(const std::vector<std::function<void()>>& tasks);
+
+  size_t GetWorkerCount() const;
+
+  /**
+   * Returns how many tasks of the last Run a worker took from another's
+   * queue.
+   */
+  size_t GetStolenTasks() const;
+
+ private:
+  /**
+   * A worker's queue of task indices, guarded by its own mutex so that
+   * workers only contend while stealing.
+   */
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<size_t> tasks;
+  };
+
+  /**
+   * Runs tasks until every queue is empty.
+   * @param error   set to the first exception a task threw
+   */
+  void RunWorker(size_t worker, const std::vector<std::function<void()>>& tasks,
+                 std::exception_ptr& error);
+
+  /**
+   * Takes the next task for a worker, from its own queue or another's.
+   * @return  false once every queue is empty
+   */
+  bool TakeTask(size_t worker, size_t& task);
+
+  const size_t WORKERS_;
+  std::vector<TaskQueue> queues_;
+  std::mutex stolen_tasks_mutex_;
+  size_t stolen_tasks_;  // Guarded by stolen_tasks_mutex_
+};
+}  // namespace common
+#endif  // FINAL_PROJECT_WORK_STEALING_POOL_H
@@ -6,11 +6,22 @@
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
+#include "pianoapp/cinder_backends.h"
 #include "pianoapp/piano_engine.h"
 #include "gesturerecognition/calibration.h"
 #include "gesturerecognition/hand_extractor.h"
 #include "gesturerecognition/hand_tracker.h"
 #include "gesturerecognition/gesture_wrapper.h"
+#include "pianoapp/performance_recorder.h"
+#include "common/clock.h"
+#include "common/latency.h"
+#include "common/metrics.h"
+#include "common/shared_memory_bus.h"
+#include "common/thread_policy.h"
+
+#include <memory>
+#include <string>
+#include <vector>
 
 
 namespace finalproject {
@@ -38,8 +49,34 @@ class FinalProjectApp : public ci::app::App {
   void keyDown(ci::app::KeyEvent event) override;
 
  private:
+  /**
+   * Draws the metrics in the top left corner of the window.
+   */
+  void DrawMetricsOverlay();
+
   gesturerecognition::ProgramSettings settings;//Loads all settings from config_file.
+  common::ThreadPolicies thread_policies;  // Constructed before any thread
   gesturerecognition::GestureWrapper gesture_wrapper;
+  piano::CinderAudioBackend audio_backend;
+  piano::CinderRenderer renderer;
   piano::PianoEngine piano_engine;
+  std::unique_ptr<piano::PerformanceRecorder> recorder;
+  // Publishes the pipeline's output when settings.bus_name is set.
+  std::unique_ptr<common::SharedMemoryBusWriter> bus;
+  std::vector<piano::NoteEvent> replay_events;  // Empty unless replaying
+  size_t replay_cursor;  // Index of the next event in replay_events to play
+  int64_t replay_start_time_ns;
+  common::MetricsRegistry metrics;
+  std::unique_ptr<common::MetricsFileWriter> metrics_writer;
+  common::NoteLatencyRecorder latency_recorder;
+  // Replays of a video file run on this clock, one frame interval per update,
+  // so that their latencies are the same on every run.
+  common::SyntheticClock replay_clock;
+  int64_t replay_frame_interval_ns;  // 0 unless the replay clock is used
+  bool show_metrics_overlay;  // Toggled with the M key
+  bool time_to_playable_reported;  // Printed once, when recognition starts
+  const float OVERLAY_LINE_HEIGHT = 14;
+  const float OVERLAY_WIDTH = 380;
+  const int64_t DEFAULT_FRAME_INTERVAL_NS = 1000000000 / 30;
 };
 }  // namespace finalproject
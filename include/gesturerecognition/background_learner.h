@@ -0,0 +1,87 @@
+#ifndef FINAL_PROJECT_BACKGROUND_LEARNER_H
+#define FINAL_PROJECT_BACKGROUND_LEARNER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "common/metrics.h"
+#include "common/thread_policy.h"
+#include "gesturerecognition/background_model.h"
+
+namespace gesturerecognition {
+
+/**
+ * Learns the background on its own thread, so that updating the model is
+ * kept off the per-frame path. The vision thread subtracts the background
+ * with a frozen snapshot of the model, and every update is published as a
+ * new snapshot which replaces the old one atomically: a snapshot that is
+ * being used stays alive until its last user lets go of it.
+ */
+class BackgroundLearner {
+ public:
+  /**
+   * Constructor. Starts the learning thread.
+   * @param model             the model to start from, which becomes the first
+   *                          snapshot
+   * @param thread_policies   applied to the learning thread as the background
+   *                          thread, unless it is nullptr. Must outlive the
+   *                          learner.
+   */
+  BackgroundLearner(const BackgroundModel& model,
+                    common::ThreadPolicies* thread_policies = nullptr);
+
+  /**
+   * Stops the learning thread, dropping any update it has not started.
+   */
+  ~BackgroundLearner();
+
+  /**
+   * Returns the latest snapshot of the model. Never blocks.
+   */
+  std::shared_ptr<const BackgroundModel> GetSnapshot() const;
+
+  /**
+   * Hands a frame to the learning thread, unless it is still busy with the
+   * last one, in which case the frame is dropped.
+   * @param input_image     a BGR frame. It is copied.
+   * @param learning_rate   see BackgroundModel::Update
+   * @param update_mask     only its nonzero pixels are learnt. It is copied.
+   * @return                false if the frame was dropped
+   */
+  bool Learn(const cv::Mat& input_image, double learning_rate,
+             const cv::Mat& update_mask);
+
+  /**
+   * Sets the registry the duration and the number of updates are recorded
+   * in. Pass nullptr to stop recording. The learner does not own the
+   * registry.
+   */
+  void SetMetrics(common::MetricsRegistry* metrics);
+
+ private:
+  void LearnLoop();
+
+  BackgroundModel model_;  // Only touched by the learning thread
+  // Read and replaced with std::atomic_load and std::atomic_store.
+  std::shared_ptr<const BackgroundModel> snapshot_;
+  cv::Mat pending_image_;  // The next frame to learn, guarded by learn_mutex_
+  cv::Mat pending_mask_;
+  double pending_learning_rate_;
+  bool has_pending_frame_;  // Guarded by learn_mutex_
+  bool is_learning_;        // Guarded by learn_mutex_
+  bool running_;            // Guarded by learn_mutex_
+  std::mutex learn_mutex_;
+  std::condition_variable learn_condition_;
+  common::ThreadPolicies* const thread_policies_;
+  // Null unless SetMetrics was called with a registry.
+  std::atomic<common::Counter*> update_counter_;
+  std::atomic<common::Counter*> dropped_update_counter_;
+  std::atomic<common::LatencyHistogram*> update_histogram_;
+  std::thread learn_thread_;
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_BACKGROUND_LEARNER_H
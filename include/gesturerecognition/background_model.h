@@ -0,0 +1,114 @@
+#ifndef FINAL_PROJECT_BACKGROUND_MODEL_H
+#define FINAL_PROJECT_BACKGROUND_MODEL_H
+
+#include <cstdint>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+
+namespace gesturerecognition {
+
+/**
+ * A background model which keeps a single Gaussian per pixel: the mean color,
+ * and one variance shared by the channels. It learns either BGR images or
+ * single channel luma images. It is lighter than MOG2 and,
+ * unlike it, its statistics can be copied and saved to a calibration profile.
+ * The thresholds follow the defaults of MOG2.
+ */
+class BackgroundModel {
+ public:
+  /**
+   * Constructor. The model is empty until it is first updated.
+   * @param variance_threshold  a pixel is foreground when its squared distance
+   *                            to the mean is above this many variances
+   */
+  BackgroundModel(double variance_threshold = 16);
+
+  /**
+   * Computes the foreground mask of the image, then learns the image.
+   * @param input_image     a BGR or luma image
+   * @param foreground_mask set to 255 for foreground pixels and 0 elsewhere
+   * @param learning_rate   see Update
+   */
+  void Apply(const cv::Mat& input_image, cv::Mat& foreground_mask,
+             double learning_rate);
+
+  /**
+   * Computes the foreground mask of the image without changing the model. If
+   * the model is empty, or of another size or number of channels, every pixel
+   * is foreground.
+   * @param input_image     a BGR or luma image
+   * @param foreground_mask set to 255 for foreground pixels and 0 elsewhere
+   */
+  void ComputeForeground(const cv::Mat& input_image,
+                         cv::Mat& foreground_mask) const;
+
+  /**
+   * Moves the mean and variance of every pixel towards the image. An empty
+   * model, or one of another size or number of channels, is started from the
+   * image instead.
+   * @param input_image     a BGR or luma image
+   * @param learning_rate   how far the statistics move, between 0 and 1
+   * @param update_mask     if not empty, only its nonzero pixels are learnt
+   */
+  void Update(const cv::Mat& input_image, double learning_rate,
+              const cv::Mat& update_mask = cv::Mat());
+
+  /**
+   * Returns a copy of the model which shares no memory with it.
+   */
+  BackgroundModel Clone() const;
+
+  bool IsEmpty() const;
+  cv::Size GetSize() const;
+
+  /**
+   * Returns the number of channels of the images learnt, or 0 if empty.
+   */
+  int GetChannels() const;
+
+  /**
+   * Returns the number of frames learnt since the model was started.
+   */
+  uint64_t GetFramesLearnt() const;
+
+  /**
+   * Returns the mean variance of the pixels, or 0 if the model is empty.
+   */
+  double GetMeanVariance() const;
+
+  /**
+   * Sets image to the mean of every pixel, in 8 bits. It is left empty if the
+   * model is.
+   */
+  void GetMeanImage(cv::Mat& image) const;
+
+  /**
+   * Writes the statistics of the model in binary.
+   */
+  void Write(std::ostream& stream) const;
+
+  /**
+   * Replaces the statistics of the model with ones written by Write. Throws
+   * std::invalid_argument if the stream does not hold a model.
+   */
+  void Read(std::istream& stream);
+
+ private:
+  /**
+   * Returns whether the model was learnt from images like this one.
+   */
+  bool Matches(const cv::Mat& input_image) const;
+
+  /**
+   * Starts the model from the image, with the initial variance everywhere.
+   */
+  void Reset(const cv::Mat& input_image);
+
+  double variance_threshold_;
+  cv::Mat mean_;      // CV_32FC3 or CV_32FC1, the mean of every pixel
+  cv::Mat variance_;  // CV_32FC1, the variance of every pixel
+  uint64_t frames_learnt_;
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_BACKGROUND_MODEL_H
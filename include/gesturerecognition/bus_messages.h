@@ -0,0 +1,71 @@
+#ifndef FINAL_PROJECT_BUS_MESSAGES_H
+#define FINAL_PROJECT_BUS_MESSAGES_H
+
+#include <opencv2/opencv.hpp>
+#include <utility>
+
+#include "common/shared_memory_bus.h"
+#include "gesturerecognition/frame_source.h"
+#include "gesturerecognition/hand_extractor.h"
+#include "gesturerecognition/rle_mask.h"
+
+namespace gesturerecognition {
+
+/**
+ * Publishes a frame as a FRAME message. Its pixels are copied straight into
+ * the bus, in whatever format they were captured in.
+ * @param bus               the bus to publish on
+ * @param frame             the frame
+ * @param capture_time_ns   the message's timestamp
+ */
+void PublishFrame(common::SharedMemoryBusWriter& bus,
+                  const CapturedFrame& frame, int64_t capture_time_ns);
+
+/**
+ * Publishes a mask, e.g the combined filter image, as a MASK message.
+ */
+void PublishMask(common::SharedMemoryBusWriter& bus, const cv::Mat& mask,
+                 int64_t capture_time_ns);
+
+/**
+ * Publishes a mask in its run length encoding as an RLE_MASK message, which
+ * takes a small fraction of the bus a MASK message does.
+ */
+void PublishRleMask(common::SharedMemoryBusWriter& bus, const RleMask& mask,
+                    int64_t capture_time_ns);
+
+/**
+ * Publishes both hands found in a frame as a HANDS message.
+ */
+void PublishHands(common::SharedMemoryBusWriter& bus,
+                  const std::pair<Hand, Hand>& hands,
+                  int64_t capture_time_ns);
+
+/**
+ * Reads a FRAME message without copying it: the frame's data points into the
+ * bus, which is read only. Check that the message is still valid once done
+ * with the frame.
+ * @return  false if the message is not a well formed frame
+ */
+bool ReadFrame(const common::BusMessage& message, CapturedFrame& frame);
+
+/**
+ * Reads a MASK message without copying it, like ReadFrame.
+ */
+bool ReadMask(const common::BusMessage& message, cv::Mat& mask);
+
+/**
+ * Reads an RLE_MASK message into a mask.
+ * @return  false if the message is not a well formed mask
+ */
+bool ReadRleMask(const common::BusMessage& message, RleMask& mask);
+
+/**
+ * Reads a HANDS message.
+ * @return  false if the message is not a well formed pair of hands
+ */
+bool ReadHands(const common::BusMessage& message,
+               std::pair<Hand, Hand>& hands);
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_BUS_MESSAGES_H
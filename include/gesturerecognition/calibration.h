@@ -8,10 +8,57 @@
 #include <iostream>
 #include <opencv2/objdetect.hpp>
 #include <opencv2/opencv.hpp>
+#include <memory>
 #include <sstream>
 
+#include "common/metrics.h"
+#include "common/thread_policy.h"
+#include "gesturerecognition/background_learner.h"
+#include "gesturerecognition/background_model.h"
+#include "gesturerecognition/filter_graph.h"
+#include "gesturerecognition/frame_source.h"
+#include "gesturerecognition/skin_table.h"
+
 namespace gesturerecognition {
 
+/**
+ * The background subtraction algorithms Calibration can use.
+ */
+enum class BackgroundModelType {
+  MOG2,              // OpenCV's mixture of Gaussians, which cannot be saved
+  RUNNING_GAUSSIAN,  // BackgroundModel, which is saved in profiles
+};
+
+/**
+ * Returns the type with the given name: "mog2" or "running_gaussian". Throws
+ * std::invalid_argument for any other name.
+ */
+BackgroundModelType ParseBackgroundModelType(const std::string& name);
+
+/**
+ * Settings which trade the quality of the filtered image for speed.
+ */
+struct FilterQuality {
+  int morphology_iterations = 3;  // Of both the opening and the closing
+  int median_kernel_size = 5;     // Must be odd, 1 turns the blur off
+  // The HSV filter and the morphology run on the image scaled by this much,
+  // and their result is scaled back up.
+  double segmentation_scale = 1;
+  // The background model is only updated every this many frames. The frames
+  // in between reuse the last foreground mask.
+  int background_update_interval = 1;
+};
+
+/**
+ * A summary of the background model, to watch how it changes over a long
+ * run.
+ */
+struct BackgroundModelState {
+  uint64_t frames_learnt = 0;  // Not known for MOG2
+  double mean_variance = -1;   // Of the pixels, not known for MOG2
+  cv::Mat background_image;    // What the model takes the background to be
+};
+
 /**
  * Class which handles initial setup to detect Hands of the user.
  */
@@ -21,7 +68,9 @@ class Calibration {
               const std::string& hsv_window_name,
               const std::string& bgsub_window_name,
               const std::string& combined_window_name, double learning_rate,
-              cv::Size hsv_window_size);
+              cv::Size hsv_window_size,
+              BackgroundModelType background_model_type =
+                  BackgroundModelType::MOG2);
 
   /**
    * Processes the image by performing Median Blur, followed by Morphological
@@ -39,25 +88,38 @@ class Calibration {
   cv::Mat FilterImageByHSV(const cv::Mat& input_image);
 
   /**
-   * Performs MOG2 background subtraction on image. Learning rate depends on
+   * Performs background subtraction on image. Learning rate depends on
    * IsBackgroundTraining.
    * @param input_image: the image whose background is to be subtracted
    * @return : the foreground mask of the image
    */
   cv::Mat GetBackgroundSubtractedImage(const cv::Mat& input_image);
 
+  /**
+   * Computes the background mask of the image as GetFinalFilterImage does,
+   * unless the last one is reused because of the background update interval.
+   * @return  the mask, which is also GetLastBackgroundMask
+   */
+  const cv::Mat& SubtractBackground(const cv::Mat& input_image);
+
   /**
    * Creates trackbars in HSV window.
    * @param max_value
    */
   void CreateTrackbars(int max_value);
 
+  /**
+   * Moves the trackbars to the current HSV ranges, after they were set
+   * without them.
+   */
+  void UpdateTrackbars();
+
   /**
    * Returns whether background subtraction is learning or just applying
    * foreground mask
    * @return
    */
-  bool IsBackgroundTraining();
+  bool IsBackgroundTraining() const;
 
   /**
    * Returns whether HSV calibration mode is on or not.
@@ -65,9 +127,127 @@ class Calibration {
    */
   bool IsHSVCalibrating();
 
+  /**
+   * Sets the HSV ranges of the filter directly, instead of through the
+   * trackbars.
+   * @param low   the lowest hue, saturation and value that pass the filter
+   * @param high  the highest hue, saturation and value that pass the filter
+   */
+  void SetHSVRange(const cv::Scalar& low, const cv::Scalar& high);
+
+  /**
+   * Returns the lowest and the highest hue, saturation and value that pass the
+   * filter.
+   */
+  std::pair<cv::Scalar, cv::Scalar> GetHSVRange() const;
+
+  /**
+   * Sets how much quality the filters give up for speed.
+   * @param filter_quality  the new settings
+   */
+  void SetFilterQuality(const FilterQuality& filter_quality);
+
+  const FilterQuality& GetFilterQuality() const;
+
   void SetHSVCalibration(bool boolean);
   void SetBackgroundTraining(bool boolean);
 
+  /**
+   * Moves the learning of the running Gaussian model off the calling thread
+   * outside of training. The foreground is then computed with a frozen
+   * snapshot of the model, and every interval_frames frames a frame is handed
+   * to a BackgroundLearner, which learns it without the hand regions and
+   * swaps in the new snapshot. Has no effect on MOG2.
+   * @param interval_frames   0 learns every frame on the calling thread
+   */
+  void SetAsyncBackgroundUpdates(int interval_frames);
+
+  /**
+   * Sets the regions of the frame that hold the hands, which the background
+   * learner leaves out so that still hands never become background.
+   */
+  void SetHandRegions(const std::vector<cv::Rect>& hand_regions);
+
+  /**
+   * Sets the registry the background learner records its updates in. Pass
+   * nullptr to stop recording. Calibration does not own the registry.
+   */
+  void SetMetrics(common::MetricsRegistry* metrics);
+
+  /**
+   * Sets the policies applied to the thread of the background learner when it
+   * is started. Pass nullptr to leave it with the OS defaults. Calibration
+   * does not own the policies.
+   */
+  void SetThreadPolicies(common::ThreadPolicies* thread_policies);
+
+  /**
+   * Adds the kinds of node the filters of this object are split into:
+   * "segmentation_scale", "hsv_threshold", "background_subtraction",
+   * "median_morphology", "median", "morphology", "and", "or" and
+   * "resize_like". They follow the filter quality as it changes.
+   */
+  void RegisterFilterNodes(FilterNodeRegistry& registry);
+
+  /**
+   * Makes GetFinalFilterImage run BGR frames through a graph of the nodes of
+   * RegisterFilterNodes instead of the fixed order of the filters. The nodes
+   * refer to this object, so it must not be moved once a graph is set. Throws
+   * std::invalid_argument if the description is not a valid graph.
+   * @param description the graph, see FilterGraph. An empty one goes back to
+   *                    the fixed order.
+   * @param threads     the threads the graph's nodes run on
+   */
+  void SetFilterGraph(const nlohmann::json& description, size_t threads);
+
+  /**
+   * Returns the graph the filters run in, or nullptr if they run in their
+   * fixed order.
+   */
+  const FilterGraph* GetFilterGraph() const;
+
+  /**
+   * Saves the HSV ranges and, with the running Gaussian model, the learnt
+   * background to a versioned binary profile.
+   * @param file_name   the profile to overwrite
+   * @return            false if the file could not be written
+   */
+  bool SaveProfile(const std::string& file_name) const;
+
+  /**
+   * Loads a profile written by SaveProfile. The background in the profile is
+   * only loaded if it was learnt by the same type of model as this one uses.
+   * Throws std::invalid_argument if the file is not a profile of this version.
+   * @param file_name   the profile to read
+   * @return            false if the file does not exist
+   */
+  bool LoadProfile(const std::string& file_name);
+
+  /**
+   * Returns whether the background model has learnt a background of the
+   * given size and number of channels, which is only known for the running
+   * Gaussian model.
+   */
+  bool HasTrainedBackground(const cv::Size& size, int channels = 3) const;
+
+  /**
+   * Returns the fraction of the pixels in the last background subtracted
+   * image which were foreground.
+   */
+  double GetLastForegroundFraction() const;
+
+  /**
+   * Returns the state of the background model. Its background image is a
+   * copy.
+   */
+  BackgroundModelState GetBackgroundModelState() const;
+
+  /**
+   * Returns the last background subtracted image used by
+   * GetFinalFilterImage.
+   */
+  const cv::Mat& GetLastBackgroundMask() const;
+
   /**
    * Gets the bitwise_and image of both the background subtracted and HSV
    * filtered image.
@@ -76,6 +256,16 @@ class Calibration {
    */
   cv::Mat GetFinalFilterImage(const cv::Mat& input_image);
 
+  /**
+   * Gets the filtered image of a captured frame. BGR frames are filtered as
+   * above. YUV frames are never converted: the skin is classified through a
+   * YCbCrSkinTable built from the HSV ranges, and the background model learns
+   * their luma, so it must be trained on frames of the same format.
+   * @param frame   the frame to filter
+   * @return        a binary image of the frame's size
+   */
+  cv::Mat GetFinalFilterImage(const CapturedFrame& frame);
+
  private:
   /**
    * Functions to deal with change in trackbar position
@@ -87,6 +277,25 @@ class Calibration {
   static void on_high_S_thresh_trackbar(int, void*);
   static void on_high_V_thresh_trackbar(int, void*);
 
+  /**
+   * Cleans up the skin mask and the last background mask, and returns their
+   * intersection at the size of the background mask.
+   * @param skin_mask   a binary image, possibly scaled down by the
+   *                    segmentation scale
+   */
+  cv::Mat CombineMasks(const cv::Mat& skin_mask);
+
+  /**
+   * Subtracts the background with the learner's snapshot, and hands the
+   * frame to the learner every async_update_interval_ frames.
+   */
+  cv::Mat GetAsyncBackgroundSubtractedImage(const cv::Mat& input_image);
+
+  /**
+   * Takes the learner's latest model back and stops its thread.
+   */
+  void StopBackgroundLearner();
+
   const std::string hsv_window_name_;  // Name of the HSV calibration window:
                                        // Used in CreateTrackbars
   bool train_background;
@@ -94,7 +303,9 @@ class Calibration {
   const std::string bg_subtraction_window_name_;
   const std::string final_filter_window_name_;
   double background_subtraction_learning_rate;
-  cv::Ptr<cv::BackgroundSubtractor> background_subtractor_;
+  const BackgroundModelType background_model_type_;
+  cv::Ptr<cv::BackgroundSubtractor> background_subtractor_;  // Only for MOG2
+  BackgroundModel background_model_;  // Only for the running Gaussian model
   /*
    * The ranges for hue,saturation and values of filter
    */
@@ -105,6 +316,23 @@ class Calibration {
   int high_saturation_;
   int high_value_;
   cv::Size hsv_window_size_;
+  FilterQuality filter_quality_;
+  int frames_since_background_update_;
+  cv::Mat last_background_mask_;  // Reused between background model updates
+  YCbCrSkinTable skin_table_;      // Only used for YUV frames
+  int async_update_interval_;      // 0 when the model learns synchronously
+  int frames_since_async_update_;
+  // Only exists while the running Gaussian model learns asynchronously.
+  std::unique_ptr<BackgroundLearner> background_learner_;
+  std::vector<cv::Rect> hand_regions_;
+  cv::Mat update_mask_;  // Reused for every frame handed to the learner
+  common::MetricsRegistry* metrics_;
+  common::ThreadPolicies* thread_policies_;
+  // Null when the filters run in their fixed order.
+  std::unique_ptr<FilterGraph> filter_graph_;
+  // Hand regions are grown by this fraction of their size on every side, as
+  // the hands move between the frame they were found in and the next.
+  const double HAND_REGION_MARGIN_ = 0.1;
 };
 }  // namespace gesturerecognition
 
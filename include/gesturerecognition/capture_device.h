@@ -0,0 +1,154 @@
+#ifndef FINAL_PROJECT_CAPTURE_DEVICE_H
+#define FINAL_PROJECT_CAPTURE_DEVICE_H
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "gesturerecognition/frame_source.h"
+
+namespace gesturerecognition {
+
+/**
+ * A buffer filled by a CaptureDevice. It belongs to the caller from Dequeue
+ * until it is handed back with Queue.
+ */
+struct DeviceBuffer {
+  size_t index_ = 0;           // Which of the device's buffers this is
+  uchar* data_ = nullptr;      // The frame, laid out as the device's format
+  size_t bytes_used_ = 0;      // How much of the buffer the frame fills
+  uint32_t sequence_ = 0;      // Counts every frame the device captured
+  int64_t timestamp_ns_ = 0;   // On the steady clock, 0 if unknown
+};
+
+/**
+ * A capture device which fills a fixed set of buffers, the way V4L2 streams:
+ * the device only fills buffers that are queued, and drops the frames that
+ * arrive while none is, which shows as a gap in the sequence numbers.
+ */
+class CaptureDevice {
+ public:
+  virtual ~CaptureDevice() = default;
+
+  /**
+   * Waits for the oldest filled buffer and takes it from the device.
+   * @param buffer  set to the filled buffer
+   * @return        false once the device has no more frames
+   */
+  virtual bool Dequeue(DeviceBuffer& buffer) = 0;
+
+  /**
+   * Hands a dequeued buffer back to the device to be filled again.
+   * @param index   the index_ of the buffer
+   */
+  virtual void Queue(size_t index) = 0;
+
+  virtual PixelFormat GetPixelFormat() const = 0;
+  virtual cv::Size GetFrameSize() const = 0;
+  virtual size_t GetBytesPerLine() const = 0;
+  virtual double GetFramesPerSecond() const = 0;
+  virtual size_t GetBufferCount() const = 0;
+};
+
+/**
+ * Stands in for a camera by filling its buffers with the raw YUYV or NV12
+ * frames of a file, stored back to back without a header. When paced, frame
+ * n is due n frame intervals after the first Dequeue and is timestamped with
+ * that time, and the frames which are due while no buffer is queued are
+ * dropped, exactly as a driver would. Otherwise every frame is delivered as
+ * soon as it is asked for, timestamped with the time it was read.
+ */
+class FileCaptureDevice : public CaptureDevice {
+ public:
+  /**
+   * Constructor. Throws std::invalid_argument if the format is not YUYV or
+   * NV12, the size is not even, or there are fewer than 2 buffers.
+   * @param file_name           the raw file
+   * @param format              the layout of every frame in the file
+   * @param frame_size          the size of every frame, in pixels
+   * @param frames_per_second   the rate frames are due at when paced
+   * @param buffer_count        the number of buffers, all queued at the start
+   * @param paced               whether frames arrive at their frame rate
+   */
+  FileCaptureDevice(const std::string& file_name, PixelFormat format,
+                    const cv::Size& frame_size, double frames_per_second,
+                    size_t buffer_count, bool paced);
+
+  bool Dequeue(DeviceBuffer& buffer) override;
+  void Queue(size_t index) override;
+  PixelFormat GetPixelFormat() const override;
+  cv::Size GetFrameSize() const override;
+  size_t GetBytesPerLine() const override;
+  double GetFramesPerSecond() const override;
+  size_t GetBufferCount() const override;
+
+ private:
+  /**
+   * Fills the oldest queued buffer with the next frame of the file, or skips
+   * the frame if no buffer is queued.
+   * @param timestamp_ns    the capture time of the frame
+   */
+  void CaptureFrame(int64_t timestamp_ns);
+
+  /**
+   * Captures every frame that is due by the given time, when paced.
+   */
+  void CaptureDueFrames(int64_t now_ns);
+
+  /**
+   * Returns when the next frame is due, when paced.
+   */
+  int64_t GetNextFrameTime() const;
+
+  std::ifstream file_;
+  const PixelFormat format_;
+  const cv::Size frame_size_;
+  const double frames_per_second_;
+  const bool paced_;
+  const size_t frame_bytes_;
+  std::vector<std::vector<uchar>> buffers_;
+  std::deque<size_t> queued_buffers_;        // Waiting to be filled
+  std::deque<DeviceBuffer> filled_buffers_;  // Waiting to be dequeued
+  uint32_t next_sequence_;
+  int64_t start_time_ns_;  // When frame 0 was due, 0 before the first Dequeue
+  bool end_of_file_;
+};
+
+/**
+ * Reads frames straight out of the buffers of a CaptureDevice, without
+ * copying them: every frame is a header on the buffer it was captured in,
+ * which is handed back to the device by the next Read. The device's
+ * timestamps and dropped frames are passed on.
+ */
+class DeviceFrameSource : public FrameSource {
+ public:
+  /**
+   * Constructor. Throws std::invalid_argument if the device captures BGR.
+   * @param device  the device to read, which the source takes ownership of
+   */
+  explicit DeviceFrameSource(std::unique_ptr<CaptureDevice> device);
+  ~DeviceFrameSource() override;
+
+  bool Read(CapturedFrame& frame) override;
+  double GetFramesPerSecond() const override;
+  cv::Size GetFrameSize() const override;
+  bool CountsDroppedFrames() const override;
+  uint64_t GetDroppedFrames() const override;
+
+ private:
+  std::unique_ptr<CaptureDevice> device_;
+  DeviceBuffer buffer_;      // The buffer of the last frame read
+  bool holds_buffer_;        // Whether buffer_ still has to be queued
+  size_t frame_rows_;        // Rows of the frame's Mat
+  size_t frame_bytes_;       // The least a buffer must hold for a whole frame
+  uint64_t frames_read_;
+  uint32_t last_sequence_;
+  uint64_t dropped_frames_;
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_CAPTURE_DEVICE_H
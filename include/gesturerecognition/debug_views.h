@@ -0,0 +1,92 @@
+#ifndef FINAL_PROJECT_DEBUG_VIEWS_H
+#define FINAL_PROJECT_DEBUG_VIEWS_H
+
+#include <cstdint>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+namespace gesturerecognition {
+
+/**
+ * The OpenCV windows which show the intermediate images of the pipeline.
+ * Every view renders its image with a function which is only called while the
+ * view is open, and no more often than the refresh rate, so views which are
+ * closed cost nothing. The views get windows of their own, or are tiled in a
+ * single window.
+ */
+class DebugViews {
+ public:
+  /**
+   * Renders the image of a view. The image may be left sharing its data with
+   * the pipeline, as it is shown before the pipeline runs again.
+   */
+  typedef std::function<void(cv::Mat& image)> RenderFunction;
+
+  /**
+   * Constructor.
+   * @param refresh_rate        the most times per second the views are
+   *                            rendered, 0 renders them on every Show
+   * @param tiled_window_name   the window every view is tiled in, or empty to
+   *                            give every view a window of its own
+   * @param tile_size           the size of every view in the tiled window
+   */
+  DebugViews(double refresh_rate, const std::string& tiled_window_name,
+             const cv::Size& tile_size);
+
+  /**
+   * Adds a view, which starts closed.
+   * @param name    the title of its window or tile
+   * @param render  renders its image
+   */
+  void AddView(const std::string& name, const RenderFunction& render);
+
+  /**
+   * Opens or closes a view. A view's window is destroyed when it is closed.
+   * Throws std::invalid_argument if there is no view with the name.
+   */
+  void SetViewOpen(const std::string& name, bool open);
+
+  bool IsViewOpen(const std::string& name) const;
+
+  /**
+   * Renders and shows the open views, unless they were shown less than one
+   * refresh interval ago.
+   * @param now_ns  the current time, on the steady clock
+   * @return        whether the views were rendered
+   */
+  bool Show(int64_t now_ns);
+
+ private:
+  struct View {
+    std::string name_;
+    RenderFunction render_;
+    bool open_;
+    cv::Mat image_;  // Reused between renders
+  };
+
+  /**
+   * Returns the view with the name. Throws std::invalid_argument if there is
+   * none.
+   */
+  View& FindView(const std::string& name);
+  const View& FindView(const std::string& name) const;
+
+  /**
+   * Draws the images of the open views into the tiled window.
+   */
+  void ShowTiled(const std::vector<View*>& open_views);
+
+  std::vector<View> views_;
+  const int64_t refresh_interval_ns_;
+  int64_t last_shown_ns_;  // 0 before the first Show
+  const std::string tiled_window_name_;
+  const cv::Size tile_size_;
+  cv::Mat tiled_image_;
+  cv::Mat tile_;
+  bool tiled_window_open_;
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_DEBUG_VIEWS_H
@@ -0,0 +1,208 @@
+#ifndef FINAL_PROJECT_FILTER_GRAPH_H
+#define FINAL_PROJECT_FILTER_GRAPH_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/metrics.h"
+#include "common/thread_policy.h"
+#include "nlohmann/json.hpp"
+
+namespace gesturerecognition {
+
+/**
+ * A stage of a FilterGraph, which computes one image from the images of the
+ * stages it depends on.
+ */
+class FilterNode {
+ public:
+  virtual ~FilterNode() {}
+
+  /**
+   * Computes the node's image. It is never run twice at once, but may run on
+   * any of the graph's threads, at the same time as other nodes.
+   * @param inputs  the images of the node's inputs, in the declared order
+   * @param output  set to the node's image. It holds a buffer the graph
+   *                reuses between frames, so writing into it with OpenCV's
+   *                output arguments allocates nothing once the sizes settle.
+   *                Unless MayForwardInput, it must not be pointed at an input.
+   */
+  virtual void Run(const std::vector<const cv::Mat*>& inputs,
+                   cv::Mat& output) = 0;
+
+  /**
+   * Returns whether Run may set output to its first input as it is, e.g when
+   * a resize has nothing to do. The graph then keeps that input's buffer for
+   * as long as the node's image is used.
+   */
+  virtual bool MayForwardInput() const {
+    return false;
+  }
+};
+
+/**
+ * Creates nodes by the name of their kind, so that a graph can be described
+ * in the config and one implementation swapped for another there.
+ */
+class FilterNodeRegistry {
+ public:
+  /**
+   * Creates a node from the parameters of its description, which are an
+   * empty object if it has none. Throws std::invalid_argument for bad
+   * parameters.
+   */
+  typedef std::function<std::unique_ptr<FilterNode>(
+      const nlohmann::json& parameters)>
+      Factory;
+
+  /**
+   * Registers a kind of node, replacing any kind of the same name.
+   */
+  void Add(const std::string& kind, const Factory& factory);
+
+  /**
+   * Creates a node of the given kind. Throws std::invalid_argument for a
+   * kind which was never added.
+   */
+  std::unique_ptr<FilterNode> Create(const std::string& kind,
+                                     const nlohmann::json& parameters) const;
+
+  std::vector<std::string> GetKinds() const;
+
+ private:
+  std::map<std::string, Factory> factories_;
+};
+
+/**
+ * How long a node of a graph took.
+ */
+struct FilterNodeTiming {
+  std::string name;
+  double last_ms;  // For the last frame
+};
+
+/**
+ * Runs a graph of filter nodes over every frame. The graph is described as
+ * {"output": name, "nodes": [{"name": name, "node": kind, "inputs": [names],
+ * "parameters": {...}}, ...]}, where an input is either another node or
+ * "frame", the image the graph is run on.
+ *
+ * The nodes are run level by level: a node's level is one more than the
+ * highest level of its inputs, so the nodes of a level are independent of
+ * each other and run in parallel. Nodes the output does not depend on are not
+ * run. Nodes whose images are never needed at the same time share a buffer,
+ * except for the output, which gets a new buffer every frame so that it stays
+ * valid for as long as the caller keeps it.
+ */
+class FilterGraph {
+ public:
+  /**
+   * Constructor. Throws std::invalid_argument if the description is not a
+   * well formed graph without cycles, or names a kind the registry lacks.
+   * @param description the graph, see above
+   * @param registry    creates the nodes
+   * @param threads     the threads the nodes run on, including the one
+   *                    calling Run. 1 runs every node on the calling thread.
+   */
+  FilterGraph(const nlohmann::json& description,
+              const FilterNodeRegistry& registry, size_t threads);
+
+  ~FilterGraph();
+
+  FilterGraph(const FilterGraph&) = delete;
+  FilterGraph& operator=(const FilterGraph&) = delete;
+
+  /**
+   * Runs every node on a frame. Rethrows the first exception a node threw,
+   * once its level is done.
+   * @return  the image of the output node
+   */
+  cv::Mat Run(const cv::Mat& frame);
+
+  /**
+   * Returns how long each node that is run took for the last frame, in the
+   * order they are scheduled.
+   */
+  std::vector<FilterNodeTiming> GetNodeTimings() const;
+
+  /**
+   * Returns the number of levels, i.e the nodes on the longest path.
+   */
+  size_t GetLevelCount() const;
+
+  /**
+   * Returns the number of buffers the nodes' images share.
+   */
+  size_t GetBufferCount() const;
+
+  /**
+   * Sets the registry the time of every node is recorded in, as
+   * filter_graph.<name>. Pass nullptr to stop recording. The graph does not
+   * own the registry.
+   */
+  void SetMetrics(common::MetricsRegistry* metrics);
+
+  /**
+   * Sets the policies applied to the graph's threads when they are started,
+   * on the first Run. Pass nullptr to leave them with the OS defaults. The
+   * graph does not own the policies.
+   */
+  void SetThreadPolicies(common::ThreadPolicies* thread_policies);
+
+ private:
+  struct Node {
+    std::string name;
+    std::unique_ptr<FilterNode> filter;
+    std::vector<int> inputs;  // Node indices, or FRAME_INPUT
+    size_t level;
+    size_t buffer;
+    double last_ms;
+    common::LatencyHistogram* histogram;
+  };
+
+  /**
+   * Runs one node and records its time.
+   */
+  void RunNode(size_t node);
+
+  /**
+   * Runs the nodes of the current level until none is left to take.
+   */
+  void RunLevelTasks();
+
+  void WorkerLoop();
+
+  static const int FRAME_INPUT = -1;
+
+  std::vector<Node> nodes_;  // In the order they are scheduled
+  std::vector<std::vector<size_t>> levels_;  // The nodes of every level
+  size_t output_node_;
+  cv::Mat frame_;
+  std::vector<cv::Mat> outputs_;  // The image of every node
+  std::vector<cv::Mat> buffers_;  // Shared by the outputs
+  std::vector<size_t> final_buffers_;  // Those needed after the last level
+  std::vector<std::vector<const cv::Mat*>> node_inputs_;
+  const size_t THREADS_;
+  common::ThreadPolicies* thread_policies_;
+  std::vector<std::thread> workers_;  // Started on the first Run
+  std::mutex level_mutex_;
+  std::condition_variable level_condition_;  // A level started or stopping
+  std::condition_variable done_condition_;   // A level finished
+  const std::vector<size_t>* level_tasks_;  // Null unless a level is running
+  size_t next_task_;
+  size_t unfinished_tasks_;
+  uint64_t level_generation_;
+  bool stopping_;
+  std::exception_ptr error_;  // The first one of the level
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_FILTER_GRAPH_H
@@ -0,0 +1,205 @@
+#ifndef FINAL_PROJECT_FINGER_PREDICTOR_H
+#define FINAL_PROJECT_FINGER_PREDICTOR_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "common/metrics.h"
+#include "gesturerecognition/hand_extractor.h"
+
+namespace gesturerecognition {
+
+/**
+ * When the predictive tracker fires a press, and how long it waits for the
+ * batches to confirm it.
+ */
+struct PredictiveOnsetSettings {
+  // How far, in pixels, a finger tip has to be predicted to move towards the
+  // palm from where it rested for a press to fire.
+  double bend_threshold_px = 12;
+  double horizon_ms = 60;  // How far ahead the trajectory is predicted
+  // A fired press that no batch has clicked after this many frames is
+  // cancelled.
+  size_t confirm_frames = 12;
+  double measurement_noise_px = 2;  // Of a measured finger tip
+  // A tip resting nearer the palm than before, e.g because the hand turned,
+  // moves its rest distance towards it with this time constant. A bend is
+  // much quicker, so little of it is lost.
+  double rest_decay_ms = 500;
+  // A click point confirms a fired press at most this fraction of the hand's
+  // width away from it, as the tips of neighbouring fingers are about a
+  // quarter of it apart.
+  double confirm_radius_by_hand_width = 0.125;
+};
+
+/**
+ * A Kalman filter of how far a finger tip is from the center of its palm. The
+ * state is the distance, its velocity and its acceleration, which is taken to
+ * change by random jerks between frames.
+ */
+class FingerKalmanFilter {
+ public:
+  /**
+   * Constructor. The filter starts at rest at the distance.
+   * @param distance            the first measured distance, in pixels
+   * @param measurement_noise   the standard deviation of a measurement
+   */
+  FingerKalmanFilter(double distance, double measurement_noise);
+
+  /**
+   * Moves the state the given number of seconds ahead.
+   */
+  void Predict(double seconds);
+
+  /**
+   * Corrects the state with a measured distance.
+   */
+  void Correct(double distance);
+
+  double GetDistance() const;
+  double GetVelocity() const;  // In pixels per second, negative towards palm
+  double GetAcceleration() const;
+
+  /**
+   * Returns the distance the state reaches the given number of seconds
+   * ahead, if its acceleration holds.
+   */
+  double Extrapolate(double seconds) const;
+
+ private:
+  double state_[3];
+  double covariance_[3][3];
+  double measurement_variance_;
+};
+
+/**
+ * Follows the finger tips of a hand from frame to frame and fires a press as
+ * soon as a tip is predicted to bend towards the palm, rather than once the
+ * finger has gone from the contour for most of a batch. A fired press is
+ * confirmed when a batch of the HandTracker clicks a point near it, and takes
+ * the place of that point for as long as the batches hold it. It is cancelled
+ * if the finger straightens again, or if no batch clicks it in time.
+ */
+class FingerPredictor {
+ public:
+  /**
+   * Constructor.
+   * @param settings                        see PredictiveOnsetSettings
+   * @param max_change_in_finger_position   the most, in pixels, a finger tip
+   *                                        moves between frames and still
+   *                                        belongs to the same finger
+   */
+  FingerPredictor(const PredictiveOnsetSettings& settings,
+                  int max_change_in_finger_position);
+
+  /**
+   * Follows the tips of a frame's hand, confirms or cancels the fired
+   * presses against the points the batches hold as clicked, and fires new
+   * ones.
+   * @param hand            the hand of the frame
+   * @param click_points    the points the batches hold as clicked
+   * @param batch_onset_ns  when the batches' points were first pressed
+   * @param points          set to the click points, with each confirmed
+   *                        press in place of the point that confirmed it,
+   *                        then the presses waiting to be confirmed
+   * @param onset_times     set to when each of the points was first pressed,
+   *                        which is when it fired for a predicted press
+   */
+  void Update(const Hand& hand, const std::vector<cv::Point>& click_points,
+              int64_t batch_onset_ns, std::vector<cv::Point>& points,
+              std::vector<int64_t>& onset_times);
+
+  /**
+   * Returns the number of fired presses waiting to be confirmed.
+   */
+  size_t GetPendingPressCount() const;
+
+  /**
+   * Sets the registry that fired, confirmed and cancelled presses are counted
+   * in, and how much earlier than the batches the confirmed ones fired is
+   * recorded in. Pass nullptr to stop. The predictor does not own the
+   * registry.
+   */
+  void SetMetrics(common::MetricsRegistry* metrics);
+
+ private:
+  struct Track {
+    uint64_t id;
+    cv::Point tip;
+    FingerKalmanFilter filter;
+    // How far from the palm the tip rests: the farthest it has been, falling
+    // towards it while it stays nearer.
+    double rest_distance;
+    int64_t last_seen_ns;
+    size_t observations;   // Since the filter was started
+    size_t missed_frames;  // Since the tip was last seen
+    bool seen;             // In the current frame
+    // Whether it fired a press and has not straightened since. Its rest
+    // distance is held while it has.
+    bool has_fired;
+  };
+
+  struct PredictedPress {
+    uint64_t track_id;
+    cv::Point point;  // Where the tip was when the press fired
+    int64_t fired_ns;
+    size_t frames_waited;
+  };
+
+  struct ConfirmedPress {
+    cv::Point batch_point;  // The click point of the batch that confirmed it
+    cv::Point point;
+    int64_t fired_ns;
+  };
+
+  /**
+   * Matches the tips of the hand to the tracks, starts tracks for the new
+   * tips and drops those that have been missing too long.
+   */
+  void FollowTips(const Hand& hand);
+
+  /**
+   * Confirms the waiting presses near the points the batches newly clicked,
+   * cancels those that waited too long or whose finger straightened, and
+   * forgets the confirmed presses whose points the batches released.
+   * @param hand_width  of the frame's hand, 0 if it is unknown
+   */
+  void ResolvePresses(const std::vector<cv::Point>& click_points,
+                      int64_t capture_time_ns, int hand_width);
+
+  /**
+   * Fires a press for every track predicted to bend past the threshold.
+   */
+  void FirePresses(int64_t capture_time_ns);
+
+  Track* FindTrack(uint64_t id);
+
+  /**
+   * Returns the rest distance of a tip that has not fired, from the last one
+   * and the tip's distance from the palm the given number of seconds later.
+   * A rest decay of 0 keeps the farthest distance.
+   */
+  double GetRestDistance(double rest_distance, double distance,
+                         double seconds) const;
+
+  /**
+   * Returns whether the tip is not moving towards the palm and is back within
+   * half the bend threshold of where it rested.
+   */
+  bool HasStraightened(const Track& track) const;
+
+  const PredictiveOnsetSettings SETTINGS_;
+  const double MAX_CHANGE_IN_FINGER_POSITION_;
+  std::vector<Track> tracks_;
+  uint64_t next_track_id_;
+  std::vector<PredictedPress> pending_presses_;
+  std::vector<ConfirmedPress> confirmed_presses_;
+  std::vector<cv::Point> last_click_points_;
+  common::Counter* predicted_counter_;   // Null unless metrics are set
+  common::Counter* confirmed_counter_;   // Null unless metrics are set
+  common::Counter* cancelled_counter_;   // Null unless metrics are set
+  common::LatencyHistogram* lead_histogram_;  // Null unless metrics are set
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_FINGER_PREDICTOR_H
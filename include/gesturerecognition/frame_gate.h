@@ -0,0 +1,58 @@
+#ifndef FINAL_PROJECT_FRAME_GATE_H
+#define FINAL_PROJECT_FRAME_GATE_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace gesturerecognition {
+
+/**
+ * Decides whether a frame has changed enough since the last frame that went
+ * through the pipeline to be worth processing. Both frames are subsampled and
+ * compared by their mean absolute difference, with OpenCV's vectorised L1
+ * norm, over the hand regions if they are known and over the whole frame
+ * otherwise.
+ */
+class FrameGate {
+ public:
+  /**
+   * Constructor.
+   * @param threshold       frames whose mean absolute difference per channel
+   *                        value is at most this are unchanged
+   * @param subsample_step  only every this many pixels in both directions are
+   *                        compared
+   */
+  FrameGate(double threshold, int subsample_step);
+
+  /**
+   * Compares the frame with the last frame that passed the gate. A frame that
+   * passes becomes the one the next frames are compared with, so slow changes
+   * add up until they pass too.
+   * @param input_image   the new BGR frame
+   * @param regions       where the hands were in the last frame that passed,
+   *                      or nothing to compare whole frames
+   * @return              whether the frame has changed and should be processed
+   */
+  bool HasChanged(const cv::Mat& input_image,
+                  const std::vector<cv::Rect>& regions);
+
+  /**
+   * Makes the next frame pass, whatever it looks like.
+   */
+  void Reset();
+
+  /**
+   * Returns the mean absolute difference found by the last HasChanged.
+   */
+  double GetLastDifference() const;
+
+ private:
+  const double threshold_;
+  const int subsample_step_;
+  cv::Mat reference_;  // The subsampled last frame that passed
+  cv::Mat subsampled_;
+  double last_difference_;
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_FRAME_GATE_H
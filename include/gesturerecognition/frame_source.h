@@ -0,0 +1,130 @@
+#ifndef FINAL_PROJECT_FRAME_SOURCE_H
+#define FINAL_PROJECT_FRAME_SOURCE_H
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <string>
+
+namespace gesturerecognition {
+
+/**
+ * The layouts a captured frame can come in.
+ */
+enum class PixelFormat {
+  BGR,   // CV_8UC3, as OpenCV's capture converts everything to
+  YUYV,  // CV_8UC2 of the frame's size: Y0 U Y1 V for every two pixels
+  NV12,  // CV_8UC1 with 3 / 2 of the frame's rows: the Y plane, then the
+         // interleaved U and V planes at half the size in both directions
+};
+
+/**
+ * Returns the format with the given name: "bgr", "yuyv" or "nv12". Throws
+ * std::invalid_argument for any other name.
+ */
+PixelFormat ParsePixelFormat(const std::string& name);
+
+/**
+ * A frame as it was captured, before any conversion.
+ */
+struct CapturedFrame {
+  cv::Mat data_;  // Laid out as described by format_
+  PixelFormat format_ = PixelFormat::BGR;
+  // When the device captured the frame, on the steady clock. 0 if the source
+  // does not know, and the frame is timestamped when it is read instead.
+  int64_t timestamp_ns_ = 0;
+};
+
+/**
+ * Returns the size of the frame in pixels.
+ */
+cv::Size GetFrameSize(const CapturedFrame& frame);
+
+/**
+ * Returns the luma of the frame as CV_8UC1. For NV12 this is the Y plane
+ * itself, without a copy.
+ */
+cv::Mat GetLuma(const CapturedFrame& frame);
+
+/**
+ * Converts the frame to BGR. BGR frames are returned without a copy.
+ */
+cv::Mat ConvertToBGR(const CapturedFrame& frame);
+
+/**
+ * Mirrors the frame left to right, keeping the pairing of its luma and chroma.
+ * @param frame           the frame to mirror
+ * @param flipped_frame   set to the mirrored frame. Must not be frame.
+ */
+void FlipFrame(const CapturedFrame& frame, CapturedFrame& flipped_frame);
+
+/**
+ * Where the frames of the pipeline come from.
+ */
+class FrameSource {
+ public:
+  virtual ~FrameSource() = default;
+
+  /**
+   * Reads the next frame.
+   * @param frame   set to the frame. Its buffer may be reused by the next Read
+   * @return        false once there are no more frames
+   */
+  virtual bool Read(CapturedFrame& frame) = 0;
+
+  /**
+   * Returns the frame rate of the source, or 0 if it does not report one.
+   */
+  virtual double GetFramesPerSecond() const = 0;
+
+  /**
+   * Returns the size of the frames, or an empty size if it is not known.
+   */
+  virtual cv::Size GetFrameSize() const = 0;
+
+  /**
+   * Returns whether the source numbers its frames, so that it knows how many
+   * frames it has dropped.
+   */
+  virtual bool CountsDroppedFrames() const {
+    return false;
+  }
+
+  /**
+   * Returns the number of frames the source has dropped since it started,
+   * from the gaps in the numbers of the frames read.
+   */
+  virtual uint64_t GetDroppedFrames() const {
+    return 0;
+  }
+
+  /**
+   * Starts reading from the first frame again, e.g to play a recording in a
+   * loop.
+   * @return  false if the source cannot go back, e.g a camera
+   */
+  virtual bool Rewind() {
+    return false;
+  }
+};
+
+/**
+ * Reads BGR frames through OpenCV's capture layer, from a camera or any
+ * video file OpenCV can decode.
+ */
+class OpenCVFrameSource : public FrameSource {
+ public:
+  explicit OpenCVFrameSource(int camera_number);
+  explicit OpenCVFrameSource(const std::string& video_file_name);
+
+  bool Read(CapturedFrame& frame) override;
+  double GetFramesPerSecond() const override;
+  cv::Size GetFrameSize() const override;
+  bool Rewind() override;
+
+ private:
+  cv::VideoCapture video_capture_;
+  const std::string video_file_name_;  // Empty for a camera
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_FRAME_SOURCE_H
@@ -5,16 +5,27 @@
 #ifndef FINAL_PROJECT_GESTURE_WRAPPER_H
 #define FINAL_PROJECT_GESTURE_WRAPPER_H
 
-#include <cinder/Color.h>
-#include <cinder/gl/gl.h>
-#include <pianoapp/piano_engine.h>
-
 #include <iostream>
 #include <fstream>
+#include <memory>
 
+#include "common/clock.h"
+#include "common/latency.h"
+#include "common/metrics.h"
+#include "common/shared_memory_bus.h"
+#include "common/thread_policy.h"
+#include "gesturerecognition/bus_messages.h"
 #include "gesturerecognition/calibration.h"
+#include "gesturerecognition/capture_device.h"
+#include "gesturerecognition/debug_views.h"
+#include "gesturerecognition/frame_gate.h"
+#include "gesturerecognition/frame_source.h"
 #include "gesturerecognition/hand_extractor.h"
 #include "gesturerecognition/hand_tracker.h"
+#include "gesturerecognition/hsv_estimator.h"
+#include "gesturerecognition/keypoint_detector.h"
+#include "gesturerecognition/quality_controller.h"
+#include "gesturerecognition/v4l2_device.h"
 #include "nlohmann/json.hpp"
 
 /**
@@ -22,36 +33,28 @@
  */
 namespace gesturerecognition {
 
+//Replace *ENTER_PROJECT_PATH_HERE* with the location of this project directory
+const std::string CONFIG_FILE_PATH = "*ENTER_PROJECT_PATH_HERE*\\config.json";
+
 struct ProgramSettings {
   ProgramSettings(const std::string& json_file_name) {
     std::ifstream istream;
-    //Replace *ENTER_PROJECT_PATH_HERE* with the location of this project directory
-    istream.open("*ENTER_PROJECT_PATH_HERE*\\config.json");
+    istream.open(json_file_name);
     if (istream.is_open()) {
-      nlohmann::json j = nlohmann::json::parse(istream);
-      //We feed in all the necessary data from the config file.
-      camera_number = j["camera_number"];
-      maximum_hsv_limit = j["maximum_hsv_limit"];
-      output_window_size =
-          cv::Size(j["output_window_length"], j["output_window_height"]);
-      hsv_window_size =
-          cv::Size(j["hsv_window_length"], j["hsv_window_height"]);
-      background_learning_rate = j["background_learning_rate"];
-      frames_to_track = j["frames_to_track"];
-      combined_window_name = j["combined_window_name"];
-      background_sub_window_name = j["background_sub_window_name"];
-      hsv_window_name = j["hsv_window_name"];
-      convex_hull_window_name = j["convex_hull_window_name"];
-      number_of_white_keys = j["number_of_white_keys"];
-      row_margin = j["row_margin"];
-      number_of_rows = j["number_of_rows"];
-      piano_notes_file_name = j["piano_notes_file_name"];
-      finger_tip_circle_radius = j["finger_tip_circle_radius"];
-      piano_circle_radius = j["piano_circle_radius"];
-      finger_tip_circle_thickness = j["finger_tip_circle_thickness"];
-      line_type = j["line_type"];
+      Load(nlohmann::json::parse(istream));
     }
   }
+
+  /**
+   * Reads the settings from the parsed contents of a config file, e.g one
+   * whose values a parameter sweep has changed.
+   */
+  static ProgramSettings FromJson(const nlohmann::json& j) {
+    ProgramSettings settings;
+    settings.Load(j);
+    return settings;
+  }
+
   int camera_number;
   int number_of_rows;
   int row_margin;
@@ -66,10 +69,208 @@ struct ProgramSettings {
   size_t frames_to_track;
   std::string convex_hull_window_name;
   std::string piano_notes_file_name;
+  // The zones and keys of the piano, see piano::ParseKeyboardLayout. When it
+  // is empty, the keys are read from piano_notes_file_name instead and split
+  // into number_of_rows rows.
+  std::string keyboard_layout_file;
   int finger_tip_circle_radius;
   int piano_circle_radius;
   int finger_tip_circle_thickness;
   int line_type;
+  std::string recording_file_prefix;  // Recording is off when this is empty
+  size_t journal_capacity;
+  int journal_flush_interval_ms;
+  std::string replay_log_file;  // Replays this log instead of using the camera
+  std::string video_file_name;  // Read from this file instead of the camera
+  bool show_debug_windows;      // Whether OpenCV windows may be opened
+  std::string metrics_file_name;  // Metrics are not dumped when this is empty
+  int metrics_dump_interval_s;
+  bool show_metrics_overlay;
+  bool latency_measurement_mode;  // Prints the latency of every note
+  double frame_budget_ms;  // Quality is never lowered when this is 0
+  size_t quality_window_frames;
+  double quality_restore_fraction;
+  std::string background_model;  // "mog2" or "running_gaussian"
+  // "convexity_defects" or "column_profile", see FingerTipDetector
+  std::string finger_tip_detector;
+  HandExtractorSettings hand_extractor;
+  // The most, in pixels, a finger tip moves between batches of frames.
+  int max_change_in_finger_position;
+  // "batch" clicks once a batch's finger count drops. "predictive" also fires
+  // a press as soon as a finger tip is predicted to bend, see
+  // FingerPredictor.
+  std::string tracker_mode;
+  PredictiveOnsetSettings predictive_onset;
+  // Of the opening and the closing of the mask, unless the quality controller
+  // has lowered the quality.
+  int morphology_iterations;
+  // Whether the hands are found in the runs of the mask (see RleMask) rather
+  // than in the mask itself, and the mask is published on the bus as runs.
+  bool rle_masks;
+  // Every mask is appended to this file as its capture time, in 8 bytes,
+  // then RleMask::Write. Nothing is recorded when it is empty.
+  std::string mask_recording_file;
+  // The graph the filters run in, see FilterGraph and
+  // Calibration::RegisterFilterNodes. An empty one runs them in their fixed
+  // order.
+  nlohmann::json filter_graph;
+  size_t filter_graph_threads;  // Including the vision thread
+  // While playing, the hands are found by this keypoint network in the frames
+  // instead of in the filtered mask, unless its model file is empty.
+  KeypointModelSettings keypoint_model;
+  // Loaded at startup and saved after calibrating. Not used when empty.
+  std::string calibration_profile_file;
+  size_t profile_check_frames;  // Frames a loaded profile is checked against
+  // A loaded profile is dropped if more of the checked frames than this is
+  // foreground.
+  double profile_max_foreground_fraction;
+  size_t auto_hsv_calibration_frames;  // Frames the hand boxes are sampled for
+  // How often the background is learnt on its own thread during recognition.
+  // 0 learns every frame on the vision thread.
+  int async_background_update_frames;
+  // Frames which differ from the last processed one by at most this mean
+  // absolute difference reuse its hands. 0 processes every frame.
+  double frame_gate_threshold;
+  int frame_gate_subsample;  // The gate compares every this many pixels
+  // "bgr" captures through OpenCV. "yuyv" and "nv12" capture frames of that
+  // format through V4L2 from /dev/video<camera_number>, or read them from the
+  // raw video_file_name through a stand-in device, and filter them without
+  // converting them.
+  std::string capture_pixel_format;
+  cv::Size yuv_frame_size;  // The size of the YUV frames
+  double yuv_frames_per_second;
+  size_t capture_buffer_count;  // The number of buffers a YUV device fills
+  // Whether the stand-in device delivers frames at yuv_frames_per_second,
+  // dropping those that come while no buffer is free, like a camera does.
+  bool capture_paced;
+  double debug_view_fps;  // The most the debug views are redrawn per second
+  bool debug_views_tiled;  // Whether the debug views share a single window
+  std::string debug_tiled_window_name;
+  cv::Size debug_tile_size;  // The size of a view in the tiled window
+  // How the pipeline's threads are pinned and scheduled, and whether the
+  // process memory is locked.
+  common::ThreadPolicyConfig thread_policy_config;
+  // The shared memory every frame, mask, pair of hands and note is published
+  // on for other processes, e.g /gesture-piano. Nothing is published when it
+  // is empty.
+  std::string bus_name;
+  size_t bus_capacity_mb;
+
+ private:
+  ProgramSettings() = default;
+
+  void Load(const nlohmann::json& j) {
+    //We feed in all the necessary data from the config file.
+    camera_number = j["camera_number"];
+    maximum_hsv_limit = j["maximum_hsv_limit"];
+    output_window_size =
+        cv::Size(j["output_window_length"], j["output_window_height"]);
+    hsv_window_size =
+        cv::Size(j["hsv_window_length"], j["hsv_window_height"]);
+    background_learning_rate = j["background_learning_rate"];
+    frames_to_track = j["frames_to_track"];
+    combined_window_name = j["combined_window_name"];
+    background_sub_window_name = j["background_sub_window_name"];
+    hsv_window_name = j["hsv_window_name"];
+    convex_hull_window_name = j["convex_hull_window_name"];
+    number_of_white_keys = j["number_of_white_keys"];
+    row_margin = j["row_margin"];
+    number_of_rows = j["number_of_rows"];
+    piano_notes_file_name = j["piano_notes_file_name"];
+    keyboard_layout_file = j["keyboard_layout_file"];
+    finger_tip_circle_radius = j["finger_tip_circle_radius"];
+    piano_circle_radius = j["piano_circle_radius"];
+    finger_tip_circle_thickness = j["finger_tip_circle_thickness"];
+    line_type = j["line_type"];
+    recording_file_prefix = j["recording_file_prefix"];
+    journal_capacity = j["journal_capacity"];
+    journal_flush_interval_ms = j["journal_flush_interval_ms"];
+    replay_log_file = j["replay_log_file"];
+    video_file_name = j["video_file_name"];
+    show_debug_windows = j["show_debug_windows"];
+    metrics_file_name = j["metrics_file_name"];
+    metrics_dump_interval_s = j["metrics_dump_interval_s"];
+    show_metrics_overlay = j["show_metrics_overlay"];
+    latency_measurement_mode = j["latency_measurement_mode"];
+    frame_budget_ms = j["frame_budget_ms"];
+    quality_window_frames = j["quality_window_frames"];
+    quality_restore_fraction = j["quality_restore_fraction"];
+    background_model = j["background_model"];
+    finger_tip_detector = j["finger_tip_detector"];
+    hand_extractor.max_angle_between_fingers = j["max_angle_between_fingers"];
+    hand_extractor.lowest_finger_ratio = j["lowest_finger_ratio"];
+    hand_extractor.min_hand_size = j["min_hand_size"];
+    hand_extractor.min_finger_prominence_ratio =
+        j["min_finger_prominence_ratio"];
+    hand_extractor.max_finger_width_ratio = j["max_finger_width_ratio"];
+    hand_extractor.min_finger_width_ratio = j["min_finger_width_ratio"];
+    max_change_in_finger_position = j["max_change_in_finger_position"];
+    tracker_mode = j["tracker_mode"];
+    predictive_onset.bend_threshold_px = j["predictive_bend_threshold_px"];
+    predictive_onset.horizon_ms = j["predictive_horizon_ms"];
+    predictive_onset.confirm_frames = j["predictive_confirm_frames"];
+    predictive_onset.measurement_noise_px =
+        j["predictive_measurement_noise_px"];
+    predictive_onset.rest_decay_ms = j["predictive_rest_decay_ms"];
+    predictive_onset.confirm_radius_by_hand_width =
+        j["predictive_confirm_radius_by_hand_width"];
+    morphology_iterations = j["morphology_iterations"];
+    rle_masks = j["rle_masks"];
+    mask_recording_file = j["mask_recording_file"];
+    filter_graph = j["filter_graph"];
+    filter_graph_threads = j["filter_graph_threads"];
+    keypoint_model.model_file = j["keypoint_model_file"];
+    keypoint_model.int8_model_file = j["keypoint_int8_model_file"];
+    keypoint_model.use_int8 = j["keypoint_use_int8"];
+    keypoint_model.input_size =
+        cv::Size(j["keypoint_input_size"], j["keypoint_input_size"]);
+    keypoint_model.confidence_threshold =
+        j["keypoint_confidence_threshold"];
+    calibration_profile_file = j["calibration_profile_file"];
+    profile_check_frames = j["profile_check_frames"];
+    profile_max_foreground_fraction = j["profile_max_foreground_fraction"];
+    auto_hsv_calibration_frames = j["auto_hsv_calibration_frames"];
+    async_background_update_frames = j["async_background_update_frames"];
+    frame_gate_threshold = j["frame_gate_threshold"];
+    frame_gate_subsample = j["frame_gate_subsample"];
+    capture_pixel_format = j["capture_pixel_format"];
+    yuv_frame_size = cv::Size(j["yuv_frame_width"], j["yuv_frame_height"]);
+    yuv_frames_per_second = j["yuv_frames_per_second"];
+    capture_buffer_count = j["capture_buffer_count"];
+    capture_paced = j["capture_paced"];
+    debug_view_fps = j["debug_view_fps"];
+    debug_views_tiled = j["debug_views_tiled"];
+    debug_tiled_window_name = j["debug_tiled_window_name"];
+    debug_tile_size =
+        cv::Size(j["debug_tile_width"], j["debug_tile_height"]);
+    thread_policy_config =
+        common::ThreadPolicyConfig::FromJson(j["thread_policies"]);
+    bus_name = j["bus_name"];
+    bus_capacity_mb = j["bus_capacity_mb"];
+  }
+};
+
+/**
+ * The time each stage of GestureWrapper::Update took for the last frame, in
+ * milliseconds. Stages which did not run are 0.
+ */
+struct StageTimings {
+  double capture_ms = 0;     // Reading and flipping the frame
+  double filter_ms = 0;      // HSV filter, background subtraction, morphology
+  double extraction_ms = 0;  // Finding the hands and their finger tips
+  double tracking_ms = 0;    // Finding the clicked points of both hands
+  double drawing_ms = 0;     // Drawing the debug views since the last Update
+};
+
+/**
+ * The state the pipeline carries from one frame to the next, which has to
+ * stay bounded however long it runs.
+ */
+struct PipelineState {
+  size_t held_hands = 0;    // Hands both trackers hold for their batches
+  size_t click_points = 0;  // Points both trackers hold as clicked
+  double foreground_fraction = 0;  // Of the last background mask
+  BackgroundModelState background;
 };
 
 class GestureWrapper {
@@ -91,6 +292,79 @@ class GestureWrapper {
    */
   void ToggleHSVCalibration();
 
+  /**
+   * Starts the automatic HSV calibration, or cancels it if it is running.
+   * The hands are held in the boxes returned by GetAutoHSVBoxes, and after
+   * auto_hsv_calibration_frames frames the HSV ranges are estimated from
+   * them. The trackbars can still be used afterwards for fine-tuning.
+   */
+  void ToggleAutoHSVCalibration();
+
+  bool IsAutoHSVCalibrating() const;
+
+  /**
+   * Returns the boxes the hands should be held in during the automatic HSV
+   * calibration, in the coordinate system of the output window, or nothing
+   * if it is not running.
+   */
+  std::vector<cv::Rect> GetAutoHSVBoxes() const;
+
+  /**
+   * Sets the HSV ranges of the filter without the calibration trackbars.
+   * @param low   the lowest hue, saturation and value that pass the filter
+   * @param high  the highest hue, saturation and value that pass the filter
+   */
+  void SetHSVRange(const cv::Scalar& low, const cv::Scalar& high);
+
+  /**
+   * Returns the lowest and the highest hue, saturation and value that pass the
+   * HSV filter.
+   */
+  std::pair<cv::Scalar, cv::Scalar> GetHSVRange() const;
+
+  /**
+   * Loads the HSV ranges and background of the calibration profile. If it has
+   * a background of the camera's size, recognition starts straight away and
+   * the first frames are checked against the background: if the scene has
+   * changed too much, the background is learnt again.
+   * @return whether the profile was found
+   */
+  bool LoadCalibrationProfile();
+
+  /**
+   * Saves the current calibration to the profile. This is done whenever a
+   * calibration mode is turned off.
+   * @return whether the profile was written
+   */
+  bool SaveCalibrationProfile() const;
+
+  bool IsProfileLoaded() const;
+  bool IsBackgroundTraining() const;
+
+  /**
+   * Returns the time from the construction of the wrapper to the first frame
+   * in recognition mode(after the check of a loaded profile), or 0 if that
+   * frame has not come yet.
+   */
+  int64_t GetTimeToPlayable() const;
+
+  /**
+   * Returns whether the frame gate found the last frame unchanged, so that it
+   * reused the hands of the frame before instead of finding them again.
+   */
+  bool WasLastFrameSkipped() const;
+
+  /**
+   * Returns the number of frames the frame gate has skipped.
+   */
+  size_t GetSkippedFrames() const;
+
+  /**
+   * Returns the number of frames read until recognition started, counting
+   * the first recognised frame.
+   */
+  size_t GetFramesToPlayable() const;
+
   /**
    * Toggles the Gesture recognition mode. When it is turned on, the program
    * starts extracting finger tips from the video feed and performs the
@@ -99,13 +373,17 @@ class GestureWrapper {
   void ToggleGestureRecognitionMode();
 
   /**
-   * Draws all the UI elements on screen: the combined filter, the convex hulls
-   * image,etc
+   * Shows the OpenCV debug views which apply to the current mode: the
+   * combined filter, the convex hulls image,etc. They are only rendered at
+   * debug_view_fps, and the views of other modes are never rendered. Does
+   * nothing if show_debug_windows is off.
    */
   void Draw();
 
   /**
    * Extracts finger tips from the input video frame, tracks both hands, and
+   * returns the clicked points. With a keypoint model, rethrows whatever
+   * stopped its inference thread, see AsyncKeypointDetector::TakeResult.
    * @return
    */
   const std::vector<cv::Point>& Update();
@@ -123,9 +401,188 @@ class GestureWrapper {
       const std::vector<cv::Point>& points, int input_height, int input_width,
       int ext_window_height, int ext_window_width);
 
+  /**
+   * Returns the time at which the frame used by the last Update was captured,
+   * in nanoseconds on the wrapper's clock(see SetClock)
+   */
+  int64_t GetLastCaptureTime() const;
+
+  /**
+   * Returns the clock timestamps of the frame used by the last Update.
+   */
+  const common::FrameTimestamps& GetLastFrameTimestamps() const;
+
+  /**
+   * Returns, for every click point returned by the last Update, the capture
+   * time of the first frame in which its finger was seen pressed.
+   */
+  const std::vector<int64_t>& GetLastOnsetTimes() const;
+
+  /**
+   * Returns the time between two frames of the camera or video file, or 0 if
+   * it does not report its frame rate.
+   */
+  int64_t GetSourceFrameInterval() const;
+
+  bool IsReadingVideoFile() const;
+
+  /**
+   * Returns whether the video source numbers its frames, so that the frames
+   * it dropped are counted instead of estimated from the frame intervals.
+   */
+  bool CountsDroppedFrames() const;
+
+  /**
+   * Returns the number of frames the video source has dropped, if it counts
+   * them.
+   */
+  uint64_t GetDroppedFrames() const;
+
+  /**
+   * Returns the current level of the quality controller, or 0(full quality)
+   * if there is no frame budget.
+   */
+  size_t GetQualityLevel() const;
+
+  /**
+   * Sets the clock that frames are timestamped with. The default is the
+   * steady clock. The wrapper does not own the clock.
+   */
+  void SetClock(const common::Clock& clock);
+
+  /**
+   * Returns how long each stage of the last Update took.
+   */
+  const StageTimings& GetLastStageTimings() const;
+
+  /**
+   * Returns how long each node of the filter graph took for the last frame
+   * it filtered, or nothing if the filters run in their fixed order.
+   */
+  std::vector<FilterNodeTiming> GetFilterNodeTimings() const;
+
+  /**
+   * Returns whether the video source has run out of frames. Update does
+   * nothing once this is true.
+   */
+  bool IsEndOfStream() const;
+
+  /**
+   * Starts the video over from its first frame, keeping everything learnt
+   * from it, e.g to play a recording in a loop.
+   * @return  false if the source cannot go back, e.g a camera or a raw YUV
+   *          file
+   */
+  bool RewindVideo();
+
+  /**
+   * Returns the state carried between frames. It copies the background
+   * image, so it is meant to be sampled now and then.
+   */
+  PipelineState GetPipelineState() const;
+
+  bool IsRecognitionMode() const;
+
+  /**
+   * Returns the finger tips of each hand found in the last Update, in the
+   * coordinate system of the output window.
+   */
+  const std::vector<cv::Point>& GetLeftFingerTips() const;
+  const std::vector<cv::Point>& GetRightFingerTips() const;
+
+  /**
+   * Sets the registry that the frame rate, dropped frames and stage timings
+   * of every Update are recorded in, along with the decisions of both hand
+   * trackers and the updates of the background learner. Pass nullptr to stop
+   * recording. The wrapper does not own the registry.
+   */
+  void SetMetrics(common::MetricsRegistry* metrics);
+
+  /**
+   * Sets the policies applied to the threads the wrapper starts, i.e the
+   * background learner's. The thread calling Update is the caller's to set.
+   * Pass nullptr to leave them with the OS defaults. The wrapper does not own
+   * the policies.
+   */
+  void SetThreadPolicies(common::ThreadPolicies* thread_policies);
+
+  /**
+   * Sets the bus every frame, filter mask and pair of hands is published on,
+   * from the thread calling Update. Pass nullptr to stop publishing. The bus
+   * must hold messages of a frame's size. The wrapper does not own the bus.
+   */
+  void SetBus(common::SharedMemoryBusWriter* bus);
+
  private:
+  /**
+   * Does the work of Update: captures a frame and runs it through the stages.
+   */
+  const std::vector<cv::Point>& ProcessFrame();
+
+  /**
+   * Records the metrics of the frame just processed.
+   * @param previous_capture_time_ns   when the frame before it was captured
+   */
+  void RecordMetrics(int64_t previous_capture_time_ns);
+
+  /**
+   * Feeds the processing time of the frame just processed to the quality
+   * controller, and applies the level it picks.
+   */
+  void UpdateQuality();
+
+  /**
+   * Adds the last frame to the check of a loaded profile, and starts learning
+   * the background again if the check fails.
+   */
+  void CheckProfileDrift();
+
+  /**
+   * Records the time to playable if recognition has just started.
+   */
+  void UpdateTimeToPlayable();
+
+  /**
+   * Adds the last frame to the automatic HSV calibration, and applies the
+   * estimated ranges once it has enough frames.
+   */
+  void UpdateAutoHSVCalibration();
+
+  /**
+   * Passes the bounding boxes of last_hands_ to the background learner and
+   * the frame gate.
+   */
+  void UpdateHandRegions();
+
+  /**
+   * Returns the frame as BGR, converting it the first time it is asked for.
+   * Only the debug views and the automatic HSV calibration need it, so YUV
+   * frames are not converted otherwise.
+   */
+  const cv::Mat& GetBGRImage();
+
+  /**
+   * Returns the image the background model and the frame gate work on: the
+   * frame itself if it is BGR, or its luma.
+   */
+  cv::Mat GetBackgroundInput() const;
+
+  /**
+   * Adds the debug views, each rendering its image from the last frame.
+   */
+  void CreateDebugViews(const ProgramSettings& settings);
+
+  /**
+   * Draws the finger tips of the hand, and lines joining them to the center of
+   * the palm.
+   * @param image   the image to draw on
+   * @param hand    the hand to be drawn
+   * @param color   the color to draw the hand's features with
+   */
+  void DrawHandFeatures(cv::Mat& image, const Hand& hand,
+                        const cv::Scalar& color);
+
   const std::string CONVEX_HULL_WINDOW_NAME_;
-  const int PIANO_CIRCLE_RADIUS;
   const int FINGER_TIP_CIRCLE_RADIUS_;
   const int FINGER_TIP_CIRCLE_THICKNESS_;
   const std::string HSV_WINDOW_NAME_;
@@ -133,29 +590,82 @@ class GestureWrapper {
   const std::string COMBINED_WINDOW_NAME_;
   const cv::Size OUTPUT_WINDOW_SIZE_;
   const int LINE_TYPE_;
+  const bool SHOW_DEBUG_WINDOWS_;
+  const std::string PROFILE_FILE_NAME_;
+  const size_t PROFILE_CHECK_FRAMES_;
+  const double PROFILE_MAX_FOREGROUND_FRACTION_;
+  const size_t AUTO_HSV_CALIBRATION_FRAMES_;
   const cv::Scalar COLOR_1 = cv::Scalar(0, 255, 200);
   const cv::Scalar COLOR_2 = cv::Scalar(255, 0, 200);
 
-  // A videoCapture object to capture the webcam stream.
-  cv::VideoCapture video_capture_;
+  const PixelFormat PIXEL_FORMAT_;
+  const bool USE_RLE_MASKS_;
+
+  // Captures the webcam stream, or reads the video file.
+  std::unique_ptr<FrameSource> frame_source_;
   HandExtractor hand_extractor_;
+  // Null unless a keypoint model was set.
+  std::unique_ptr<AsyncKeypointDetector> keypoint_detector_;
   Calibration calibration_;
+  HSVEstimator hsv_estimator_;
+  bool auto_hsv_calibrating_;
   bool recognition_mode_;  // Whether or not the program should detect gestures.
   // I added a tracker for two hands.
   HandTracker left_hand_tracker_;
   HandTracker right_hand_tracker_;
 
-  cv::Mat
-      image;  // Original image from the webcam is copied here for each frame.
-  cv::Mat hsv_filter_image_;  // The image after passing it through the HSV
-                              // filter is copied here for each frame
-  cv::Mat background_subtracted_image_;  // The image after passing it through
-                                         // the background subtraction filter.
-  cv::Mat convex_hull_image_;  // The image which contains all the features(i.e
-                               // finger_tips)
+  CapturedFrame captured_frame_;  // As read from the frame source
+  CapturedFrame frame_;           // The captured frame, laterally inverted
+  cv::Size frame_size_;
+  cv::Mat image;  // The frame as BGR, only valid when image_converted_ is true
+  bool image_converted_;
+  int64_t capture_time_ns_;  // The time at which image was captured.
+  bool end_of_stream_;
+  const common::Clock* clock_;
+  common::FrameTimestamps frame_timestamps_;
+  // Null when there is no frame budget.
+  std::unique_ptr<QualityController> quality_controller_;
+  bool draw_debug_overlays_;  // Turned off by the quality controller
+  // Null unless show_debug_windows is on.
+  std::unique_ptr<DebugViews> debug_views_;
+  double pending_drawing_ms_;  // Spent in Draw since the last Update
+  StageTimings stage_timings_;
+  bool profile_loaded_;
+  size_t profile_check_frames_left_;  // 0 when no profile is being checked
+  double profile_foreground_fraction_sum_;
+  const int64_t startup_time_ns_;  // On the steady clock
+  int64_t time_to_playable_ns_;
+  size_t frames_read_;
+  size_t frames_to_playable_;
+  std::unique_ptr<FrameGate> frame_gate_;  // Null when frames are not gated
+  bool frame_skipped_;  // Whether the gate skipped the last frame
+  size_t skipped_frames_;
+  std::pair<Hand, Hand> last_hands_;  // Found in the last processed frame
+  std::vector<cv::Rect> gate_regions_;
+  const bool is_video_file_;  // Whether frames come from video_file_name
+  uint64_t source_dropped_frames_;  // Already added to the dropped frames
+  // The frame interval of the source, or 0 if the source does not report it.
+  int64_t source_frame_interval_ns_;
+  double smoothed_frame_interval_ns_;  // Moving average, for the frame rate
+  const double FRAME_INTERVAL_SMOOTHING_ = 0.1;
+  // Metrics, all null unless SetMetrics was called with a registry.
+  common::Counter* frame_counter_;
+  common::Counter* dropped_frame_counter_;
+  common::Gauge* fps_gauge_;
+  common::LatencyHistogram* frame_interval_histogram_;
+  common::LatencyHistogram* update_histogram_;
+  common::Gauge* time_to_playable_gauge_;
+  common::Counter* profile_rejection_counter_;
+  common::Counter* skipped_frame_counter_;
+  // In the order of the fields of StageTimings.
+  std::vector<common::LatencyHistogram*> stage_histograms_;
+  common::SharedMemoryBusWriter* bus_;  // Null unless SetBus was called
   cv::Mat
       combined_filter_image_;  // The image after passing it through the
                                // background subtraction filter and HSV filter.
+  // The runs of combined_filter_image_, only kept when they are used.
+  RleMask combined_filter_runs_;
+  std::ofstream mask_recording_;  // Not open unless masks are recorded
 
   std::vector<cv::Point>
       left_finger_tips;  // Stores the finger tips of the left hand
@@ -163,6 +673,7 @@ class GestureWrapper {
       right_finger_tips;  // Stores the finger tips of the right hand
   std::vector<cv::Point>
       merged_click_points;  // Stores the points clicked by both hands.
+  std::vector<int64_t> merged_onset_times_;  // One per merged click point
 };
 
 }  // namespace gesturerecognition
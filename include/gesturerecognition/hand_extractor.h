@@ -8,12 +8,53 @@
 #include <iostream>
 #include <opencv2/objdetect.hpp>
 #include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
 
-#include "cinder/Cinder.h"
+#include "gesturerecognition/rle_mask.h"
 #include "stdio.h"
 
 namespace gesturerecognition {
 
+/**
+ * How HandExtractor finds the finger tips of a hand.
+ */
+enum class FingerTipDetector {
+  // The convexity defects of the hand's contour, which finds fingers pointing
+  // any way.
+  CONVEXITY_DEFECTS,
+  // The peaks of the topmost foreground row of each column, which is much
+  // cheaper but only finds fingers pointing up, as when playing.
+  COLUMN_PROFILE,
+};
+
+/**
+ * Returns the detector with the given name: "convexity_defects" or
+ * "column_profile". Throws std::invalid_argument for any other name.
+ */
+FingerTipDetector ParseFingerTipDetector(const std::string& name);
+
+/**
+ * The thresholds HandExtractor tells fingers apart from the rest of the hand
+ * by. Ratios divide the size of the hand's bounding box.
+ */
+struct HandExtractorSettings {
+  // The widest angle, in degrees, between two fingers of a convexity defect.
+  int max_angle_between_fingers = 95;
+  // Fingers are at least the hand's height over this long, finger tips at
+  // least the hand's width over this apart, and no tip is further below the
+  // hand's center than its height over this.
+  int lowest_finger_ratio = 10;
+  int min_hand_size = 1000;  // Smaller contours have no finger tips
+  // A peak of the column profile is only a finger if it stands out by at
+  // least the hand's height over min_finger_prominence_ratio, and is at most
+  // the hand's width over max_finger_width_ratio and at least over
+  // min_finger_width_ratio wide at half that height.
+  int min_finger_prominence_ratio = 6;
+  int max_finger_width_ratio = 3;
+  int min_finger_width_ratio = 40;
+};
+
 /**
  * A struct representing the Hand. Stores the finger tips of the hand, as well
  * as its center
@@ -22,17 +63,29 @@ namespace gesturerecognition {
 struct Hand {
   std::vector<cv::Point> finger_tips_;
   cv::Point center_of_palm_;
-  Hand() : finger_tips_(), center_of_palm_(cv::Point(-1, -1)) {
+  int64_t capture_time_ns_;  // Capture time of the frame the hand was found in
+  cv::Rect bounding_box_;    // Of the hand's contour, empty if it is unknown
+  Hand()
+      : finger_tips_(),
+        center_of_palm_(cv::Point(-1, -1)),
+        capture_time_ns_(0),
+        bounding_box_() {
   }
   Hand(const std::vector<cv::Point>& finger_tips,
-       const cv::Point& center_of_palm)
-      : finger_tips_(std::move(finger_tips)), center_of_palm_(center_of_palm) {
+       const cv::Point& center_of_palm, int64_t capture_time_ns = 0)
+      : finger_tips_(std::move(finger_tips)),
+        center_of_palm_(center_of_palm),
+        capture_time_ns_(capture_time_ns),
+        bounding_box_() {
   }
   Hand(const std::pair<const std::vector<cv::Point>&, const cv::Point&>& pair)
-      : finger_tips_(std::move(pair.first)), center_of_palm_(pair.second) {
+      : finger_tips_(std::move(pair.first)),
+        center_of_palm_(pair.second),
+        capture_time_ns_(0),
+        bounding_box_() {
   }
-  int Hand::getNumberOfFingers() const {
-    return finger_tips_.size();
+  int getNumberOfFingers() const {
+    return static_cast<int>(finger_tips_.size());
   }
 };
 
@@ -42,7 +95,13 @@ struct Hand {
  */
 class HandExtractor {
  public:
-  HandExtractor();
+  /**
+   * Constructor. Throws std::invalid_argument if a ratio of the settings is
+   * not positive.
+   */
+  explicit HandExtractor(
+      FingerTipDetector detector = FingerTipDetector::CONVEXITY_DEFECTS,
+      const HandExtractorSettings& settings = HandExtractorSettings());
   /**
    * Finds the 2 largest contours in the contours list
    * @param contours : a vector of contours
@@ -55,12 +114,50 @@ class HandExtractor {
   /**
    * Extracts the hands in the image.
    * @param input_image : the inputted image
+   * @param capture_time_ns : the capture time of the image, stored in both
+   * hands
    * @return and image with convex hulls drawn around it.
    */
 
-  std::pair<Hand, Hand> ExtractHands(const cv::Mat& input_image);
+  std::pair<Hand, Hand> ExtractHands(const cv::Mat& input_image,
+                                     int64_t capture_time_ns = 0);
+
+  /**
+   * Extracts the hands in a run length encoded mask. The contours are traced
+   * on the runs, and only for the two blobs with the most pixels.
+   * @param mask            : the mask
+   * @param capture_time_ns : the capture time of the mask, stored in both
+   * hands
+   */
+  std::pair<Hand, Hand> ExtractHands(const RleMask& mask,
+                                     int64_t capture_time_ns = 0);
 
  private:
+  /**
+   * Extracts the hands from the two largest of the outer contours of a mask.
+   */
+  std::pair<Hand, Hand> ExtractHandsFromContours(
+      const std::vector<std::vector<cv::Point>>& contours,
+      int64_t capture_time_ns);
+
+  /**
+   * Extracts the hands with the column profile detector: the two largest
+   * connected components are the hands, and the finger tips are the peaks of
+   * their column profiles.
+   */
+  std::pair<Hand, Hand> ExtractHandsByColumnProfile(const cv::Mat& input_image,
+                                                    int64_t capture_time_ns);
+
+  /**
+   * Finds the finger tips of a connected component from the topmost row of
+   * it in each column of its bounding box.
+   * @param label           the component's label in labels_
+   * @param bounding_box    the component's bounding box
+   * @return                the finger tips, from the left to the right
+   */
+  std::vector<cv::Point> FindColumnProfileFingerTips(
+      int label, const cv::Rect& bounding_box);
+
   /**
    * Finds the center along with the finger tips of the inputted contour
    * @param contour         contour of the hand
@@ -103,11 +200,45 @@ class HandExtractor {
    */
   std::vector<cv::Point> FindFingerTips(
       const std::vector<cv::Point>& finger_tips, cv::Rect bounding_rectangle);
-  const int MAX_ANGLE_BETWEEN_FINGERS_ = 95;
-  const int LOWEST_FINGER_RATIO = 10;
-  const int MIN_HAND_SIZE = 1000;
+  const FingerTipDetector detector_;
+  // Reused by every frame of the column profile detector.
+  cv::Mat labels_;
+  cv::Mat stats_;
+  cv::Mat centroids_;
+  std::vector<int> column_heights_;
+  cv::Mat decoded_mask_;  // Of a run length encoded mask
+  // See HandExtractorSettings.
+  const int MAX_ANGLE_BETWEEN_FINGERS_;
+  const int LOWEST_FINGER_RATIO;
+  const int MIN_HAND_SIZE;
+  const int MIN_FINGER_PROMINENCE_RATIO;
+  const int MAX_FINGER_WIDTH_RATIO;
+  const int MIN_FINGER_WIDTH_RATIO;
+};
+
+/**
+ * A peak of a profile.
+ */
+struct ProfilePeak {
+  int position;    // The middle of the peak's top
+  int prominence;  // How far it rises above the higher of its two bases
+  int width;       // At half its prominence
 };
 
+/**
+ * Finds the peaks of a profile which stand out by at least min_prominence and
+ * whose width is between min_width and max_width. The profile is taken to be
+ * 0 beyond both of its ends.
+ * @param profile           e.g the height of the hand in each column
+ * @param min_prominence    the least a peak must rise above its bases
+ * @param min_width         the narrowest a peak may be at half its prominence
+ * @param max_width         the widest it may be
+ * @return                  the peaks, from the left to the right
+ */
+std::vector<ProfilePeak> FindProfilePeaks(const std::vector<int>& profile,
+                                          int min_prominence, int min_width,
+                                          int max_width);
+
 /**
  * Finds the euclidean distance between two points
  * @param a first point
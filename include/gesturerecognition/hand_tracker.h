@@ -4,6 +4,10 @@
 
 #ifndef FINAL_PROJECT_HAND_TRACKER_H
 #define FINAL_PROJECT_HAND_TRACKER_H
+#include <memory>
+
+#include "common/metrics.h"
+#include "finger_predictor.h"
 #include "hand_extractor.h"
 
 namespace gesturerecognition {
@@ -13,8 +17,10 @@ class HandTracker {
   /**
    * Default constructor
    *@param number_of_frames : the number of frame that each batch holds.
+   *@param max_change_in_finger_position : the most, in pixels, that a finger
+   * tip can move between batches and still be taken for the same finger.
    */
-  HandTracker(size_t number_of_frames);
+  HandTracker(size_t number_of_frames, int max_change_in_finger_position = 20);
 
   /**
    * Finds points clicked by the fingers. Returns an empty vector if there are
@@ -24,6 +30,45 @@ class HandTracker {
    */
   std::vector<cv::Point> FindClickPoints(const Hand& hand);
 
+  /**
+   * Fires presses as soon as a finger tip is predicted to bend, see
+   * FingerPredictor, and holds them until the batches confirm or cancel
+   * them. Without this, a press is only found once a batch's finger count
+   * drops.
+   */
+  void SetPredictiveOnset(const PredictiveOnsetSettings& settings);
+
+  /**
+   * Sets the registry that the tracker's decisions are counted in. Pass
+   * nullptr to stop counting. The tracker does not own the registry.
+   */
+  void SetMetrics(common::MetricsRegistry* metrics);
+
+  /**
+   * Returns when the finger count that the last batch settled on was first
+   * seen, i.e the capture time of the first frame showing the latest click or
+   * unclick. Frames before that count are from the previous batches if the
+   * change started there.
+   */
+  int64_t GetLastBatchOnsetTime() const;
+
+  /**
+   * Returns when each point the last FindClickPoints returned was first
+   * pressed: the onset of the last batch, or when a predicted press fired.
+   */
+  const std::vector<int64_t>& GetClickOnsetTimes() const;
+
+  /**
+   * Returns the number of hands held for the batch being filled.
+   */
+  size_t GetHeldHandCount() const;
+
+  /**
+   * Returns the number of points the tracker holds as clicked, including the
+   * predicted presses waiting to be confirmed.
+   */
+  size_t GetClickPointCount() const;
+
  private:
   /**
    * Finds the most common number of fingers open in a batch, by counting the
@@ -99,7 +144,19 @@ class HandTracker {
   Hand current_batch_hand;
   std::vector<cv::Point> click_points;
   std::vector<Hand> hands;
-  const int MAX_CHANGE_IN_FINGER_POSITION_ = 20;
+  // For each hand in hands, the capture time of the first of the run of
+  // frames with the same number of fingers that it belongs to.
+  std::vector<int64_t> finger_count_onset_times_;
+  int last_finger_count_;
+  int64_t last_finger_count_onset_ns_;
+  int64_t last_batch_onset_ns_;
+  const int MAX_CHANGE_IN_FINGER_POSITION_;
+  std::vector<int64_t> click_onset_times_;  // Of the last returned points
+  std::unique_ptr<FingerPredictor> predictor_;  // Null unless predictive
+  common::MetricsRegistry* metrics_;
+  common::Counter* batch_counter_;    // Null unless metrics are set
+  common::Counter* click_counter_;    // Null unless metrics are set
+  common::Counter* unclick_counter_;  // Null unless metrics are set
 };
 /**
  * A comparator function to sort a points vector by ascending order of the
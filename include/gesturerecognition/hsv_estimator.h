@@ -0,0 +1,69 @@
+#ifndef FINAL_PROJECT_HSV_ESTIMATOR_H
+#define FINAL_PROJECT_HSV_ESTIMATOR_H
+
+#include <opencv2/opencv.hpp>
+#include <utility>
+#include <vector>
+
+namespace gesturerecognition {
+
+/**
+ * Estimates the HSV ranges of the hands from frames in which the user holds
+ * their hands in two boxes, instead of having them drag the trackbars. The
+ * colors inside the boxes are counted in a hue, saturation and value
+ * histogram, and the colors outside them in a hue and saturation histogram.
+ * The hand colors are the hue and saturation bins which are more common in
+ * the boxes than outside them, and the ranges cover most of their pixels.
+ */
+class HSVEstimator {
+ public:
+  /**
+   * Constructor.
+   * @param hand_coverage   the fraction of the hand colored pixels in the
+   *                        boxes that the ranges cover. The rarest colors at
+   *                        both ends of each range are left out.
+   */
+  HSVEstimator(double hand_coverage = 0.9);
+
+  /**
+   * Returns the boxes the hands should be held in, for a frame of the given
+   * size.
+   */
+  static std::vector<cv::Rect> GetHandBoxes(const cv::Size& frame_size);
+
+  /**
+   * Adds the colors of a frame to the histograms. Uses OpenCV's histogram
+   * kernel, so it is cheap enough to run on every frame.
+   * @param input_image   a BGR frame with the hands in the hand boxes
+   */
+  void AddFrame(const cv::Mat& input_image);
+
+  /**
+   * Estimates the HSV ranges of the hands from the frames added so far.
+   * @param low   set to the lowest hue, saturation and value of the hands
+   * @param high  set to the highest hue, saturation and value of the hands
+   * @return      false if no frames were added, or no colors were more common
+   *              in the boxes than outside them
+   */
+  bool EstimateRange(cv::Scalar& low, cv::Scalar& high) const;
+
+  /**
+   * Forgets every frame added.
+   */
+  void Reset();
+
+  size_t GetFramesAdded() const;
+
+  static const int HUE_BINS = 30;  // OpenCV's hues go from 0 to 179
+  static const int SATURATION_BINS = 32;
+  static const int VALUE_BINS = 32;
+
+ private:
+  double hand_coverage_;
+  cv::Mat hand_histogram_;        // Hue, saturation and value in the boxes
+  cv::Mat background_histogram_;  // Hue and saturation outside the boxes
+  size_t frames_added_;
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_HSV_ESTIMATOR_H
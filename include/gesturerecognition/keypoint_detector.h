@@ -0,0 +1,179 @@
+#ifndef FINAL_PROJECT_KEYPOINT_DETECTOR_H
+#define FINAL_PROJECT_KEYPOINT_DETECTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <opencv2/dnn.hpp>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "common/metrics.h"
+#include "common/thread_policy.h"
+#include "gesturerecognition/hand_extractor.h"
+
+namespace gesturerecognition {
+
+/**
+ * The hand keypoint network and how its input is prepared. The network takes
+ * a batch of hand crops and outputs one heatmap per keypoint for each, in the
+ * usual 21 point layout: the wrist, then four points along each finger from
+ * the thumb to the little finger, the last of which is its tip. Any extra
+ * heatmaps, e.g a background one, are ignored.
+ */
+struct KeypointModelSettings {
+  std::string model_file;       // Anything cv::dnn::readNet reads, e.g ONNX
+  std::string int8_model_file;  // The same network quantised to int8
+  bool use_int8 = false;        // Runs int8_model_file instead of model_file
+  cv::Size input_size = cv::Size(224, 224);  // Each crop is resized to it
+  double input_scale = 1.0 / 255;            // Applied to the pixel values
+  bool swap_red_blue = true;                 // The network takes RGB
+  // Keypoints whose heatmap peaks below this are taken to be hidden.
+  float confidence_threshold = 0.3f;
+  // The crop around a hand found in the last frame is its bounding box grown
+  // by this fraction of its size on every side.
+  double region_margin = 0.25;
+
+  /**
+   * Returns the model file that is run, which is empty if none was set.
+   */
+  const std::string& GetModelFile() const;
+};
+
+/**
+ * Finds the finger tips and palm centers of hands with a keypoint network, on
+ * the CPU through OpenCV's DNN module. Only the regions the hands are expected
+ * in are run through the network, all of them in one batch.
+ */
+class KeypointDetector {
+ public:
+  /**
+   * Loads the network. Throws std::invalid_argument if the settings name no
+   * model file, and std::runtime_error if it cannot be loaded.
+   */
+  explicit KeypointDetector(const KeypointModelSettings& settings);
+
+  /**
+   * Runs the network once on the crops of every region of the frame. A hand
+   * is left empty if its region is outside the frame, or the network does not
+   * see its palm.
+   * @param frame             a BGR frame
+   * @param regions           where to look for each hand
+   * @param capture_time_ns   stored in every hand
+   * @return                  one hand per region
+   */
+  std::vector<Hand> Detect(const cv::Mat& frame,
+                           const std::vector<cv::Rect>& regions,
+                           int64_t capture_time_ns);
+
+  /**
+   * Returns the regions to look for the left and the right hand in: around
+   * where each was last found, or the half of the frame it is on if it was
+   * not. The regions are square, as the network's input is.
+   * @param last_hands  the left and the right hand of the last frame
+   * @param frame_size  the size of the frame
+   * @param margin      see KeypointModelSettings::region_margin
+   */
+  static std::vector<cv::Rect> FindRegions(const std::vector<Hand>& last_hands,
+                                           const cv::Size& frame_size,
+                                           double margin);
+
+  const KeypointModelSettings& GetSettings() const;
+
+ private:
+  /**
+   * Reads a hand from the heatmaps of one crop.
+   * @param heatmaps        the crop's heatmaps, one after the other
+   * @param heatmap_size    the size of each heatmap
+   * @param region          where the crop was taken from the frame
+   */
+  Hand DecodeHand(const float* heatmaps, const cv::Size& heatmap_size,
+                  const cv::Rect& region) const;
+
+  const KeypointModelSettings settings_;
+  cv::dnn::Net net_;
+  std::vector<cv::Mat> crops_;  // Reused by every Detect
+  cv::Mat input_blob_;
+};
+
+/**
+ * Runs a KeypointDetector on a thread of its own, so that the inference on
+ * one frame overlaps with the capture and filtering of the next ones. Only
+ * the newest frame is ever waiting: one handed over while another waits
+ * replaces it. The detector keeps track of where the hands were itself, and
+ * crops the next frame around them.
+ */
+class AsyncKeypointDetector {
+ public:
+  /**
+   * Loads the network on the calling thread, so that a bad model fails
+   * straight away. The inference thread is started by the first Submit.
+   * Throws like KeypointDetector.
+   */
+  explicit AsyncKeypointDetector(const KeypointModelSettings& settings);
+
+  /**
+   * Stops the inference thread, dropping any frame it has not started.
+   */
+  ~AsyncKeypointDetector();
+
+  /**
+   * Hands a frame to the inference thread.
+   * @param frame             a BGR frame. It is copied.
+   * @param capture_time_ns   stored in the hands found in it
+   * @return                  false if a frame that was still waiting was
+   *                          dropped for it
+   */
+  bool Submit(const cv::Mat& frame, int64_t capture_time_ns);
+
+  /**
+   * Takes the hands found in the newest frame that finished since the last
+   * call. Never blocks. If the network threw on the inference thread, e.g a
+   * model whose outputs are not 21 heatmaps per crop, that thread has stopped
+   * and its exception is rethrown by this and every later call.
+   * @param hands   set to the left and the right hand if true is returned
+   * @return        false if no frame finished since the last call
+   */
+  bool TakeResult(std::pair<Hand, Hand>& hands);
+
+  /**
+   * Sets the policies applied to the inference thread when it starts. Has no
+   * effect once a frame was submitted. The detector does not own them.
+   */
+  void SetThreadPolicies(common::ThreadPolicies* thread_policies);
+
+  /**
+   * Sets the registry the inference time and the dropped frames are recorded
+   * in. Pass nullptr to stop recording. The detector does not own the
+   * registry.
+   */
+  void SetMetrics(common::MetricsRegistry* metrics);
+
+ private:
+  void InferenceLoop();
+
+  KeypointDetector detector_;     // Only used by the inference thread
+  std::vector<Hand> last_hands_;  // Only used by the inference thread
+  cv::Mat pending_frame_;         // Guarded by mutex_
+  int64_t pending_capture_time_ns_;
+  bool has_pending_frame_;  // Guarded by mutex_
+  bool running_;            // Guarded by mutex_
+  std::pair<Hand, Hand> result_;  // Guarded by mutex_
+  bool has_result_;               // Guarded by mutex_
+  // What stopped the inference thread, if anything. Guarded by mutex_.
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  common::ThreadPolicies* thread_policies_;
+  // Null unless SetMetrics was called with a registry.
+  std::atomic<common::Counter*> dropped_frame_counter_;
+  std::atomic<common::LatencyHistogram*> inference_histogram_;
+  std::thread inference_thread_;
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_KEYPOINT_DETECTOR_H
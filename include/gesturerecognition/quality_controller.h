@@ -0,0 +1,76 @@
+#ifndef FINAL_PROJECT_QUALITY_CONTROLLER_H
+#define FINAL_PROJECT_QUALITY_CONTROLLER_H
+
+#include <vector>
+
+#include "common/metrics.h"
+#include "gesturerecognition/calibration.h"
+
+namespace gesturerecognition {
+
+/**
+ * One step of the quality ladder.
+ */
+struct QualityLevel {
+  FilterQuality filter_quality;
+  bool draw_debug_overlays;  // Whether the convex hull image is drawn
+};
+
+/**
+ * Keeps the processing time of GestureWrapper::Update within a budget, by
+ * stepping down the quality ladder(see GetQualityLevels) while frames take
+ * too long, and back up once there is enough headroom. Decisions are made on
+ * the mean time of a window of frames, and the window starts over after every
+ * change, so that the new level is judged on its own frames only.
+ */
+class QualityController {
+ public:
+  /**
+   * Constructor.
+   * @param frame_budget_ms     the processing time each frame may take
+   * @param window_frames       the number of frames each decision is based on
+   * @param restore_fraction    quality is only restored when the mean frame
+   *                            time is below this fraction of the budget
+   */
+  QualityController(double frame_budget_ms, size_t window_frames,
+                    double restore_fraction);
+
+  /**
+   * Adds the processing time of a frame, and changes the level if needed.
+   * @param frame_time_ms   the processing time of the frame
+   * @return                whether the level changed
+   */
+  bool Update(double frame_time_ms);
+
+  /**
+   * Returns the current level: 0 is full quality, higher is faster.
+   */
+  size_t GetLevel() const;
+
+  const QualityLevel& GetQualityLevel() const;
+
+  /**
+   * Sets the registry that the level and its changes are recorded in. Pass
+   * nullptr to stop recording. The controller does not own the registry.
+   */
+  void SetMetrics(common::MetricsRegistry* metrics);
+
+  /**
+   * Returns every level, from full quality to the fastest. Each level gives
+   * up a little more than the one before it.
+   */
+  static const std::vector<QualityLevel>& GetQualityLevels();
+
+ private:
+  const double frame_budget_ms_;
+  const size_t window_frames_;
+  const double restore_fraction_;
+  size_t level_;
+  double window_total_ms_;
+  size_t window_size_;
+  common::Gauge* level_gauge_;           // Null unless metrics are set
+  common::Counter* degradation_counter_;  // Null unless metrics are set
+  common::Counter* restoration_counter_;  // Null unless metrics are set
+};
+}  // namespace gesturerecognition
+#endif  // FINAL_PROJECT_QUALITY_CONTROLLER_H
@@ -0,0 +1,178 @@
+#ifndef FINAL_PROJECT_RLE_MASK_H
+#define FINAL_PROJECT_RLE_MASK_H
+
+#include <cstdint>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <utility>
+#include <vector>
+
+namespace gesturerecognition {
+
+/**
+ * A run of foreground pixels in a row of a mask.
+ */
+struct MaskRun {
+  int32_t start;  // The first column of the run
+  int32_t end;    // One past its last column
+};
+
+/**
+ * A binary mask stored as the runs of foreground pixels of each row. The hands
+ * are a few large blobs, so a row takes a few runs instead of a byte per
+ * pixel, and the area, the bounding box, AND and OR and the contours are found
+ * from the runs without reading the background.
+ */
+class RleMask {
+ public:
+  /**
+   * Constructor. The mask is empty until it is assigned.
+   */
+  RleMask();
+
+  /**
+   * Constructor which encodes a mask, see Assign.
+   */
+  explicit RleMask(const cv::Mat& mask);
+
+  /**
+   * Replaces the runs with those of the nonzero pixels of a mask, reusing the
+   * memory of the last ones. Throws std::invalid_argument if the mask is not
+   * 8 bit single channel.
+   */
+  void Assign(const cv::Mat& mask);
+
+  /**
+   * Sets mask to 255 for the pixels of the runs, and 0 elsewhere.
+   */
+  void ToMat(cv::Mat& mask) const;
+
+  cv::Size GetSize() const;
+  bool IsEmpty() const;
+  size_t GetRunCount() const;
+
+  /**
+   * Returns the runs of a row, from the left to the right, as the range
+   * [first, second).
+   */
+  std::pair<const MaskRun*, const MaskRun*> GetRowRuns(int row) const;
+
+  /**
+   * Returns whether a pixel is foreground. Pixels outside the mask are not.
+   */
+  bool IsForeground(int x, int y) const;
+
+  /**
+   * Returns the number of foreground pixels.
+   */
+  int64_t GetArea() const;
+
+  /**
+   * Returns the smallest rectangle holding every foreground pixel, which is
+   * empty if there is none.
+   */
+  cv::Rect GetBoundingBox() const;
+
+  /**
+   * Returns the pixels foreground in both masks. Throws std::invalid_argument
+   * if their sizes differ.
+   */
+  RleMask And(const RleMask& other) const;
+
+  /**
+   * Returns the pixels foreground in either mask. Throws std::invalid_argument
+   * if their sizes differ.
+   */
+  RleMask Or(const RleMask& other) const;
+
+  /**
+   * Traces the outer boundaries of the largest 8-connected blobs on the runs.
+   * These are the contours cv::findContours finds with RETR_EXTERNAL and
+   * CHAIN_APPROX_SIMPLE: blobs inside the holes of others are left out.
+   * @param max_contours  how many blobs are traced, 0 for all
+   * @return              the contours, from the blob with the most pixels
+   */
+  std::vector<std::vector<cv::Point>> FindOuterContours(
+      size_t max_contours = 0) const;
+
+  /**
+   * Returns the bytes the runs take in memory.
+   */
+  size_t GetMemoryBytes() const;
+
+  /**
+   * Returns the size of the encoding of the mask written by Encode.
+   */
+  size_t GetEncodedSize() const;
+
+  /**
+   * Writes the compact encoding of the mask: its size then, for every row,
+   * its number of runs and the gap before and the length of each, as
+   * variable length integers.
+   * @param data  holds at least GetEncodedSize bytes
+   */
+  void Encode(unsigned char* data) const;
+
+  /**
+   * Replaces the mask with one written by Encode.
+   * @return  false if the data is not a well formed encoding, in which case
+   *          the mask is left empty
+   */
+  bool Decode(const unsigned char* data, size_t size);
+
+  /**
+   * Writes the encoding of the mask, after its size in bytes.
+   */
+  void Write(std::ostream& stream) const;
+
+  /**
+   * Replaces the mask with one written by Write. Throws std::invalid_argument
+   * if the stream does not hold a mask.
+   */
+  void Read(std::istream& stream);
+
+ private:
+  /**
+   * Empties the mask and gives it a size, without freeing its memory.
+   */
+  void Reset(const cv::Size& size);
+
+  /**
+   * Returns the first run of every 8-connected blob, in the order of the
+   * runs, and the number of pixels of each.
+   */
+  std::vector<std::pair<size_t, int64_t>> FindBlobs() const;
+
+  /**
+   * Returns whether each gap between the runs is background reaching the
+   * border of the mask, through background 4-connected to it. The gap before
+   * run i of row r is gap i + r, and the one after the last run of row r is
+   * gap row_starts_[r + 1] + r.
+   */
+  std::vector<bool> FindOpenGaps() const;
+
+  /**
+   * Returns the columns of a gap of a row, counted from the left, between its
+   * runs and the edges of the mask.
+   */
+  MaskRun GetGap(int row, size_t gap) const;
+
+  /**
+   * Returns the row a run is in.
+   */
+  int GetRunRow(size_t run) const;
+
+  /**
+   * Follows the outer boundary of a blob from its top left pixel, keeping
+   * only the points where its direction changes.
+   */
+  std::vector<cv::Point> TraceBoundary(const cv::Point& start) const;
+
+  cv::Size size_;
+  std::vector<MaskRun> runs_;  // Row by row, from the left to the right
+  // The runs of row r are runs_[row_starts_[r]] to runs_[row_starts_[r + 1]].
+  std::vector<uint32_t> row_starts_;
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_RLE_MASK_H
@@ -0,0 +1,56 @@
+#ifndef FINAL_PROJECT_SKIN_TABLE_H
+#define FINAL_PROJECT_SKIN_TABLE_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "gesturerecognition/frame_source.h"
+
+namespace gesturerecognition {
+
+/**
+ * Classifies the pixels of YUV frames as skin with a lookup table indexed by
+ * their quantised Y, Cb and Cr, so that they never have to be converted to
+ * BGR and then to HSV. The table is built from the HSV ranges of the filter
+ * by running OpenCV's own conversions on every entry, so it agrees with
+ * converting the frame and filtering it by HSV up to the quantisation.
+ */
+class YCbCrSkinTable {
+ public:
+  YCbCrSkinTable();
+
+  /**
+   * Rebuilds the table for the given HSV ranges, unless it was built for them
+   * already.
+   * @param low   the lowest hue, saturation and value of the skin
+   * @param high  the highest hue, saturation and value of the skin
+   */
+  void Build(const cv::Scalar& low, const cv::Scalar& high);
+
+  /**
+   * Classifies every pixel of a YUYV or NV12 frame.
+   * @param frame   the frame to classify
+   * @param mask    set to a CV_8UC1 image, 255 for skin and 0 elsewhere
+   */
+  void Classify(const CapturedFrame& frame, cv::Mat& mask) const;
+
+  static const int BITS_PER_COMPONENT = 6;
+  static const int LEVELS = 1 << BITS_PER_COMPONENT;  // Per component
+
+ private:
+  /**
+   * Returns the entry of a pixel with the given Y, Cb and Cr.
+   */
+  uchar Lookup(int y, int cb, int cr) const {
+    const int shift = 8 - BITS_PER_COMPONENT;
+    return table_[((y >> shift) << (2 * BITS_PER_COMPONENT)) |
+                  ((cb >> shift) << BITS_PER_COMPONENT) | (cr >> shift)];
+  }
+
+  std::vector<uchar> table_;  // LEVELS ^ 3 entries, 255 for skin
+  cv::Scalar low_;            // The ranges the table was built for
+  cv::Scalar high_;
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_SKIN_TABLE_H
@@ -0,0 +1,157 @@
+#ifndef FINAL_PROJECT_SYNTHETIC_HANDS_H
+#define FINAL_PROJECT_SYNTHETIC_HANDS_H
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace gesturerecognition {
+
+const int FINGERS_PER_HAND = 5;
+
+/**
+ * The pose of one synthetic hand. The hand points upwards when rotation_ is 0,
+ * like a hand playing the piano in front of the webcam.
+ */
+struct SyntheticHand {
+  cv::Point2f palm_center_;
+  float palm_width_;        // The scale of the hand, in pixels
+  float rotation_degrees_;  // Clockwise rotation around the palm center
+  bool is_left_;            // Left hands have their thumb on the right
+  bool extended_fingers_[FINGERS_PER_HAND];  // From the left to the right
+
+  SyntheticHand();
+};
+
+/**
+ * Settings of the scene the hands are drawn in.
+ */
+struct SyntheticSceneSettings {
+  cv::Size resolution_;
+  int noise_specks_;             // Small foreground blobs added to the mask
+  int clutter_objects_;          // Colored shapes drawn behind the hands
+  double pixel_noise_;           // Standard deviation of the frame noise
+  cv::Scalar skin_color_;        // BGR
+  cv::Scalar background_color_;  // BGR
+  uint64_t seed_;
+
+  SyntheticSceneSettings();
+};
+
+/**
+ * One rendered frame, along with where the finger tips really are.
+ */
+struct SyntheticFrame {
+  cv::Mat mask_;   // CV_8UC1: 255 where the hands(and noise specks) are
+  cv::Mat frame_;  // CV_8UC3: the hands drawn in skin color on the scene
+  std::vector<cv::Point> left_finger_tips_;   // Only the extended fingers
+  std::vector<cv::Point> right_finger_tips_;  // Only the extended fingers
+  cv::Point left_palm_center_;
+  cv::Point right_palm_center_;
+  int64_t timestamp_ns_;
+};
+
+/**
+ * A finger being bent(pressed) or straightened(released) in a session.
+ */
+struct SyntheticPressEvent {
+  int64_t timestamp_ns_;
+  size_t frame_number_;
+  bool is_left_hand_;
+  int finger_;
+  bool is_press_;
+  cv::Point position_;  // Where the finger tip was before it was bent
+};
+
+/**
+ * Settings of a generated session: both hands hover over the keys with small
+ * drift, and now and then bend a finger for a while.
+ */
+struct SyntheticSessionSettings {
+  size_t number_of_frames_;
+  double frames_per_second_;
+  int press_duration_frames_;  // How long a finger stays bent
+  double press_probability_;   // Chance per frame that a finger gets bent
+  float drift_pixels_;         // Maximum palm movement per frame
+  bool render_frames_;         // Whether to draw BGR frames or only masks
+
+  SyntheticSessionSettings();
+};
+
+/**
+ * A generated session: the frames, and every press and release in them.
+ */
+struct SyntheticSession {
+  std::vector<SyntheticFrame> frames_;
+  std::vector<SyntheticPressEvent> press_events_;
+};
+
+/**
+ * Draws parametric hand silhouettes, so that the finger tip pipeline can be
+ * tested and benchmarked at any scale without a camera.
+ */
+class SyntheticHandGenerator {
+ public:
+  explicit SyntheticHandGenerator(const SyntheticSceneSettings& settings);
+
+  /**
+   * Creates a pair of hands placed side by side in the scene, with the given
+   * number of fingers extended(counting from the thumb).
+   * @param extended_fingers  the number of extended fingers on each hand
+   * @param scale             the palm width as a fraction of the frame width
+   * @return                  the left and the right hand
+   */
+  std::pair<SyntheticHand, SyntheticHand> CreateHandPair(int extended_fingers,
+                                                         float scale) const;
+
+  /**
+   * Draws both hands.
+   * @param left_hand       the hand on the left of the frame
+   * @param right_hand      the hand on the right of the frame
+   * @param render_frame    whether to draw frame_ as well as mask_
+   * @return                the drawn frame with its ground truth.
+   */
+  SyntheticFrame Render(const SyntheticHand& left_hand,
+                        const SyntheticHand& right_hand, bool render_frame);
+
+  /**
+   * Generates a session in which fingers are bent and straightened over time.
+   * @param settings    the session settings
+   * @return            the frames and the press events
+   */
+  SyntheticSession GenerateSession(const SyntheticSessionSettings& settings);
+
+ private:
+  /**
+   * Draws one hand on the mask and returns its extended finger tips.
+   */
+  std::vector<cv::Point> DrawHand(const SyntheticHand& hand, cv::Mat& mask);
+
+  /**
+   * Returns where the tip of each finger of the hand is when extended.
+   */
+  std::vector<cv::Point> GetFingerTipPositions(const SyntheticHand& hand) const;
+
+  /**
+   * Draws the hands in skin color on a cluttered background.
+   */
+  cv::Mat RenderFrame(const cv::Mat& mask);
+
+  const SyntheticSceneSettings settings_;
+  cv::RNG rng_;
+  cv::Mat background_;  // The cluttered background, drawn once
+};
+
+/**
+ * Counts the detected points which are within max_distance of a distinct
+ * ground truth point.
+ * @param detected        the detected points
+ * @param ground_truth    the real points
+ * @param max_distance    the largest distance at which two points match
+ * @return                the number of matched points
+ */
+int CountMatchedPoints(const std::vector<cv::Point>& detected,
+                       const std::vector<cv::Point>& ground_truth,
+                       double max_distance);
+}  // namespace gesturerecognition
+#endif  // FINAL_PROJECT_SYNTHETIC_HANDS_H
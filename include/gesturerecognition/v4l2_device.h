@@ -0,0 +1,76 @@
+#ifndef FINAL_PROJECT_V4L2_DEVICE_H
+#define FINAL_PROJECT_V4L2_DEVICE_H
+
+#include <string>
+#include <vector>
+
+#include "gesturerecognition/capture_device.h"
+
+namespace gesturerecognition {
+
+/**
+ * Captures from a Video4Linux2 camera into buffers mapped from the kernel, so
+ * that frames are read where the driver wrote them. Frames are timestamped
+ * with the driver's monotonic timestamp, which is on the steady clock. Only
+ * available on Linux: elsewhere the constructor throws.
+ */
+class V4L2Device : public CaptureDevice {
+ public:
+  /**
+   * Opens the device and starts streaming. The driver may pick a different
+   * frame rate, and a different number of buffers, than the ones asked for.
+   * Throws std::invalid_argument if the format is not YUYV or NV12, and
+   * std::runtime_error if the device cannot capture it at the given size.
+   * @param device_name         e.g /dev/video0
+   * @param format              the format to capture in
+   * @param frame_size          the size to capture at
+   * @param frames_per_second   the frame rate to ask for
+   * @param buffer_count        the number of buffers to ask for, at least 2
+   */
+  V4L2Device(const std::string& device_name, PixelFormat format,
+             const cv::Size& frame_size, double frames_per_second,
+             size_t buffer_count);
+  ~V4L2Device() override;
+
+  V4L2Device(const V4L2Device&) = delete;
+  V4L2Device& operator=(const V4L2Device&) = delete;
+
+  /**
+   * Waits for the next frame, returning false if the device has not
+   * delivered one for a while or has failed.
+   */
+  bool Dequeue(DeviceBuffer& buffer) override;
+  void Queue(size_t index) override;
+  PixelFormat GetPixelFormat() const override;
+  cv::Size GetFrameSize() const override;
+  size_t GetBytesPerLine() const override;
+  double GetFramesPerSecond() const override;
+  size_t GetBufferCount() const override;
+
+ private:
+  /**
+   * A kernel buffer mapped into our memory.
+   */
+  struct MappedBuffer {
+    void* start_;
+    size_t length_;
+  };
+
+  /**
+   * Stops streaming, unmaps the buffers and closes the device.
+   */
+  void Close();
+
+  int file_descriptor_;
+  const PixelFormat format_;
+  cv::Size frame_size_;  // As set by the driver
+  size_t bytes_per_line_;
+  double frames_per_second_;
+  std::vector<MappedBuffer> buffers_;
+  bool streaming_;
+  // How long Dequeue waits for a frame before giving up on the device.
+  const int DEQUEUE_TIMEOUT_MS_ = 2000;
+};
+}  // namespace gesturerecognition
+
+#endif  // FINAL_PROJECT_V4L2_DEVICE_H
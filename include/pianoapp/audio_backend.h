@@ -0,0 +1,47 @@
+#ifndef FINAL_PROJECT_AUDIO_BACKEND_H
+#define FINAL_PROJECT_AUDIO_BACKEND_H
+
+#include <memory>
+#include <string>
+
+namespace piano {
+
+/**
+ * A sound that a key can play. Implemented by the audio backend in use.
+ */
+class Voice {
+ public:
+  virtual ~Voice() = default;
+  virtual void Start() = 0;
+  virtual void Stop() = 0;
+  virtual bool IsPlaying() const = 0;
+};
+
+typedef std::shared_ptr<Voice> VoiceRef;
+
+/**
+ * Loads the voices of the piano keys. Keeps PianoEngine independent of the
+ * audio library, so that it can be built and benchmarked without Cinder.
+ */
+class AudioBackend {
+ public:
+  virtual ~AudioBackend() = default;
+
+  /**
+   * Creates a voice which plays the inputted audio file.
+   * @param audio_file_name   the name of the audio asset
+   * @return                  the voice
+   */
+  virtual VoiceRef LoadVoice(const std::string& audio_file_name) = 0;
+};
+
+/**
+ * An audio backend which plays nothing. Its voices only keep track of whether
+ * they are playing. Used by the headless targets.
+ */
+class SilentAudioBackend : public AudioBackend {
+ public:
+  VoiceRef LoadVoice(const std::string& audio_file_name) override;
+};
+}  // namespace piano
+#endif  // FINAL_PROJECT_AUDIO_BACKEND_H
@@ -0,0 +1,67 @@
+#ifndef FINAL_PROJECT_CINDER_BACKENDS_H
+#define FINAL_PROJECT_CINDER_BACKENDS_H
+
+#include "cinder/Cinder.h"
+#include "cinder/audio/Node.h"
+#include "cinder/audio/Voice.h"
+#include "cinder/gl/gl.h"
+#include "common/thread_policy.h"
+#include "pianoapp/audio_backend.h"
+#include "pianoapp/renderer.h"
+
+namespace piano {
+
+/**
+ * Plays the key sounds with Cinder's audio library. The audio files are loaded
+ * from the app's assets folder.
+ */
+class CinderAudioBackend : public AudioBackend {
+ public:
+  /**
+   * Takes the thread policy node out of the audio graph, which outlives the
+   * backend.
+   */
+  ~CinderAudioBackend() override;
+
+  VoiceRef LoadVoice(const std::string& audio_file_name) override;
+
+  /**
+   * Applies the audio thread's policy to Cinder's audio thread, from that
+   * thread, the next time it mixes. Must be called at most once, with
+   * policies which outlive the backend.
+   */
+  void SetThreadPolicies(common::ThreadPolicies* thread_policies);
+
+ private:
+  // Pulled by the audio graph only to run on the audio thread.
+  ci::audio::NodeRef thread_policy_node_;
+  const float KEY_VOLUME = 2.0f;
+};
+
+/**
+ * Draws with Cinder's OpenGL helpers. Only valid inside the Cinder draw
+ * function.
+ */
+class CinderRenderer : public Renderer {
+ public:
+  void DrawSolidRoundedRect(const cv::Rect2f& rect, float corner_radius,
+                            const cv::Scalar& color) override;
+  void DrawStrokedRect(const cv::Rect2f& rect,
+                       const cv::Scalar& color) override;
+  void DrawSolidCircle(const cv::Point2f& center, float radius,
+                       const cv::Scalar& color) override;
+  void DrawString(const std::string& text, const cv::Point2f& top_left_corner,
+                  const cv::Scalar& color) override;
+};
+
+/**
+ * Converts an OpenCV rectangle to a cinder rectangle
+ */
+ci::Rectf ConvertToRectf(const cv::Rect2f& rect);
+
+/**
+ * Converts an OpenCV BGR color to a cinder color
+ */
+ci::Color ConvertToColor(const cv::Scalar& color);
+}  // namespace piano
+#endif  // FINAL_PROJECT_CINDER_BACKENDS_H
@@ -0,0 +1,89 @@
+#ifndef FINAL_PROJECT_KEYBOARD_LAYOUT_H
+#define FINAL_PROJECT_KEYBOARD_LAYOUT_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace piano {
+
+/**
+ * A keyboard in part of the piano's window, whose keys play the samples of
+ * one bank.
+ */
+struct KeyboardZone {
+  std::string name;
+  // The part of the window the zone takes, as fractions of its size.
+  cv::Rect2f region = cv::Rect2f(0, 0, 1, 1);
+  // The notes of each row from the left, the top row first, e.g "C4", "Db4",
+  // "D4". Every row starts and ends with a white key, and a black key sits on
+  // the boundary between the white keys around it.
+  std::vector<std::vector<std::string>> rows;
+  // The sample of a note is sample_prefix + note + sample_suffix.
+  std::string sample_prefix;
+  std::string sample_suffix;
+};
+
+/**
+ * The zones of the piano. Where zones overlap, the later one is on top.
+ */
+struct KeyboardLayout {
+  std::vector<KeyboardZone> zones;
+};
+
+/**
+ * Returns whether a note, e.g "Db4", is played on a black key.
+ */
+bool IsBlackKey(const std::string& note);
+
+/**
+ * Returns the notes from first_note up, with number_of_white_keys white keys
+ * and the black keys between them, named with flats as the samples are.
+ * Throws std::invalid_argument if first_note is not a white key.
+ */
+std::vector<std::string> GetNoteRange(const std::string& first_note,
+                                      int number_of_white_keys);
+
+/**
+ * Parses a layout of the form {"zones": [{"name": name, "region": [x, y,
+ * width, height], "sample_prefix": prefix, "sample_suffix": suffix, "rows":
+ * [row, ...]}, ...]}, where a row is either {"first_note": note,
+ * "white_keys": count}, see GetNoteRange, or {"notes": [note, ...]}. The
+ * region defaults to the whole window. Throws std::invalid_argument if the
+ * layout is not well formed, e.g a note has no MIDI number or a row starts
+ * with a black key.
+ */
+KeyboardLayout ParseKeyboardLayout(const nlohmann::json& description);
+
+/**
+ * Reads a layout file in the format of ParseKeyboardLayout. Throws
+ * std::runtime_error if the file cannot be opened.
+ */
+KeyboardLayout ReadKeyboardLayoutFile(const std::string& file_name);
+
+/**
+ * Reads a notes file: the sample prefix and suffix, then the notes of every
+ * white key, each followed by its black key unless it is a B, an E or the
+ * last key of its row. Every row after the first starts with the last key of
+ * the row above. Throws std::invalid_argument if the keys cannot be split
+ * into the rows or the file runs out of notes, and std::runtime_error if it
+ * cannot be opened.
+ * @return  a layout of a single zone taking the whole window
+ */
+KeyboardLayout ReadNotesFileLayout(const std::string& file_name,
+                                   int number_of_white_keys,
+                                   int number_of_rows);
+
+/**
+ * Reads the layout file if there is one, or else the notes file, as the
+ * settings choose between them.
+ */
+KeyboardLayout LoadKeyboardLayout(const std::string& layout_file_name,
+                                  const std::string& notes_file_name,
+                                  int number_of_white_keys,
+                                  int number_of_rows);
+}  // namespace piano
+
+#endif  // FINAL_PROJECT_KEYBOARD_LAYOUT_H
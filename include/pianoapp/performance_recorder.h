@@ -0,0 +1,145 @@
+#ifndef FINAL_PROJECT_PERFORMANCE_RECORDER_H
+#define FINAL_PROJECT_PERFORMANCE_RECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/clock.h"
+#include "common/shared_memory_bus.h"
+#include "common/thread_policy.h"
+
+namespace piano {
+
+enum class NoteEventType : uint8_t { PRESS = 0, RELEASE = 1 };
+
+/**
+ * A single entry of the performance journal. Times are nanoseconds on the
+ * steady clock returned by common::GetTimestampNanoseconds.
+ */
+struct NoteEvent {
+  NoteEventType type;
+  uint8_t midi_note;
+  int64_t capture_time_ns;  // When the frame that caused the event was grabbed
+  int64_t trigger_time_ns;  // When the voice was started/stopped
+};
+
+/**
+ * Records every press and release of the piano into a fixed size in-memory
+ * journal. The journal is a single producer/single consumer ring buffer, so
+ * recording from PianoEngine::Run never blocks or allocates. A background
+ * thread drains the journal into a compact binary log and a Standard MIDI File.
+ */
+class PerformanceRecorder {
+ public:
+  /**
+   * Constructor. Opens the output files and starts the flushing thread.
+   * Throws std::runtime_error if either file cannot be opened.
+   * @param output_prefix       files are written to <prefix>.mid and
+   *                            <prefix>.log, replacing any files there
+   * @param journal_capacity    the number of events the journal can hold
+   *                            before the flushing thread drains it
+   * @param flush_interval_ms   how often the flushing thread wakes up
+   * @param thread_policies     applied to the flushing thread as the recorder
+   *                            thread, unless it is nullptr. Must outlive the
+   *                            recorder.
+   */
+  PerformanceRecorder(const std::string& output_prefix,
+                      size_t journal_capacity, int flush_interval_ms,
+                      common::ThreadPolicies* thread_policies = nullptr);
+
+  /**
+   * Stops the flushing thread and writes out whatever is left in the journal.
+   */
+  ~PerformanceRecorder();
+
+  /**
+   * Appends an event to the journal. Only one thread may call this.
+   * @param event   the event to be recorded
+   * @return        false if the journal was full and the event was dropped
+   */
+  bool Record(const NoteEvent& event);
+
+  /**
+   * Returns the number of events dropped because the journal was full.
+   */
+  size_t GetDroppedEvents() const;
+
+  /**
+   * Reads back a binary log written by a recorder.
+   * @param file_name   the path of the .log file
+   * @return            the recorded events, in the order they were recorded
+   */
+  static std::vector<NoteEvent> LoadBinaryLog(const std::string& file_name);
+
+ private:
+  /**
+   * Body of the flushing thread.
+   */
+  void FlushLoop();
+
+  /**
+   * Moves all events in the journal to the binary log and appends them to
+   * the MIDI track, if anything was drained.
+   */
+  void Drain();
+
+  /**
+   * Writes the new events of midi_events_ after the end of the track, ends
+   * the track again and patches its length, so that the file is complete
+   * after every flush without being rewritten.
+   */
+  void AppendMidiEvents();
+
+  const int flush_interval_ms_;
+  common::ThreadPolicies* const thread_policies_;
+  std::vector<NoteEvent> journal_;
+  std::atomic<size_t> head_;  // Next slot to be written by Record
+  std::atomic<size_t> tail_;  // Next slot to be read by Drain
+  std::atomic<size_t> dropped_events_;
+  std::atomic<bool> running_;
+  std::mutex flush_mutex_;
+  std::condition_variable flush_condition_;  // Wakes the flush thread on exit
+  std::ofstream binary_log_;
+  // A format 0 Standard MIDI File, only touched by the flush thread.
+  std::ofstream midi_file_;
+  uint32_t midi_track_size_;  // Bytes of the track before its end event
+  bool has_midi_events_;
+  int64_t previous_midi_time_ns_;  // Of the last event in the track
+  std::vector<char> midi_events_;  // Drained but not yet written
+  std::thread flush_thread_;
+};
+
+/**
+ * Converts a note name as used in the notes file(e.g "C4", "Db3") into its
+ * MIDI note number, where C4 is middle C(60).
+ * @param note_name   the note name
+ * @return            the MIDI note number, or -1 if the name is not a note.
+ */
+int NoteNameToMidiNumber(const std::string& note_name);
+
+/**
+ * Publishes a press or release on the bus as a NOTE_EVENT message, stamped
+ * with its trigger time.
+ */
+void PublishNoteEvent(common::SharedMemoryBusWriter& bus,
+                      const NoteEvent& event);
+
+/**
+ * Reads a NOTE_EVENT message.
+ * @return  false if the message is not a well formed note event
+ */
+bool ReadNoteEvent(const common::BusMessage& message, NoteEvent& event);
+
+const uint32_t JOURNAL_FILE_VERSION = 1;
+const int MIDI_TICKS_PER_QUARTER_NOTE = 1000;
+// One quarter note per second, so that a tick is exactly one millisecond.
+const int MIDI_MICROSECONDS_PER_QUARTER_NOTE = 1000000;
+const int MIDI_NOTE_VELOCITY = 100;
+}  // namespace piano
+#endif  // FINAL_PROJECT_PERFORMANCE_RECORDER_H
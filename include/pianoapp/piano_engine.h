@@ -4,16 +4,16 @@
 
 #ifndef FINAL_PROJECT_PIANO_ENGINE_H
 #define FINAL_PROJECT_PIANO_ENGINE_H
-#include <cinder/app/AppBase.h>
-
 #include <opencv2/opencv.hpp>
+#include <unordered_map>
 
-#include "cinder/Area.h"
-#include "cinder/Cinder.h"
-#include "cinder/CinderResources.h"
-#include "cinder/Vector.h"
-#include "cinder/audio/Voice.h"
-#include "cinder/gl/gl.h"
+#include "common/clock.h"
+#include "common/latency.h"
+#include "common/metrics.h"
+#include "pianoapp/audio_backend.h"
+#include "pianoapp/keyboard_layout.h"
+#include "pianoapp/performance_recorder.h"
+#include "pianoapp/renderer.h"
 
 namespace piano {
 
@@ -23,33 +23,31 @@ namespace piano {
  */
 struct Key {
   Key() = default;
-  Key(const ci::Rectf& rect, const std::string& audio_file_name,
-      const std::string note_name)
+  Key(const cv::Rect2f& rect, const std::string& audio_file_name,
+      const VoiceRef& key_sound, const std::string note_name)
       : rectangular_region(rect),
-        audio_file_name(audio_file_name),
+        key_sound(key_sound),
+        note_name(note_name),
+        midi_note(NoteNameToMidiNumber(note_name)),
         black_key_ptr(nullptr),
-        note_name(note_name) {
-    ci::audio::SourceFileRef source_file =
-        ci::audio::load(cinder::app::loadAsset(audio_file_name));
-    key_sound = ci::audio::Voice::create(source_file);
-    key_sound->setVolume(2.0f);
+        audio_file_name(audio_file_name) {
   }
 
-  Key(const ci::Rectf& rect, const std::string& audio_file_name,
-      Key* black_key_ptr, const std::string note_name)
+  Key(const cv::Rect2f& rect, const std::string& audio_file_name,
+      const VoiceRef& key_sound, Key* black_key_ptr,
+      const std::string note_name)
       : rectangular_region(rect),
-        audio_file_name(audio_file_name),
+        key_sound(key_sound),
+        note_name(note_name),
+        midi_note(NoteNameToMidiNumber(note_name)),
         black_key_ptr(black_key_ptr),
-        note_name(note_name) {
-    ci::audio::SourceFileRef source_file =
-        ci::audio::load(cinder::app::loadAsset(audio_file_name));
-    key_sound = ci::audio::Voice::create(source_file);
-    key_sound->setVolume(2.0f);
+        audio_file_name(audio_file_name) {
   }
-  const ci::Rectf rectangular_region;
-  ci::audio::VoiceRef key_sound;
-  ci::vec2 trigger_point;
+  const cv::Rect2f rectangular_region;
+  VoiceRef key_sound;
+  cv::Point2f trigger_point;
   const std::string note_name;
+  const int midi_note;
   const Key* black_key_ptr;
   const std::string audio_file_name;
 };
@@ -59,96 +57,144 @@ struct Key {
 class PianoEngine {
  public:
   /**
-   * Constructor
+   * Constructor. The keys of every zone are laid out and compiled into a map
+   * of the window, so that finding the key under a point takes the same time
+   * however many zones and keys there are.
    * @param top_left_corner           the top left corner of the application
    *                                  window
    * @param window_width              the width of the window
    * @param window_height             the height of the window
    * @param row_margin                the vertical space between keys in two
    *                                  separate rows
-   * @param number_of_white_keys      the total number of white keys
-   * @param number_of_rows            the total number of rows in the piano.
-   * @param file_name                 the file name which contains the order of
-   *                                  notes that the user wants the piano to
-   * have
+   * @param layout                    the zones of keys, see KeyboardLayout
+   * @param audio_backend             loads the sound of each key. Must outlive
+   *                                  the engine.
    */
   PianoEngine(const cv::Point& top_left_corner, double window_width,
-              double window_height, int row_margin, int number_of_white_keys,
-              int number_of_rows, const std::string& file_name);
+              double window_height, int row_margin,
+              const KeyboardLayout& layout, AudioBackend& audio_backend);
 
   /**
    * Draws all the keys on to the application window. Used in the cinder draw
    * function
+   * @param renderer  the renderer to draw with
    */
-  void DrawKeys();
+  void DrawKeys(Renderer& renderer);
   /**
    * Updates the state of the piano by responding to the inputted click points.
-   * @param points the points on the piano which are to be clicked.
+   * @param points            the points on the piano which are to be clicked.
+   * @param capture_time_ns   the time at which the frame the points were
+   *                          found in was captured. Used for recording and
+   *                          latency measurement.
+   * @param onset_times_ns    for each point, when its finger was first seen
+   *                          pressed(see GestureWrapper::GetLastOnsetTimes).
+   *                          May be empty.
    */
-  void Run(const std::vector<cv::Point>& points);
+  void Run(const std::vector<cv::Point>& points, int64_t capture_time_ns = 0,
+           const std::vector<int64_t>& onset_times_ns = {});
 
-  const std::vector<Key>& getWhiteKeys();
-  const std::vector<Key>& getBlackKeys();
-  const std::unordered_map<float, Key>& getPressedKeys();
+  /**
+   * Returns the timing of every key the last Run started.
+   */
+  const std::vector<common::PressTiming>& GetLastPressTimings() const;
+
+  /**
+   * Sets the clock that notes are timestamped with. The default is the steady
+   * clock. The engine does not own the clock.
+   */
+  void SetClock(const common::Clock& clock);
+
+  /**
+   * Plays or stops the key of a recorded event, without going through the
+   * click points. Used to replay a recorded performance.
+   * @param event   the recorded event
+   */
+  void Replay(const NoteEvent& event);
+
+  /**
+   * Sets the recorder that every press and release is written to. Pass
+   * nullptr to stop recording. The engine does not own the recorder.
+   */
+  void SetRecorder(PerformanceRecorder* recorder);
+
+  /**
+   * Sets the registry that the time of each Run, the presses and releases,
+   * and the latency from frame capture to note are recorded in. Pass nullptr
+   * to stop recording. The engine does not own the registry.
+   */
+  void SetMetrics(common::MetricsRegistry* metrics);
 
   /**
-   * Checks if the inputted point lies on a black key. A helper function made
-   * public for testing.
-   * @param point:          the input point
-   * @param previous_key:   the key before the nearest white key
-   * @param key:            the key nearest to the input point
-   * @return                0.5 if the point lies on the key, -0.5 if it lies on
-   *                        the previous key, and 0 otherwise
+   * Sets the bus every press and release is published on. Pass nullptr to
+   * stop publishing. Only the thread publishing the frames may call Run. The
+   * engine does not own the bus.
    */
-  static double CheckIfPointOnBlackKey(const cv::Point& point,
-                                       const Key& previous_key, const Key& key);
+  void SetBus(common::SharedMemoryBusWriter* bus);
+
+  const std::vector<Key>& getWhiteKeys();
+  const std::vector<Key>& getBlackKeys();
+  const std::unordered_map<float, Key>& getPressedKeys();
 
  private:
   /**
    * Plays the inputted key if it isnt playing already.
    * @param key
+   * @return    whether the key was started
    */
-  void PlayKey(Key& key);
+  bool PlayKey(Key& key, int64_t capture_time_ns);
 
   /**
    * Unplays the inputted key if it is playing
    */
-  void UnplayKey(Key& key);
+  void UnplayKey(Key& key, int64_t capture_time_ns);
 
   /**
-   * Sets up the initial state of keys : from positioning to matching the notes.
+   * Records the event and publishes it on the bus, if there are any.
    */
-  void SetupKeys();
+  void RecordEvent(const NoteEvent& event);
 
   /**
-   * Gets the index of the nearest white key to the point. Index returned is
-   * with respect to the white_keys vector.
+   * Sets up the keys of every zone, from positioning them to matching the
+   * notes, and draws them into the key map.
+   */
+  void SetupKeys(const KeyboardLayout& layout);
+
+  /**
+   * Sets the pixels of the key map that a key contains to its label.
+   */
+  void FillKeyMap(const cv::Rect2f& key_region, int label);
+
+  /**
+   * Gets the index of the key under the point from the key map. Index
+   * returned is with respect to the white_keys vector, plus 0.5 for the black
+   * key after a white key.
    * @param point the inputted point
-   * @return the nearest white key index.
+   * @return the key index, or the number of white keys if there is no key
+   *         under the point
    */
   float GetKeyIndexAtPoint(const cv::Point& point);
   const double CORNER_RADIUS_OF_KEYS = 0.5;
   const double BLACK_KEY_WIDTH_BY_WHITE_KEY_WIDTH = 0.4;
   const double BLACK_KEY_HEIGHT_BY_WHITE_KEY_HEIGHT = 0.66;
-  std::ifstream stream_reader_;
-  std::string audio_file_name_prefix_;
-  std::string audio_file_name_suffix_;
+  AudioBackend& audio_backend_;
   std::vector<Key> white_keys_;
   int row_margin_;
   std::vector<Key> black_keys_;
-  int number_of_white_keys_;
-  int number_of_rows_;
-  int number_of_keys_in_row_;
-  ci::Rectf window_region_;
-  double white_key_width_;
-  double white_key_height_;
+  cv::Rect2f window_region_;
+  // For every pixel of the window, twice the index of the white key under
+  // it, plus 1 for the black key after that white key, or -1 for no key.
+  cv::Mat key_map_;
   std::unordered_map<float, Key> pressed_keys_;
+  PerformanceRecorder* recorder_;
+  common::SharedMemoryBusWriter* bus_;
+  const common::Clock* clock_;
+  std::vector<common::PressTiming> last_press_timings_;
+  // Metrics, all null unless SetMetrics was called with a registry.
+  common::LatencyHistogram* run_histogram_;
+  common::LatencyHistogram* capture_to_note_histogram_;
+  common::Counter* press_counter_;
+  common::Counter* release_counter_;
+  common::Gauge* pressed_keys_gauge_;
 };
-/**
- * Converts an OpenCV point to a cinder/glm point
- * @param point opencv point
- * @return the glm version of point.
- */
-glm::vec2 ConvertToVec2(const cv::Point& point);
 }  // namespace piano
 #endif  // FINAL_PROJECT_PIANO_ENGINE_H
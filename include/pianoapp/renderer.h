@@ -0,0 +1,33 @@
+#ifndef FINAL_PROJECT_RENDERER_H
+#define FINAL_PROJECT_RENDERER_H
+
+#include <opencv2/core.hpp>
+#include <string>
+
+namespace piano {
+
+/**
+ * The drawing operations the piano needs. Keeps PianoEngine independent of the
+ * graphics library. Colors are in OpenCV's BGR order.
+ */
+class Renderer {
+ public:
+  virtual ~Renderer() = default;
+  virtual void DrawSolidRoundedRect(const cv::Rect2f& rect, float corner_radius,
+                                    const cv::Scalar& color) = 0;
+  virtual void DrawStrokedRect(const cv::Rect2f& rect,
+                               const cv::Scalar& color) = 0;
+  virtual void DrawSolidCircle(const cv::Point2f& center, float radius,
+                               const cv::Scalar& color) = 0;
+  virtual void DrawString(const std::string& text,
+                          const cv::Point2f& top_left_corner,
+                          const cv::Scalar& color) = 0;
+};
+
+const cv::Scalar WHITE(255, 255, 255);
+const cv::Scalar BLACK(0, 0, 0);
+const cv::Scalar RED(0, 0, 255);
+const cv::Scalar BLUE(255, 0, 0);
+const cv::Scalar PINK(203, 192, 255);
+}  // namespace piano
+#endif  // FINAL_PROJECT_RENDERER_H
@@ -0,0 +1,28 @@
+#include "pianoapp/audio_backend.h"
+
+namespace piano {
+
+namespace {
+class SilentVoice : public Voice {
+ public:
+  SilentVoice() : is_playing_(false) {
+  }
+  void Start() override {
+    is_playing_ = true;
+  }
+  void Stop() override {
+    is_playing_ = false;
+  }
+  bool IsPlaying() const override {
+    return is_playing_;
+  }
+
+ private:
+  bool is_playing_;
+};
+}  // namespace
+
+VoiceRef SilentAudioBackend::LoadVoice(const std::string& audio_file_name) {
+  return std::make_shared<SilentVoice>();
+}
+}  // namespace piano
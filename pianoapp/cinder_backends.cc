@@ -0,0 +1,111 @@
+#include "pianoapp/cinder_backends.h"
+
+#include "cinder/app/AppBase.h"
+
+namespace piano {
+
+namespace {
+class CinderVoice : public Voice {
+ public:
+  CinderVoice(const ci::audio::VoiceRef& voice) : voice_(voice) {
+  }
+  void Start() override {
+    voice_->start();
+  }
+  void Stop() override {
+    voice_->stop();
+  }
+  bool IsPlaying() const override {
+    return voice_->isPlaying();
+  }
+
+ private:
+  ci::audio::VoiceRef voice_;
+};
+
+/**
+ * A node which adds nothing to the output. Applies the audio thread's policy
+ * the first time it is pulled, which happens on the audio thread.
+ */
+class ThreadPolicyNode : public ci::audio::Node {
+ public:
+  ThreadPolicyNode(common::ThreadPolicies* thread_policies)
+      : ci::audio::Node(Format()),
+        thread_policies_(thread_policies),
+        applied_(false) {
+  }
+
+ protected:
+  void process(ci::audio::Buffer*) override {
+    if (!applied_) {
+      thread_policies_->Apply(common::AUDIO_THREAD);
+      applied_ = true;
+    }
+  }
+
+ private:
+  common::ThreadPolicies* const thread_policies_;
+  bool applied_;  // Only touched by the audio thread
+};
+}  // namespace
+
+CinderAudioBackend::~CinderAudioBackend() {
+  if (thread_policy_node_) {
+    thread_policy_node_->disconnectAll();
+  }
+}
+
+VoiceRef CinderAudioBackend::LoadVoice(const std::string& audio_file_name) {
+  ci::audio::SourceFileRef source_file =
+      ci::audio::load(cinder::app::loadAsset(audio_file_name));
+  ci::audio::VoiceRef voice = ci::audio::Voice::create(source_file);
+  voice->setVolume(KEY_VOLUME);
+  return std::make_shared<CinderVoice>(voice);
+}
+
+void CinderAudioBackend::SetThreadPolicies(
+    common::ThreadPolicies* thread_policies) {
+  ci::audio::Context* context = ci::audio::master();
+  thread_policy_node_ =
+      context->makeNode(new ThreadPolicyNode(thread_policies));
+  thread_policy_node_ >> context->getOutput();
+  thread_policy_node_->enable();
+  context->enable();
+}
+
+void CinderRenderer::DrawSolidRoundedRect(const cv::Rect2f& rect,
+                                          float corner_radius,
+                                          const cv::Scalar& color) {
+  ci::gl::color(ConvertToColor(color));
+  ci::gl::drawSolidRoundedRect(ConvertToRectf(rect), corner_radius);
+}
+
+void CinderRenderer::DrawStrokedRect(const cv::Rect2f& rect,
+                                     const cv::Scalar& color) {
+  ci::gl::color(ConvertToColor(color));
+  ci::gl::drawStrokedRect(ConvertToRectf(rect));
+}
+
+void CinderRenderer::DrawSolidCircle(const cv::Point2f& center, float radius,
+                                     const cv::Scalar& color) {
+  ci::gl::color(ConvertToColor(color));
+  ci::gl::drawSolidCircle(glm::vec2(center.x, center.y), radius);
+}
+
+void CinderRenderer::DrawString(const std::string& text,
+                                const cv::Point2f& top_left_corner,
+                                const cv::Scalar& color) {
+  ci::gl::drawString(text, glm::vec2(top_left_corner.x, top_left_corner.y),
+                     ci::ColorA(ConvertToColor(color)));
+}
+
+ci::Rectf ConvertToRectf(const cv::Rect2f& rect) {
+  return ci::Rectf(rect.x, rect.y, rect.x + rect.width, rect.y + rect.height);
+}
+
+ci::Color ConvertToColor(const cv::Scalar& color) {
+  return ci::Color(static_cast<float>(color[2] / 255),
+                   static_cast<float>(color[1] / 255),
+                   static_cast<float>(color[0] / 255));
+}
+}  // namespace piano
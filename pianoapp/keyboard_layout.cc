@@ -0,0 +1,192 @@
+#include "pianoapp/keyboard_layout.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include "pianoapp/performance_recorder.h"
+
+namespace piano {
+
+namespace {
+// Named with flats, as the samples are.
+const char* const NOTE_NAMES[] = {"C",  "Db", "D",  "Eb", "E",  "F",
+                                  "Gb", "G",  "Ab", "A",  "Bb", "B"};
+const int HIGHEST_MIDI_NOTE = 127;
+
+/**
+ * Throws std::invalid_argument unless the row starts and ends with a white
+ * key, never has two black keys next to each other, and every note has a
+ * MIDI number.
+ */
+void CheckRow(const std::vector<std::string>& notes,
+              const std::string& zone_name) {
+  if (notes.empty() || IsBlackKey(notes.front()) ||
+      IsBlackKey(notes.back())) {
+    throw std::invalid_argument("A row of zone " + zone_name +
+                                " must start and end with a white key!");
+  }
+  for (size_t i = 0; i < notes.size(); ++i) {
+    int midi_note = NoteNameToMidiNumber(notes[i]);
+    if (midi_note < 0 || midi_note > HIGHEST_MIDI_NOTE) {
+      throw std::invalid_argument("Zone " + zone_name + " has no note " +
+                                  notes[i]);
+    }
+    if (i > 0 && IsBlackKey(notes[i]) && IsBlackKey(notes[i - 1])) {
+      throw std::invalid_argument("Zone " + zone_name + " has black keys " +
+                                  notes[i - 1] + " and " + notes[i] +
+                                  " next to each other!");
+    }
+  }
+}
+
+KeyboardZone ParseZone(const nlohmann::json& description) {
+  KeyboardZone zone;
+  if (description.find("name") != description.end()) {
+    zone.name = description["name"];
+  }
+  if (description.find("region") != description.end()) {
+    const nlohmann::json& region = description["region"];
+    if (!region.is_array() || region.size() != 4) {
+      throw std::invalid_argument("The region of zone " + zone.name +
+                                  " must be [x, y, width, height]!");
+    }
+    zone.region = cv::Rect2f(region[0], region[1], region[2], region[3]);
+    if (zone.region.x < 0 || zone.region.y < 0 || zone.region.width <= 0 ||
+        zone.region.height <= 0 || zone.region.x + zone.region.width > 1 ||
+        zone.region.y + zone.region.height > 1) {
+      throw std::invalid_argument("The region of zone " + zone.name +
+                                  " must lie within the window!");
+    }
+  }
+  if (description.find("sample_prefix") != description.end()) {
+    zone.sample_prefix = description["sample_prefix"];
+  }
+  if (description.find("sample_suffix") != description.end()) {
+    zone.sample_suffix = description["sample_suffix"];
+  }
+  if (description.find("rows") == description.end() ||
+      !description["rows"].is_array() || description["rows"].empty()) {
+    throw std::invalid_argument("Zone " + zone.name + " has no rows!");
+  }
+  for (const nlohmann::json& row : description["rows"]) {
+    std::vector<std::string> notes;
+    if (row.find("notes") != row.end()) {
+      notes = row["notes"].get<std::vector<std::string>>();
+    } else if (row.find("first_note") != row.end() &&
+               row.find("white_keys") != row.end()) {
+      notes = GetNoteRange(row["first_note"], row["white_keys"]);
+    } else {
+      throw std::invalid_argument(
+          "A row of zone " + zone.name +
+          " needs either notes or a first note and a number of white keys!");
+    }
+    CheckRow(notes, zone.name);
+    zone.rows.push_back(notes);
+  }
+  return zone;
+}
+}  // namespace
+
+bool IsBlackKey(const std::string& note) {
+  return note.size() > 1 && (note[1] == 'b' || note[1] == '#');
+}
+
+std::vector<std::string> GetNoteRange(const std::string& first_note,
+                                      int number_of_white_keys) {
+  int midi_note = NoteNameToMidiNumber(first_note);
+  if (midi_note < 0 || IsBlackKey(first_note)) {
+    throw std::invalid_argument(first_note + " is not a white key!");
+  }
+  std::vector<std::string> notes;
+  for (int white_keys = 0; white_keys < number_of_white_keys; ++midi_note) {
+    std::string note = std::string(NOTE_NAMES[midi_note % 12]) +
+                       std::to_string(midi_note / 12 - 1);
+    notes.push_back(note);
+    if (!IsBlackKey(note)) {
+      ++white_keys;
+    }
+  }
+  return notes;
+}
+
+KeyboardLayout ParseKeyboardLayout(const nlohmann::json& description) {
+  if (!description.is_object() ||
+      description.find("zones") == description.end() ||
+      !description["zones"].is_array() || description["zones"].empty()) {
+    throw std::invalid_argument("A keyboard layout needs zones!");
+  }
+  KeyboardLayout layout;
+  for (const nlohmann::json& zone : description["zones"]) {
+    layout.zones.push_back(ParseZone(zone));
+  }
+  return layout;
+}
+
+KeyboardLayout ReadKeyboardLayoutFile(const std::string& file_name) {
+  std::ifstream stream(file_name);
+  if (!stream.is_open()) {
+    throw std::runtime_error("Could not open " + file_name);
+  }
+  return ParseKeyboardLayout(nlohmann::json::parse(stream));
+}
+
+KeyboardLayout ReadNotesFileLayout(const std::string& file_name,
+                                   int number_of_white_keys,
+                                   int number_of_rows) {
+  if (number_of_rows <= 0 || number_of_white_keys <= 0 ||
+      number_of_white_keys % number_of_rows != 0) {
+    throw std::invalid_argument(
+        "Number of Rows must be a factor of number of white keys!");
+  }
+  std::ifstream stream(file_name);
+  if (!stream.is_open()) {
+    throw std::runtime_error("Could not open " + file_name);
+  }
+  KeyboardZone zone;
+  zone.name = "piano";
+  stream >> zone.sample_prefix >> zone.sample_suffix;
+  const int keys_in_row = number_of_white_keys / number_of_rows;
+  std::string white_note;
+  std::string black_note;
+  stream >> white_note;
+  for (int row_number = 0; row_number < number_of_rows; ++row_number) {
+    std::vector<std::string> notes;
+    for (int j = 0; j < keys_in_row; ++j) {
+      if (j != 0) {
+        // We want the first key of a row to be the same as the last key of the
+        // previous row.
+        stream >> white_note;
+      }
+      if (!stream) {
+        throw std::invalid_argument(file_name + " runs out of notes!");
+      }
+      notes.push_back(white_note);
+      char note = white_note.at(0);
+      if (note != 'B' && note != 'E' && j != keys_in_row - 1) {
+        // There is no B# or E# in a piano.
+        stream >> black_note;
+        if (!stream) {
+          throw std::invalid_argument(file_name + " runs out of notes!");
+        }
+        notes.push_back(black_note);
+      }
+    }
+    CheckRow(notes, zone.name);
+    zone.rows.push_back(notes);
+  }
+  KeyboardLayout layout;
+  layout.zones.push_back(zone);
+  return layout;
+}
+
+KeyboardLayout LoadKeyboardLayout(const std::string& layout_file_name,
+                                  const std::string& notes_file_name,
+                                  int number_of_white_keys,
+                                  int number_of_rows) {
+  if (!layout_file_name.empty()) {
+    return ReadKeyboardLayoutFile(layout_file_name);
+  }
+  return ReadNotesFileLayout(notes_file_name, number_of_white_keys,
+                             number_of_rows);
+}
+}  // namespace piano
@@ -0,0 +1,258 @@
+#include "pianoapp/performance_recorder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace piano {
+
+namespace {
+const char JOURNAL_MAGIC[4] = {'G', 'P', 'J', 'L'};
+// The MIDI header chunk, then "MTrk" and the length of the track.
+const std::streamoff MIDI_TRACK_LENGTH_POSITION = 14 + 4;
+const std::streamoff MIDI_TRACK_START = MIDI_TRACK_LENGTH_POSITION + 4;
+const char MIDI_END_OF_TRACK[] = {0x00, static_cast<char>(0xFF), 0x2F, 0x00};
+
+/**
+ * Appends value to buffer as a big endian integer of the given byte count, as
+ * required by the MIDI file format.
+ */
+void AppendBigEndian(std::vector<char>& buffer, uint32_t value,
+                     int number_of_bytes) {
+  for (int shift = 8 * (number_of_bytes - 1); shift >= 0; shift -= 8) {
+    buffer.push_back(static_cast<char>((value >> shift) & 0xFF));
+  }
+}
+
+/**
+ * Appends value to buffer as a MIDI variable length quantity.
+ */
+void AppendVariableLength(std::vector<char>& buffer, uint32_t value) {
+  char bytes[5];
+  int count = 0;
+  bytes[count++] = static_cast<char>(value & 0x7F);
+  while ((value >>= 7) > 0) {
+    bytes[count++] = static_cast<char>((value & 0x7F) | 0x80);
+  }
+  while (count > 0) {
+    buffer.push_back(bytes[--count]);
+  }
+}
+}  // namespace
+
+PerformanceRecorder::PerformanceRecorder(
+    const std::string& output_prefix, size_t journal_capacity,
+    int flush_interval_ms, common::ThreadPolicies* thread_policies)
+    : flush_interval_ms_(flush_interval_ms),
+      thread_policies_(thread_policies),
+      journal_(journal_capacity),
+      head_(0),
+      tail_(0),
+      dropped_events_(0),
+      running_(true),
+      binary_log_(output_prefix + ".log", std::ios::binary | std::ios::trunc),
+      midi_file_(output_prefix + ".mid", std::ios::binary | std::ios::trunc),
+      midi_track_size_(0),
+      has_midi_events_(false),
+      previous_midi_time_ns_(0) {
+  if (journal_capacity == 0) {
+    throw std::invalid_argument("The journal capacity must be positive!");
+  }
+  if (!binary_log_.is_open() || !midi_file_.is_open()) {
+    throw std::runtime_error("Cannot write the performance to " +
+                             output_prefix + ".log and " + output_prefix +
+                             ".mid!");
+  }
+  binary_log_.write(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+  binary_log_.write(reinterpret_cast<const char*>(&JOURNAL_FILE_VERSION),
+                    sizeof(JOURNAL_FILE_VERSION));
+
+  std::vector<char> header{'M', 'T', 'h', 'd'};
+  AppendBigEndian(header, 6, 4);
+  AppendBigEndian(header, 0, 2);  // Format 0: a single track
+  AppendBigEndian(header, 1, 2);
+  AppendBigEndian(header, MIDI_TICKS_PER_QUARTER_NOTE, 2);
+  header.insert(header.end(), {'M', 'T', 'r', 'k'});
+  AppendBigEndian(header, 0, 4);  // Patched by AppendMidiEvents
+  midi_file_.write(header.data(), header.size());
+  // Tempo meta event, so that one tick is one millisecond.
+  AppendVariableLength(midi_events_, 0);
+  midi_events_.push_back(static_cast<char>(0xFF));
+  midi_events_.push_back(0x51);
+  midi_events_.push_back(0x03);
+  AppendBigEndian(midi_events_, MIDI_MICROSECONDS_PER_QUARTER_NOTE, 3);
+  AppendMidiEvents();
+  flush_thread_ = std::thread(&PerformanceRecorder::FlushLoop, this);
+}
+
+PerformanceRecorder::~PerformanceRecorder() {
+  {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    running_ = false;
+  }
+  flush_condition_.notify_all();
+  flush_thread_.join();
+  // The flush thread has exited, so we can safely drain the last events here.
+  Drain();
+}
+
+bool PerformanceRecorder::Record(const NoteEvent& event) {
+  size_t head = head_.load(std::memory_order_relaxed);
+  if (head - tail_.load(std::memory_order_acquire) >= journal_.size()) {
+    dropped_events_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  journal_[head % journal_.size()] = event;
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+size_t PerformanceRecorder::GetDroppedEvents() const {
+  return dropped_events_.load(std::memory_order_relaxed);
+}
+
+void PerformanceRecorder::FlushLoop() {
+  if (thread_policies_ != nullptr) {
+    thread_policies_->Apply(common::RECORDER_THREAD);
+  }
+  std::unique_lock<std::mutex> lock(flush_mutex_);
+  while (running_) {
+    flush_condition_.wait_for(lock,
+                              std::chrono::milliseconds(flush_interval_ms_));
+    lock.unlock();
+    Drain();
+    lock.lock();
+  }
+}
+
+void PerformanceRecorder::Drain() {
+  size_t tail = tail_.load(std::memory_order_relaxed);
+  size_t head = head_.load(std::memory_order_acquire);
+  if (tail == head) {
+    return;
+  }
+  for (; tail != head; ++tail) {
+    const NoteEvent& event = journal_[tail % journal_.size()];
+    uint8_t type = static_cast<uint8_t>(event.type);
+    binary_log_.write(reinterpret_cast<const char*>(&type), sizeof(type));
+    binary_log_.write(reinterpret_cast<const char*>(&event.midi_note),
+                      sizeof(event.midi_note));
+    binary_log_.write(reinterpret_cast<const char*>(&event.capture_time_ns),
+                      sizeof(event.capture_time_ns));
+    binary_log_.write(reinterpret_cast<const char*>(&event.trigger_time_ns),
+                      sizeof(event.trigger_time_ns));
+
+    if (!has_midi_events_) {
+      previous_midi_time_ns_ = event.trigger_time_ns;
+      has_midi_events_ = true;
+    }
+    int64_t delta_ms =
+        (event.trigger_time_ns - previous_midi_time_ns_) / 1000000;
+    if (delta_ms < 0) {
+      delta_ms = 0;
+    } else {
+      // Only advance by whole ticks so rounding errors do not accumulate.
+      previous_midi_time_ns_ += delta_ms * 1000000;
+    }
+    AppendVariableLength(midi_events_, static_cast<uint32_t>(delta_ms));
+    if (event.type == NoteEventType::PRESS) {
+      midi_events_.push_back(static_cast<char>(0x90));
+      midi_events_.push_back(static_cast<char>(event.midi_note & 0x7F));
+      midi_events_.push_back(static_cast<char>(MIDI_NOTE_VELOCITY));
+    } else {
+      midi_events_.push_back(static_cast<char>(0x80));
+      midi_events_.push_back(static_cast<char>(event.midi_note & 0x7F));
+      midi_events_.push_back(0);
+    }
+  }
+  // The slots can only be reused by Record once we have copied them out.
+  tail_.store(tail, std::memory_order_release);
+  binary_log_.flush();
+  AppendMidiEvents();
+}
+
+void PerformanceRecorder::AppendMidiEvents() {
+  // The new events overwrite the end of the track written by the last call.
+  midi_file_.seekp(MIDI_TRACK_START + midi_track_size_);
+  midi_file_.write(midi_events_.data(), midi_events_.size());
+  midi_file_.write(MIDI_END_OF_TRACK, sizeof(MIDI_END_OF_TRACK));
+  midi_track_size_ += static_cast<uint32_t>(midi_events_.size());
+  midi_events_.clear();
+
+  std::vector<char> track_length;
+  AppendBigEndian(track_length,
+                  midi_track_size_ + sizeof(MIDI_END_OF_TRACK), 4);
+  midi_file_.seekp(MIDI_TRACK_LENGTH_POSITION);
+  midi_file_.write(track_length.data(), track_length.size());
+  midi_file_.flush();
+}
+
+std::vector<NoteEvent> PerformanceRecorder::LoadBinaryLog(
+    const std::string& file_name) {
+  std::ifstream stream(file_name, std::ios::binary);
+  char magic[sizeof(JOURNAL_MAGIC)];
+  uint32_t version = 0;
+  stream.read(magic, sizeof(magic));
+  stream.read(reinterpret_cast<char*>(&version), sizeof(version));
+  if (!stream || !std::equal(magic, magic + sizeof(magic), JOURNAL_MAGIC) ||
+      version != JOURNAL_FILE_VERSION) {
+    throw std::invalid_argument(file_name + " is not a performance log!");
+  }
+
+  std::vector<NoteEvent> events;
+  NoteEvent event;
+  uint8_t type;
+  while (stream.read(reinterpret_cast<char*>(&type), sizeof(type)) &&
+         stream.read(reinterpret_cast<char*>(&event.midi_note),
+                     sizeof(event.midi_note)) &&
+         stream.read(reinterpret_cast<char*>(&event.capture_time_ns),
+                     sizeof(event.capture_time_ns)) &&
+         stream.read(reinterpret_cast<char*>(&event.trigger_time_ns),
+                     sizeof(event.trigger_time_ns))) {
+    event.type = static_cast<NoteEventType>(type);
+    events.push_back(event);
+  }
+  return events;
+}
+
+int NoteNameToMidiNumber(const std::string& note_name) {
+  // Semitone offsets of the natural notes from C.
+  static const int NOTE_OFFSETS[] = {9, 11, 0, 2, 4, 5, 7};  // A B C D E F G
+  if (note_name.size() < 2 || note_name[0] < 'A' || note_name[0] > 'G') {
+    return -1;
+  }
+  int semitone = NOTE_OFFSETS[note_name[0] - 'A'];
+  size_t octave_position = 1;
+  if (note_name[1] == 'b') {
+    --semitone;
+    ++octave_position;
+  } else if (note_name[1] == '#') {
+    ++semitone;
+    ++octave_position;
+  }
+  if (octave_position >= note_name.size() ||
+      !std::isdigit(note_name[octave_position])) {
+    return -1;
+  }
+  int octave = std::stoi(note_name.substr(octave_position));
+  return (octave + 1) * 12 + semitone;
+}
+
+void PublishNoteEvent(common::SharedMemoryBusWriter& bus,
+                      const NoteEvent& event) {
+  bus.Publish(common::BusMessageType::NOTE_EVENT, &event, sizeof(event),
+              event.trigger_time_ns);
+}
+
+bool ReadNoteEvent(const common::BusMessage& message, NoteEvent& event) {
+  if (message.type != common::BusMessageType::NOTE_EVENT ||
+      message.size != sizeof(event)) {
+    return false;
+  }
+  std::memcpy(&event, message.data, sizeof(event));
+  return event.type == NoteEventType::PRESS ||
+         event.type == NoteEventType::RELEASE;
+}
+}  // namespace piano
@@ -4,117 +4,177 @@
 
 #include "pianoapp/piano_engine.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
 namespace piano {
 PianoEngine::PianoEngine(const cv::Point& top_left_corner, double window_width,
                          double window_height, int row_margin,
-                         int number_of_white_keys, int number_of_rows,
-                         const std::string& file_name)
-    : window_region_(ConvertToVec2(top_left_corner),
-                     glm::vec2((top_left_corner.x + window_width,
-                                top_left_corner.y + window_height))),
-      number_of_rows_(number_of_rows),
+                         const KeyboardLayout& layout,
+                         AudioBackend& audio_backend)
+    : audio_backend_(audio_backend),
       row_margin_(row_margin),
-      number_of_white_keys_(number_of_white_keys),
-      number_of_keys_in_row_(number_of_white_keys_ / number_of_rows),
-      white_key_height_((window_region_.getHeight() / number_of_rows) -
-                        row_margin),
-      white_key_width_(window_region_.getWidth() / number_of_keys_in_row_) {
-  stream_reader_.open(file_name);
-  stream_reader_ >> audio_file_name_prefix_;
-  stream_reader_ >> audio_file_name_suffix_;
-  SetupKeys();
-}
-
-void PianoEngine::SetupKeys() {
-  if (number_of_white_keys_ % number_of_rows_ != 0 ||
-      number_of_white_keys_ < 0) {
-    throw std::invalid_argument(
-        "Number of Rows must be a factor of number of white keys!");
-  }
-  /*We reserve number_of_white_keys_ space to prevent the vector from being
+      // The keys span the whole width. The Cinder version built the corner
+      // as glm::vec2((x + w, y + h)), whose comma operator made the window
+      // window_height wide.
+      window_region_(static_cast<float>(top_left_corner.x),
+                     static_cast<float>(top_left_corner.y),
+                     static_cast<float>(window_width),
+                     static_cast<float>(window_height)),
+      recorder_(nullptr),
+      bus_(nullptr),
+      clock_(&common::GetSteadyClock()),
+      run_histogram_(nullptr),
+      capture_to_note_histogram_(nullptr),
+      press_counter_(nullptr),
+      release_counter_(nullptr),
+      pressed_keys_gauge_(nullptr) {
+  SetupKeys(layout);
+}
+
+void PianoEngine::SetupKeys(const KeyboardLayout& layout) {
+  size_t number_of_white_keys = 0;
+  size_t number_of_black_keys = 0;
+  for (const KeyboardZone& zone : layout.zones) {
+    for (const std::vector<std::string>& row : zone.rows) {
+      for (const std::string& note : row) {
+        ++(IsBlackKey(note) ? number_of_black_keys : number_of_white_keys);
+      }
+    }
+  }
+  if (2 * number_of_white_keys >=
+      static_cast<size_t>(std::numeric_limits<int16_t>::max())) {
+    throw std::invalid_argument("The layout has too many keys!");
+  }
+  /*We reserve space for every black key to prevent the vector from being
     reallocated when elements are pushed back. When it is reallocated, the
     pointers to the black keys in white keys are invalidated*/
-  black_keys_.reserve(number_of_white_keys_);
-  std::string white_key_audio_file_name;
-  std::string black_key_audio_file_name;
-  stream_reader_ >> white_key_audio_file_name;
-
-  glm::vec2 start_point = window_region_.getLowerLeft();
-  for (int row_number = number_of_rows_; row_number > 0; --row_number) {
-    for (size_t j = 0; j < number_of_keys_in_row_; ++j) {
-      glm::vec2 white_key_start_point = glm::vec2(
-          (start_point.x + j * white_key_width_),
-          (start_point.y - row_number * (white_key_height_ + row_margin_)));
-      glm::vec2 white_key_end_point(
-          (white_key_start_point.x + white_key_width_),
-          (white_key_start_point.y + white_key_height_));
-      if (j != 0) {
-        // We want the first key of a row to be the same as the last key of the
-        // previous row.
-        stream_reader_ >> white_key_audio_file_name;
+  black_keys_.reserve(number_of_black_keys);
+  white_keys_.reserve(number_of_white_keys);
+  key_map_.create(static_cast<int>(std::ceil(window_region_.height)),
+                  static_cast<int>(std::ceil(window_region_.width)), CV_16SC1);
+  key_map_.setTo(-1);
+
+  for (const KeyboardZone& zone : layout.zones) {
+    cv::Rect2f zone_region(
+        window_region_.x + zone.region.x * window_region_.width,
+        window_region_.y + zone.region.y * window_region_.height,
+        zone.region.width * window_region_.width,
+        zone.region.height * window_region_.height);
+    size_t keys_in_widest_row = 0;
+    for (const std::vector<std::string>& row : zone.rows) {
+      keys_in_widest_row = std::max<size_t>(
+          keys_in_widest_row,
+          std::count_if(row.begin(), row.end(), [](const std::string& note) {
+            return !IsBlackKey(note);
+          }));
+    }
+    double white_key_width = zone_region.width / keys_in_widest_row;
+    double row_height = zone_region.height / zone.rows.size();
+    double white_key_height = row_height - row_margin_;
+    size_t first_white_key = white_keys_.size();
+
+    for (size_t row_number = 0; row_number < zone.rows.size(); ++row_number) {
+      int white_keys_in_row = 0;
+      for (const std::string& note : zone.rows[row_number]) {
+        std::string audio_file_name =
+            zone.sample_prefix + note + zone.sample_suffix;
+        if (!IsBlackKey(note)) {
+          cv::Point2f white_key_start_point(
+              static_cast<float>(zone_region.x +
+                                 white_keys_in_row * white_key_width),
+              static_cast<float>(zone_region.y + row_number * row_height));
+          cv::Point2f white_key_end_point(
+              static_cast<float>(white_key_start_point.x + white_key_width),
+              static_cast<float>(white_key_start_point.y + white_key_height));
+          white_keys_.push_back(
+              Key(cv::Rect2f(white_key_start_point, white_key_end_point),
+                  audio_file_name, audio_backend_.LoadVoice(audio_file_name),
+                  note));
+          ++white_keys_in_row;
+          continue;
+        }
+        // A black key sits between the white key before it and the next.
+        Key& white_key = white_keys_.back();
+        cv::Point2f black_key_start_point(
+            static_cast<float>(white_key.rectangular_region.x +
+                               0.75 * white_key_width),
+            white_key.rectangular_region.y);
+        cv::Point2f black_key_end_point(
+            static_cast<float>(black_key_start_point.x +
+                               BLACK_KEY_WIDTH_BY_WHITE_KEY_WIDTH *
+                                   white_key_width),
+            static_cast<float>(black_key_start_point.y +
+                               (white_key_height *
+                                BLACK_KEY_HEIGHT_BY_WHITE_KEY_HEIGHT)));
+        black_keys_.push_back(
+            Key(cv::Rect2f(black_key_start_point, black_key_end_point),
+                audio_file_name, audio_backend_.LoadVoice(audio_file_name),
+                note));
+        white_key.black_key_ptr = &black_keys_.back();
       }
+    }
 
-      char note = white_key_audio_file_name.at(0);
-      if (note == 'B' || note == 'E' || j == number_of_keys_in_row_ - 1) {
-        // There is no B# or E# in a piano, so we just add a white key
-        Key key(
-            ci::Rectf(white_key_start_point, glm::vec2((white_key_end_point))),
-            audio_file_name_prefix_ + white_key_audio_file_name +
-                audio_file_name_suffix_,
-            white_key_audio_file_name);
-        white_keys_.push_back(key);
-      } else {
-        glm::vec2 black_key_start_point =
-            glm::vec2((white_key_start_point.x + 0.75 * white_key_width_),
-                      white_key_start_point.y);
-        glm::vec2 black_key_end_point = glm::vec2(
-            (black_key_start_point.x +
-             BLACK_KEY_WIDTH_BY_WHITE_KEY_WIDTH * white_key_width_),
-            (white_key_start_point.y +
-             (white_key_height_ * BLACK_KEY_HEIGHT_BY_WHITE_KEY_HEIGHT)));
-        stream_reader_ >> black_key_audio_file_name;
-        Key black_key(ci::Rectf(black_key_start_point, black_key_end_point),
-                      audio_file_name_prefix_ + black_key_audio_file_name +
-                          audio_file_name_suffix_,
-                      black_key_audio_file_name);
-        black_keys_.push_back(black_key);
-        Key white_key(
-            ci::Rectf(white_key_start_point, glm::vec2((white_key_end_point))),
-            audio_file_name_prefix_ + white_key_audio_file_name +
-                audio_file_name_suffix_,
-            &(*black_keys_.rbegin()), white_key_audio_file_name);
-        white_keys_.push_back(white_key);
+    // The black keys are drawn over the white ones, and each zone over the
+    // zones before it.
+    for (size_t i = first_white_key; i < white_keys_.size(); ++i) {
+      FillKeyMap(white_keys_[i].rectangular_region, static_cast<int>(2 * i));
+    }
+    for (size_t i = first_white_key; i < white_keys_.size(); ++i) {
+      if (white_keys_[i].black_key_ptr != nullptr) {
+        FillKeyMap(white_keys_[i].black_key_ptr->rectangular_region,
+                   static_cast<int>(2 * i + 1));
       }
     }
   }
-  return;
 }
 
-void PianoEngine::DrawKeys() {
+void PianoEngine::FillKeyMap(const cv::Rect2f& key_region, int label) {
+  // The pixels a key contains are those from the first whole pixel at or
+  // after its top left corner to the last one before its bottom right.
+  float left = key_region.x - window_region_.x;
+  float top = key_region.y - window_region_.y;
+  int first_column = static_cast<int>(std::ceil(left));
+  int first_row = static_cast<int>(std::ceil(top));
+  int end_column = static_cast<int>(std::ceil(left + key_region.width));
+  int end_row = static_cast<int>(std::ceil(top + key_region.height));
+  cv::Rect pixels = cv::Rect(first_column, first_row,
+                             end_column - first_column, end_row - first_row) &
+                    cv::Rect(0, 0, key_map_.cols, key_map_.rows);
+  if (pixels.area() > 0) {
+    key_map_(pixels).setTo(label);
+  }
+}
+
+void PianoEngine::DrawKeys(Renderer& renderer) {
   for (const Key& white_key : white_keys_) {
-    ci::gl::color(ci::Color("white"));
-    ci::gl::drawSolidRoundedRect(white_key.rectangular_region,
-                                 CORNER_RADIUS_OF_KEYS);
-    ci::gl::color(ci::Color("black"));
-    ci::gl::drawStrokedRect(white_key.rectangular_region);
+    renderer.DrawSolidRoundedRect(white_key.rectangular_region,
+                                  CORNER_RADIUS_OF_KEYS, WHITE);
+    renderer.DrawStrokedRect(white_key.rectangular_region, BLACK);
   }
   for (const Key& black_key : black_keys_) {
-    ci::gl::color(ci::Color("black"));
-    ci::gl::drawSolidRoundedRect(black_key.rectangular_region,
-                                 CORNER_RADIUS_OF_KEYS);
+    renderer.DrawSolidRoundedRect(black_key.rectangular_region,
+                                  CORNER_RADIUS_OF_KEYS, BLACK);
   }
-  for (auto pair : pressed_keys_) {
-    ci::gl::color(ci::Color("red"));
-    ci::gl::drawSolidRoundedRect(pair.second.rectangular_region,
-                                 CORNER_RADIUS_OF_KEYS);
+  for (const auto& pair : pressed_keys_) {
+    renderer.DrawSolidRoundedRect(pair.second.rectangular_region,
+                                  CORNER_RADIUS_OF_KEYS, RED);
   }
 }
 
-void PianoEngine::Run(const std::vector<cv::Point>& points) {
+void PianoEngine::Run(const std::vector<cv::Point>& points,
+                      int64_t capture_time_ns,
+                      const std::vector<int64_t>& onset_times_ns) {
+  int64_t run_start_ns =
+      run_histogram_ != nullptr ? common::GetTimestampNanoseconds() : 0;
   std::vector<double> indexes_of_keys;
   std::vector<double> keys_to_remove;
+  last_press_timings_.clear();
 
-  for (cv::Point point : points) {
+  for (size_t point_index = 0; point_index < points.size(); ++point_index) {
+    const cv::Point& point = points[point_index];
     // We convert the point to the coordinate system of the piano.
     // We check for any additional piano keys to be pressed.
     float key_index = GetKeyIndexAtPoint(point);
@@ -131,7 +191,19 @@ void PianoEngine::Run(const std::vector<cv::Point>& points) {
           pressed_keys_.insert(
               {(key_index), white_keys_.at(static_cast<int>(key_index))});
         }
-        PlayKey(pressed_keys_.at(key_index));
+        Key& key = pressed_keys_.at(key_index);
+        if (PlayKey(key, capture_time_ns)) {
+          int64_t onset_ns = point_index < onset_times_ns.size()
+                                 ? onset_times_ns[point_index]
+                                 : capture_time_ns;
+          last_press_timings_.push_back({key.midi_note, onset_ns,
+                                         capture_time_ns,
+                                         clock_->GetTimestampNanoseconds()});
+          if (capture_to_note_histogram_ != nullptr && capture_time_ns != 0) {
+            capture_to_note_histogram_->Record(
+                last_press_timings_.back().trigger_ns - capture_time_ns);
+          }
+        }
       }
     }
   }
@@ -142,7 +214,7 @@ void PianoEngine::Run(const std::vector<cv::Point>& points) {
          ++iterator) {
       if (std::find(indexes_of_keys.begin(), indexes_of_keys.end(),
                     iterator->first) == indexes_of_keys.end()) {
-        UnplayKey(pressed_keys_.at(iterator->first));
+        UnplayKey(pressed_keys_.at(iterator->first), capture_time_ns);
         keys_to_remove.push_back(iterator->first);
       }
     }
@@ -150,57 +222,108 @@ void PianoEngine::Run(const std::vector<cv::Point>& points) {
       pressed_keys_.erase(keytr);
     }
   }
-}
-
-glm::vec2 ConvertToVec2(const cv::Point& point) {
-  return glm::vec2(point.x, point.y);
+  if (run_histogram_ != nullptr) {
+    pressed_keys_gauge_->Set(static_cast<double>(pressed_keys_.size()));
+    run_histogram_->Record(common::GetTimestampNanoseconds() - run_start_ns);
+  }
 }
 
 float PianoEngine::GetKeyIndexAtPoint(const cv::Point& point) {
-  if (!window_region_.contains(ConvertToVec2(point))) {
+  int column = point.x - static_cast<int>(window_region_.x);
+  int row = point.y - static_cast<int>(window_region_.y);
+  if (column < 0 || row < 0 || column >= key_map_.cols ||
+      row >= key_map_.rows) {
     return static_cast<float>(white_keys_.size());
   }
-  double marginal_value;
-  int column_number = static_cast<int>(number_of_keys_in_row_ * point.x /
-                                       window_region_.getWidth());
-  int row_number =
-      static_cast<int>(number_of_rows_ * point.y / window_region_.getHeight());
-  int index_to_return = row_number * number_of_keys_in_row_ + column_number;
-  if (index_to_return == 0) {
-    // Since 0 -1 = 1 is not a valid index
-    marginal_value =
-        CheckIfPointOnBlackKey(point, white_keys_[white_keys_.size() - 1],
-                               white_keys_[index_to_return]);
-  } else {
-    marginal_value = CheckIfPointOnBlackKey(
-        point, white_keys_[index_to_return - 1], white_keys_[index_to_return]);
+  int label = key_map_.at<int16_t>(row, column);
+  if (label < 0) {
+    return static_cast<float>(white_keys_.size());
   }
-  return index_to_return + marginal_value;
+  return label / 2.0f;
 }
-void PianoEngine::PlayKey(Key& key) {
-  if (!key.key_sound->isPlaying()) {
-    key.key_sound->start();
+bool PianoEngine::PlayKey(Key& key, int64_t capture_time_ns) {
+  if (key.key_sound->IsPlaying()) {
+    return false;
+  }
+  key.key_sound->Start();
+  if (press_counter_ != nullptr) {
+    press_counter_->Increment();
+  }
+  if (key.midi_note >= 0) {
+    RecordEvent({NoteEventType::PRESS, static_cast<uint8_t>(key.midi_note),
+                 capture_time_ns, clock_->GetTimestampNanoseconds()});
+  }
+  return true;
+}
+
+void PianoEngine::UnplayKey(Key& key, int64_t capture_time_ns) {
+  if (key.key_sound->IsPlaying()) {
+    key.key_sound->Stop();
+    if (release_counter_ != nullptr) {
+      release_counter_->Increment();
+    }
+    if (key.midi_note >= 0) {
+      RecordEvent({NoteEventType::RELEASE,
+                   static_cast<uint8_t>(key.midi_note), capture_time_ns,
+                   clock_->GetTimestampNanoseconds()});
+    }
+  }
+}
+
+void PianoEngine::Replay(const NoteEvent& event) {
+  for (std::vector<Key>* keys : {&white_keys_, &black_keys_}) {
+    for (Key& key : *keys) {
+      if (key.midi_note != event.midi_note) {
+        continue;
+      }
+      if (event.type == NoteEventType::PRESS) {
+        PlayKey(key, event.capture_time_ns);
+      } else {
+        UnplayKey(key, event.capture_time_ns);
+      }
+      return;
+    }
   }
 }
 
-double PianoEngine::CheckIfPointOnBlackKey(const cv::Point& point,
-                                           const Key& previous_key,
-                                           const Key& key) {
-  if (previous_key.black_key_ptr != nullptr &&
-      previous_key.black_key_ptr->rectangular_region.contains(
-          ConvertToVec2(point))) {
-    return -0.5;
+void PianoEngine::RecordEvent(const NoteEvent& event) {
+  if (recorder_ != nullptr) {
+    recorder_->Record(event);
   }
-  if (key.black_key_ptr != nullptr &&
-      key.black_key_ptr->rectangular_region.contains(ConvertToVec2(point))) {
-    return 0.5;
+  if (bus_ != nullptr) {
+    PublishNoteEvent(*bus_, event);
   }
-  return 0;
 }
-void PianoEngine::UnplayKey(Key& key) {
-  if (key.key_sound->isPlaying()) {
-    key.key_sound->stop();
+
+void PianoEngine::SetRecorder(PerformanceRecorder* recorder) {
+  recorder_ = recorder;
+}
+
+void PianoEngine::SetBus(common::SharedMemoryBusWriter* bus) {
+  bus_ = bus;
+}
+
+const std::vector<common::PressTiming>& PianoEngine::GetLastPressTimings()
+    const {
+  return last_press_timings_;
+}
+
+void PianoEngine::SetClock(const common::Clock& clock) {
+  clock_ = &clock;
+}
+
+void PianoEngine::SetMetrics(common::MetricsRegistry* metrics) {
+  if (metrics == nullptr) {
+    run_histogram_ = capture_to_note_histogram_ = nullptr;
+    press_counter_ = release_counter_ = nullptr;
+    pressed_keys_gauge_ = nullptr;
+    return;
   }
+  run_histogram_ = &metrics->GetHistogram("piano.run");
+  capture_to_note_histogram_ = &metrics->GetHistogram("piano.capture_to_note");
+  press_counter_ = &metrics->GetCounter("piano.presses");
+  release_counter_ = &metrics->GetCounter("piano.releases");
+  pressed_keys_gauge_ = &metrics->GetGauge("piano.pressed_keys");
 }
 
 const std::vector<Key>& PianoEngine::getBlackKeys() {
@@ -0,0 +1,346 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gesturerecognition/capture_device.h"
+#include "gesturerecognition/frame_source.h"
+
+using gesturerecognition::CaptureDevice;
+using gesturerecognition::CapturedFrame;
+using gesturerecognition::DeviceBuffer;
+using gesturerecognition::DeviceFrameSource;
+using gesturerecognition::FileCaptureDevice;
+using gesturerecognition::PixelFormat;
+
+namespace {
+const cv::Size FRAME_SIZE(8, 4);
+const size_t FRAME_BYTES = 2 * 8 * 4;  // Of a YUYV frame of FRAME_SIZE
+const double FRAMES_PER_SECOND = 100;
+const int64_t FRAME_INTERVAL_NS = 10000000;
+
+/**
+ * A raw YUYV file in which every byte of a frame holds the frame's number. It
+ * is removed when it goes out of scope.
+ */
+class RawFile {
+ public:
+  RawFile(const std::string& name, size_t frame_count) : name_(name) {
+    std::ofstream file(name_, std::ios::binary);
+    for (size_t i = 0; i < frame_count; ++i) {
+      std::vector<char> frame(FRAME_BYTES, static_cast<char>(i));
+      file.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+    }
+  }
+
+  ~RawFile() {
+    std::remove(name_.c_str());
+  }
+
+  const std::string& GetName() const {
+    return name_;
+  }
+
+ private:
+  const std::string name_;
+};
+
+/**
+ * A frame a ScriptedDevice delivers.
+ */
+struct ScriptedFrame {
+  uint32_t sequence;
+  size_t bytes_used;
+};
+
+/**
+ * A device with two buffers that delivers the frames of a script as soon as
+ * they are asked for, filling the queued buffers in the order they were
+ * queued. Every byte of a frame holds its sequence number, and it is
+ * timestamped a microsecond per sequence number.
+ */
+class ScriptedDevice : public CaptureDevice {
+ public:
+  explicit ScriptedDevice(const std::vector<ScriptedFrame>& script)
+      : script_(script),
+        next_frame_(0),
+        buffers_(2, std::vector<uchar>(FRAME_BYTES)),
+        queued_buffers_({0, 1}) {
+  }
+
+  bool Dequeue(DeviceBuffer& buffer) override {
+    if (next_frame_ == script_.size()) {
+      return false;
+    }
+    if (queued_buffers_.empty()) {
+      throw std::logic_error("Every buffer of the device is dequeued!");
+    }
+    const ScriptedFrame& frame = script_[next_frame_++];
+    const size_t index = queued_buffers_.front();
+    queued_buffers_.pop_front();
+    std::fill(buffers_[index].begin(), buffers_[index].end(),
+              static_cast<uchar>(frame.sequence));
+    buffer.index_ = index;
+    buffer.data_ = buffers_[index].data();
+    buffer.bytes_used_ = frame.bytes_used;
+    buffer.sequence_ = frame.sequence;
+    buffer.timestamp_ns_ = 1000 * static_cast<int64_t>(frame.sequence);
+    return true;
+  }
+
+  void Queue(size_t index) override {
+    if (std::find(queued_buffers_.begin(), queued_buffers_.end(), index) !=
+        queued_buffers_.end()) {
+      throw std::logic_error("The buffer is already queued!");
+    }
+    queued_buffers_.push_back(index);
+  }
+
+  PixelFormat GetPixelFormat() const override {
+    return PixelFormat::YUYV;
+  }
+
+  cv::Size GetFrameSize() const override {
+    return FRAME_SIZE;
+  }
+
+  size_t GetBytesPerLine() const override {
+    return 2 * FRAME_SIZE.width;
+  }
+
+  double GetFramesPerSecond() const override {
+    return FRAMES_PER_SECOND;
+  }
+
+  size_t GetBufferCount() const override {
+    return buffers_.size();
+  }
+
+  /**
+   * Returns the number of buffers the device may fill.
+   */
+  size_t GetQueuedCount() const {
+    return queued_buffers_.size();
+  }
+
+ private:
+  const std::vector<ScriptedFrame> script_;
+  size_t next_frame_;
+  std::vector<std::vector<uchar>> buffers_;
+  std::deque<size_t> queued_buffers_;
+};
+
+/**
+ * Sleeps for the given number of frame intervals.
+ */
+void SleepFrames(int frames) {
+  std::this_thread::sleep_for(std::chrono::nanoseconds(frames *
+                                                       FRAME_INTERVAL_NS));
+}
+}  // namespace
+
+TEST_CASE("A file capture device checks its arguments", "[capture-device]") {
+  RawFile file("test_capture_arguments.yuyv", 3);
+
+  SECTION("The format must be YUV") {
+    REQUIRE_THROWS_AS(FileCaptureDevice(file.GetName(), PixelFormat::BGR,
+                                        FRAME_SIZE, FRAMES_PER_SECOND, 2,
+                                        false),
+                      std::invalid_argument);
+  }
+
+  SECTION("The frame size must be even") {
+    REQUIRE_THROWS_AS(FileCaptureDevice(file.GetName(), PixelFormat::YUYV,
+                                        cv::Size(7, 4), FRAMES_PER_SECOND, 2,
+                                        false),
+                      std::invalid_argument);
+  }
+
+  SECTION("There must be at least 2 buffers") {
+    REQUIRE_THROWS_AS(FileCaptureDevice(file.GetName(), PixelFormat::YUYV,
+                                        FRAME_SIZE, FRAMES_PER_SECOND, 1,
+                                        false),
+                      std::invalid_argument);
+  }
+
+  SECTION("Dequeuing while every buffer is dequeued is an error") {
+    FileCaptureDevice device(file.GetName(), PixelFormat::YUYV, FRAME_SIZE,
+                             FRAMES_PER_SECOND, 2, false);
+    DeviceBuffer buffer;
+    REQUIRE(device.Dequeue(buffer));
+    REQUIRE(device.Dequeue(buffer));
+    REQUIRE_THROWS_AS(device.Dequeue(buffer), std::logic_error);
+  }
+}
+
+TEST_CASE("An unpaced file capture device delivers every frame in order",
+          "[capture-device]") {
+  const size_t frame_count = 5;
+  RawFile file("test_capture_unpaced.yuyv", frame_count);
+  FileCaptureDevice device(file.GetName(), PixelFormat::YUYV, FRAME_SIZE,
+                           FRAMES_PER_SECOND, 2, false);
+  REQUIRE(device.GetBufferCount() == 2);
+  REQUIRE(device.GetBytesPerLine() == FRAME_BYTES / FRAME_SIZE.height);
+
+  int64_t last_timestamp_ns = 0;
+  for (size_t i = 0; i < frame_count; ++i) {
+    DeviceBuffer buffer;
+    REQUIRE(device.Dequeue(buffer));
+    REQUIRE(buffer.sequence_ == i);
+    REQUIRE(buffer.bytes_used_ == FRAME_BYTES);
+    REQUIRE(buffer.data_[0] == i);
+    REQUIRE(buffer.data_[FRAME_BYTES - 1] == i);
+    // Timestamped when it was read.
+    REQUIRE(buffer.timestamp_ns_ > 0);
+    REQUIRE(buffer.timestamp_ns_ >= last_timestamp_ns);
+    last_timestamp_ns = buffer.timestamp_ns_;
+    device.Queue(buffer.index_);
+  }
+  DeviceBuffer buffer;
+  REQUIRE_FALSE(device.Dequeue(buffer));
+}
+
+TEST_CASE("A paced file capture device", "[capture-device]") {
+  RawFile file("test_capture_paced.yuyv", 30);
+  FileCaptureDevice device(file.GetName(), PixelFormat::YUYV, FRAME_SIZE,
+                           FRAMES_PER_SECOND, 2, true);
+  DeviceBuffer first;
+  REQUIRE(device.Dequeue(first));
+  REQUIRE(first.sequence_ == 0);
+  REQUIRE(first.data_[0] == 0);
+
+  SECTION("Timestamps every frame with when it was due") {
+    device.Queue(first.index_);
+    uint32_t last_sequence = 0;
+    for (int i = 0; i < 4; ++i) {
+      DeviceBuffer buffer;
+      REQUIRE(device.Dequeue(buffer));
+      REQUIRE(buffer.sequence_ > last_sequence);
+      REQUIRE(buffer.data_[0] == buffer.sequence_);
+      REQUIRE(buffer.timestamp_ns_ - first.timestamp_ns_ ==
+              buffer.sequence_ * FRAME_INTERVAL_NS);
+      last_sequence = buffer.sequence_;
+      device.Queue(buffer.index_);
+    }
+  }
+
+  SECTION("Drops the frames due while every buffer is dequeued") {
+    DeviceBuffer second;
+    REQUIRE(device.Dequeue(second));
+    REQUIRE(second.sequence_ == 1);
+    // Frames 2 to 5 at least are due while both buffers are held.
+    SleepFrames(5);
+    device.Queue(first.index_);
+    DeviceBuffer third;
+    REQUIRE(device.Dequeue(third));
+    REQUIRE(third.sequence_ >= 6);
+    REQUIRE(third.data_[0] == third.sequence_);
+    REQUIRE(third.timestamp_ns_ - first.timestamp_ns_ ==
+            third.sequence_ * FRAME_INTERVAL_NS);
+
+    // The next frame goes straight into the queued buffer.
+    device.Queue(second.index_);
+    device.Queue(third.index_);
+    DeviceBuffer fourth;
+    REQUIRE(device.Dequeue(fourth));
+    REQUIRE(fourth.sequence_ > third.sequence_);
+    REQUIRE(fourth.data_[0] == fourth.sequence_);
+  }
+}
+
+TEST_CASE("A device frame source reads frames out of the device's buffers",
+          "[device-frame-source]") {
+  SECTION("Each buffer is handed back by the next Read") {
+    auto* device = new ScriptedDevice(
+        {{0, FRAME_BYTES}, {1, FRAME_BYTES}, {2, FRAME_BYTES}});
+    DeviceFrameSource source((std::unique_ptr<CaptureDevice>(device)));
+    REQUIRE(source.CountsDroppedFrames());
+    REQUIRE(source.GetFrameSize() == FRAME_SIZE);
+
+    const uchar* last_data = nullptr;
+    for (uint32_t sequence = 0; sequence < 3; ++sequence) {
+      CapturedFrame frame;
+      REQUIRE(source.Read(frame));
+      // Only the frame being read is held, whatever the source read before.
+      REQUIRE(device->GetQueuedCount() == 1);
+      REQUIRE(frame.format_ == PixelFormat::YUYV);
+      REQUIRE(frame.data_.type() == CV_8UC2);
+      REQUIRE(frame.data_.size() == FRAME_SIZE);
+      REQUIRE(frame.data_.data[0] == sequence);
+      REQUIRE(frame.timestamp_ns_ == 1000 * sequence);
+      // The frame is the device's buffer, not a copy of it.
+      REQUIRE(frame.data_.data != last_data);
+      last_data = frame.data_.data;
+    }
+    CapturedFrame frame;
+    REQUIRE_FALSE(source.Read(frame));
+    REQUIRE(device->GetQueuedCount() == 2);
+    REQUIRE(source.GetDroppedFrames() == 0);
+  }
+
+  SECTION("Gaps in the sequence are counted as dropped frames") {
+    auto* device = new ScriptedDevice({{0, FRAME_BYTES},
+                                       {1, FRAME_BYTES},
+                                       {4, FRAME_BYTES},
+                                       {5, FRAME_BYTES},
+                                       {9, FRAME_BYTES}});
+    DeviceFrameSource source((std::unique_ptr<CaptureDevice>(device)));
+    const uint64_t dropped_frames[] = {0, 0, 2, 2, 5};
+    for (uint64_t dropped : dropped_frames) {
+      CapturedFrame frame;
+      REQUIRE(source.Read(frame));
+      REQUIRE(source.GetDroppedFrames() == dropped);
+    }
+  }
+
+  SECTION("A buffer without a whole frame is handed back at once") {
+    auto* device = new ScriptedDevice(
+        {{0, FRAME_BYTES}, {1, FRAME_BYTES / 2}, {2, FRAME_BYTES}});
+    DeviceFrameSource source((std::unique_ptr<CaptureDevice>(device)));
+    CapturedFrame frame;
+    REQUIRE(source.Read(frame));
+    REQUIRE(frame.data_.data[0] == 0);
+    REQUIRE(source.Read(frame));
+    REQUIRE(frame.data_.data[0] == 2);
+    REQUIRE(device->GetQueuedCount() == 1);
+    // The partial frame is lost like any other.
+    REQUIRE(source.GetDroppedFrames() == 1);
+  }
+}
+
+TEST_CASE("A device frame source passes on the drops of a paced device",
+          "[device-frame-source]") {
+  RawFile file("test_capture_source.yuyv", 30);
+  DeviceFrameSource source(std::unique_ptr<CaptureDevice>(
+      new FileCaptureDevice(file.GetName(), PixelFormat::YUYV, FRAME_SIZE,
+                            FRAMES_PER_SECOND, 2, true)));
+  CapturedFrame frame;
+  REQUIRE(source.Read(frame));
+  const int64_t first_timestamp_ns = frame.timestamp_ns_;
+
+  // Reading slower than the frames are due drops all but one of the frames
+  // that arrive while the source holds a buffer.
+  const int reads = 4;
+  int64_t sequence = 0;
+  for (int i = 1; i < reads; ++i) {
+    SleepFrames(4);
+    REQUIRE(source.Read(frame));
+    const int64_t since_first_ns = frame.timestamp_ns_ - first_timestamp_ns;
+    REQUIRE(since_first_ns % FRAME_INTERVAL_NS == 0);
+    REQUIRE(since_first_ns / FRAME_INTERVAL_NS > sequence);
+    sequence = since_first_ns / FRAME_INTERVAL_NS;
+    REQUIRE(frame.data_.data[0] == sequence);
+  }
+  REQUIRE(source.GetDroppedFrames() > 0);
+  REQUIRE(source.GetDroppedFrames() ==
+          static_cast<uint64_t>(sequence - (reads - 1)));
+}
@@ -0,0 +1,152 @@
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gesturerecognition/filter_graph.h"
+#include "nlohmann/json.hpp"
+
+using gesturerecognition::FilterGraph;
+using gesturerecognition::FilterNode;
+using gesturerecognition::FilterNodeRegistry;
+
+namespace {
+/**
+ * A node whose image is the sum of its inputs plus a constant.
+ */
+class SumNode : public FilterNode {
+ public:
+  explicit SumNode(int constant) : constant_(constant) {
+  }
+
+  void Run(const std::vector<const cv::Mat*>& inputs,
+           cv::Mat& output) override {
+    cv::add(*inputs[0], cv::Scalar(constant_), output);
+    for (size_t input = 1; input < inputs.size(); ++input) {
+      cv::add(output, *inputs[input], output);
+    }
+  }
+
+ private:
+  const int constant_;
+};
+
+/**
+ * A node which always fails.
+ */
+class FailingNode : public FilterNode {
+ public:
+  void Run(const std::vector<const cv::Mat*>&, cv::Mat&) override {
+    throw std::runtime_error("The node failed");
+  }
+};
+
+FilterNodeRegistry CreateRegistry() {
+  FilterNodeRegistry registry;
+  registry.Add("sum", [](const nlohmann::json& parameters) {
+    int constant = parameters.find("constant") != parameters.end()
+                       ? parameters["constant"].get<int>()
+                       : 0;
+    return std::unique_ptr<FilterNode>(new SumNode(constant));
+  });
+  registry.Add("fail", [](const nlohmann::json&) {
+    return std::unique_ptr<FilterNode>(new FailingNode());
+  });
+  return registry;
+}
+
+/**
+ * Requires the graph to be rejected when it is built.
+ */
+void RequireRejected(const std::string& description) {
+  REQUIRE_THROWS_AS(FilterGraph(nlohmann::json::parse(description),
+                                CreateRegistry(), 2),
+                    std::invalid_argument);
+}
+}  // namespace
+
+TEST_CASE("A filter graph runs the nodes its output depends on",
+          "[filter-graph]") {
+  const nlohmann::json description = nlohmann::json::parse(R"({
+    "output": "sum",
+    "nodes": [
+      {"name": "unused", "node": "fail", "inputs": ["frame"]},
+      {"name": "plus_one", "node": "sum", "inputs": ["frame"],
+       "parameters": {"constant": 1}},
+      {"name": "plus_ten", "node": "sum", "inputs": ["frame"],
+       "parameters": {"constant": 10}},
+      {"name": "sum", "node": "sum", "inputs": ["plus_one", "plus_ten"]}
+    ]})");
+  const cv::Mat frame(4, 4, CV_8UC1, cv::Scalar(2));
+  const size_t threads = GENERATE(1, 3);
+  FilterGraph graph(description, CreateRegistry(), threads);
+  REQUIRE(graph.GetLevelCount() == 2);
+
+  // The output stays valid after the next frames are run.
+  cv::Mat first_output = graph.Run(frame);
+  cv::Mat second_output = graph.Run(frame);
+  REQUIRE(cv::countNonZero(first_output != 3 + 12) == 0);
+  REQUIRE(cv::countNonZero(second_output != 3 + 12) == 0);
+  REQUIRE(graph.GetNodeTimings().size() == 3);
+}
+
+TEST_CASE("A filter graph rethrows what a node threw", "[filter-graph]") {
+  FilterGraph graph(nlohmann::json::parse(R"({
+    "output": "sum",
+    "nodes": [
+      {"name": "failing", "node": "fail", "inputs": ["frame"]},
+      {"name": "working", "node": "sum", "inputs": ["frame"]},
+      {"name": "sum", "node": "sum", "inputs": ["failing", "working"]}
+    ]})"),
+                    CreateRegistry(), 2);
+  const cv::Mat frame(4, 4, CV_8UC1, cv::Scalar(2));
+  REQUIRE_THROWS_AS(graph.Run(frame), std::runtime_error);
+  // The graph can still be run after a failure.
+  REQUIRE_THROWS_AS(graph.Run(frame), std::runtime_error);
+}
+
+TEST_CASE("Malformed filter graphs are rejected", "[filter-graph]") {
+  SECTION("A cycle") {
+    RequireRejected(R"({"output": "first", "nodes": [
+        {"name": "first", "node": "sum", "inputs": ["second"]},
+        {"name": "second", "node": "sum", "inputs": ["first"]}]})");
+  }
+
+  SECTION("A node which is its own input") {
+    RequireRejected(R"({"output": "first", "nodes": [
+        {"name": "first", "node": "sum", "inputs": ["frame", "first"]}]})");
+  }
+
+  SECTION("An unknown kind of node") {
+    RequireRejected(R"({"output": "first", "nodes": [
+        {"name": "first", "node": "blur", "inputs": ["frame"]}]})");
+  }
+
+  SECTION("An unknown input") {
+    RequireRejected(R"({"output": "first", "nodes": [
+        {"name": "first", "node": "sum", "inputs": ["second"]}]})");
+  }
+
+  SECTION("An unknown output") {
+    RequireRejected(R"({"output": "second", "nodes": [
+        {"name": "first", "node": "sum", "inputs": ["frame"]}]})");
+  }
+
+  SECTION("No nodes") {
+    RequireRejected(R"({"output": "first"})");
+  }
+
+  SECTION("A node named after the frame") {
+    RequireRejected(R"({"output": "frame", "nodes": [
+        {"name": "frame", "node": "sum", "inputs": ["frame"]}]})");
+  }
+
+  SECTION("Two nodes of the same name") {
+    RequireRejected(R"({"output": "first", "nodes": [
+        {"name": "first", "node": "sum", "inputs": ["frame"]},
+        {"name": "first", "node": "sum", "inputs": ["frame"]}]})");
+  }
+}
@@ -0,0 +1,218 @@
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "common/metrics.h"
+#include "gesturerecognition/finger_predictor.h"
+#include "gesturerecognition/hand_extractor.h"
+
+using gesturerecognition::FingerKalmanFilter;
+using gesturerecognition::FingerPredictor;
+using gesturerecognition::Hand;
+using gesturerecognition::PredictiveOnsetSettings;
+
+namespace {
+const int64_t FRAME_INTERVAL_NS = 33333333;
+const int MAX_CHANGE_IN_FINGER_POSITION = 20;
+const cv::Point PALM(200, 300);
+// Neighbouring fingers are 28 pixels apart on a hand 160 pixels wide.
+const int FINGER_SPACING = 28;
+const cv::Rect HAND_BOX(120, 150, 160, 200);
+
+/**
+ * Plays a hand whose finger tips move straight towards or away from the palm,
+ * one frame at a time, and keeps what the predictor makes of it.
+ */
+class ScriptedHand {
+ public:
+  explicit ScriptedHand(size_t fingers,
+                        const PredictiveOnsetSettings& settings =
+                            PredictiveOnsetSettings())
+      : predictor(settings, MAX_CHANGE_IN_FINGER_POSITION),
+        distances(fingers, 100),
+        hand_box(HAND_BOX),
+        time_ns(0) {
+    predictor.SetMetrics(&metrics);
+  }
+
+  /**
+   * Returns where a finger's tip is at a distance from the palm.
+   */
+  static cv::Point GetTip(size_t finger, double distance) {
+    return cv::Point(PALM.x + static_cast<int>(finger) * FINGER_SPACING,
+                     PALM.y - static_cast<int>(distance));
+  }
+
+  /**
+   * Runs a frame of the fingers at their current distances.
+   */
+  void Step(const std::vector<cv::Point>& click_points = {}) {
+    std::vector<cv::Point> tips;
+    for (size_t finger = 0; finger < distances.size(); ++finger) {
+      tips.push_back(GetTip(finger, distances[finger]));
+    }
+    Hand hand(tips, PALM, time_ns);
+    hand.bounding_box_ = hand_box;
+    predictor.Update(hand, click_points, time_ns - FRAME_INTERVAL_NS, points,
+                     onset_times);
+    time_ns += FRAME_INTERVAL_NS;
+  }
+
+  /**
+   * Runs frames while a finger moves by a step each frame until it reaches a
+   * distance.
+   * @return  the frames it took
+   */
+  int Move(size_t finger, double distance, double step) {
+    int frames = 0;
+    while (distances[finger] != distance) {
+      double remaining = distance - distances[finger];
+      distances[finger] += std::abs(remaining) <= step
+                               ? remaining
+                               : (remaining > 0 ? step : -step);
+      Step();
+      ++frames;
+    }
+    return frames;
+  }
+
+  /**
+   * Runs frames without moving any finger.
+   */
+  void Hold(int frames) {
+    for (int frame = 0; frame < frames; ++frame) {
+      Step();
+    }
+  }
+
+  uint64_t GetCount(const std::string& name) {
+    return metrics.GetCounter("tracker." + name).Get();
+  }
+
+  common::MetricsRegistry metrics;
+  FingerPredictor predictor;
+  std::vector<double> distances;
+  cv::Rect hand_box;
+  int64_t time_ns;
+  std::vector<cv::Point> points;
+  std::vector<int64_t> onset_times;
+};
+}  // namespace
+
+TEST_CASE("A Kalman filter follows a finger's distance from the palm",
+          "[finger-predictor]") {
+  FingerKalmanFilter filter(100, 1);
+  // Towards the palm at 300 pixels per second.
+  for (int frame = 1; frame <= 30; ++frame) {
+    filter.Predict(0.01);
+    filter.Correct(100 - 3.0 * frame);
+  }
+  REQUIRE(filter.GetDistance() == Approx(10).margin(0.5));
+  REQUIRE(filter.GetVelocity() == Approx(-300).margin(10));
+  REQUIRE(filter.GetAcceleration() == Approx(0).margin(200));
+  REQUIRE(filter.Extrapolate(0.1) == Approx(-20).margin(2));
+}
+
+TEST_CASE("A bending finger fires a press before the batches click it",
+          "[finger-predictor]") {
+  ScriptedHand script(1);
+  script.Hold(10);
+  REQUIRE(script.points.empty());
+  // Bends at 240 pixels per second, 25 pixels in all.
+  script.Move(0, 92, 8);
+  REQUIRE(script.predictor.GetPendingPressCount() == 1);
+  REQUIRE(script.GetCount("predicted_presses") == 1);
+  const cv::Point fired_point = script.points.at(0);
+  const int64_t fired_ns = script.onset_times.at(0);
+  REQUIRE(fired_point.x == PALM.x);
+  REQUIRE(fired_point.y <= ScriptedHand::GetTip(0, 92).y);
+  script.Move(0, 75, 8);
+
+  SECTION("A batch clicking the finger confirms it") {
+    const cv::Point batch_point = ScriptedHand::GetTip(0, 100);
+    script.Step({batch_point});
+    REQUIRE(script.predictor.GetPendingPressCount() == 0);
+    REQUIRE(script.GetCount("confirmed_presses") == 1);
+    // The note keeps sounding where it fired, from when it fired.
+    REQUIRE(script.points == std::vector<cv::Point>({fired_point}));
+    REQUIRE(script.onset_times == std::vector<int64_t>({fired_ns}));
+    script.Step({batch_point});
+    REQUIRE(script.points == std::vector<cv::Point>({fired_point}));
+
+    // Once the batch releases it, so does the predictor.
+    script.Step();
+    REQUIRE(script.points.empty());
+  }
+
+  SECTION("Straightening the finger cancels it, and arms it again") {
+    script.Move(0, 100, 8);
+    REQUIRE(script.predictor.GetPendingPressCount() == 0);
+    REQUIRE(script.points.empty());
+    REQUIRE(script.GetCount("cancelled_presses") == 1);
+    script.Hold(5);
+    script.Move(0, 75, 8);
+    REQUIRE(script.GetCount("predicted_presses") == 2);
+  }
+
+  SECTION("A press no batch clicks is cancelled") {
+    script.Hold(static_cast<int>(PredictiveOnsetSettings().confirm_frames));
+    REQUIRE(script.predictor.GetPendingPressCount() == 0);
+    REQUIRE(script.GetCount("cancelled_presses") == 1);
+    // A finger which stays bent does not fire again.
+    script.Hold(20);
+    REQUIRE(script.GetCount("predicted_presses") == 1);
+  }
+}
+
+TEST_CASE("The confirm radius shrinks with the hand", "[finger-predictor]") {
+  ScriptedHand script(2);
+  script.Hold(10);
+  script.Move(0, 80, 8);
+  REQUIRE(script.predictor.GetPendingPressCount() == 1);
+  const cv::Point neighbour = ScriptedHand::GetTip(1, 100);
+
+  SECTION("A small hand") {
+    script.Step({neighbour});
+    REQUIRE(script.GetCount("confirmed_presses") == 0);
+  }
+
+  SECTION("A hand of unknown size takes the fixed radius") {
+    script.hand_box = cv::Rect();
+    script.Step({neighbour});
+    REQUIRE(script.GetCount("confirmed_presses") == 1);
+  }
+}
+
+TEST_CASE("Where a finger rests follows a hand that moves",
+          "[finger-predictor]") {
+  PredictiveOnsetSettings settings;
+
+  SECTION("It falls towards a tip which stays nearer the palm") {
+    ScriptedHand script(1, settings);
+    script.Hold(10);
+    // The hand turns, so the tip nears the palm at 15 pixels a second.
+    script.Move(0, 70, 0.5);
+    script.Hold(30);
+    REQUIRE(script.GetCount("predicted_presses") == 0);
+
+    // Then the finger bends from where it now rests, and straightens again.
+    script.Move(0, 45, 8);
+    REQUIRE(script.GetCount("predicted_presses") == 1);
+    script.Move(0, 70, 8);
+    script.Hold(2);
+    REQUIRE(script.GetCount("cancelled_presses") == 1);
+    script.Move(0, 45, 8);
+    REQUIRE(script.GetCount("predicted_presses") == 2);
+  }
+
+  SECTION("Without the decay it is where the tip was farthest") {
+    settings.rest_decay_ms = 0;
+    ScriptedHand script(1, settings);
+    script.Hold(10);
+    script.Move(0, 70, 0.5);
+    REQUIRE(script.GetCount("predicted_presses") == 1);
+  }
+}
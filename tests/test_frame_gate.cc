@@ -0,0 +1,104 @@
+#include <catch2/catch.hpp>
+
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "gesturerecognition/frame_gate.h"
+
+using gesturerecognition::FrameGate;
+
+namespace {
+const cv::Size FRAME_SIZE(40, 30);
+const std::vector<cv::Rect> WHOLE_FRAME;
+
+/**
+ * Returns a BGR frame whose every channel value is the same.
+ */
+cv::Mat MakeFrame(int value, const cv::Size& size = FRAME_SIZE) {
+  return cv::Mat(size, CV_8UC3, cv::Scalar(value, value, value));
+}
+}  // namespace
+
+TEST_CASE("The frame gate passes frames that changed enough", "[frame-gate]") {
+  // Every pixel is compared, so the difference is exact.
+  FrameGate gate(2.5, 1);
+  REQUIRE(gate.HasChanged(MakeFrame(100), WHOLE_FRAME));
+
+  SECTION("An identical frame is skipped") {
+    REQUIRE_FALSE(gate.HasChanged(MakeFrame(100), WHOLE_FRAME));
+    REQUIRE(gate.GetLastDifference() == 0);
+  }
+
+  SECTION("A change just below the threshold is skipped") {
+    REQUIRE_FALSE(gate.HasChanged(MakeFrame(102), WHOLE_FRAME));
+    REQUIRE(gate.GetLastDifference() == Approx(2));
+  }
+
+  SECTION("A change just above the threshold passes") {
+    REQUIRE(gate.HasChanged(MakeFrame(103), WHOLE_FRAME));
+    REQUIRE(gate.GetLastDifference() == Approx(3));
+    // The frame which passed is the one the next are compared with.
+    REQUIRE_FALSE(gate.HasChanged(MakeFrame(103), WHOLE_FRAME));
+  }
+
+  SECTION("Slow changes add up until they pass") {
+    REQUIRE_FALSE(gate.HasChanged(MakeFrame(102), WHOLE_FRAME));
+    REQUIRE(gate.HasChanged(MakeFrame(103), WHOLE_FRAME));
+  }
+
+  SECTION("The difference is the mean over the frame") {
+    // A tenth of the frame changes by 30, which is 3 over the whole frame.
+    cv::Mat frame = MakeFrame(100);
+    frame(cv::Rect(0, 0, 4, 30)).setTo(cv::Scalar(130, 130, 130));
+    REQUIRE(gate.HasChanged(frame, WHOLE_FRAME));
+    REQUIRE(gate.GetLastDifference() == Approx(3));
+  }
+
+  SECTION("A frame of another size passes") {
+    REQUIRE(gate.HasChanged(MakeFrame(100, cv::Size(20, 15)), WHOLE_FRAME));
+    REQUIRE_FALSE(
+        gate.HasChanged(MakeFrame(100, cv::Size(20, 15)), WHOLE_FRAME));
+    REQUIRE(gate.HasChanged(MakeFrame(100), WHOLE_FRAME));
+  }
+
+  SECTION("A reset gate passes the next frame") {
+    gate.Reset();
+    REQUIRE(gate.HasChanged(MakeFrame(100), WHOLE_FRAME));
+  }
+}
+
+TEST_CASE("The frame gate only compares the hand regions", "[frame-gate]") {
+  FrameGate gate(2.5, 1);
+  const std::vector<cv::Rect> regions = {cv::Rect(0, 0, 10, 10),
+                                         cv::Rect(35, 25, 10, 10)};
+  REQUIRE(gate.HasChanged(MakeFrame(100), regions));
+  cv::Mat frame = MakeFrame(100);
+
+  SECTION("A change outside the regions is skipped") {
+    frame(cv::Rect(15, 12, 10, 6)).setTo(cv::Scalar(255, 255, 255));
+    REQUIRE_FALSE(gate.HasChanged(frame, regions));
+    REQUIRE(gate.GetLastDifference() == 0);
+    // Over the whole frame it is a change.
+    REQUIRE(gate.HasChanged(frame, WHOLE_FRAME));
+  }
+
+  SECTION("A change inside a region passes") {
+    // The second region is cut to the 5 by 5 pixels in the frame.
+    frame(cv::Rect(35, 25, 5, 5)).setTo(cv::Scalar(130, 130, 130));
+    REQUIRE(gate.HasChanged(frame, regions));
+    // Regions grow by a pixel, so the first compares 11 by 11 pixels.
+    REQUIRE(gate.GetLastDifference() ==
+            Approx(30.0 * 5 * 5 / (11 * 11 + 5 * 5)));
+  }
+
+  SECTION("Regions outside the frame compare the whole frame") {
+    const std::vector<cv::Rect> outside = {cv::Rect(100, 100, 10, 10)};
+    frame(cv::Rect(15, 12, 10, 6)).setTo(cv::Scalar(255, 255, 255));
+    REQUIRE(gate.HasChanged(frame, outside));
+  }
+}
+
+TEST_CASE("The frame gate needs a positive subsample step", "[frame-gate]") {
+  REQUIRE_THROWS_AS(FrameGate(1.5, 0), std::invalid_argument);
+}
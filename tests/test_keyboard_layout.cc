@@ -0,0 +1,226 @@
+#include <catch2/catch.hpp>
+
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "pianoapp/audio_backend.h"
+#include "pianoapp/keyboard_layout.h"
+#include "pianoapp/performance_recorder.h"
+#include "pianoapp/piano_engine.h"
+
+using piano::GetNoteRange;
+using piano::IsBlackKey;
+using piano::KeyboardLayout;
+using piano::KeyboardZone;
+using piano::ParseKeyboardLayout;
+using piano::PianoEngine;
+
+namespace {
+const std::string LAYOUTS_DIRECTORY =
+    std::string(GESTURE_PIANO_SOURCE_DIR) + "/layouts/";
+
+/**
+ * Returns every note of a zone, row after row.
+ */
+std::vector<std::string> GetNotes(const KeyboardZone& zone) {
+  std::vector<std::string> notes;
+  for (const std::vector<std::string>& row : zone.rows) {
+    notes.insert(notes.end(), row.begin(), row.end());
+  }
+  return notes;
+}
+
+/**
+ * Requires the layout to be rejected when it is parsed.
+ */
+void RequireRejected(const std::string& description) {
+  REQUIRE_THROWS_AS(ParseKeyboardLayout(nlohmann::json::parse(description)),
+                    std::invalid_argument);
+}
+
+/**
+ * Returns the note of the key a point presses, or nothing if it presses none.
+ */
+std::string GetNoteAtPoint(PianoEngine& piano_engine, const cv::Point& point) {
+  piano_engine.Run({point});
+  std::string note;
+  if (!piano_engine.getPressedKeys().empty()) {
+    note = piano_engine.getPressedKeys().begin()->second.note_name;
+  }
+  piano_engine.Run({});
+  return note;
+}
+}  // namespace
+
+TEST_CASE("The shipped keyboard layouts are well formed",
+          "[keyboard-layout]") {
+  SECTION("88 keys") {
+    KeyboardLayout layout =
+        piano::ReadKeyboardLayoutFile(LAYOUTS_DIRECTORY + "88_keys.json");
+    REQUIRE(layout.zones.size() == 1);
+    REQUIRE(layout.zones[0].rows.size() == 2);
+    REQUIRE(layout.zones[0].rows[0].back() == "E4");
+    REQUIRE(layout.zones[0].rows[1].front() == "F4");
+    // Every key of a piano, from A0 to C8, once.
+    std::vector<std::string> notes = GetNotes(layout.zones[0]);
+    REQUIRE(notes.size() == 88);
+    for (size_t i = 0; i < notes.size(); ++i) {
+      REQUIRE(piano::NoteNameToMidiNumber(notes[i]) ==
+              static_cast<int>(21 + i));
+    }
+  }
+
+  SECTION("A bass beside a piano") {
+    KeyboardLayout layout = piano::ReadKeyboardLayoutFile(
+        LAYOUTS_DIRECTORY + "bass_and_piano.json");
+    REQUIRE(layout.zones.size() == 2);
+    const KeyboardZone& bass = layout.zones[0];
+    const KeyboardZone& piano = layout.zones[1];
+    REQUIRE(bass.name == "bass");
+    REQUIRE(bass.region == cv::Rect2f(0, 0, 0.3f, 1));
+    REQUIRE(bass.sample_prefix == "Bass.");
+    REQUIRE(bass.rows[0].front() == "E1");
+    REQUIRE(bass.rows[1].back() == "G2");
+    REQUIRE(piano.name == "piano");
+    REQUIRE(piano.region.x + piano.region.width == Approx(1));
+    REQUIRE(piano.sample_prefix == "Piano.pp.");
+    REQUIRE(piano.rows[0].front() == "C3");
+    REQUIRE(piano.rows[1].back() == "B6");
+  }
+
+  SECTION("A missing file") {
+    REQUIRE_THROWS_AS(
+        piano::ReadKeyboardLayoutFile(LAYOUTS_DIRECTORY + "no_such.json"),
+        std::runtime_error);
+  }
+}
+
+TEST_CASE("Note ranges are counted in white keys", "[keyboard-layout]") {
+  REQUIRE(GetNoteRange("E4", 3) ==
+          std::vector<std::string>({"E4", "F4", "Gb4", "G4"}));
+  REQUIRE(GetNoteRange("B3", 2) == std::vector<std::string>({"B3", "C4"}));
+  REQUIRE(IsBlackKey("Db4"));
+  REQUIRE(IsBlackKey("C#4"));
+  REQUIRE_FALSE(IsBlackKey("D4"));
+
+  SECTION("A range must start on a white key") {
+    REQUIRE_THROWS_AS(GetNoteRange("Db4", 3), std::invalid_argument);
+    REQUIRE_THROWS_AS(GetNoteRange("H4", 3), std::invalid_argument);
+  }
+}
+
+TEST_CASE("Malformed keyboard layouts are rejected", "[keyboard-layout]") {
+  SECTION("No zones") {
+    RequireRejected(R"({"zones": []})");
+  }
+
+  SECTION("A zone without rows") {
+    RequireRejected(R"({"zones": [{"name": "piano"}]})");
+  }
+
+  SECTION("A row starting with a black key") {
+    RequireRejected(R"({"zones": [{"rows": [{"notes": ["Db4", "D4"]}]}]})");
+    RequireRejected(
+        R"({"zones": [{"rows": [{"first_note": "Db4", "white_keys": 3}]}]})");
+  }
+
+  SECTION("A row ending with a black key") {
+    RequireRejected(R"({"zones": [{"rows": [{"notes": ["C4", "Db4"]}]}]})");
+  }
+
+  SECTION("Black keys next to each other") {
+    RequireRejected(
+        R"({"zones": [{"rows": [{"notes": ["C4", "Db4", "Eb4", "E4"]}]}]})");
+  }
+
+  SECTION("An unknown note") {
+    RequireRejected(R"({"zones": [{"rows": [{"notes": ["C4", "H4"]}]}]})");
+  }
+
+  SECTION("A range past the highest MIDI note") {
+    RequireRejected(
+        R"({"zones": [{"rows": [{"first_note": "G9", "white_keys": 3}]}]})");
+  }
+
+  SECTION("A row with neither notes nor a range") {
+    RequireRejected(R"({"zones": [{"rows": [{"first_note": "C4"}]}]})");
+  }
+
+  SECTION("A region out of the window") {
+    RequireRejected(R"({"zones": [{"region": [0.5, 0, 0.6, 1],
+                                   "rows": [{"notes": ["C4"]}]}]})");
+    RequireRejected(R"({"zones": [{"region": [-0.1, 0, 0.5, 1],
+                                   "rows": [{"notes": ["C4"]}]}]})");
+    RequireRejected(R"({"zones": [{"region": [0, 0, 0, 1],
+                                   "rows": [{"notes": ["C4"]}]}]})");
+    RequireRejected(R"({"zones": [{"region": [0, 0, 1],
+                                   "rows": [{"notes": ["C4"]}]}]})");
+  }
+}
+
+TEST_CASE("The key map finds the key under a point", "[keyboard-layout]") {
+  piano::SilentAudioBackend audio_backend;
+
+  SECTION("At the edges of white and black keys") {
+    // White keys 100 pixels wide and black keys 40 pixels wide from 75
+    // pixels into the white key before them, 66 pixels high.
+    KeyboardZone zone;
+    zone.rows = {{"C4", "Db4", "D4", "Eb4", "E4"}};
+    KeyboardLayout layout;
+    layout.zones.push_back(zone);
+    PianoEngine piano_engine(cv::Point(10, 20), 300, 100, 0, layout,
+                             audio_backend);
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(10, 20)) == "C4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(84, 30)) == "C4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(85, 30)) == "Db4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(124, 30)) == "Db4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(125, 30)) == "D4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(85, 85)) == "Db4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(85, 86)) == "C4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(109, 100)) == "C4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(110, 100)) == "D4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(185, 30)) == "Eb4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(309, 119)) == "E4");
+    // Outside the window no key is pressed.
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(310, 50)).empty());
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(9, 50)).empty());
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(50, 120)).empty());
+  }
+
+  SECTION("Where zones overlap, the later one is on top") {
+    KeyboardZone lower;
+    lower.rows = {{"C4", "D4"}};
+    KeyboardZone upper;
+    upper.region = cv::Rect2f(0.5f, 0, 0.5f, 0.5f);
+    upper.rows = {{"C5"}};
+    KeyboardLayout layout;
+    layout.zones = {lower, upper};
+    PianoEngine piano_engine(cv::Point(0, 0), 200, 100, 0, layout,
+                             audio_backend);
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(50, 25)) == "C4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(99, 25)) == "C4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(100, 25)) == "C5");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(150, 49)) == "C5");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(150, 50)) == "D4");
+  }
+
+  SECTION("Rows of a zone split its height") {
+    KeyboardZone zone;
+    zone.rows = {{"C4", "D4"}, {"C5"}};
+    KeyboardLayout layout;
+    layout.zones.push_back(zone);
+    // Rows 50 pixels high, with 10 pixels between them. Every row has keys
+    // as wide as those of the widest one.
+    PianoEngine piano_engine(cv::Point(0, 0), 200, 100, 10, layout,
+                             audio_backend);
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(150, 39)) == "D4");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(150, 45)).empty());
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(0, 50)) == "C5");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(99, 89)) == "C5");
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(99, 90)).empty());
+    REQUIRE(GetNoteAtPoint(piano_engine, cv::Point(100, 50)).empty());
+  }
+}
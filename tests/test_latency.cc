@@ -0,0 +1,96 @@
+#include <catch2/catch.hpp>
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "common/clock.h"
+#include "common/latency.h"
+#include "gesturerecognition/hand_tracker.h"
+
+using common::ComputeNoteLatency;
+using common::FrameTimestamps;
+using common::NoteLatency;
+using common::PressTiming;
+using common::SyntheticClock;
+using gesturerecognition::Hand;
+using gesturerecognition::HandTracker;
+
+namespace {
+const int64_t FRAME_INTERVAL_NS = 33000000;
+
+/**
+ * Returns the timestamps of a frame that took no time at all, as it does on
+ * a synthetic clock.
+ */
+FrameTimestamps GetInstantFrame(int64_t time_ns) {
+  FrameTimestamps frame;
+  frame.capture_start_ns = frame.capture_ns = frame.vision_done_ns =
+      frame.tracking_done_ns = time_ns;
+  return frame;
+}
+}  // namespace
+
+TEST_CASE("A note's latency is split into the parts of the pipeline",
+          "[latency]") {
+  FrameTimestamps frame;
+  frame.capture_start_ns = 1000;
+  frame.capture_ns = 4000;
+  frame.vision_done_ns = 9000;
+  frame.tracking_done_ns = 10000;
+
+  SECTION("The tracker held the press from its onset") {
+    PressTiming press{60, 2500, 4000, 12000};
+    NoteLatency latency = ComputeNoteLatency(frame, press);
+    REQUIRE(latency.midi_note == 60);
+    REQUIRE(latency.capture_ns == 3000);
+    REQUIRE(latency.vision_ns == 5000);
+    REQUIRE(latency.tracker_hold_ns == 1500 + 1000);
+    REQUIRE(latency.audio_scheduling_ns == 2000);
+    REQUIRE(latency.GetTotal() == 3000 + 5000 + 2500 + 2000);
+  }
+
+  SECTION("An onset at 0 is a time like any other") {
+    PressTiming press{60, 0, 4000, 12000};
+    REQUIRE(ComputeNoteLatency(frame, press).tracker_hold_ns == 4000 + 1000);
+  }
+
+  SECTION("Without an onset only the tracking is held") {
+    PressTiming press{60, common::UNKNOWN_ONSET_NS, 4000, 12000};
+    REQUIRE(ComputeNoteLatency(frame, press).tracker_hold_ns == 1000);
+  }
+}
+
+TEST_CASE("A replayed press has the same tracker hold on a synthetic clock",
+          "[latency]") {
+  // Frame 3, where the finger bends, is captured at 0.
+  SyntheticClock clock(-3 * FRAME_INTERVAL_NS);
+  HandTracker tracker(3);
+  const cv::Point palm(100, 200);
+  const std::vector<cv::Point> open_fingers = {cv::Point(50, 100),
+                                               cv::Point(150, 100)};
+  const std::vector<cv::Point> bent_finger = {cv::Point(150, 100)};
+
+  std::vector<NoteLatency> latencies;
+  for (int frame_number = 0; frame_number < 9; ++frame_number) {
+    const int64_t capture_ns = clock.GetTimestampNanoseconds();
+    Hand hand(frame_number < 3 ? open_fingers : bent_finger, palm, capture_ns);
+    std::vector<cv::Point> click_points = tracker.FindClickPoints(hand);
+    // Each click point is played the frame it first shows up, as the piano
+    // does.
+    if (!click_points.empty() && latencies.empty()) {
+      REQUIRE(click_points.size() == 1);
+      REQUIRE(click_points[0] == open_fingers[0]);
+      PressTiming press{60, tracker.GetClickOnsetTimes()[0], capture_ns,
+                        clock.GetTimestampNanoseconds()};
+      latencies.push_back(
+          ComputeNoteLatency(GetInstantFrame(capture_ns), press));
+    }
+    clock.Advance(FRAME_INTERVAL_NS);
+  }
+
+  // The second batch, frames 3 to 5, clicks on frame 5: the tracker held the
+  // press for the two frames after the finger bent.
+  REQUIRE(latencies.size() == 1);
+  REQUIRE(latencies[0].tracker_hold_ns == 2 * FRAME_INTERVAL_NS);
+  REQUIRE(latencies[0].GetTotal() == 2 * FRAME_INTERVAL_NS);
+}
@@ -0,0 +1,153 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/clock.h"
+#include "pianoapp/audio_backend.h"
+#include "pianoapp/keyboard_layout.h"
+#include "pianoapp/performance_recorder.h"
+#include "pianoapp/piano_engine.h"
+
+using piano::KeyboardLayout;
+using piano::KeyboardZone;
+using piano::NoteEvent;
+using piano::NoteEventType;
+using piano::PerformanceRecorder;
+
+namespace {
+const int64_t MILLISECOND_NS = 1000000;
+// The header chunk, then "MTrk" and the length of the track.
+const size_t MIDI_TRACK_START = 14 + 8;
+
+/**
+ * Returns the bytes of a file.
+ */
+std::vector<unsigned char> ReadBytes(const std::string& file_name) {
+  std::ifstream file(file_name, std::ios::binary);
+  return std::vector<unsigned char>(std::istreambuf_iterator<char>(file),
+                                    std::istreambuf_iterator<char>());
+}
+
+/**
+ * Requires the events to be the same, in the same order.
+ */
+void RequireSameEvents(const std::vector<NoteEvent>& events,
+                       const std::vector<NoteEvent>& expected_events) {
+  REQUIRE(events.size() == expected_events.size());
+  for (size_t i = 0; i < events.size(); ++i) {
+    REQUIRE(events[i].type == expected_events[i].type);
+    REQUIRE(events[i].midi_note == expected_events[i].midi_note);
+    REQUIRE(events[i].capture_time_ns == expected_events[i].capture_time_ns);
+    REQUIRE(events[i].trigger_time_ns == expected_events[i].trigger_time_ns);
+  }
+}
+
+/**
+ * Removes the files a recorder wrote under the prefix.
+ */
+void RemoveRecording(const std::string& prefix) {
+  std::remove((prefix + ".log").c_str());
+  std::remove((prefix + ".mid").c_str());
+}
+}  // namespace
+
+TEST_CASE("A performance recorder writes what it records",
+          "[performance-recorder]") {
+  const int64_t start_ns = 1000 * MILLISECOND_NS;
+  // C4 and Db4 overlap, then D4 is played alone.
+  const std::vector<NoteEvent> events = {
+      {NoteEventType::PRESS, 60, start_ns - 40 * MILLISECOND_NS, start_ns},
+      {NoteEventType::PRESS, 61, start_ns + 200 * MILLISECOND_NS,
+       start_ns + 250 * MILLISECOND_NS},
+      {NoteEventType::RELEASE, 60, start_ns + 450 * MILLISECOND_NS,
+       start_ns + 500 * MILLISECOND_NS},
+      {NoteEventType::RELEASE, 61, start_ns + 700 * MILLISECOND_NS,
+       start_ns + 750 * MILLISECOND_NS},
+      {NoteEventType::PRESS, 62, start_ns + 1950 * MILLISECOND_NS,
+       start_ns + 2000 * MILLISECOND_NS},
+      {NoteEventType::RELEASE, 62, start_ns + 2950 * MILLISECOND_NS,
+       start_ns + 3000 * MILLISECOND_NS}};
+  {
+    PerformanceRecorder recorder("test_performance", 16, 1);
+    for (size_t i = 0; i < events.size(); ++i) {
+      REQUIRE(recorder.Record(events[i]));
+      // Lets the flush thread drain the events in several batches, so that
+      // the track is appended to more than once.
+      if (i % 2 == 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+    }
+    REQUIRE(recorder.GetDroppedEvents() == 0);
+  }
+
+  SECTION("The binary log holds every event") {
+    RequireSameEvents(
+        PerformanceRecorder::LoadBinaryLog("test_performance.log"), events);
+  }
+
+  SECTION("The MIDI file holds a track of every event") {
+    std::vector<unsigned char> bytes = ReadBytes("test_performance.mid");
+    REQUIRE(bytes.size() > MIDI_TRACK_START);
+    const std::vector<unsigned char> header(bytes.begin(),
+                                            bytes.begin() + MIDI_TRACK_START);
+    REQUIRE(header == std::vector<unsigned char>(
+                          {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x03,
+                           0xE8, 'M', 'T', 'r', 'k', 0, 0, 0, 40}));
+    // Deltas are in milliseconds: 250 and 1250 take two bytes each.
+    const std::vector<unsigned char> track(bytes.begin() + MIDI_TRACK_START,
+                                           bytes.end());
+    REQUIRE(track == std::vector<unsigned char>({
+                         0x00, 0xFF, 0x51, 0x03, 0x0F, 0x42, 0x40,  // Tempo
+                         0x00, 0x90, 60, 100,                       //
+                         0x81, 0x7A, 0x90, 61, 100,                 // 250 ms
+                         0x81, 0x7A, 0x80, 60, 0,                   //
+                         0x81, 0x7A, 0x80, 61, 0,                   //
+                         0x89, 0x62, 0x90, 62, 100,                 // 1250 ms
+                         0x87, 0x68, 0x80, 62, 0,                   // 1000 ms
+                         0x00, 0xFF, 0x2F, 0x00}));  // End of track
+  }
+
+  SECTION("Replaying the log records the same performance") {
+    KeyboardZone zone;
+    zone.rows = {{"C4", "Db4", "D4"}};
+    KeyboardLayout layout;
+    layout.zones.push_back(zone);
+    piano::SilentAudioBackend audio_backend;
+    piano::PianoEngine piano_engine(cv::Point(0, 0), 300, 100, 0, layout,
+                                    audio_backend);
+    common::SyntheticClock clock;
+    piano_engine.SetClock(clock);
+    {
+      PerformanceRecorder recorder("test_performance_replay", 16, 1);
+      piano_engine.SetRecorder(&recorder);
+      for (const NoteEvent& event :
+           PerformanceRecorder::LoadBinaryLog("test_performance.log")) {
+        clock.Set(event.trigger_time_ns);
+        piano_engine.Replay(event);
+      }
+      piano_engine.SetRecorder(nullptr);
+    }
+    RequireSameEvents(
+        PerformanceRecorder::LoadBinaryLog("test_performance_replay.log"),
+        events);
+    REQUIRE(ReadBytes("test_performance_replay.mid") ==
+            ReadBytes("test_performance.mid"));
+    RemoveRecording("test_performance_replay");
+  }
+
+  RemoveRecording("test_performance");
+}
+
+TEST_CASE("A performance recorder needs files it can write",
+          "[performance-recorder]") {
+  REQUIRE_THROWS_AS(PerformanceRecorder("no_such_directory/performance", 16, 1),
+                    std::runtime_error);
+}
@@ -0,0 +1,155 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "gesturerecognition/hand_extractor.h"
+
+using gesturerecognition::FindProfilePeaks;
+using gesturerecognition::ProfilePeak;
+
+namespace {
+/**
+ * Returns the positions of the peaks.
+ */
+std::vector<int> GetPositions(const std::vector<ProfilePeak>& peaks) {
+  std::vector<int> positions;
+  for (const ProfilePeak& peak : peaks) {
+    positions.push_back(peak.position);
+  }
+  return positions;
+}
+
+/**
+ * Returns the column heights of a hand: a thumb sloping up on the left, five
+ * fingers 16 columns wide standing on a palm 90 high, the last of them bent
+ * down to the palm, and the palm falling away on the right.
+ */
+std::vector<int> CreateHandProfile() {
+  std::vector<int> profile;
+  for (int column = 0; column < 20; ++column) {
+    profile.push_back(40 + column);
+  }
+  profile.insert(profile.end(), 4, 55);
+  for (int finger_height : {170, 180, 175, 150, 95}) {
+    for (int column = 0; column < 16; ++column) {
+      int offset = std::abs(column - 8);
+      profile.push_back(finger_height - offset * offset / 8);
+    }
+    profile.insert(profile.end(), 4, 90);
+  }
+  for (int column = 0; column < 6; ++column) {
+    profile.push_back(90 - 10 * column);
+  }
+  // The edge of a segmented hand is never quite smooth.
+  for (size_t column = 3; column < profile.size(); column += 7) {
+    profile[column] += 2;
+  }
+  return profile;
+}
+}  // namespace
+
+TEST_CASE("Profile peaks are found on flat tops and at the ends",
+          "[profile-peaks]") {
+  SECTION("A flat top is one peak, at its middle") {
+    std::vector<ProfilePeak> peaks =
+        FindProfilePeaks({0, 0, 5, 10, 10, 10, 10, 5, 0, 0}, 5, 2, 10);
+    REQUIRE(peaks.size() == 1);
+    REQUIRE(peaks[0].position == 4);
+    REQUIRE(peaks[0].prominence == 10);
+    REQUIRE(peaks[0].width == 4);
+  }
+
+  SECTION("A flat shoulder is not a peak") {
+    REQUIRE(GetPositions(FindProfilePeaks({0, 5, 5, 10, 0}, 1, 1, 10)) ==
+            std::vector<int>({3}));
+  }
+
+  SECTION("The profile is 0 beyond its ends") {
+    std::vector<ProfilePeak> peaks =
+        FindProfilePeaks({10, 10, 5, 0, 0, 0, 0, 5, 10, 10}, 5, 2, 10);
+    REQUIRE(GetPositions(peaks) == std::vector<int>({0, 8}));
+    REQUIRE(peaks[0].prominence == 10);
+    REQUIRE(peaks[0].width == 2);
+    REQUIRE(peaks[1].prominence == 10);
+    REQUIRE(peaks[1].width == 2);
+  }
+
+  SECTION("An empty profile has no peaks") {
+    REQUIRE(FindProfilePeaks({}, 1, 1, 10).empty());
+    REQUIRE(FindProfilePeaks({0, 0, 0}, 1, 1, 10).empty());
+  }
+}
+
+TEST_CASE("Profile peaks must be prominent enough and of the right width",
+          "[profile-peaks]") {
+  SECTION("Prominence") {
+    const std::vector<int> profile = {0, 0, 20, 20, 0, 0, 9, 9, 0, 0};
+    REQUIRE(GetPositions(FindProfilePeaks(profile, 10, 1, 10)) ==
+            std::vector<int>({2}));
+    REQUIRE(GetPositions(FindProfilePeaks(profile, 9, 1, 10)) ==
+            std::vector<int>({2, 6}));
+  }
+
+  SECTION("A peak on the shoulder of a higher one rises above the shoulder") {
+    std::vector<ProfilePeak> peaks = FindProfilePeaks(
+        {0, 0, 30, 30, 20, 20, 25, 25, 20, 20, 0, 0}, 1, 1, 12);
+    REQUIRE(GetPositions(peaks) == std::vector<int>({2, 6}));
+    REQUIRE(peaks[0].prominence == 30);
+    // Half way down, the higher peak takes in the shoulder.
+    REQUIRE(peaks[0].width == 8);
+    REQUIRE(peaks[1].prominence == 5);
+    REQUIRE(peaks[1].width == 2);
+  }
+
+  SECTION("Width") {
+    std::vector<int> profile(30, 0);
+    profile[2] = 20;  // 1 wide
+    for (int column = 5; column < 9; ++column) {
+      profile[column] = 20;  // 4 wide
+    }
+    for (int column = 12; column < 24; ++column) {
+      profile[column] = 20;  // 12 wide
+    }
+    REQUIRE(GetPositions(FindProfilePeaks(profile, 10, 2, 10)) ==
+            std::vector<int>({6}));
+    REQUIRE(GetPositions(FindProfilePeaks(profile, 10, 1, 12)) ==
+            std::vector<int>({2, 6, 17}));
+  }
+}
+
+TEST_CASE("A finger on the palm is measured from the palm",
+          "[profile-peaks]") {
+  std::vector<int> profile(50, 90);
+  for (int column = 20; column < 30; ++column) {
+    profile[column] = 170;
+  }
+
+  SECTION("Bases are looked for within the widest a finger may be") {
+    std::vector<ProfilePeak> peaks = FindProfilePeaks(profile, 30, 2, 16);
+    REQUIRE(peaks.size() == 1);
+    REQUIRE(peaks[0].position == 24);
+    REQUIRE(peaks[0].prominence == 80);
+    REQUIRE(peaks[0].width == 10);
+  }
+
+  SECTION("Looked for farther, they are the ends of the hand") {
+    std::vector<ProfilePeak> peaks = FindProfilePeaks(profile, 30, 2, 50);
+    REQUIRE(peaks.size() == 1);
+    REQUIRE(peaks[0].prominence == 170);
+  }
+
+  SECTION("A hand with a bent finger") {
+    const std::vector<int> hand = CreateHandProfile();
+    const int hand_width = static_cast<int>(hand.size());
+    // As HandExtractor sets the limits for a hand 180 pixels high.
+    std::vector<ProfilePeak> peaks = FindProfilePeaks(
+        hand, 180 / 6, std::max(2, hand_width / 40), hand_width / 3);
+    REQUIRE(GetPositions(peaks) == std::vector<int>({31, 52, 73, 94}));
+    for (const ProfilePeak& peak : peaks) {
+      REQUIRE(peak.width == 16);
+      REQUIRE(peak.prominence > 60);
+    }
+  }
+}
@@ -0,0 +1,133 @@
+#include <catch2/catch.hpp>
+
+#include <stdexcept>
+#include <vector>
+
+#include "common/metrics.h"
+#include "gesturerecognition/quality_controller.h"
+
+using gesturerecognition::FilterQuality;
+using gesturerecognition::QualityController;
+using gesturerecognition::QualityLevel;
+
+namespace {
+const double FRAME_BUDGET_MS = 10;
+const size_t WINDOW_FRAMES = 3;
+const double RESTORE_FRACTION = 0.5;
+
+/**
+ * Feeds a window of frames which all take the same time.
+ * @return  whether the level changed
+ */
+bool UpdateWindow(QualityController& controller, double frame_time_ms) {
+  for (size_t frame = 1; frame < WINDOW_FRAMES; ++frame) {
+    REQUIRE_FALSE(controller.Update(frame_time_ms));
+  }
+  return controller.Update(frame_time_ms);
+}
+}  // namespace
+
+TEST_CASE("Each quality level gives up more than the one before it",
+          "[quality-controller]") {
+  const std::vector<QualityLevel>& levels =
+      QualityController::GetQualityLevels();
+  REQUIRE(levels.size() > 1);
+  REQUIRE(levels.front().draw_debug_overlays);
+  REQUIRE_FALSE(levels.back().draw_debug_overlays);
+  for (size_t level = 1; level < levels.size(); ++level) {
+    const FilterQuality& last = levels[level - 1].filter_quality;
+    const FilterQuality& next = levels[level].filter_quality;
+    REQUIRE(next.morphology_iterations <= last.morphology_iterations);
+    REQUIRE(next.median_kernel_size <= last.median_kernel_size);
+    REQUIRE(next.segmentation_scale <= last.segmentation_scale);
+    REQUIRE(next.background_update_interval >=
+            last.background_update_interval);
+    REQUIRE(next.median_kernel_size % 2 == 1);
+    const bool gives_up_more =
+        next.morphology_iterations < last.morphology_iterations ||
+        next.median_kernel_size < last.median_kernel_size ||
+        next.segmentation_scale < last.segmentation_scale ||
+        next.background_update_interval > last.background_update_interval ||
+        (levels[level - 1].draw_debug_overlays &&
+         !levels[level].draw_debug_overlays);
+    REQUIRE(gives_up_more);
+  }
+}
+
+TEST_CASE("The quality controller keeps frames within the budget",
+          "[quality-controller]") {
+  QualityController controller(FRAME_BUDGET_MS, WINDOW_FRAMES,
+                               RESTORE_FRACTION);
+  common::MetricsRegistry metrics;
+  controller.SetMetrics(&metrics);
+  const size_t last_level = QualityController::GetQualityLevels().size() - 1;
+  REQUIRE(controller.GetLevel() == 0);
+
+  SECTION("Quality is lowered a step at a time while over budget") {
+    REQUIRE(UpdateWindow(controller, 12));
+    REQUIRE(controller.GetLevel() == 1);
+    REQUIRE(&controller.GetQualityLevel() ==
+            &QualityController::GetQualityLevels()[1]);
+    REQUIRE(UpdateWindow(controller, 12));
+    REQUIRE(controller.GetLevel() == 2);
+    REQUIRE(metrics.GetGauge("quality.level").Get() == 2);
+    REQUIRE(metrics.GetCounter("quality.degradations").Get() == 2);
+  }
+
+  SECTION("A frame at the budget is within it") {
+    REQUIRE_FALSE(UpdateWindow(controller, FRAME_BUDGET_MS));
+    REQUIRE(controller.GetLevel() == 0);
+  }
+
+  SECTION("Decisions are made on the mean of a window") {
+    REQUIRE_FALSE(controller.Update(30));
+    REQUIRE_FALSE(controller.Update(1));
+    REQUIRE(controller.Update(1));
+    REQUIRE(controller.GetLevel() == 1);
+  }
+
+  SECTION("Quality is only restored well within the budget") {
+    REQUIRE(UpdateWindow(controller, 12));
+    REQUIRE(UpdateWindow(controller, 12));
+    // Under budget, but not by enough to step back up.
+    REQUIRE_FALSE(UpdateWindow(controller, 7));
+    REQUIRE_FALSE(UpdateWindow(controller, FRAME_BUDGET_MS * RESTORE_FRACTION));
+    REQUIRE(controller.GetLevel() == 2);
+    REQUIRE(UpdateWindow(controller, 4));
+    REQUIRE(controller.GetLevel() == 1);
+    REQUIRE(UpdateWindow(controller, 4));
+    REQUIRE(controller.GetLevel() == 0);
+    REQUIRE(metrics.GetCounter("quality.restorations").Get() == 2);
+    REQUIRE(metrics.GetGauge("quality.level").Get() == 0);
+  }
+
+  SECTION("The level stays on the ladder") {
+    REQUIRE_FALSE(UpdateWindow(controller, 1));
+    REQUIRE(controller.GetLevel() == 0);
+    for (size_t level = 0; level < last_level; ++level) {
+      REQUIRE(UpdateWindow(controller, 100));
+    }
+    REQUIRE(controller.GetLevel() == last_level);
+    REQUIRE_FALSE(UpdateWindow(controller, 100));
+    REQUIRE(controller.GetLevel() == last_level);
+    REQUIRE(metrics.GetCounter("quality.degradations").Get() == last_level);
+  }
+
+  SECTION("Without metrics nothing is recorded") {
+    controller.SetMetrics(nullptr);
+    REQUIRE(UpdateWindow(controller, 12));
+    REQUIRE(metrics.GetCounter("quality.degradations").Get() == 0);
+  }
+}
+
+TEST_CASE("The quality controller needs valid settings",
+          "[quality-controller]") {
+  REQUIRE_THROWS_AS(QualityController(0, WINDOW_FRAMES, RESTORE_FRACTION),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(QualityController(FRAME_BUDGET_MS, 0, RESTORE_FRACTION),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(QualityController(FRAME_BUDGET_MS, WINDOW_FRAMES, 0),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(QualityController(FRAME_BUDGET_MS, WINDOW_FRAMES, 1),
+                    std::invalid_argument);
+}
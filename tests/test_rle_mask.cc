@@ -0,0 +1,249 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "gesturerecognition/rle_mask.h"
+
+using gesturerecognition::RleMask;
+
+namespace {
+typedef std::vector<std::pair<int, int>> PointList;
+
+/**
+ * Returns the contours as lists of coordinates in a set order, since
+ * cv::findContours and RleMask order them differently.
+ */
+std::vector<PointList> SortContours(
+    const std::vector<std::vector<cv::Point>>& contours) {
+  std::vector<PointList> sorted;
+  for (const std::vector<cv::Point>& contour : contours) {
+    PointList points;
+    for (const cv::Point& point : contour) {
+      points.push_back(std::make_pair(point.x, point.y));
+    }
+    sorted.push_back(points);
+  }
+  std::sort(sorted.begin(), sorted.end());
+  return sorted;
+}
+
+/**
+ * Requires the runs to trace the same outer contours as OpenCV.
+ */
+void RequireSameContours(const cv::Mat& mask) {
+  cv::Mat image = mask.clone();
+  std::vector<std::vector<cv::Point>> expected;
+  cv::findContours(image, expected, cv::RETR_EXTERNAL,
+                   cv::CHAIN_APPROX_SIMPLE);
+  REQUIRE(SortContours(RleMask(mask).FindOuterContours()) ==
+          SortContours(expected));
+}
+
+/**
+ * Returns a mask of a ring around a filled disk, with another disk beside it.
+ * The disk in the ring has more pixels than the one beside it.
+ */
+cv::Mat DrawRingAroundDisk() {
+  cv::Mat mask = cv::Mat::zeros(100, 200, CV_8UC1);
+  cv::circle(mask, cv::Point(50, 50), 30, cv::Scalar(255), 6);
+  cv::circle(mask, cv::Point(50, 50), 16, cv::Scalar(255), cv::FILLED);
+  cv::circle(mask, cv::Point(150, 50), 10, cv::Scalar(255), cv::FILLED);
+  return mask;
+}
+
+/**
+ * Returns the mask a list of encoded bytes decodes to, requiring it to be well
+ * formed or not.
+ */
+RleMask Decode(const std::vector<unsigned char>& data, bool is_well_formed) {
+  RleMask mask(cv::Mat(3, 3, CV_8UC1, cv::Scalar(255)));
+  REQUIRE(mask.Decode(data.data(), data.size()) == is_well_formed);
+  return mask;
+}
+}  // namespace
+
+TEST_CASE("The outer contours of the runs are those OpenCV finds",
+          "[rle-mask]") {
+  SECTION("Blobs of every shape") {
+    cv::Mat mask = cv::Mat::zeros(60, 80, CV_8UC1);
+    cv::rectangle(mask, cv::Rect(0, 0, 10, 60), cv::Scalar(255), cv::FILLED);
+    cv::circle(mask, cv::Point(40, 30), 12, cv::Scalar(255), cv::FILLED);
+    cv::circle(mask, cv::Point(40, 30), 4, cv::Scalar(0), cv::FILLED);
+    cv::line(mask, cv::Point(60, 5), cv::Point(75, 20), cv::Scalar(255));
+    mask.at<uchar>(50, 70) = 255;
+    mask.at<uchar>(59, 79) = 255;
+    RequireSameContours(mask);
+  }
+
+  SECTION("Noise") {
+    cv::Mat noise(57, 63, CV_8UC1);
+    cv::RNG rng(47);
+    rng.fill(noise, cv::RNG::UNIFORM, 0, 256);
+    cv::Mat mask;
+    cv::threshold(noise, mask, 160, 255, cv::THRESH_BINARY);
+    RequireSameContours(mask);
+  }
+
+  SECTION("A blob in the hole of another is left out") {
+    cv::Mat mask = DrawRingAroundDisk();
+    RequireSameContours(mask);
+    // The disk in the ring must not take the place of the other one.
+    std::vector<std::vector<cv::Point>> contours =
+        RleMask(mask).FindOuterContours(2);
+    REQUIRE(contours.size() == 2);
+    REQUIRE(cv::boundingRect(contours[0]) == cv::Rect(17, 17, 67, 67));
+    REQUIRE(cv::boundingRect(contours[1]) == cv::Rect(140, 40, 21, 21));
+  }
+
+  SECTION("An empty mask has none") {
+    REQUIRE(RleMask(cv::Mat::zeros(10, 10, CV_8UC1)).FindOuterContours()
+                .empty());
+  }
+}
+
+TEST_CASE("The area and bounding box are found from the runs", "[rle-mask]") {
+  cv::Mat mask = cv::Mat::zeros(40, 50, CV_8UC1);
+
+  SECTION("An empty mask") {
+    RleMask runs(mask);
+    REQUIRE(runs.GetArea() == 0);
+    REQUIRE(runs.GetBoundingBox() == cv::Rect());
+  }
+
+  SECTION("Rectangles") {
+    cv::rectangle(mask, cv::Rect(3, 5, 10, 4), cv::Scalar(255), cv::FILLED);
+    cv::rectangle(mask, cv::Rect(30, 20, 20, 20), cv::Scalar(255),
+                  cv::FILLED);
+    RleMask runs(mask);
+    REQUIRE(runs.GetArea() == 10 * 4 + 20 * 20);
+    REQUIRE(runs.GetBoundingBox() == cv::Rect(3, 5, 47, 35));
+    REQUIRE(runs.GetBoundingBox() == cv::boundingRect(mask));
+  }
+}
+
+TEST_CASE("Masks are combined on the runs", "[rle-mask]") {
+  cv::Mat first = cv::Mat::zeros(60, 60, CV_8UC1);
+  cv::Mat second = cv::Mat::zeros(60, 60, CV_8UC1);
+  cv::rectangle(first, cv::Rect(10, 10, 20, 20), cv::Scalar(255), cv::FILLED);
+  cv::circle(first, cv::Point(45, 45), 8, cv::Scalar(255), cv::FILLED);
+  cv::rectangle(second, cv::Rect(20, 20, 20, 20), cv::Scalar(255),
+                cv::FILLED);
+  // Touches the first rectangle on its right, so OR joins their runs.
+  cv::rectangle(second, cv::Rect(30, 10, 5, 5), cv::Scalar(255), cv::FILLED);
+  RleMask first_runs(first);
+  RleMask second_runs(second);
+
+  SECTION("AND") {
+    cv::Mat expected;
+    cv::bitwise_and(first, second, expected);
+    cv::Mat result;
+    RleMask runs = first_runs.And(second_runs);
+    runs.ToMat(result);
+    REQUIRE(cv::countNonZero(result != expected) == 0);
+    REQUIRE(runs.GetArea() == cv::countNonZero(expected));
+    REQUIRE(runs.GetRunCount() == RleMask(expected).GetRunCount());
+  }
+
+  SECTION("OR") {
+    cv::Mat expected;
+    cv::bitwise_or(first, second, expected);
+    cv::Mat result;
+    RleMask runs = first_runs.Or(second_runs);
+    runs.ToMat(result);
+    REQUIRE(cv::countNonZero(result != expected) == 0);
+    REQUIRE(runs.GetArea() == cv::countNonZero(expected));
+    REQUIRE(runs.GetRunCount() == RleMask(expected).GetRunCount());
+  }
+
+  SECTION("Masks of different sizes") {
+    RleMask other(cv::Mat::zeros(60, 61, CV_8UC1));
+    REQUIRE_THROWS_AS(first_runs.And(other), std::invalid_argument);
+    REQUIRE_THROWS_AS(first_runs.Or(other), std::invalid_argument);
+  }
+}
+
+TEST_CASE("A mask is the same after it is encoded and decoded", "[rle-mask]") {
+  cv::Mat mask = DrawRingAroundDisk();
+  // Runs reaching both edges and gaps over 127 columns take several bytes.
+  cv::line(mask, cv::Point(0, 99), cv::Point(199, 99), cv::Scalar(255));
+  RleMask runs(mask);
+
+  SECTION("Encode and Decode") {
+    std::vector<unsigned char> data(runs.GetEncodedSize());
+    runs.Encode(data.data());
+    RleMask decoded = Decode(data, true);
+    cv::Mat result;
+    decoded.ToMat(result);
+    REQUIRE(decoded.GetSize() == mask.size());
+    REQUIRE(cv::countNonZero(result != mask) == 0);
+    REQUIRE(decoded.GetRunCount() == runs.GetRunCount());
+
+    SECTION("Truncated") {
+      data.pop_back();
+      REQUIRE(Decode(data, false).IsEmpty());
+    }
+
+    SECTION("With bytes after it") {
+      data.push_back(0);
+      REQUIRE(Decode(data, false).IsEmpty());
+    }
+  }
+
+  SECTION("Write and Read") {
+    std::stringstream stream;
+    runs.Write(stream);
+    RleMask read;
+    read.Read(stream);
+    cv::Mat result;
+    read.ToMat(result);
+    REQUIRE(cv::countNonZero(result != mask) == 0);
+  }
+
+  SECTION("An empty mask") {
+    RleMask empty;
+    std::vector<unsigned char> data(empty.GetEncodedSize());
+    empty.Encode(data.data());
+    REQUIRE(Decode(data, true).IsEmpty());
+  }
+}
+
+TEST_CASE("Corrupt encodings are not decoded", "[rle-mask]") {
+  // A 4 by 1 mask with a single run of 2 pixels from column 1.
+  REQUIRE(Decode({4, 1, 1, 1, 2}, true).GetArea() == 2);
+
+  SECTION("A run past the width") {
+    REQUIRE(Decode({4, 1, 1, 3, 2}, false).IsEmpty());
+  }
+
+  SECTION("A run of no pixels") {
+    REQUIRE(Decode({4, 1, 1, 1, 0}, false).IsEmpty());
+  }
+
+  SECTION("Runs which touch") {
+    REQUIRE(Decode({4, 1, 2, 0, 1, 0, 1}, false).IsEmpty());
+  }
+
+  SECTION("More runs than columns") {
+    REQUIRE(Decode({1, 1, 2, 0, 1}, false).IsEmpty());
+  }
+
+  SECTION("A width without a height") {
+    REQUIRE(Decode({4, 0}, false).IsEmpty());
+  }
+
+  SECTION("A variable length integer which does not end") {
+    REQUIRE(Decode({0x84, 0x80, 0x80, 0x80, 0x80, 0x01, 1, 0}, false)
+                .IsEmpty());
+  }
+
+  SECTION("A stream which does not hold a mask") {
+    std::stringstream stream("not a mask");
+    RleMask mask;
+    REQUIRE_THROWS_AS(mask.Read(stream), std::invalid_argument);
+  }
+}
@@ -0,0 +1,194 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common/shared_memory_bus.h"
+
+using common::BusMessage;
+using common::BusMessageType;
+using common::BusReadResult;
+using common::SharedMemoryBusReader;
+using common::SharedMemoryBusWriter;
+
+namespace {
+const std::string BUS_NAME = "/gesture-piano-test-bus";
+const size_t CAPACITY = 4096;
+const size_t RECORD_HEADER_SIZE = 24;  // Precedes every message in the ring
+
+/**
+ * Returns the payload of the message with the sequence number, in which every
+ * byte differs from the one before it and from those of the next message.
+ */
+std::vector<unsigned char> CreatePayload(uint64_t sequence, size_t size) {
+  std::vector<unsigned char> payload(size);
+  for (size_t i = 0; i < size; ++i) {
+    payload[i] = static_cast<unsigned char>(sequence * 7 + i);
+  }
+  return payload;
+}
+
+/**
+ * Publishes the writer's next message.
+ */
+void Publish(SharedMemoryBusWriter& writer, size_t size) {
+  const uint64_t sequence = writer.GetPublishedMessages();
+  std::vector<unsigned char> payload = CreatePayload(sequence, size);
+  writer.Publish(BusMessageType::FRAME, payload.data(), size,
+                 static_cast<int64_t>(sequence) * 1000);
+}
+
+/**
+ * Requires the reader's next message to be the one Publish published with
+ * the sequence number, whole.
+ */
+BusMessage RequireMessage(SharedMemoryBusReader& reader, uint64_t sequence,
+                          size_t size) {
+  BusMessage message;
+  REQUIRE(reader.Next(message) == BusReadResult::MESSAGE);
+  REQUIRE(message.type == BusMessageType::FRAME);
+  REQUIRE(message.sequence == sequence);
+  REQUIRE(message.timestamp_ns == static_cast<int64_t>(sequence) * 1000);
+  REQUIRE(message.size == size);
+  REQUIRE(std::vector<unsigned char>(message.data, message.data + size) ==
+          CreatePayload(sequence, size));
+  REQUIRE(reader.IsValid(message));
+  return message;
+}
+}  // namespace
+
+TEST_CASE("A reader reads what the writer published", "[shared-memory-bus]") {
+  std::unique_ptr<SharedMemoryBusWriter> writer(
+      new SharedMemoryBusWriter(BUS_NAME, CAPACITY));
+  // Messages published before a reader opens the bus are not read.
+  Publish(*writer, 10);
+  SharedMemoryBusReader reader(BUS_NAME);
+  BusMessage message;
+  REQUIRE(reader.Next(message) == BusReadResult::NO_MESSAGE);
+  REQUIRE_FALSE(reader.Wait(0));
+
+  Publish(*writer, 10);
+  Publish(*writer, 0);
+  REQUIRE(reader.Wait(0));
+  RequireMessage(reader, 1, 10);
+  RequireMessage(reader, 2, 0);
+  REQUIRE(reader.Next(message) == BusReadResult::NO_MESSAGE);
+
+  SECTION("A message written in place") {
+    unsigned char* payload =
+        writer->BeginMessage(BusMessageType::FRAME, 20, 3000);
+    REQUIRE_THROWS_AS(writer->BeginMessage(BusMessageType::FRAME, 20, 3000),
+                      std::logic_error);
+    std::vector<unsigned char> expected = CreatePayload(3, 20);
+    std::copy(expected.begin(), expected.end(), payload);
+    // Until it is ended, readers do not see it.
+    REQUIRE(reader.Next(message) == BusReadResult::NO_MESSAGE);
+    writer->EndMessage();
+    REQUIRE_THROWS_AS(writer->EndMessage(), std::logic_error);
+    RequireMessage(reader, 3, 20);
+  }
+
+  SECTION("Once the writer is gone") {
+    Publish(*writer, 10);
+    writer.reset();
+    // The messages published before it went are still read.
+    RequireMessage(reader, 3, 10);
+    REQUIRE(reader.Next(message) == BusReadResult::CLOSED);
+    REQUIRE(reader.Wait(0));
+    REQUIRE_THROWS_AS(SharedMemoryBusReader(BUS_NAME), std::runtime_error);
+  }
+  REQUIRE(reader.GetOverruns() == 0);
+  REQUIRE(reader.GetLostMessages() == 0);
+}
+
+TEST_CASE("Messages wrap around the end of the ring", "[shared-memory-bus]") {
+  SharedMemoryBusWriter writer(BUS_NAME, CAPACITY);
+  SharedMemoryBusReader reader(BUS_NAME);
+
+  SECTION("A reader which keeps up reads every message") {
+    // Of sizes which leave every amount of space at the end of the ring,
+    // including too little for a message's header.
+    for (uint64_t sequence = 0; sequence < 500; ++sequence) {
+      const size_t size = (sequence * 37) % writer.GetMaxMessageSize();
+      Publish(writer, size);
+      RequireMessage(reader, sequence, size);
+    }
+  }
+
+  SECTION("A reader a few messages behind reads every message") {
+    const size_t size = 300;
+    for (uint64_t sequence = 0; sequence < 500; ++sequence) {
+      Publish(writer, size);
+      if (sequence >= 5) {
+        RequireMessage(reader, sequence - 5, size);
+      }
+    }
+  }
+
+  SECTION("Publishing a message never overwrites the one before") {
+    const size_t size = writer.GetMaxMessageSize();
+    Publish(writer, size);
+    BusMessage last = RequireMessage(reader, 0, size);
+    for (uint64_t sequence = 1; sequence < 50; ++sequence) {
+      Publish(writer, size);
+      REQUIRE(reader.IsValid(last));
+      last = RequireMessage(reader, sequence, size);
+    }
+  }
+  REQUIRE(reader.GetOverruns() == 0);
+  REQUIRE(reader.GetLostMessages() == 0);
+}
+
+TEST_CASE("A reader the writer laps is told so", "[shared-memory-bus]") {
+  SharedMemoryBusWriter writer(BUS_NAME, CAPACITY);
+  SharedMemoryBusReader reader(BUS_NAME);
+  // Four messages fill the ring exactly.
+  const size_t size = CAPACITY / 4 - RECORD_HEADER_SIZE;
+  Publish(writer, size);
+  BusMessage first = RequireMessage(reader, 0, size);
+  for (int message = 0; message < 4; ++message) {
+    Publish(writer, size);
+  }
+  // The first message has been reclaimed, but the second has not yet.
+  REQUIRE_FALSE(reader.IsValid(first));
+  Publish(writer, size);
+
+  // Now the second has been reclaimed too, so everything published so far is
+  // skipped.
+  BusMessage message;
+  REQUIRE(reader.Next(message) == BusReadResult::OVERRUN);
+  REQUIRE(reader.GetOverruns() == 1);
+  REQUIRE(reader.Next(message) == BusReadResult::NO_MESSAGE);
+  Publish(writer, size);
+  RequireMessage(reader, 6, size);
+  REQUIRE(reader.GetLostMessages() == 5);
+}
+
+TEST_CASE("Messages must fit in a third of the ring", "[shared-memory-bus]") {
+  REQUIRE_THROWS_AS(SharedMemoryBusWriter(BUS_NAME, CAPACITY - 1),
+                    std::invalid_argument);
+  SharedMemoryBusWriter writer(BUS_NAME, CAPACITY);
+  SharedMemoryBusReader reader(BUS_NAME);
+  const size_t max_size = writer.GetMaxMessageSize();
+  REQUIRE(max_size < CAPACITY / 3);
+  REQUIRE(max_size > CAPACITY / 4);
+
+  const std::vector<unsigned char> payload(2 * CAPACITY);
+  for (size_t size : {max_size + 1, CAPACITY, 2 * CAPACITY}) {
+    REQUIRE_THROWS_AS(writer.BeginMessage(BusMessageType::FRAME, size, 0),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        writer.Publish(BusMessageType::FRAME, payload.data(), size, 0),
+        std::invalid_argument);
+  }
+  // Nothing was published, and the writer can still publish.
+  BusMessage message;
+  REQUIRE(reader.Next(message) == BusReadResult::NO_MESSAGE);
+  REQUIRE(writer.GetPublishedMessages() == 0);
+  Publish(writer, max_size);
+  RequireMessage(reader, 0, max_size);
+}
@@ -0,0 +1,113 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "common/work_stealing_pool.h"
+
+using common::WorkStealingPool;
+
+namespace {
+const size_t TASK_COUNT = 40;
+
+/**
+ * Returns tasks which each count how often they ran.
+ */
+std::vector<std::function<void()>> CreateCountingTasks(
+    std::vector<std::atomic<int>>& runs) {
+  std::vector<std::function<void()>> tasks;
+  for (size_t task = 0; task < runs.size(); ++task) {
+    tasks.push_back([&runs, task]() { ++runs[task]; });
+  }
+  return tasks;
+}
+
+/**
+ * Requires every task to have run exactly once.
+ */
+void RequireRanOnce(const std::vector<std::atomic<int>>& runs) {
+  for (const std::atomic<int>& task_runs : runs) {
+    REQUIRE(task_runs == 1);
+  }
+}
+}  // namespace
+
+TEST_CASE("A work stealing pool runs every task once", "[work-stealing-pool]") {
+  REQUIRE_THROWS_AS(WorkStealingPool(0), std::invalid_argument);
+  const size_t workers = GENERATE(1, 3, 4);
+  WorkStealingPool pool(workers);
+  REQUIRE(pool.GetWorkerCount() == workers);
+  std::vector<std::atomic<int>> runs(TASK_COUNT);
+  pool.Run(CreateCountingTasks(runs));
+  RequireRanOnce(runs);
+
+  SECTION("Fewer tasks than workers") {
+    std::vector<std::atomic<int>> few_runs(2);
+    pool.Run(CreateCountingTasks(few_runs));
+    RequireRanOnce(few_runs);
+  }
+
+  SECTION("No tasks") {
+    pool.Run({});
+    REQUIRE(pool.GetStolenTasks() == 0);
+  }
+}
+
+TEST_CASE("Workers steal the tasks queued behind a long one",
+          "[work-stealing-pool]") {
+  const size_t workers = 4;
+  WorkStealingPool pool(workers);
+  std::vector<std::atomic<int>> runs(TASK_COUNT);
+  std::vector<std::function<void()>> tasks = CreateCountingTasks(runs);
+  // The first task is dealt to the first worker, and holds it until every
+  // other task has run, so the others have to take the rest of its queue.
+  std::atomic<size_t> others_done(0);
+  for (size_t task = 1; task < TASK_COUNT; ++task) {
+    tasks[task] = [&runs, &others_done, task]() {
+      ++runs[task];
+      ++others_done;
+    };
+  }
+  bool was_held_up = false;
+  tasks[0] = [&runs, &others_done, &was_held_up]() {
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (others_done < TASK_COUNT - 1 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    was_held_up = others_done < TASK_COUNT - 1;
+    ++runs[0];
+  };
+  pool.Run(tasks);
+  REQUIRE_FALSE(was_held_up);
+  RequireRanOnce(runs);
+  REQUIRE(pool.GetStolenTasks() >= TASK_COUNT / workers - 1);
+}
+
+TEST_CASE("A work stealing pool rethrows what a task threw",
+          "[work-stealing-pool]") {
+  const size_t workers = GENERATE(1, 4);
+  WorkStealingPool pool(workers);
+  std::vector<std::atomic<int>> runs(TASK_COUNT);
+  std::vector<std::function<void()>> tasks = CreateCountingTasks(runs);
+  for (size_t task : {0, 3, 17}) {
+    tasks[task] = [&runs, task]() {
+      ++runs[task];
+      throw std::runtime_error("The task failed");
+    };
+  }
+  REQUIRE_THROWS_AS(pool.Run(tasks), std::runtime_error);
+  // The tasks after the ones that threw still ran, each once.
+  RequireRanOnce(runs);
+
+  // Nothing of the failed batch is run again with the next one.
+  std::vector<std::atomic<int>> next_runs(3);
+  pool.Run(CreateCountingTasks(next_runs));
+  RequireRanOnce(next_runs);
+  RequireRanOnce(runs);
+}
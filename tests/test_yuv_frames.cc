@@ -0,0 +1,191 @@
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "gesturerecognition/capture_device.h"
+#include "gesturerecognition/frame_source.h"
+#include "gesturerecognition/skin_table.h"
+
+using gesturerecognition::CaptureDevice;
+using gesturerecognition::CapturedFrame;
+using gesturerecognition::ConvertToBGR;
+using gesturerecognition::DeviceFrameSource;
+using gesturerecognition::FileCaptureDevice;
+using gesturerecognition::FlipFrame;
+using gesturerecognition::PixelFormat;
+using gesturerecognition::YCbCrSkinTable;
+
+namespace {
+const cv::Size FRAME_SIZE(32, 16);
+// About a tenth of random YUV pixels fall in this range.
+const cv::Scalar LOW_SKIN(0, 48, 80);
+const cv::Scalar HIGH_SKIN(20, 255, 255);
+
+/**
+ * Returns a frame of random bytes, each in the middle of a quantisation step
+ * of the skin table, where the table agrees exactly with converting the frame.
+ */
+CapturedFrame MakeRandomFrame(PixelFormat format, cv::RNG& rng) {
+  CapturedFrame frame;
+  frame.format_ = format;
+  if (format == PixelFormat::YUYV) {
+    frame.data_.create(FRAME_SIZE, CV_8UC2);
+  } else {
+    frame.data_.create(FRAME_SIZE.height * 3 / 2, FRAME_SIZE.width, CV_8UC1);
+  }
+  const int shift = 8 - YCbCrSkinTable::BITS_PER_COMPONENT;
+  const size_t bytes = frame.data_.total() * frame.data_.elemSize();
+  for (size_t i = 0; i < bytes; ++i) {
+    frame.data_.data[i] = static_cast<uchar>(
+        (rng.uniform(0, YCbCrSkinTable::LEVELS) << shift) + (1 << (shift - 1)));
+  }
+  return frame;
+}
+
+/**
+ * Writes the frame to a raw file and reads it back the way the pipeline
+ * reads YUV files, through the file-backed capture device.
+ */
+CapturedFrame ReadBackFromFile(const CapturedFrame& frame,
+                               const std::string& file_name) {
+  {
+    std::ofstream file(file_name, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(frame.data_.data),
+               static_cast<std::streamsize>(frame.data_.total() *
+                                            frame.data_.elemSize()));
+  }
+  CapturedFrame read_frame;
+  {
+    DeviceFrameSource source(std::unique_ptr<CaptureDevice>(
+        new FileCaptureDevice(file_name, frame.format_, FRAME_SIZE, 30, 2,
+                              false)));
+    REQUIRE(source.Read(read_frame));
+    // The frame is only valid as long as the source holds its buffer.
+    read_frame.data_ = read_frame.data_.clone();
+  }
+  std::remove(file_name.c_str());
+  return read_frame;
+}
+
+/**
+ * Returns the mask of the frame's skin found by converting the frame to BGR,
+ * then to HSV, and filtering it by the skin's range.
+ */
+cv::Mat ClassifyByConverting(const CapturedFrame& frame) {
+  cv::Mat bgr_image;
+  cv::Mat hsv_image;
+  cv::Mat mask;
+  cv::cvtColor(frame.data_, bgr_image,
+               frame.format_ == PixelFormat::YUYV ? cv::COLOR_YUV2BGR_YUYV
+                                                  : cv::COLOR_YUV2BGR_NV12);
+  cv::cvtColor(bgr_image, hsv_image, cv::COLOR_BGR2HSV);
+  cv::inRange(hsv_image, LOW_SKIN, HIGH_SKIN, mask);
+  return mask;
+}
+
+/**
+ * Returns the bytes of a continuous Mat.
+ */
+std::vector<uchar> GetBytes(const cv::Mat& image) {
+  return std::vector<uchar>(image.data,
+                            image.data + image.total() * image.elemSize());
+}
+}  // namespace
+
+TEST_CASE("The skin table agrees with converting YUV frames",
+          "[skin-table]") {
+  YCbCrSkinTable table;
+  table.Build(LOW_SKIN, HIGH_SKIN);
+  cv::RNG rng(126);
+  CapturedFrame frame;
+
+  SECTION("YUYV") {
+    frame = ReadBackFromFile(MakeRandomFrame(PixelFormat::YUYV, rng),
+                             "test_skin_table.yuyv");
+  }
+
+  SECTION("NV12") {
+    frame = ReadBackFromFile(MakeRandomFrame(PixelFormat::NV12, rng),
+                             "test_skin_table.nv12");
+  }
+
+  cv::Mat mask;
+  table.Classify(frame, mask);
+  cv::Mat expected_mask = ClassifyByConverting(frame);
+  REQUIRE(mask.size() == FRAME_SIZE);
+  REQUIRE(mask.type() == CV_8UC1);
+  // Both skin and other pixels have to be in the frame for the test to mean
+  // anything.
+  REQUIRE(cv::countNonZero(expected_mask) > 0);
+  REQUIRE(cv::countNonZero(expected_mask) < FRAME_SIZE.area());
+  REQUIRE(cv::norm(mask, expected_mask, cv::NORM_INF) == 0);
+}
+
+TEST_CASE("Flipping a YUYV frame", "[flip-frame]") {
+  CapturedFrame frame;
+  CapturedFrame flipped_frame;
+
+  SECTION("Reverses the macropixels and swaps the luma inside them") {
+    // Y0 U0 Y1 V0 Y2 U1 Y3 V1 for each of the two rows.
+    const uchar bytes[] = {10, 20, 11, 30, 12, 40, 13, 50,
+                           14, 60, 15, 70, 16, 80, 17, 90};
+    frame.format_ = PixelFormat::YUYV;
+    frame.data_ = cv::Mat(2, 4, CV_8UC2, const_cast<uchar*>(bytes));
+    FlipFrame(frame, flipped_frame);
+
+    REQUIRE(flipped_frame.format_ == PixelFormat::YUYV);
+    REQUIRE(flipped_frame.data_.size() == frame.data_.size());
+    REQUIRE(flipped_frame.data_.type() == CV_8UC2);
+    REQUIRE(GetBytes(flipped_frame.data_) ==
+            std::vector<uchar>({13, 40, 12, 50, 11, 20, 10, 30,
+                                17, 80, 16, 90, 15, 60, 14, 70}));
+  }
+
+  SECTION("Mirrors the image it converts to") {
+    cv::RNG rng(341);
+    frame = ReadBackFromFile(MakeRandomFrame(PixelFormat::YUYV, rng),
+                             "test_flip_frame.yuyv");
+    FlipFrame(frame, flipped_frame);
+
+    cv::Mat expected_image;
+    cv::flip(ConvertToBGR(frame), expected_image, 1);
+    REQUIRE(cv::norm(ConvertToBGR(flipped_frame), expected_image,
+                     cv::NORM_INF) == 0);
+  }
+}
+
+TEST_CASE("Flipping an NV12 frame", "[flip-frame]") {
+  CapturedFrame frame;
+  CapturedFrame flipped_frame;
+
+  SECTION("Mirrors the luma and keeps each chroma pair in order") {
+    // Two rows of luma, then one row of interleaved U and V.
+    const uchar bytes[] = {1, 2, 3, 4, 5, 6, 7, 8, 20, 30, 40, 50};
+    frame.format_ = PixelFormat::NV12;
+    frame.data_ = cv::Mat(3, 4, CV_8UC1, const_cast<uchar*>(bytes));
+    FlipFrame(frame, flipped_frame);
+
+    REQUIRE(flipped_frame.format_ == PixelFormat::NV12);
+    REQUIRE(flipped_frame.data_.size() == frame.data_.size());
+    REQUIRE(flipped_frame.data_.type() == CV_8UC1);
+    REQUIRE(GetBytes(flipped_frame.data_) ==
+            std::vector<uchar>({4, 3, 2, 1, 8, 7, 6, 5, 40, 50, 20, 30}));
+  }
+
+  SECTION("Mirrors the image it converts to") {
+    cv::RNG rng(341);
+    frame = ReadBackFromFile(MakeRandomFrame(PixelFormat::NV12, rng),
+                             "test_flip_frame.nv12");
+    FlipFrame(frame, flipped_frame);
+
+    cv::Mat expected_image;
+    cv::flip(ConvertToBGR(frame), expected_image, 1);
+    REQUIRE(cv::norm(ConvertToBGR(flipped_frame), expected_image,
+                     cv::NORM_INF) == 0);
+  }
+}